@@ -0,0 +1,127 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "BenchmarkComparison.h"
+#include "BenchmarkResults.h"
+
+#include <cmath>
+
+static bool isNear(double value, double expected)
+{
+    return std::abs(value - expected) < 1e-9;
+}
+
+// 30 frames around a median time, with a small repeating jitter
+static BenchmarkSection makeSection(const char* name, double median)
+{
+    BenchmarkSection section;
+    section.name = name;
+    for (uint32_t frame = 0; frame < 30; frame++)
+    {
+        section.frameTimes.push_back(median + 0.001 * double(int(frame % 7) - 3));
+        section.rayCounts.push_back(0);
+        section.hitCounts.push_back(0);
+    }
+    return section;
+}
+
+static const SectionComparison* findComparison(const BenchmarkComparison& comparison, const char* name)
+{
+    for (const SectionComparison& section : comparison.sections)
+    {
+        if (section.name == name)
+            return &section;
+    }
+    return nullptr;
+}
+
+// Checks the Mann-Whitney U test against a pairwise reference computation, and the section outcomes
+// of a comparison against its thresholds
+bool TestBenchmarkComparison(const TestOptions&)
+{
+    TestReport report("BENCHMARK COMPARISON TEST");
+
+    // The reference values count the pairs where the second sample is larger, ties count half,
+    // and use the same normal approximation with the tie and continuity corrections
+    {
+        const MannWhitneyResult result = MannWhitneyUTest({ 1, 2, 3, 4, 5, 6, 7, 8 }, { 3.5, 5.5, 7.5, 9.5, 10.5, 11.5 });
+        report.Check("U, z and p match the reference without ties", result.u == 39.0 && isNear(result.z, 1.9364916731037083) &&
+            isNear(result.pGreater, 0.030607317477301013) && isNear(result.pLess, 0.9773060354806028));
+    }
+
+    {
+        const MannWhitneyResult result = MannWhitneyUTest({ 1, 2, 2, 3, 3, 3, 4 }, { 2, 3, 3, 4, 4, 5 });
+        report.Check("U, z and p match the reference with ties", result.u == 31.0 && isNear(result.z, 1.486904285332952) &&
+            isNear(result.pGreater, 0.0788927052589825) && isNear(result.pLess, 0.9407675530642273));
+
+        // Without the continuity correction the two p-values would add up to 1
+        const double meanU = 7.0 * 6.0 * 0.5;
+        const double sigma = (result.u - meanU) / result.z;
+        report.Check("The continuity correction is applied", result.pGreater + result.pLess > 1.0 &&
+            isNear(result.pGreater, 0.5 * std::erfc((result.u - meanU - 0.5) / sigma / std::sqrt(2.0))));
+    }
+
+    {
+        const MannWhitneyResult equal = MannWhitneyUTest({ 2, 2, 2 }, { 2, 2 });
+        report.Check("All equal samples are not significant", equal.u == 3.0 && equal.z == 0.0 &&
+            equal.pGreater == 1.0 && equal.pLess == 1.0);
+
+        const MannWhitneyResult empty = MannWhitneyUTest({}, { 1, 2 });
+        report.Check("An empty sample is not significant", empty.pGreater == 1.0 && empty.pLess == 1.0);
+    }
+
+    BenchmarkResults baseline;
+    baseline.sections.push_back(makeSection("Slower", 10.0));
+    baseline.sections.push_back(makeSection("Faster", 5.0));
+    baseline.sections.push_back(makeSection("Below relative threshold", 2.0));
+    baseline.sections.push_back(makeSection("Below absolute threshold", 0.1));
+    baseline.sections.push_back(makeSection("Removed", 1.0));
+
+    BenchmarkResults current;
+    current.sections.push_back(makeSection("Slower", 11.0));
+    current.sections.push_back(makeSection("Faster", 4.0));
+    current.sections.push_back(makeSection("Below relative threshold", 2.04));
+    current.sections.push_back(makeSection("Below absolute threshold", 0.115));
+    current.sections.push_back(makeSection("Added", 1.0));
+
+    const BenchmarkComparisonSettings settings;
+    const BenchmarkComparison comparison = CompareBenchmarkResults(baseline, current, settings);
+
+    auto hasStatus = [&comparison](const char* name, SectionComparisonStatus status)
+    {
+        const SectionComparison* section = findComparison(comparison, name);
+        return section && section->status == status;
+    };
+
+    const SectionComparison* slower = findComparison(comparison, "Slower");
+    report.Check("A slower section is a regression", hasStatus("Slower", SectionComparisonStatus::Regression) &&
+        isNear(slower->baselineMedian, 10.0) && isNear(slower->currentMedian, 11.0) && isNear(slower->relativeChange, 0.1) &&
+        slower->pValue < settings.significanceLevel);
+    report.Check("A faster section is an improvement", hasStatus("Faster", SectionComparisonStatus::Improvement));
+
+    // Both are significant for the U test, the jitter is much smaller than the change
+    report.Check("A change below the relative threshold is ignored", hasStatus("Below relative threshold", SectionComparisonStatus::Unchanged) &&
+        findComparison(comparison, "Below relative threshold")->pValue < settings.significanceLevel);
+    report.Check("A change below the absolute threshold is ignored", hasStatus("Below absolute threshold", SectionComparisonStatus::Unchanged) &&
+        findComparison(comparison, "Below absolute threshold")->pValue < settings.significanceLevel);
+
+    const SectionComparison* added = findComparison(comparison, "Added");
+    report.Check("Sections missing on one side are reported", comparison.sections.size() == 6 &&
+        hasStatus("Removed", SectionComparisonStatus::MissingInCurrent) &&
+        hasStatus("Added", SectionComparisonStatus::MissingInBaseline) && isNear(added->currentMedian, 1.0));
+
+    report.Check("A regression fails the comparison", comparison.HasRegressions() &&
+        !CompareBenchmarkResults(current, current, settings).HasRegressions());
+
+    return report.Finish();
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "BenchmarkResults.h"
+
+#include <json/reader.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+static bool parseJson(const char* text, Json::Value& root)
+{
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    return reader->parse(text, text + strlen(text), &root, &errors);
+}
+
+// True if the text is valid JSON that BenchmarkResultsFromJson rejects without throwing
+static bool isRejected(const char* text)
+{
+    Json::Value root;
+    if (!parseJson(text, root))
+        return false;
+
+    try
+    {
+        BenchmarkResults results;
+        return !BenchmarkResultsFromJson(root, results);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+static bool isNear(double value, double expected)
+{
+    return std::abs(value - expected) < 1e-9;
+}
+
+bool TestBenchmarkResults(const TestOptions& options)
+{
+    TestReport report("BENCHMARK RESULTS TEST");
+
+    // Statistics, compared with values computed by hand
+    {
+        const std::vector<double> even = { 10.0, 20.0, 30.0, 40.0 };
+        report.Check("Percentiles interpolate between ranks", isNear(ComputePercentile(even, 25.0), 17.5) &&
+            isNear(ComputePercentile(even, 50.0), 25.0) && isNear(ComputePercentile(even, 95.0), 38.5));
+        report.Check("Percentiles are clamped to the samples", ComputePercentile(even, 0.0) == 10.0 &&
+            ComputePercentile(even, -5.0) == 10.0 && ComputePercentile(even, 100.0) == 40.0 && ComputePercentile(even, 150.0) == 40.0);
+
+        // Unsorted on purpose, the statistics sort their copy
+        const BenchmarkStatistics odd = ComputeBenchmarkStatistics({ 5.0, 1.0, 4.0, 2.0, 3.0 });
+        report.Check("Odd count statistics", odd.min == 1.0 && odd.max == 5.0 && isNear(odd.mean, 3.0) &&
+            isNear(odd.stddev, std::sqrt(2.5)) && odd.p50 == 3.0 && isNear(odd.p95, 4.8) && isNear(odd.p99, 4.96));
+
+        const BenchmarkStatistics evenStats = ComputeBenchmarkStatistics({ 40.0, 10.0, 30.0, 20.0 });
+        report.Check("Even count statistics", evenStats.min == 10.0 && evenStats.max == 40.0 && isNear(evenStats.mean, 25.0) &&
+            isNear(evenStats.stddev, std::sqrt(500.0 / 3.0)) && isNear(evenStats.p50, 25.0));
+
+        const BenchmarkStatistics single = ComputeBenchmarkStatistics({ 7.0 });
+        report.Check("A single sample is every statistic", single.min == 7.0 && single.max == 7.0 && single.mean == 7.0 &&
+            single.stddev == 0.0 && single.p50 == 7.0 && single.p95 == 7.0 && single.p99 == 7.0);
+
+        const BenchmarkStatistics empty = ComputeBenchmarkStatistics({});
+        report.Check("No samples give zeros", empty.min == 0.0 && empty.max == 0.0 && empty.mean == 0.0 &&
+            empty.stddev == 0.0 && empty.p50 == 0.0 && ComputePercentile({}, 50.0) == 0.0);
+    }
+
+    BenchmarkResults written;
+    written.renderer = "Test";
+    written.width = 1920;
+    written.height = 1080;
+    written.frameCount = 3;
+    written.sections.push_back({ "Frame", { 4.0, 5.0, 6.0 }, { 10, 20, 30 }, { 1, 2, 3 } });
+
+    // Round trip through a file
+    {
+        const std::filesystem::path fileName = options.tempFolder / "rtxdi-benchmark-results-test.json";
+        BenchmarkResults read;
+        const bool roundTrip = WriteBenchmarkResults(written, fileName) && ReadBenchmarkResults(fileName, read);
+        std::filesystem::remove(fileName);
+
+        report.Check("Written results read back", roundTrip &&
+            read.renderer == written.renderer && read.width == written.width && read.height == written.height &&
+            read.frameCount == written.frameCount && read.sections.size() == 1 &&
+            read.sections[0].name == "Frame" && read.sections[0].frameTimes == written.sections[0].frameTimes &&
+            read.sections[0].rayCounts == written.sections[0].rayCounts &&
+            read.sections[0].hitCounts == written.sections[0].hitCounts);
+
+        std::ofstream(fileName) << "{ \"renderer\": ";
+        report.Check("A truncated file is rejected", !ReadBenchmarkResults(fileName, read));
+        std::filesystem::remove(fileName);
+    }
+
+    // Files with the wrong types return false instead of throwing
+    report.Check("A root that isn't an object is rejected", isRejected("[ 1, 2 ]"));
+    report.Check("Missing fields are rejected", isRejected("{ \"sections\": [] }"));
+    report.Check("A string in place of a number is rejected",
+        isRejected("{ \"renderer\": \"x\", \"width\": \"wide\", \"height\": 1, \"frameCount\": 0, \"sections\": [] }"));
+    report.Check("A negative count is rejected",
+        isRejected("{ \"renderer\": \"x\", \"width\": 1, \"height\": 1, \"frameCount\": -1, \"sections\": [] }"));
+    report.Check("A section that isn't an object is rejected",
+        isRejected("{ \"renderer\": \"x\", \"width\": 1, \"height\": 1, \"frameCount\": 0, \"sections\": [ 5 ] }"));
+    report.Check("A non-numeric frame time is rejected",
+        isRejected("{ \"renderer\": \"x\", \"width\": 1, \"height\": 1, \"frameCount\": 1, \"sections\": [ "
+            "{ \"name\": \"Frame\", \"frameTimes\": [ \"slow\" ], \"rayCounts\": [ 0 ], \"hitCounts\": [ 0 ] } ] }"));
+    report.Check("A ray count that isn't an array is rejected",
+        isRejected("{ \"renderer\": \"x\", \"width\": 1, \"height\": 1, \"frameCount\": 1, \"sections\": [ "
+            "{ \"name\": \"Frame\", \"frameTimes\": [ 1.0 ], \"rayCounts\": { }, \"hitCounts\": [ 0 ] } ] }"));
+
+    return report.Finish();
+}
@@ -0,0 +1,156 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "BlasBuildScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace std::chrono;
+
+// Same rounding as ScheduleBlasBuilds
+static uint64_t alignScratchSize(uint64_t size, uint64_t alignment)
+{
+    return alignment > 1 ? (size + alignment - 1) / alignment * alignment : size;
+}
+
+// Checks the scheduler invariants on random inputs and edge cases, and logs the scheduling time of a large input
+bool TestBlasBuildScheduler(const TestOptions&)
+{
+    TestReport report("BLAS BUILD SCHEDULER TEST");
+
+    // Invariants that hold for any input
+    auto validate = [](const std::vector<BlasBuildItem>& items, const std::vector<BlasBuildBatch>& batches, uint64_t budget, uint64_t alignment)
+    {
+        std::vector<uint32_t> seen(items.size(), 0);
+        uint64_t totalSize = 0;
+        uint32_t overBudgetItems = 0;
+
+        for (const BlasBuildItem& item : items)
+        {
+            const uint64_t size = alignScratchSize(item.scratchSize, alignment);
+            if (size > budget)
+                overBudgetItems++;
+            else
+                totalSize += size;
+        }
+
+        for (const BlasBuildBatch& batch : batches)
+        {
+            if (batch.ids.empty())
+                return false;
+
+            uint64_t batchSize = 0;
+            for (uint32_t id : batch.ids)
+            {
+                if (id >= items.size())
+                    return false;
+                seen[id]++;
+                batchSize += alignScratchSize(items[id].scratchSize, alignment);
+            }
+
+            if (batchSize != batch.scratchSize)
+                return false;
+
+            if (batch.overBudget ? batch.ids.size() != 1 || batchSize <= budget : batchSize > budget)
+                return false;
+        }
+
+        for (uint32_t count : seen)
+        {
+            if (count != 1)
+                return false;
+        }
+
+        // First-fit decreasing uses at most 11/9 OPT + 6/9 bins, and OPT is at least the total size over the budget
+        const uint64_t lowerBound = (totalSize + budget - 1) / budget;
+        const uint64_t inBudgetBatches = batches.size() - overBudgetItems;
+        return inBudgetBatches * 9 <= lowerBound * 11 + 6 + 9;
+    };
+
+    std::mt19937 rng(7);
+    const uint64_t alignment = 256;
+    bool randomPassed = true;
+    for (uint32_t test = 0; test < 200; test++)
+    {
+        const uint64_t budget = (uint64_t(1) << (16 + test % 12)) + rng() % 4096;
+        const uint32_t count = 1 + rng() % 2000;
+
+        // Log-uniform sizes, from tiny meshes to ones that exceed the budget
+        std::uniform_real_distribution<double> logSize(4.0, std::log2(double(budget)) + 1.0);
+        std::vector<BlasBuildItem> items(count);
+        for (uint32_t i = 0; i < count; i++)
+            items[i] = BlasBuildItem{ i, uint64_t(std::exp2(logSize(rng))) };
+
+        randomPassed = randomPassed && validate(items, ScheduleBlasBuilds(items, budget, alignment), budget, alignment);
+    }
+    report.Check("Random inputs: budget, coverage and batch count", randomPassed);
+
+    report.Check("Empty input", ScheduleBlasBuilds({}, 1024, alignment).empty());
+
+    {
+        const std::vector<BlasBuildItem> items = { { 0, 0 }, { 1, 0 }, { 2, 0 } };
+        const auto batches = ScheduleBlasBuilds(items, 1024, alignment);
+        report.Check("Zero-size builds share one batch", batches.size() == 1 && validate(items, batches, 1024, alignment));
+    }
+
+    {
+        const std::vector<BlasBuildItem> items = { { 0, 5000 }, { 1, 100 }, { 2, 9000 }, { 3, 200 } };
+        const auto batches = ScheduleBlasBuilds(items, 4096, alignment);
+        report.Check("Oversized builds get their own batch", batches.size() == 3
+            && batches[0].overBudget && batches[0].ids[0] == 2
+            && batches[1].overBudget && batches[1].ids[0] == 0
+            && !batches[2].overBudget && batches[2].ids.size() == 2 && validate(items, batches, 4096, alignment));
+    }
+
+    {
+        // Sizes that fit exactly: 3 + 1, 2 + 2 units
+        const uint64_t unit = 1024;
+        const std::vector<BlasBuildItem> items = { { 0, 2 * unit }, { 1, 3 * unit }, { 2, unit }, { 3, 2 * unit } };
+        const auto batches = ScheduleBlasBuilds(items, 4 * unit, alignment);
+        report.Check("Exact fits", batches.size() == 2 && batches[0].scratchSize == 4 * unit && batches[1].scratchSize == 4 * unit);
+    }
+
+    {
+        std::vector<BlasBuildItem> items;
+        for (uint32_t i = 0; i < 64; i++)
+            items.push_back(BlasBuildItem{ i, 1000 + (i % 4) * 10 });
+        std::vector<BlasBuildItem> shuffled = items;
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+        const auto a = ScheduleBlasBuilds(items, 8192, alignment);
+        const auto b = ScheduleBlasBuilds(shuffled, 8192, alignment);
+        bool same = a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); i++)
+            same = a[i].ids == b[i].ids;
+        report.Check("Deterministic for any input order", same);
+    }
+
+    {
+        std::vector<BlasBuildItem> items(100000);
+        std::uniform_int_distribution<uint64_t> size(1024, 64ull << 20);
+        for (uint32_t i = 0; i < items.size(); i++)
+            items[i] = BlasBuildItem{ i, size(rng) };
+
+        const auto start = steady_clock::now();
+        const auto batches = ScheduleBlasBuilds(items, 256ull << 20, alignment);
+        const double time = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        report.Check("100k builds", validate(items, batches, 256ull << 20, alignment));
+        report.Note("Scheduled 100k builds into %d batches in %.2f ms", int(batches.size()), time);
+    }
+
+    return report.Finish();
+}
@@ -0,0 +1,217 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "BlasDeduplication.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using namespace donut::math;
+using namespace std::chrono;
+
+// Checks hash stability, sensitivity to every input and the handling of forced collisions, and logs the hashing throughput
+bool TestBlasDeduplication(const TestOptions&)
+{
+    TestReport report("BLAS DEDUPLICATION TEST");
+
+    struct MeshData
+    {
+        std::vector<float3> positions;
+        std::vector<uint32_t> indices;
+        std::vector<BlasGeometryRange> geometries;
+
+        [[nodiscard]] BlasMeshView View() const
+        {
+            BlasMeshView view;
+            view.positions = positions.data();
+            view.indices = indices.data();
+            view.vertexCount = uint32_t(positions.size());
+            view.indexCount = uint32_t(indices.size());
+            view.geometries = geometries;
+            view.shareable = true;
+            return view;
+        }
+    };
+
+    std::mt19937 rng(11);
+
+    auto makeMesh = [&rng](uint32_t vertexCount, uint32_t geometryCount)
+    {
+        MeshData mesh;
+        std::uniform_real_distribution<float> coordinate(-10.f, 10.f);
+        for (uint32_t i = 0; i < vertexCount; i++)
+            mesh.positions.push_back(float3(coordinate(rng), coordinate(rng), coordinate(rng)));
+
+        const uint32_t verticesPerGeometry = vertexCount / geometryCount;
+        for (uint32_t g = 0; g < geometryCount; g++)
+        {
+            BlasGeometryRange range;
+            range.vertexOffset = g * verticesPerGeometry;
+            range.vertexCount = (g == geometryCount - 1) ? vertexCount - range.vertexOffset : verticesPerGeometry;
+            range.indexOffset = uint32_t(mesh.indices.size());
+            range.indexCount = range.vertexCount / 3 * 3;
+            range.opaque = (g % 2) == 0;
+            for (uint32_t i = 0; i < range.indexCount; i++)
+                mesh.indices.push_back(rng() % range.vertexCount);
+            mesh.geometries.push_back(range);
+        }
+        return mesh;
+    };
+
+    // Stability: same contents at different addresses, and any thread count
+    {
+        const MeshData a = makeMesh(3000, 3);
+        const MeshData copy = a;
+        const uint64_t hash = HashBlasMesh(a.View());
+
+        std::vector<BlasMeshView> views(64, a.View());
+        bool stable = hash == HashBlasMesh(copy.View()) && hash == HashBlasMesh(a.View()) && hash != 0;
+        for (uint32_t threads : { 1u, 3u, 0u })
+        {
+            for (uint64_t h : HashBlasMeshes(views, threads))
+                stable = stable && h == hash;
+        }
+        report.Check("Hash is stable across copies and thread counts", stable);
+    }
+
+    // Sensitivity: every input that changes the BLAS changes the hash
+    {
+        const MeshData base = makeMesh(999, 3);
+        const uint64_t baseHash = HashBlasMesh(base.View());
+        bool sensitive = true;
+
+        MeshData m = base;
+        uint32_t bits;
+        memcpy(&bits, &m.positions[500].y, sizeof(bits));
+        bits ^= 1;
+        memcpy(&m.positions[500].y, &bits, sizeof(bits));
+        sensitive = sensitive && HashBlasMesh(m.View()) != baseHash && !AreBlasMeshesEqual(m.View(), base.View());
+
+        m = base;
+        m.indices[7] = (m.indices[7] + 1) % m.geometries[0].vertexCount;
+        sensitive = sensitive && HashBlasMesh(m.View()) != baseHash && !AreBlasMeshesEqual(m.View(), base.View());
+
+        m = base;
+        m.geometries[1].opaque = !m.geometries[1].opaque;
+        sensitive = sensitive && HashBlasMesh(m.View()) != baseHash && !AreBlasMeshesEqual(m.View(), base.View());
+
+        m = base;
+        m.geometries[0].indexCount -= 3;
+        m.geometries[1].indexOffset -= 3;
+        m.geometries[1].indexCount += 3;
+        sensitive = sensitive && HashBlasMesh(m.View()) != baseHash && !AreBlasMeshesEqual(m.View(), base.View());
+
+        m = base;
+        m.positions.pop_back();
+        sensitive = sensitive && HashBlasMesh(m.View()) != baseHash && !AreBlasMeshesEqual(m.View(), base.View());
+
+        report.Check("Positions, indices, ranges and opaque flags", sensitive);
+    }
+
+    // A scene with duplicated meshes, some of them not shareable
+    std::vector<MeshData> uniqueMeshes;
+    for (uint32_t i = 0; i < 40; i++)
+        uniqueMeshes.push_back(makeMesh(30 + rng() % 300, 1 + rng() % 4));
+
+    std::vector<MeshData> sceneMeshes;
+    std::vector<uint32_t> sourceMesh;
+    std::vector<bool> shareable;
+    for (uint32_t i = 0; i < 400; i++)
+    {
+        sourceMesh.push_back(rng() % uint32_t(uniqueMeshes.size()));
+        sceneMeshes.push_back(uniqueMeshes[sourceMesh.back()]);
+        shareable.push_back(rng() % 8 != 0);
+    }
+
+    std::vector<BlasMeshView> views;
+    for (size_t i = 0; i < sceneMeshes.size(); i++)
+    {
+        views.push_back(sceneMeshes[i].View());
+        views.back().shareable = shareable[i];
+    }
+
+    // The owner must be the first shareable mesh with the same source, or the mesh itself
+    auto validateOwners = [&](const std::vector<uint32_t>& owners)
+    {
+        for (uint32_t i = 0; i < uint32_t(views.size()); i++)
+        {
+            uint32_t expected = i;
+            if (shareable[i])
+            {
+                for (uint32_t j = 0; j < i; j++)
+                {
+                    if (shareable[j] && sourceMesh[j] == sourceMesh[i])
+                    {
+                        expected = j;
+                        break;
+                    }
+                }
+            }
+            if (owners[i] != expected)
+                return false;
+        }
+        return true;
+    };
+
+    const std::vector<uint64_t> hashes = HashBlasMeshes(views, 0);
+    report.Check("Duplicates share the first BLAS", validateOwners(FindDuplicateBlasMeshes(views, hashes)));
+
+    {
+        bool zeroForUnshareable = true;
+        for (size_t i = 0; i < views.size(); i++)
+            zeroForUnshareable = zeroForUnshareable && (hashes[i] == 0) == !shareable[i];
+        report.Check("Unshareable meshes are never shared", zeroForUnshareable);
+    }
+
+    // Forced collisions: every mesh gets the same hash, or one of a few
+    {
+        const std::vector<uint64_t> sameHash(views.size(), 42);
+        std::vector<uint64_t> fewHashes(views.size());
+        for (size_t i = 0; i < views.size(); i++)
+            fewHashes[i] = sourceMesh[i] % 3;
+
+        report.Check("Full collisions resolved by comparison", validateOwners(FindDuplicateBlasMeshes(views, sameHash)));
+        report.Check("Partial collisions resolved by comparison", validateOwners(FindDuplicateBlasMeshes(views, fewHashes)));
+    }
+
+    // Throughput on large meshes
+    {
+        std::vector<MeshData> largeMeshes;
+        for (uint32_t i = 0; i < 16; i++)
+            largeMeshes.push_back(makeMesh(1 << 19, 4));
+
+        std::vector<BlasMeshView> largeViews;
+        size_t totalBytes = 0;
+        for (const MeshData& mesh : largeMeshes)
+        {
+            largeViews.push_back(mesh.View());
+            totalBytes += mesh.positions.size() * sizeof(float3) + mesh.indices.size() * sizeof(uint32_t);
+        }
+
+        auto start = steady_clock::now();
+        const std::vector<uint64_t> serial = HashBlasMeshes(largeViews, 1);
+        const double serialTime = duration<double>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        const std::vector<uint64_t> parallel = HashBlasMeshes(largeViews, 0);
+        const double parallelTime = duration<double>(steady_clock::now() - start).count();
+
+        report.Check("Parallel hashes match serial hashes", serial == parallel);
+
+        report.Note("Hashed %.0f MB: %.2f GB/s on 1 thread, %.2f GB/s on all threads",
+            double(totalBytes) / (1 << 20), double(totalBytes) / serialTime * 1e-9, double(totalBytes) / parallelTime * 1e-9);
+    }
+
+    return report.Finish();
+}
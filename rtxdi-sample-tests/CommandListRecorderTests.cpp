@@ -0,0 +1,109 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "CommandListRecorder.h"
+
+#include <atomic>
+#include <chrono>
+
+using namespace std::chrono;
+
+// Runs fake recording jobs through the recorder and checks that each runs once, that they overlap on the workers
+// and that the frames don't mix
+bool TestCommandListRecorder(const TestOptions&)
+{
+    TestReport report("COMMAND LIST RECORDER TEST");
+
+    // Fake recordings sleep, which is enough to observe the overlap on any number of cores
+    const auto recordTime = milliseconds(10);
+    std::atomic<int> running = 0;
+    std::atomic<int> maxRunning = 0;
+
+    auto fakeJob = [&](std::atomic<int>& calls, std::thread::id* thread = nullptr)
+    {
+        return [&calls, &running, &maxRunning, recordTime, thread]
+        {
+            const int nowRunning = ++running;
+            int previousMax = maxRunning;
+            while (nowRunning > previousMax && !maxRunning.compare_exchange_weak(previousMax, nowRunning))
+                ;
+            if (thread)
+                *thread = std::this_thread::get_id();
+            std::this_thread::sleep_for(recordTime);
+            ++calls;
+            --running;
+        };
+    };
+
+    {
+        CommandListRecorder recorder(nullptr, 0);
+        std::atomic<int> calls[4] = {};
+        std::thread::id threads[4];
+        std::vector<CommandListRecorder::Job> jobs;
+        for (int i = 0; i < 4; i++)
+            jobs.push_back(fakeJob(calls[i], &threads[i]));
+
+        maxRunning = 0;
+        recorder.Run(jobs);
+
+        bool onCaller = true;
+        for (int i = 0; i < 4; i++)
+            onCaller = onCaller && calls[i] == 1 && threads[i] == std::this_thread::get_id();
+        report.Check("Without workers the jobs run on the calling thread", onCaller && maxRunning == 1);
+        report.Check("Statistics count the jobs", recorder.GetStatistics().jobs == 4 && recorder.GetStatistics().jobTime >= 35.0);
+    }
+
+    {
+        CommandListRecorder recorder(nullptr, 3);
+        std::atomic<int> calls[4] = {};
+        std::vector<CommandListRecorder::Job> jobs;
+        for (int i = 0; i < 4; i++)
+            jobs.push_back(fakeJob(calls[i]));
+
+        maxRunning = 0;
+        recorder.Run(jobs);
+
+        bool once = true;
+        for (int i = 0; i < 4; i++)
+            once = once && calls[i] == 1;
+        report.Check("Each job runs once", once);
+        report.Check("Jobs overlap on the workers and the caller", maxRunning == 4);
+
+        const CommandListRecorder::Statistics& statistics = recorder.GetStatistics();
+        report.Check("Wall time is shorter than the summed job time", statistics.wallTime < statistics.jobTime * 0.5);
+
+        recorder.Run({});
+        report.Check("An empty frame returns", recorder.GetStatistics().jobs == 0);
+    }
+
+    {
+        // Many short frames in a row: a job that runs twice or late would show up in the counts
+        CommandListRecorder recorder(nullptr, 3);
+        std::vector<int> counts(8);
+        bool framesSeparate = true;
+        for (int frame = 0; frame < 2000; frame++)
+        {
+            std::vector<CommandListRecorder::Job> jobs;
+            for (int i = 0; i < int(counts.size()); i++)
+                jobs.push_back([&counts, i] { counts[i]++; });
+
+            recorder.Run(jobs);
+
+            for (int count : counts)
+                framesSeparate = framesSeparate && count == frame + 1;
+        }
+        report.Check("Consecutive frames don't mix their jobs", framesSeparate);
+    }
+
+    return report.Finish();
+}
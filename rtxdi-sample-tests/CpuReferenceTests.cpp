@@ -0,0 +1,262 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "CpuReference/CpuReferenceRenderer.h"
+#include "CpuReference/HlslCompat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace hlsl
+{
+namespace
+{
+#define in
+#include "../shaders/PolymorphicLight.hlsli"
+#undef in
+}
+}
+
+using namespace donut::math;
+
+namespace
+{
+    constexpr uint32_t c_ImageSize = 32;
+    constexpr uint32_t c_BlockSize = 8;
+    constexpr uint32_t c_FrameCount = 128;
+
+    struct TestScene
+    {
+        std::shared_ptr<CpuReferenceScene> scene;
+        RTXDI_LightBufferParameters lightBufferParams = {};
+    };
+
+    void addQuad(CpuReferenceScene& scene, const float3& corner, const float3& edge1, const float3& edge2, uint32_t material)
+    {
+        const float3 vertices[6] = { corner, corner + edge1, corner + edge1 + edge2, corner, corner + edge1 + edge2, corner + edge2 };
+        scene.trianglePositions.insert(scene.trianglePositions.end(), vertices, vertices + 6);
+        scene.triangleMaterials.insert(scene.triangleMaterials.end(), 2, material);
+    }
+
+    PolymorphicLightInfo makeLight(PolymorphicLightType type, const float3& center, const float3& radiance)
+    {
+        PolymorphicLightInfo lightInfo = {};
+        hlsl::packLightColor(radiance, lightInfo);
+        lightInfo.center = center;
+        lightInfo.colorTypeAndFlags |= uint32_t(type) << kPolymorphicLightTypeShift;
+        return lightInfo;
+    }
+
+    // A floor and a back wall lit by an emissive panel, a small rect light and a directional light.
+    // A plate under the panel casts a shadow, so that the visibility of the reused samples matters.
+    TestScene createTestScene()
+    {
+        TestScene result;
+        result.scene = std::make_shared<CpuReferenceScene>();
+        CpuReferenceScene& scene = *result.scene;
+
+        CpuReferenceMaterial diffuse;
+        diffuse.diffuseAlbedo = 0.7f;
+        diffuse.roughness = 1.f;
+
+        CpuReferenceMaterial glossy;
+        glossy.diffuseAlbedo = float3(0.2f, 0.3f, 0.5f);
+        glossy.specularF0 = 0.5f;
+        glossy.roughness = 0.3f;
+
+        scene.materials = { diffuse, glossy };
+
+        addQuad(scene, float3(-3.f, 0.f, 0.f), float3(6.f, 0.f, 0.f), float3(0.f, 0.f, 6.f), 0);
+        addQuad(scene, float3(-3.f, 0.f, 6.f), float3(6.f, 0.f, 0.f), float3(0.f, 3.f, 0.f), 1);
+        addQuad(scene, float3(-0.6f, 1.f, 2.4f), float3(1.2f, 0.f, 0.f), float3(0.f, 0.f, 1.2f), 0);
+
+        // The emissive panel faces down, its triangles are geometry and lights like in BuildCpuReferenceScene
+        const float3 panelCorner = float3(-1.f, 2.5f, 2.f);
+        const float3 panelEdge1 = float3(2.f, 0.f, 0.f);
+        const float3 panelEdge2 = float3(0.f, 0.f, 2.f);
+        addQuad(scene, panelCorner, panelEdge1, panelEdge2, 0);
+
+        for (uint32_t triangle = 0; triangle < 2; triangle++)
+        {
+            const float3* vertices = &scene.trianglePositions[scene.trianglePositions.size() - 6 + triangle * 3];
+            hlsl::TriangleLight light;
+            light.base = vertices[0];
+            light.edge1 = vertices[1] - vertices[0];
+            light.edge2 = vertices[2] - vertices[0];
+            light.radiance = float3(4.f, 3.5f, 3.f);
+            scene.lights.push_back(light.Store());
+        }
+
+        PolymorphicLightInfo rect = makeLight(PolymorphicLightType::kRect, float3(2.f, 2.f, 1.5f), float3(20.f, 15.f, 10.f));
+        rect.scalars = hlsl::f32tof16(0.5f) | (hlsl::f32tof16(0.5f) << 16);
+        rect.direction1 = hlsl::ndirToOctUnorm32(hlsl::float3(1.f, 0.f, 0.f));
+        rect.direction2 = hlsl::ndirToOctUnorm32(hlsl::float3(0.f, 0.f, 1.f));
+        scene.lights.push_back(rect);
+
+        const float halfAngle = 0.05f;
+        PolymorphicLightInfo directional = makeLight(PolymorphicLightType::kDirectional, 0.f, float3(150.f));
+        directional.direction1 = hlsl::ndirToOctUnorm32(normalize(hlsl::float3(0.3f, -1.f, 0.4f)));
+        directional.scalars = hlsl::f32tof16(halfAngle) | (hlsl::f32tof16(2.f * PI_f * (1.f - std::cos(halfAngle))) << 16);
+        scene.lights.push_back(directional);
+
+        result.lightBufferParams.localLightBufferRegion.firstLightIndex = 0;
+        result.lightBufferParams.localLightBufferRegion.numLights = 3;
+        result.lightBufferParams.infiniteLightBufferRegion.firstLightIndex = 3;
+        result.lightBufferParams.infiniteLightBufferRegion.numLights = 1;
+
+        return result;
+    }
+
+    // Perspective camera at the position looking along +Z, with the reverse-Z projection of the sample:
+    // the clip W is the view depth and the clip Z is the near plane distance.
+    void fillViewConstants(PlanarViewConstants& view, const float3& position, float verticalFov)
+    {
+        const float f = 1.f / std::tan(verticalFov * 0.5f);
+        const float zNear = 0.1f;
+
+        view.matWorldToClip = float4x4{
+            float4(f, 0.f, 0.f, 0.f),
+            float4(0.f, f, 0.f, 0.f),
+            float4(0.f, 0.f, 0.f, 1.f),
+            float4(-position.x * f, -position.y * f, zNear, -position.z) };
+
+        view.matClipToWorld = float4x4{
+            float4(1.f / f, 0.f, 0.f, 0.f),
+            float4(0.f, 1.f / f, 0.f, 0.f),
+            float4(position.x / zNear, position.y / zNear, position.z / zNear, 1.f / zNear),
+            float4(0.f, 0.f, 1.f, 0.f) };
+
+        view.viewportSize = float2(float(c_ImageSize));
+        view.viewportSizeInv = float2(1.f / float(c_ImageSize));
+        view.cameraDirectionOrPosition = float4(position, 1.f);
+    }
+
+    ResamplingConstants createConstants(const TestScene& testScene)
+    {
+        ResamplingConstants constants = {};
+        fillViewConstants(constants.view, float3(0.f, 1.6f, -2.5f), radians(60.f));
+        constants.prevView = constants.view;
+        constants.lightBufferParams = testScene.lightBufferParams;
+
+        ReSTIRDI_InitialSamplingParameters& initial = constants.restirDI.initialSamplingParams;
+        initial.numPrimaryLocalLightSamples = 4;
+        initial.numPrimaryInfiniteLightSamples = 1;
+        initial.enableInitialVisibility = true;
+
+        // Raytraced bias correction, the other modes are biased in the shadows
+        ReSTIRDI_TemporalResamplingParameters& temporal = constants.restirDI.temporalResamplingParams;
+        temporal.temporalDepthThreshold = 0.1f;
+        temporal.temporalNormalThreshold = 0.5f;
+        temporal.maxHistoryLength = 20;
+        temporal.temporalBiasCorrection = ReSTIRDI_TemporalBiasCorrectionMode::Raytraced;
+
+        ReSTIRDI_SpatialResamplingParameters& spatial = constants.restirDI.spatialResamplingParams;
+        spatial.spatialDepthThreshold = 0.1f;
+        spatial.spatialNormalThreshold = 0.5f;
+        spatial.spatialBiasCorrection = ReSTIRDI_SpatialBiasCorrectionMode::Raytraced;
+        spatial.numSpatialSamples = 4;
+        spatial.spatialSamplingRadius = 16.f;
+
+        constants.restirDI.shadingParams.enableFinalVisibility = true;
+
+        return constants;
+    }
+
+    float calcLuminance(const float3& color)
+    {
+        return dot(color, float3(0.299f, 0.587f, 0.114f));
+    }
+
+    // Average luminance of the frames over blocks of pixels, which averages out most of the noise
+    std::vector<double> renderBlocks(const TestScene& testScene, rtxdi::ReSTIRDI_ResamplingMode resamplingMode, double& time)
+    {
+        CpuReferenceRenderer renderer;
+        renderer.SetScene(testScene.scene);
+        ResamplingConstants constants = createConstants(testScene);
+
+        constexpr uint32_t blocksPerRow = c_ImageSize / c_BlockSize;
+        std::vector<double> blocks(blocksPerRow * blocksPerRow, 0.0);
+
+        for (uint32_t frame = 0; frame < c_FrameCount; frame++)
+        {
+            constants.frameIndex = frame;
+            renderer.RenderFrame(constants, resamplingMode);
+
+            const std::vector<float3>& output = renderer.GetOutput();
+            for (uint32_t y = 0; y < c_ImageSize; y++)
+            for (uint32_t x = 0; x < c_ImageSize; x++)
+                blocks[x / c_BlockSize + (y / c_BlockSize) * blocksPerRow] += calcLuminance(output[x + y * c_ImageSize]);
+        }
+
+        for (double& block : blocks)
+            block /= double(c_FrameCount * c_BlockSize * c_BlockSize);
+
+        time = renderer.GetStats().totalTime;
+        return blocks;
+    }
+
+    double mean(const std::vector<double>& values)
+    {
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        return values.empty() ? 0.0 : sum / double(values.size());
+    }
+}
+
+// Renders a synthetic scene with the CPU reference in the no-reuse, temporal and spatial modes and checks that the
+// resampling modes converge to the no-reuse image. No scene file or graphics device is needed.
+bool TestCpuReference(const TestOptions&)
+{
+    TestReport report("CPU REFERENCE TEST");
+
+    const TestScene testScene = createTestScene();
+
+    double referenceTime = 0.0;
+    const std::vector<double> reference = renderBlocks(testScene, rtxdi::ReSTIRDI_ResamplingMode::None, referenceTime);
+    const double referenceMean = mean(reference);
+
+    if (!report.Check("The scene is lit", referenceMean > 0.0 && std::isfinite(referenceMean)))
+        return report.Finish();
+
+    report.Note("%ux%u, %u frames per mode, mean luminance %.4f, no reuse %.1f ms", c_ImageSize, c_ImageSize, c_FrameCount, referenceMean, referenceTime);
+
+    const struct
+    {
+        const char* name;
+        rtxdi::ReSTIRDI_ResamplingMode mode;
+    } modes[] = {
+        { "Temporal", rtxdi::ReSTIRDI_ResamplingMode::Temporal },
+        { "Spatial", rtxdi::ReSTIRDI_ResamplingMode::Spatial }
+    };
+
+    for (const auto& mode : modes)
+    {
+        double time = 0.0;
+        const std::vector<double> blocks = renderBlocks(testScene, mode.mode, time);
+
+        // Relative to the block, or to a fraction of the image mean for the blocks in the shadows
+        double maxBlockError = 0.0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            maxBlockError = std::max(maxBlockError, std::abs(blocks[i] - reference[i]) / std::max(reference[i], 0.2 * referenceMean));
+
+        const double meanError = std::abs(mean(blocks) - referenceMean) / referenceMean;
+
+        report.Check(std::string(mode.name) + " mean matches no reuse", meanError < 0.02);
+        report.Check(std::string(mode.name) + " blocks match no reuse", maxBlockError < 0.1);
+        report.Note("%-8s mean error %.2f%%, max block error %.2f%%, %.1f ms", mode.name, meanError * 100.0, maxBlockError * 100.0, time);
+    }
+
+    return report.Finish();
+}
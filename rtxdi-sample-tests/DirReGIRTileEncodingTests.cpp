@@ -0,0 +1,121 @@
+/***************************************************************************
+ # Copyright (c) 2020-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "DirReGIRTileEncoding.h"
+#include "../shaders/DirReGIRParameters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+bool TestDirReGIRTileEncoding(const TestOptions&)
+{
+    TestReport report("DIRREGIR TILE ENCODING TEST");
+
+    const double minLog2Weight = DIRREGIR_PACKED_MIN_LOG2_WEIGHT;
+    const double maxLog2Weight = DIRREGIR_PACKED_MAX_LOG2_WEIGHT;
+
+    // Rounding to the nearest code is off by half a step in log2 space at most, plus float precision
+    const double log2Step = (maxLog2Weight - minLog2Weight) / double(DIRREGIR_PACKED_WEIGHT_MAX_CODE - 1);
+    const double maxRelativeErrorBound = std::exp2(0.5 * log2Step) - 1.0 + 1e-5;
+
+    // Log-uniform weights over the representable range with random indices
+    {
+        const uint32_t sampleCount = 65536;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> log2WeightDist(static_cast<float>(minLog2Weight), static_cast<float>(maxLog2Weight));
+        std::uniform_int_distribution<uint32_t> lightIndexDist(0, DIRREGIR_PACKED_INVALID_INDEX - 1);
+
+        uint32_t roundTripFailures = 0;
+        double meanRelativeError = 0.0;
+        double maxRelativeError = 0.0;
+
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            const float weight = std::exp2(log2WeightDist(rng));
+            const uint32_t lightIndex = lightIndexDist(rng);
+            const bool compact = (i & 1) != 0;
+
+            uint32_t decodedIndex;
+            bool decodedCompact;
+            float decodedWeight;
+            if (!UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(lightIndex, compact, weight), decodedIndex, decodedCompact, decodedWeight)
+                || decodedIndex != lightIndex || decodedCompact != compact)
+            {
+                roundTripFailures++;
+                continue;
+            }
+
+            const double relativeError = std::abs(double(decodedWeight) - double(weight)) / double(weight);
+            meanRelativeError += relativeError;
+            maxRelativeError = std::max(maxRelativeError, relativeError);
+        }
+        meanRelativeError /= double(sampleCount);
+
+        report.Check("Indices and compact flags round-trip", roundTripFailures == 0);
+        report.Check("Weight error is within half a quantization step", maxRelativeError <= maxRelativeErrorBound);
+        report.Check("Mean weight error is below the bound", meanRelativeError < maxRelativeErrorBound * 0.75);
+        report.Note("Weight error: mean %.3f%%, max %.3f%%, bound %.3f%%",
+            meanRelativeError * 100.0, maxRelativeError * 100.0, maxRelativeErrorBound * 100.0);
+    }
+
+    // Every code decodes to a weight that encodes back to the same code
+    {
+        bool stable = true;
+        bool increasing = true;
+        float previous = 0.f;
+        for (uint32_t code = 1; code <= DIRREGIR_PACKED_WEIGHT_MAX_CODE; code++)
+        {
+            const float weight = DecodeDirReGIRWeight(code);
+            stable = stable && EncodeDirReGIRWeight(weight) == code;
+            increasing = increasing && weight > previous;
+            previous = weight;
+        }
+        report.Check("Codes decode and encode back to themselves", stable);
+        report.Check("Decoded weights increase with the code", increasing);
+    }
+
+    // Weights outside of the range are clamped, and non-positive weights are invalid entries
+    {
+        const float minWeight = float(std::exp2(minLog2Weight));
+        const float maxWeight = float(std::exp2(maxLog2Weight));
+        report.Check("Weights outside of the range are clamped",
+            EncodeDirReGIRWeight(minWeight * 1e-3f) == 1 &&
+            EncodeDirReGIRWeight(maxWeight * 1e3f) == DIRREGIR_PACKED_WEIGHT_MAX_CODE);
+
+        uint32_t index;
+        bool compact;
+        float weight;
+        report.Check("Zero and negative weights are invalid entries",
+            !UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(5, false, 0.f), index, compact, weight) &&
+            !UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(5, false, -1.f), index, compact, weight) &&
+            !UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(5, false, NAN), index, compact, weight));
+    }
+
+    // The largest light index that fits, and the buffer sizes that the host accepts for the packed encodings
+    {
+        uint32_t index;
+        bool compact;
+        float weight;
+        const bool lastIndexFits = UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(DIRREGIR_PACKED_INVALID_INDEX - 1, true, 1.f), index, compact, weight)
+            && index == DIRREGIR_PACKED_INVALID_INDEX - 1 && compact;
+        const bool overflowIsInvalid = !UnpackDirReGIRTileEntry(PackDirReGIRTileEntry(DIRREGIR_PACKED_INVALID_INDEX, true, 1.f), index, compact, weight);
+        report.Check("Light indices up to 2^20 - 2 fit, larger are invalid", lastIndexFits && overflowIsInvalid);
+
+        report.Check("Light buffers above 2^20 - 1 need the full encoding",
+            IsDirReGIRPackedEncodingSupported(DIRREGIR_PACKED_INVALID_INDEX) &&
+            !IsDirReGIRPackedEncodingSupported(DIRREGIR_PACKED_INVALID_INDEX + 1));
+    }
+
+    return report.Finish();
+}
@@ -0,0 +1,229 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "EnvironmentAliasTable.h"
+#include "EnvironmentPdf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace std::chrono;
+
+// Same expression as the shader and EnvironmentAliasTable.cpp
+static float getTexelThreshold(const EnvironmentAliasTexel& texel)
+{
+    return float(texel.aliasAndThreshold >> 16) / 65535.f;
+}
+
+// Checks the stored probabilities against the ones implied by the tables, runs a chi-square test of sampled
+// texels against the pixel weights, then logs the build throughput.
+bool TestEnvironmentAliasTable(const TestOptions&)
+{
+    TestReport report("ENVIRONMENT ALIAS TABLE TEST");
+
+    // An environment map with a sun, a black row, NaN, infinite, negative and very bright pixels,
+    // with a width that is not a power of 2
+    const uint32_t width = 250;
+    const uint32_t height = 125;
+    const uint32_t blackRow = 7;
+    std::vector<float> pixels(size_t(width) * height * 4);
+    {
+        std::mt19937 rng(5);
+        std::exponential_distribution<float> radiance(1.f);
+        for (size_t i = 0; i < size_t(width) * height; i++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+                pixels[i * 4 + c] = radiance(rng);
+        }
+
+        const float specials[] = { std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), -5.f, 1e3f, 0.f };
+        for (uint32_t i = 0; i < 200; i++)
+            pixels[(rng() % (width * height)) * 4 + rng() % 3] = specials[i % 5];
+
+        for (uint32_t y = 30; y < 33; y++)
+        {
+            for (uint32_t x = 150; x < 153; x++)
+                pixels[(size_t(y) * width + x) * 4 + 1] = 5000.f;
+        }
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+                pixels[(size_t(blackRow) * width + x) * 4 + c] = 0.f;
+        }
+    }
+
+    std::vector<double> weights(size_t(width) * height);
+    double weightSum = 0.0;
+    {
+        std::vector<float> row(width);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            ComputeEnvironmentWeightRow(pixels.data() + size_t(y) * width * 4, width, y, height, std::numeric_limits<float>::max(), row.data());
+            for (uint32_t x = 0; x < width; x++)
+            {
+                weights[size_t(y) * width + x] = row[x];
+                weightSum += row[x];
+            }
+        }
+    }
+
+    EnvironmentAliasTable serial;
+    EnvironmentAliasTable parallel;
+    const bool built = BuildEnvironmentAliasTable(pixels.data(), width, height, 1, serial)
+        && BuildEnvironmentAliasTable(pixels.data(), width, height, 0, parallel);
+    if (!report.Check("Tables are built", built && serial.texels.size() == weights.size() && serial.rows.size() == height))
+        return report.Finish();
+
+    {
+        bool same = parallel.rows.size() == serial.rows.size();
+        for (size_t i = 0; same && i < serial.texels.size(); i++)
+        {
+            same = serial.texels[i].pdf == parallel.texels[i].pdf
+                && serial.texels[i].aliasAndThreshold == parallel.texels[i].aliasAndThreshold;
+        }
+        for (size_t i = 0; same && i < serial.rows.size(); i++)
+            same = serial.rows[i].threshold == parallel.rows[i].threshold && serial.rows[i].alias == parallel.rows[i].alias;
+        report.Check("Multi-threaded result matches single-threaded", same);
+    }
+
+    {
+        // Enumerate every outcome of the lookup and compare with the stored probabilities
+        std::vector<double> rowProbabilities(height, 0.0);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            rowProbabilities[y] += double(serial.rows[y].threshold) / height;
+            rowProbabilities[serial.rows[y].alias] += (1.0 - double(serial.rows[y].threshold)) / height;
+        }
+
+        std::vector<double> implied(weights.size(), 0.0);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const EnvironmentAliasTexel& texel = serial.texels[size_t(y) * width + x];
+                const double threshold = getTexelThreshold(texel);
+                implied[size_t(y) * width + x] += rowProbabilities[y] * threshold / width;
+                implied[size_t(y) * width + (texel.aliasAndThreshold & 0xffff)] += rowProbabilities[y] * (1.0 - threshold) / width;
+            }
+        }
+
+        bool exact = true;
+        double pdfSum = 0.0;
+        double totalVariation = 0.0;
+        bool zeroNeverSampled = true;
+        for (size_t i = 0; i < implied.size(); i++)
+        {
+            const double pdf = serial.texels[i].pdf;
+            exact = exact && std::abs(pdf - implied[i]) <= 1e-6 * implied[i] + 1e-12;
+            pdfSum += pdf;
+            totalVariation += std::abs(pdf - weights[i] / weightSum);
+            if (weights[i] == 0.0)
+                zeroNeverSampled = zeroNeverSampled && implied[i] == 0.0 && pdf == 0.0;
+        }
+
+        report.Check("Stored probabilities match the tables", exact);
+        report.Check("Probabilities sum to one", std::abs(pdfSum - 1.0) < 1e-5);
+        report.Check("Probabilities match the normalized weights", totalVariation * 0.5 < 1e-3);
+        report.Check("Zero weights are never sampled", zeroNeverSampled && weights[size_t(blackRow) * width] == 0.0);
+    }
+
+    {
+        // Chi-square test of the sampled texels against the pixel weights, bins with few expected samples are merged
+        const uint32_t sampleCount = 1 << 23;
+        std::mt19937 rng(11);
+        auto random = [&rng]() { return float(rng() >> 8) * (1.f / 16777216.f); };
+
+        std::vector<uint32_t> histogram(weights.size(), 0);
+        bool pdfsMatch = true;
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            const float rowRandom = random();
+            const float rowAliasRandom = random();
+            const float columnRandom = random();
+            const float columnAliasRandom = random();
+
+            uint32_t x, y;
+            float pdf;
+            SampleEnvironmentAliasTable(serial, rowRandom, rowAliasRandom, columnRandom, columnAliasRandom, x, y, pdf);
+            histogram[size_t(y) * width + x]++;
+            pdfsMatch = pdfsMatch && pdf > 0.f && pdf == serial.texels[size_t(y) * width + x].pdf;
+        }
+
+        double chiSquare = 0.0;
+        uint32_t bins = 0;
+        double pooledExpected = 0.0;
+        double pooledObserved = 0.0;
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            const double expected = double(sampleCount) * weights[i] / weightSum;
+            if (expected < 5.0)
+            {
+                pooledExpected += expected;
+                pooledObserved += histogram[i];
+                continue;
+            }
+
+            const double difference = double(histogram[i]) - expected;
+            chiSquare += difference * difference / expected;
+            bins++;
+        }
+        if (pooledExpected >= 5.0)
+        {
+            const double difference = pooledObserved - pooledExpected;
+            chiSquare += difference * difference / pooledExpected;
+            bins++;
+        }
+
+        // Wilson-Hilferty approximation of the 99.9th percentile of the chi-square distribution
+        const double dof = double(bins - 1);
+        const double z = 3.09;
+        const double term = 1.0 - 2.0 / (9.0 * dof) + z * std::sqrt(2.0 / (9.0 * dof));
+        const double critical = dof * term * term * term;
+
+        report.Check("Sampled texels report their stored probability", pdfsMatch);
+        report.Check("Chi-square test against the pixel weights", chiSquare < critical);
+
+        report.Note("Chi-square: %.1f with %u degrees of freedom, critical value %.1f at p = 0.001",
+            chiSquare, bins - 1, critical);
+    }
+
+    {
+        // A typical HDRI size
+        const uint32_t benchmarkWidth = 4096;
+        const uint32_t benchmarkHeight = 2048;
+        std::vector<float> benchmarkPixels(size_t(benchmarkWidth) * benchmarkHeight * 4);
+        std::mt19937 rng(7);
+        std::exponential_distribution<float> radiance(1.f);
+        for (float& value : benchmarkPixels)
+            value = radiance(rng);
+
+        EnvironmentAliasTable table;
+
+        auto start = steady_clock::now();
+        BuildEnvironmentAliasTable(benchmarkPixels.data(), benchmarkWidth, benchmarkHeight, 1, table);
+        const double serialTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        BuildEnvironmentAliasTable(benchmarkPixels.data(), benchmarkWidth, benchmarkHeight, 0, table);
+        const double parallelTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        report.Note("%ux%u alias tables: %.1f ms on 1 thread, %.1f ms on all threads",
+            benchmarkWidth, benchmarkHeight, serialTime, parallelTime);
+    }
+
+    return report.Finish();
+}
@@ -0,0 +1,251 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "EnvironmentPdf.h"
+#include "HalfFloat.h"
+
+#include <donut/core/math/math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+// Same conditions as the SSE2 path in EnvironmentPdf.cpp
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+static constexpr bool c_Sse2 = true;
+#else
+static constexpr bool c_Sse2 = false;
+#endif
+
+// Same constants and per-pixel math as EnvironmentPdf.cpp and PreprocessEnvironmentMap.hlsl
+static constexpr float c_MaxWeight = 65504.f;
+static constexpr uint32_t c_MipLevelsPerPass = 5;
+
+static uint32_t getMipSize(uint32_t size, uint32_t level)
+{
+    return std::max(1u, size >> level);
+}
+
+static float getRowSolidAngle(uint32_t y, uint32_t height)
+{
+    const float elevation = ((float(y) + 0.5f) / float(height) - 0.5f) * dm::PI_f;
+    return cosf(elevation);
+}
+
+static float getPixelWeight(const float* rgba, float solidAngle, float maxWeight)
+{
+    const float luma = rgba[0] * 0.299f + rgba[1] * 0.587f + rgba[2] * 0.114f;
+    if (!(luma > 0.f) || std::isinf(luma))
+        return 0.f;
+
+    return std::min(luma * solidAngle, maxWeight);
+}
+
+static float reduceQuad(float x0y0, float x1y0, float x0y1, float x1y1, bool textureOrder)
+{
+    return textureOrder
+        ? (x0y0 + x0y1 + x1y0 + x1y1) * 0.25f
+        : (x0y0 + x1y0 + x0y1 + x1y1) * 0.25f;
+}
+
+// Compares the optimized implementation with a straightforward one, checks the float16 conversion and
+// the cache files, then logs the throughput.
+bool TestEnvironmentPdf(const TestOptions& options)
+{
+    TestReport report("ENVIRONMENT PDF TEST");
+
+    {
+        // Every finite float16 value survives a round trip, and the rounding is to nearest even
+        bool roundTrip = true;
+        for (uint32_t value = 0; value < 0x10000; value++)
+        {
+            if ((value & 0x7c00) == 0x7c00 && (value & 0x3ff) != 0)
+                continue; // NaN
+            roundTrip = roundTrip && Fp32ToFp16(Fp16ToFp32(value)) == value;
+        }
+        roundTrip = roundTrip
+            && Fp32ToFp16(1.f + 1.f / 2048.f) == 0x3c00 // halfway, rounds down to even
+            && Fp32ToFp16(1.f + 3.f / 2048.f) == 0x3c02 // halfway, rounds up to even
+            && Fp32ToFp16(65520.f) == 0x7c00 // rounds to infinity
+            && Fp32ToFp16(c_MaxWeight) == 0x7bff;
+        report.Check("Float16 conversion", roundTrip);
+    }
+
+    // An environment map with a sun, NaN, infinite, negative and very bright pixels, with a width that is not a power of 2
+    const uint32_t width = 1000;
+    const uint32_t height = 500;
+    std::vector<float> pixels(size_t(width) * height * 4);
+    {
+        std::mt19937 rng(3);
+        std::exponential_distribution<float> radiance(1.f);
+        for (size_t i = 0; i < size_t(width) * height; i++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+                pixels[i * 4 + c] = radiance(rng);
+        }
+
+        const float specials[] = { std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), -5.f, 1e6f, 1e30f };
+        for (uint32_t i = 0; i < 200; i++)
+            pixels[(rng() % (width * height)) * 4 + rng() % 3] = specials[i % 5];
+
+        for (uint32_t y = 100; y < 110; y++)
+        {
+            for (uint32_t x = 600; x < 610; x++)
+                pixels[(size_t(y) * width + x) * 4 + 1] = 50000.f;
+        }
+    }
+
+    // Straightforward implementation of the shader, one pixel at a time
+    EnvironmentPdfMips reference;
+    {
+        const uint32_t mipLevels = GetEnvironmentPdfMipLevels(width, height);
+        reference.width = width;
+        reference.height = height;
+        reference.levels.resize(mipLevels);
+
+        std::vector<float> current(size_t(width) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+                current[size_t(y) * width + x] = getPixelWeight(&pixels[(size_t(y) * width + x) * 4], getRowSolidAngle(y, height), c_MaxWeight);
+        }
+
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            const uint32_t levelWidth = getMipSize(width, level);
+            const uint32_t levelHeight = getMipSize(height, level);
+
+            if (level > 0)
+            {
+                const uint32_t sourceWidth = getMipSize(width, level - 1);
+                const uint32_t sourceHeight = getMipSize(height, level - 1);
+                const bool passStart = ((level - 1) % c_MipLevelsPerPass) == 0;
+                if (passStart && level > 1)
+                {
+                    for (float& value : current)
+                        value = Fp16ToFp32(Fp32ToFp16(value));
+                }
+
+                auto fetch = [&](uint32_t x, uint32_t y)
+                {
+                    return (x < sourceWidth && y < sourceHeight) ? current[size_t(y) * sourceWidth + x] : 0.f;
+                };
+
+                std::vector<float> next(size_t(levelWidth) * levelHeight);
+                for (uint32_t y = 0; y < levelHeight; y++)
+                {
+                    for (uint32_t x = 0; x < levelWidth; x++)
+                    {
+                        next[size_t(y) * levelWidth + x] = reduceQuad(
+                            fetch(x * 2, y * 2), fetch(x * 2 + 1, y * 2), fetch(x * 2, y * 2 + 1), fetch(x * 2 + 1, y * 2 + 1), passStart);
+                    }
+                }
+                current = std::move(next);
+            }
+
+            for (float value : current)
+                reference.levels[level].push_back(Fp32ToFp16(value));
+        }
+    }
+
+    EnvironmentPdfMips serial;
+    EnvironmentPdfMips parallel;
+    ComputeEnvironmentPdfMips(pixels.data(), width, height, 1, serial);
+    ComputeEnvironmentPdfMips(pixels.data(), width, height, 0, parallel);
+
+    report.Check(c_Sse2 ? "SSE2 path matches the reference" : "Scalar path matches the reference", serial.levels == reference.levels);
+    report.Check("Multi-threaded result matches single-threaded", parallel.levels == serial.levels);
+
+    {
+        bool validWeights = serial.levels.size() == 11 && serial.levels.back().size() == 1;
+        for (uint16_t value : serial.levels[0])
+            validWeights = validWeights && value < 0x7c00; // finite and not negative
+        report.Check("Weights are finite, non-negative and clamped", validWeights);
+    }
+
+    {
+        // The last level of a 4x2 map reads its 2x1 source with zeros below it
+        std::vector<float> small(4 * 2 * 4, 1.f);
+        EnvironmentPdfMips mips;
+        ComputeEnvironmentPdfMips(small.data(), 4, 2, 1, mips);
+        const float level1 = Fp16ToFp32(mips.levels[1][0]);
+        report.Check("Out of bounds reads are zero", mips.levels.size() == 3 && mips.levels[2].size() == 1
+            && Fp16ToFp32(mips.levels[2][0]) == Fp16ToFp32(Fp32ToFp16(level1 * 0.5f)));
+    }
+
+    {
+        const fs::path fileName = options.tempFolder / "environment_pdf_check.envpdf";
+        const uint64_t key = HashEnvironmentMapFile(pixels.data(), pixels.size() * sizeof(float));
+
+        EnvironmentPdfMips loaded;
+        const bool roundTrip = WriteEnvironmentPdfCache(fileName, key, serial)
+            && ReadEnvironmentPdfCache(fileName, key, loaded)
+            && loaded.width == width && loaded.height == height && loaded.levels == serial.levels;
+
+        EnvironmentPdfMips rejected;
+        const bool staleRejected = !ReadEnvironmentPdfCache(fileName, key + 1, rejected) && rejected.levels.empty();
+
+        std::error_code ec;
+        fs::resize_file(fileName, fs::file_size(fileName) - 2, ec);
+        const bool truncatedRejected = !ec && !ReadEnvironmentPdfCache(fileName, key, rejected);
+        fs::remove(fileName, ec);
+
+        pixels[12345] += 1.f;
+        const bool keyChanges = HashEnvironmentMapFile(pixels.data(), pixels.size() * sizeof(float)) != key;
+
+        report.Check("Cache file round trip", roundTrip);
+        report.Check("Stale and truncated cache files are rejected", staleRejected && truncatedRejected);
+        report.Check("Key depends on the file contents", keyChanges);
+    }
+
+    {
+        // A typical HDRI size
+        const uint32_t benchmarkWidth = 4096;
+        const uint32_t benchmarkHeight = 2048;
+        std::vector<float> benchmarkPixels(size_t(benchmarkWidth) * benchmarkHeight * 4, 0.5f);
+        EnvironmentPdfMips mips;
+
+        auto start = steady_clock::now();
+        ComputeEnvironmentPdfMips(benchmarkPixels.data(), benchmarkWidth, benchmarkHeight, 1, mips);
+        const double serialTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        ComputeEnvironmentPdfMips(benchmarkPixels.data(), benchmarkWidth, benchmarkHeight, 0, mips);
+        const double parallelTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        const fs::path fileName = options.tempFolder / "environment_pdf_benchmark.envpdf";
+        start = steady_clock::now();
+        const bool written = WriteEnvironmentPdfCache(fileName, 1, mips);
+        const double writeTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        const bool read = ReadEnvironmentPdfCache(fileName, 1, mips);
+        const double readTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        std::error_code ec;
+        fs::remove(fileName, ec);
+
+        report.Check("Benchmark cache file round trip", written && read);
+
+        report.Note("%ux%u PDF mip chain: %.1f ms on 1 thread, %.1f ms on all threads%s",
+            benchmarkWidth, benchmarkHeight, serialTime, parallelTime, c_Sse2 ? " (SSE2)" : "");
+        report.Note("Cache file: %.1f ms to write, %.1f ms to read", writeTime, readTime);
+    }
+
+    return report.Finish();
+}
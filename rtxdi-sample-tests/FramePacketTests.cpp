@@ -0,0 +1,238 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "FramePacket.h"
+#include "PrepareLightsPass.h"
+
+#include <donut/engine/SceneGraph.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <unordered_map>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+using namespace std::chrono;
+
+static bool PacketsMatch(const FramePacket& a, const FramePacket& b)
+{
+    return a.frameIndex == b.frameIndex
+        && a.lightTasks.size() == b.lightTasks.size()
+        && std::equal(a.lightTasks.begin(), a.lightTasks.end(), b.lightTasks.begin(),
+            [](const PrepareLightsTask& x, const PrepareLightsTask& y) { return memcmp(&x, &y, sizeof(x)) == 0; })
+        && a.primitiveLightInfos.size() == b.primitiveLightInfos.size()
+        && std::equal(a.primitiveLightInfos.begin(), a.primitiveLightInfos.end(), b.primitiveLightInfos.begin(),
+            [](const PolymorphicLightInfo& x, const PolymorphicLightInfo& y) { return memcmp(&x, &y, sizeof(x)) == 0; })
+        && a.geometryInstanceToLight == b.geometryInstanceToLight
+        && a.lightCount == b.lightCount
+        && a.taskBufferOffset == b.taskBufferOffset
+        && a.infiniteLightCount == b.infiniteLightCount
+        && a.environmentLightCount == b.environmentLightCount
+        && all(a.staticLightRange == b.staticLightRange)
+        && a.clearLocalLightPdf == b.clearLocalLightPdf;
+}
+
+// Builds fake packets to check the double buffering and the overlap with the calling thread, then builds the light
+// tasks of a synthetic scene graph on the worker and on the calling thread and compares them.
+bool TestFramePacket(const TestOptions&)
+{
+    TestReport report("FRAME PACKET TEST");
+
+    {
+        FramePacketBuilder builder(true);
+        std::thread::id buildThread;
+
+        builder.Begin(7, [&](FramePacket& packet)
+        {
+            buildThread = std::this_thread::get_id();
+            packet.lightCount = packet.frameIndex * 10;
+        });
+        const FramePacket& first = builder.Wait();
+
+        report.Check("The packet is built on the worker thread", buildThread != std::this_thread::get_id() && builder.UsesWorkerThread());
+        report.Check("Wait returns the packet of the frame", first.frameIndex == 7 && first.lightCount == 70);
+
+        // The next build blocks until the calling thread has read the previous packet, which is only possible
+        // when Begin returns before the build is done. A build that runs inside Begin times out instead of hanging.
+        std::promise<void> release;
+        std::future<void> released = release.get_future();
+        bool buildOverlapped = false;
+        builder.Begin(8, [&](FramePacket& packet)
+        {
+            buildOverlapped = released.wait_for(seconds(10)) == std::future_status::ready;
+            packet.lightCount = packet.frameIndex * 10;
+        });
+        const bool previousUnchanged = first.frameIndex == 7 && first.lightCount == 70;
+        release.set_value();
+        const FramePacket& second = builder.Wait();
+
+        report.Check("The build overlaps the calling thread", buildOverlapped);
+        report.Check("The previous packet is kept during the next build", previousUnchanged && &second != &first &&
+            second.frameIndex == 8 && second.lightCount == 80);
+
+        // Many short frames in a row: a packet that is built late or twice would show up in the values
+        bool framesSeparate = true;
+        uint32_t builds = 0;
+        for (uint32_t frame = 0; frame < 2000; frame++)
+        {
+            builder.Begin(frame, [&builds](FramePacket& packet) { builds++; packet.taskBufferOffset = packet.frameIndex; });
+            const FramePacket& packet = builder.Wait();
+            framesSeparate = framesSeparate && builds == frame + 1 && packet.frameIndex == frame && packet.taskBufferOffset == frame;
+        }
+        report.Check("Consecutive frames don't mix their packets", framesSeparate);
+    }
+
+    {
+        FramePacketBuilder builder(false);
+        const std::thread::id caller = std::this_thread::get_id();
+        bool builtInBegin = false;
+        builder.Begin(3, [&](FramePacket& packet)
+        {
+            builtInBegin = std::this_thread::get_id() == caller && packet.frameIndex == 3;
+        });
+        const bool beforeWait = builtInBegin;
+        builder.Wait();
+        report.Check("Without the worker Begin builds on the caller", beforeWait && !builder.UsesWorkerThread());
+    }
+
+    // A scene with emissive meshes, point lights and a directional light. One node moves on every frame,
+    // which moves its lights out of the static region, and one emissive geometry is added later.
+    auto graph = std::make_shared<SceneGraph>();
+    auto root = std::make_shared<SceneGraphNode>();
+    graph->SetRootNode(root);
+
+    auto emissive = std::make_shared<Material>();
+    emissive->emissiveColor = float3(1.f, 0.5f, 0.25f);
+    emissive->emissiveIntensity = 2.f;
+    auto dark = std::make_shared<Material>();
+    auto late = std::make_shared<Material>();
+
+    std::vector<std::shared_ptr<SceneGraphNode>> nodes;
+    for (int i = 0; i < 4; i++)
+    {
+        auto mesh = std::make_shared<MeshInfo>();
+        for (int g = 0; g < 3; g++)
+        {
+            auto geometry = std::make_shared<MeshGeometry>();
+            geometry->material = g == 0 ? emissive : g == 1 ? dark : late;
+            geometry->numIndices = uint32_t(3 * (i + 2 + g));
+            mesh->geometries.push_back(geometry);
+        }
+
+        auto node = std::make_shared<SceneGraphNode>();
+        node->SetTranslation(double3(i, 0.0, 0.0));
+        graph->Attach(root, node);
+        graph->AttachLeafToNode(node, std::make_shared<MeshInstance>(mesh));
+
+        auto light = std::make_shared<PointLight>();
+        light->color = float3(1.f);
+        light->intensity = float(i + 1);
+        light->radius = 0.1f;
+        auto lightNode = std::make_shared<SceneGraphNode>();
+        lightNode->SetTranslation(double3(0.0, 1.0, 0.0));
+        graph->Attach(node, lightNode);
+        graph->AttachLeafToNode(lightNode, light);
+
+        nodes.push_back(node);
+    }
+
+    auto sun = std::make_shared<DirectionalLight>();
+    sun->irradiance = 1.f;
+    sun->angularSize = 0.5f;
+    auto sunNode = std::make_shared<SceneGraphNode>();
+    graph->Attach(root, sunNode);
+    graph->AttachLeafToNode(sunNode, sun);
+
+    graph->Refresh(0);
+
+    LightTaskBuilder workerTasks;
+    LightTaskBuilder inlineTasks;
+    workerTasks.ClassifyStaticLights(*graph);
+    inlineTasks.ClassifyStaticLights(*graph);
+
+    LightTaskSettings settings;
+    settings.enableVirtualLights = true;
+    settings.virtualLightsSamplesPerFrame = 4;
+    settings.virtualLightsSampleLifespan = 2;
+    settings.incrementalLocalLightPdf = true;
+    settings.enableStaticLightRegion = true;
+
+    FramePacketBuilder builder(true);
+    FramePacket inlinePacket;
+    bool identical = true;
+    bool contiguous = true;
+    bool previousOffsets = true;
+    bool staticRegionUsed = false;
+    std::unordered_map<uint32_t, int> meshOffsets; // instanceAndGeometryIndex -> last known offset, static lights keep theirs
+
+    for (uint32_t frame = 1; frame <= 12; frame++)
+    {
+        nodes[1]->SetTranslation(double3(1.0, 0.1 * frame, 0.0));
+        if (frame == 6)
+        {
+            late->emissiveColor = float3(1.f);
+            late->emissiveIntensity = 1.f;
+        }
+        graph->Refresh(frame);
+
+        settings.frameIndex = frame;
+        settings.virtualLightsCurrentBlock = frame % settings.virtualLightsSampleLifespan;
+        settings.virtualLightsPreviousBlock = (frame - 1) % settings.virtualLightsSampleLifespan;
+        builder.Begin(frame, [&workerTasks, &graph, settings](FramePacket& packet)
+        {
+            workerTasks.Build(*graph, settings, packet);
+        });
+        inlinePacket.frameIndex = frame;
+        inlineTasks.Build(*graph, settings, inlinePacket);
+        const FramePacket& packet = builder.Wait();
+
+        identical = identical && PacketsMatch(packet, inlinePacket);
+        staticRegionUsed = staticRegionUsed || packet.staticLightRange.y > packet.staticLightRange.x;
+
+        // The tasks, preceded by the current block of virtual lights, cover the end of the light buffer without gaps
+        std::vector<PrepareLightsTask> tasks = packet.lightTasks;
+        std::sort(tasks.begin(), tasks.end(), [](const PrepareLightsTask& a, const PrepareLightsTask& b)
+            { return a.lightBufferOffset < b.lightBufferOffset; });
+        uint32_t end = packet.taskBufferOffset + settings.virtualLightsSamplesPerFrame;
+        for (const PrepareLightsTask& task : tasks)
+        {
+            contiguous = contiguous && task.lightBufferOffset == end;
+            end += task.triangleCount;
+        }
+        contiguous = contiguous && end == packet.lightCount;
+
+        // Primitive light tasks are numbered by their index in the packet, which changes with the static region
+        for (const PrepareLightsTask& task : tasks)
+        {
+            if (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT)
+                continue;
+
+            auto previous = meshOffsets.find(task.instanceAndGeometryIndex);
+            const int expected = previous != meshOffsets.end() ? previous->second : -1;
+            previousOffsets = previousOffsets && task.previousLightBufferOffset == expected;
+            meshOffsets[task.instanceAndGeometryIndex] = int(task.lightBufferOffset);
+        }
+    }
+
+    report.Check("Light tasks from the worker match the inline build", identical);
+    report.Check("Light tasks tile the end of the light buffer", contiguous);
+    report.Check("Previous light offsets match the previous frame", previousOffsets);
+    report.Check("The static region is skipped once it is built", staticRegionUsed);
+
+    return report.Finish();
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "FrameRecording.h"
+
+#include <cstring>
+
+// Offset of the frame count in a serialized recording
+static size_t getFrameCountOffset(const FrameRecording& recording)
+{
+    return sizeof(uint32_t) * 2 + sizeof(uint32_t) + recording.sceneName.size() + sizeof(uint64_t);
+}
+
+bool TestFrameRecording(const TestOptions&)
+{
+    TestReport report("FRAME RECORDING TEST");
+
+    FrameRecording recording;
+    recording.sceneName = "Test Scene";
+    recording.uiLayout = 0x0123456789abcdefull;
+    for (uint32_t frameIndex = 0; frameIndex < 4; frameIndex++)
+    {
+        RecordedFrame& frame = recording.frames.emplace_back();
+        frame.elapsedTime = 1.f / 60.f;
+        frame.benchmarkFrame = int32_t(frameIndex);
+        frame.cameraPosition = dm::float3(float(frameIndex), 1.f, 2.f);
+        frame.fieldChanges.push_back({ 7, { 1, 2, 3, 4 } });
+        if (frameIndex == 0)
+            frame.lightChanges.push_back({ 3, dm::double3(1.0), dm::dquat::identity(), dm::double3(2.0), "{\"radiance\":1}" });
+    }
+
+    std::vector<uint8_t> data;
+    SerializeFrameRecording(recording, data);
+
+    FrameRecording read;
+    std::string error;
+    {
+        const bool success = DeserializeFrameRecording(data.data(), data.size(), read, error);
+        report.Check("A recording reads back", success && read.sceneName == recording.sceneName && read.uiLayout == recording.uiLayout &&
+            read.frames.size() == recording.frames.size() &&
+            read.frames[3].benchmarkFrame == 3 && read.frames[3].cameraPosition.x == 3.f &&
+            read.frames[2].fieldChanges.size() == 1 && read.frames[2].fieldChanges[0].data == recording.frames[2].fieldChanges[0].data &&
+            read.frames[0].lightChanges.size() == 1 && read.frames[0].lightChanges[0].parameters == "{\"radiance\":1}");
+    }
+
+    // Every truncation fails, never reads past the end, and never allocates for data that isn't there
+    {
+        bool allRejected = true;
+        for (size_t size = 0; size < data.size(); size++)
+        {
+            const std::vector<uint8_t> truncated(data.begin(), data.begin() + size);
+            allRejected = allRejected && !DeserializeFrameRecording(truncated.data(), truncated.size(), read, error);
+        }
+        report.Check("Truncated recordings are rejected", allRejected);
+    }
+
+    {
+        std::vector<uint8_t> corrupted = data;
+        const uint32_t frameCount = ~0u;
+        memcpy(corrupted.data() + getFrameCountOffset(recording), &frameCount, sizeof(frameCount));
+        report.Check("A frame count larger than the file is rejected",
+            !DeserializeFrameRecording(corrupted.data(), corrupted.size(), read, error) && read.frames.empty());
+    }
+
+    {
+        std::vector<uint8_t> extended = data;
+        extended.push_back(0);
+        report.Check("Data after the last frame is rejected", !DeserializeFrameRecording(extended.data(), extended.size(), read, error));
+    }
+
+    return report.Finish();
+}
@@ -0,0 +1,398 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Statistical checks of PolymorphicLight.hlsli compiled for the host, run on one synthetic light of every type:
+// - the solid angle pdf returned by calcSample integrates to one over the light,
+// - the flux through a sphere around the light, integrated with calcSample, matches getPower,
+// - photons from calcPhotonSample carry the same flux through one half of that sphere.
+// Each estimate must be within the sampling error. The single-threaded throughput of calcSample and
+// calcPhotonSample per light type is logged as well.
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "CpuReference/HlslCompat.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace hlsl
+{
+namespace
+{
+#define in
+#include "../shaders/PolymorphicLight.hlsli"
+#undef in
+}
+}
+
+namespace
+{
+    using hlsl::float2;
+    using hlsl::float3;
+    using hlsl::float4;
+
+    constexpr double c_Pi = 3.14159265358979323846;
+
+    struct Estimate
+    {
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        uint64_t count = 0;
+
+        void Add(double value)
+        {
+            sum += value;
+            sumSquares += value * value;
+            ++count;
+        }
+
+        [[nodiscard]] double Mean() const { return count ? sum / double(count) : 0.0; }
+
+        [[nodiscard]] double StandardError() const
+        {
+            if (count < 2)
+                return 0.0;
+            const double mean = Mean();
+            const double variance = std::max(0.0, sumSquares / double(count) - mean * mean);
+            return std::sqrt(variance / double(count - 1));
+        }
+    };
+
+    struct TestLight
+    {
+        const char* name;
+        PolymorphicLightInfo info;
+        float3 viewerPosition;
+        float boundingRadius; // zero for infinite lights
+        bool isDelta;
+        double solidAngle = 0.0; // of the light as seen from viewerPosition
+        double solidAngleError = 0.0;
+    };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_Engine(seed) { }
+        float Next() { return m_Distribution(m_Engine); }
+        float2 Next2() { return float2(Next(), Next()); }
+        float4 Next4() { return float4(Next(), Next(), Next(), Next()); }
+
+    private:
+        std::mt19937 m_Engine;
+        std::uniform_real_distribution<float> m_Distribution{ 0.f, 1.f };
+    };
+
+    float3 uniformSphereDirection(const float2& u)
+    {
+        const float z = 1.f - 2.f * u.x;
+        const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+        const float phi = float(2.0 * c_Pi) * u.y;
+        return float3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    // Van Oosterom and Strackee, the solid angle of a triangle seen from the origin
+    double triangleSolidAngle(const float3& a, const float3& b, const float3& c)
+    {
+        const double la = length(a), lb = length(b), lc = length(c);
+        const double numerator = std::abs(dot(a, cross(b, c)));
+        const double denominator = la * lb * lc + dot(a, b) * lc + dot(a, c) * lb + dot(b, c) * la;
+        return 2.0 * std::atan2(numerator, denominator);
+    }
+
+    // Monte Carlo estimate over the cone bounding the cylinder. The sampler only produces points on the side
+    // facing the viewer, which are the points where a ray from the viewer enters the open tube.
+    void cylinderSolidAngle(const hlsl::CylinderLight& cylinder, const float3& viewerPosition, uint32_t sampleCount, Random& random,
+        double& solidAngle, double& solidAngleError)
+    {
+        const float3 toCenter = cylinder.position - viewerPosition;
+        const float distance = length(toCenter);
+        const float boundingRadius = std::sqrt(hlsl::square(cylinder.radius) + hlsl::square(0.5f * cylinder.axisLength));
+        const float cosMax = std::sqrt(1.f - hlsl::square(boundingRadius / distance));
+
+        float3 tangent, bitangent;
+        const float3 axis = toCenter / distance;
+        hlsl::branchlessONB(axis, tangent, bitangent);
+
+        uint32_t hits = 0;
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            const float cosTheta = hlsl::lerp(cosMax, 1.f, random.Next());
+            const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+            const float phi = float(2.0 * c_Pi) * random.Next();
+            const float3 direction = axis * cosTheta + (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta;
+
+            const float3 offset = viewerPosition - cylinder.position;
+            const float3 directionRadial = direction - cylinder.tangent * dot(direction, cylinder.tangent);
+            const float3 offsetRadial = offset - cylinder.tangent * dot(offset, cylinder.tangent);
+            const float a = dot(directionRadial, directionRadial);
+            const float b = 2.f * dot(directionRadial, offsetRadial);
+            const float c = dot(offsetRadial, offsetRadial) - hlsl::square(cylinder.radius);
+            const float discriminant = b * b - 4.f * a * c;
+            if (discriminant < 0.f || a <= 0.f)
+                continue;
+
+            const float t = (-b - std::sqrt(discriminant)) / (2.f * a);
+            const float axial = dot(offset + direction * t, cylinder.tangent);
+            if (t > 0.f && std::abs(axial) <= 0.5f * cylinder.axisLength)
+                ++hits;
+        }
+
+        const double coneSolidAngle = 2.0 * c_Pi * (1.0 - cosMax);
+        const double fraction = double(hits) / double(sampleCount);
+        solidAngle = coneSolidAngle * fraction;
+        solidAngleError = coneSolidAngle * std::sqrt(fraction * (1.0 - fraction) / double(sampleCount));
+    }
+
+    PolymorphicLightInfo makeLight(PolymorphicLightType type, const float3& center, const float3& radiance)
+    {
+        PolymorphicLightInfo lightInfo = {};
+        hlsl::packLightColor(radiance, lightInfo);
+        lightInfo.center = center;
+        lightInfo.colorTypeAndFlags |= uint32_t(type) << kPolymorphicLightTypeShift;
+        return lightInfo;
+    }
+
+    std::vector<TestLight> createTestLights(uint32_t sampleCount)
+    {
+        std::vector<TestLight> lights;
+        const float3 center = float3(1.f, 2.f, -0.5f);
+        const float3 radiance = float3(3.f, 2.f, 0.5f);
+        Random random(7);
+
+        {
+            TestLight light{ "Sphere", makeLight(PolymorphicLightType::kSphere, center, radiance), center + float3(0.f, 0.f, 2.f), 0.5f, false };
+            light.info.scalars = hlsl::f32tof16(0.5f);
+            const hlsl::SphereLight sphere = hlsl::SphereLight::Create(light.info);
+            const float distance = length(sphere.position - light.viewerPosition);
+            light.solidAngle = 2.0 * c_Pi * (1.0 - std::sqrt(1.0 - hlsl::square(double(sphere.radius) / distance)));
+            lights.push_back(light);
+        }
+
+        {
+            TestLight light{ "Point", makeLight(PolymorphicLightType::kPoint, center, radiance), center + float3(0.f, 1.f, 1.f), 0.f, true };
+            lights.push_back(light);
+        }
+
+        {
+            TestLight light{ "Cylinder", makeLight(PolymorphicLightType::kCylinder, center, radiance), center + float3(0.5f, -0.5f, 2.5f), 0.f, false };
+            light.info.scalars = hlsl::f32tof16(0.25f) | (hlsl::f32tof16(2.f) << 16);
+            light.info.direction1 = hlsl::ndirToOctUnorm32(normalize(float3(1.f, 1.f, 0.f)));
+            const hlsl::CylinderLight cylinder = hlsl::CylinderLight::Create(light.info);
+            light.boundingRadius = std::sqrt(hlsl::square(cylinder.radius) + hlsl::square(0.5f * cylinder.axisLength));
+            cylinderSolidAngle(cylinder, light.viewerPosition, sampleCount, random, light.solidAngle, light.solidAngleError);
+            lights.push_back(light);
+        }
+
+        for (PolymorphicLightType type : { PolymorphicLightType::kDisk, PolymorphicLightType::kVirtual })
+        {
+            TestLight light{ type == PolymorphicLightType::kDisk ? "Disk" : "Virtual", makeLight(type, center, radiance), center, 0.75f, false };
+            light.info.scalars = hlsl::f32tof16(0.75f);
+            light.info.direction1 = hlsl::ndirToOctUnorm32(normalize(float3(0.f, 1.f, 1.f)));
+            const hlsl::DiskLight disk = hlsl::DiskLight::Create(light.info);
+            const float height = 1.5f;
+            light.viewerPosition = disk.position + disk.normal * height;
+            light.solidAngle = 2.0 * c_Pi * (1.0 - height / std::sqrt(hlsl::square(double(height)) + hlsl::square(double(disk.radius))));
+            lights.push_back(light);
+        }
+
+        {
+            TestLight light{ "Rect", makeLight(PolymorphicLightType::kRect, center, radiance), center, 0.f, false };
+            light.info.scalars = hlsl::f32tof16(1.f) | (hlsl::f32tof16(0.5f) << 16);
+            light.info.direction1 = hlsl::ndirToOctUnorm32(normalize(float3(1.f, 0.f, 1.f)));
+            light.info.direction2 = hlsl::ndirToOctUnorm32(float3(0.f, 1.f, 0.f));
+            const hlsl::RectLight rect = hlsl::RectLight::Create(light.info);
+            light.boundingRadius = 0.5f * length(rect.dimensions);
+            light.viewerPosition = rect.position + rect.normal * 0.8f + rect.dirx * 0.3f;
+            const float3 dx = rect.dirx * (0.5f * rect.dimensions.x);
+            const float3 dy = rect.diry * (0.5f * rect.dimensions.y);
+            const float3 p = rect.position - light.viewerPosition;
+            light.solidAngle = triangleSolidAngle(p - dx - dy, p + dx - dy, p + dx + dy)
+                + triangleSolidAngle(p - dx - dy, p + dx + dy, p - dx + dy);
+            lights.push_back(light);
+        }
+
+        {
+            hlsl::TriangleLight triangle;
+            triangle.base = center;
+            triangle.edge1 = float3(1.f, 0.2f, 0.f);
+            triangle.edge2 = float3(0.1f, 0.f, 0.8f);
+            triangle.radiance = radiance;
+
+            TestLight light{ "Triangle", triangle.Store(), center, 0.f, false };
+            triangle = hlsl::TriangleLight::Create(light.info);
+            light.boundingRadius = std::max(length(triangle.edge1), length(triangle.edge2));
+            // The pdf is one-sided, the viewer has to be on the side of the normal
+            light.viewerPosition = triangle.base + (triangle.edge1 + triangle.edge2) * 0.3f + triangle.normal * 0.6f;
+            const float3 p = triangle.base - light.viewerPosition;
+            light.solidAngle = triangleSolidAngle(p, p + triangle.edge1, p + triangle.edge2);
+            lights.push_back(light);
+        }
+
+        {
+            TestLight light{ "Directional", makeLight(PolymorphicLightType::kDirectional, 0.f, radiance), center, 0.f, false };
+            const float halfAngle = 0.05f;
+            light.info.direction1 = hlsl::ndirToOctUnorm32(normalize(float3(0.3f, -1.f, 0.2f)));
+            light.info.scalars = hlsl::f32tof16(halfAngle) | (hlsl::f32tof16(float(2.0 * c_Pi * (1.0 - std::cos(halfAngle)))) << 16);
+            light.solidAngle = 2.0 * c_Pi * (1.0 - std::cos(hlsl::f16tof32(light.info.scalars)));
+            lights.push_back(light);
+        }
+
+        {
+            TestLight light{ "Environment", makeLight(PolymorphicLightType::kEnvironment, 0.f, radiance), center, 0.f, false };
+            light.info.direction1 = uint32_t(-1);
+            light.solidAngle = 4.0 * c_Pi;
+            lights.push_back(light);
+        }
+
+        return lights;
+    }
+
+    bool withinError(double value, double valueError, double expected, double expectedError)
+    {
+        // Four standard errors, plus a relative margin for the fp16 and oct encoding of the light parameters
+        const double error = 4.0 * std::sqrt(valueError * valueError + expectedError * expectedError);
+        return std::abs(value - expected) <= error + 0.005 * std::abs(expected);
+    }
+}
+
+static void checkLightSampling(TestReport& report, uint32_t sampleCount)
+{
+    const std::vector<TestLight> lights = createTestLights(sampleCount);
+    const hlsl::float3 halfSpaceAxis = normalize(hlsl::float3(1.f, 2.f, 3.f));
+
+    for (const TestLight& light : lights)
+    {
+        Random random(1);
+        const std::string name = light.name;
+
+        // Pdf normalization: E[1 / pdf] over the samples equals the measure of the sampled solid angle
+        if (!light.isDelta)
+        {
+            Estimate inversePdf;
+            for (uint32_t i = 0; i < sampleCount; i++)
+            {
+                const hlsl::PolymorphicLightSample lightSample = hlsl::PolymorphicLight::calcSample(light.info, random.Next2(), light.viewerPosition, 0.f);
+                inversePdf.Add(lightSample.solidAnglePdf > 0.f ? 1.0 / lightSample.solidAnglePdf : 0.0);
+            }
+
+            report.Check(name + " pdf integrates to one",
+                withinError(inversePdf.Mean(), inversePdf.StandardError(), light.solidAngle, light.solidAngleError));
+            report.Note("%-12s pdf integral %.5f", light.name, inversePdf.Mean() / light.solidAngle);
+        }
+
+        // Flux: integrate the irradiance over an enclosing sphere, and count photons leaving through one half of it
+        if (light.boundingRadius > 0.f || light.isDelta)
+        {
+            const hlsl::float3 center = light.info.center;
+            const float radius = 4.f * std::max(light.boundingRadius, 0.25f);
+            const double sphereArea = 4.0 * c_Pi * radius * radius;
+
+            Estimate flux;
+            Estimate halfFlux;
+            for (uint32_t i = 0; i < sampleCount; i++)
+            {
+                const hlsl::float3 normal = uniformSphereDirection(random.Next2());
+                const hlsl::float3 position = center + normal * radius;
+                const hlsl::PolymorphicLightSample lightSample = hlsl::PolymorphicLight::calcSample(light.info, random.Next2(), position, 0.f);
+
+                double irradiance = 0.0;
+                if (lightSample.solidAnglePdf > 0.f)
+                {
+                    const float cosTheta = dot(normalize(lightSample.position - position), -normal);
+                    irradiance = hlsl::calcLuminance(lightSample.radiance) * std::max(cosTheta, 0.f) / lightSample.solidAnglePdf;
+                }
+
+                flux.Add(irradiance * sphereArea);
+                halfFlux.Add(dot(normal, halfSpaceAxis) > 0.f ? irradiance * sphereArea : 0.0);
+            }
+
+            const double power = hlsl::PolymorphicLight::getPower(light.info);
+
+            Estimate photonHalfFlux;
+            for (uint32_t i = 0; i < sampleCount; i++)
+            {
+                const hlsl::PolymorphicLightPhotonSample photon = hlsl::PolymorphicLight::calcPhotonSample(light.info, random.Next4());
+                const hlsl::float3 direction = normalize(photon.direction);
+                const hlsl::float3 offset = photon.position - center;
+                const float b = dot(direction, offset);
+                const float t = -b + std::sqrt(std::max(0.f, b * b - dot(offset, offset) + radius * radius));
+                const hlsl::float3 exitNormal = normalize(offset + direction * t);
+                photonHalfFlux.Add(dot(exitNormal, halfSpaceAxis) > 0.f ? power : 0.0);
+            }
+
+            report.Check(name + " flux matches getPower", withinError(flux.Mean(), flux.StandardError(), power, 0.0));
+            report.Check(name + " photons match the sampled flux",
+                withinError(photonHalfFlux.Mean(), photonHalfFlux.StandardError(), halfFlux.Mean(), halfFlux.StandardError()));
+            report.Note("%-12s flux/getPower %.5f, photon/sampled half-space flux %.5f",
+                light.name, flux.Mean() / power, photonHalfFlux.Mean() / halfFlux.Mean());
+        }
+    }
+}
+
+static void benchmarkLightSampling(TestReport& report, uint32_t sampleCount)
+{
+    const std::vector<TestLight> lights = createTestLights(1024);
+
+    // Pregenerate the random numbers so that the benchmark measures only the light code
+    constexpr uint32_t randomCount = 4096;
+    Random random(3);
+    std::vector<hlsl::float4> randoms(randomCount);
+    for (hlsl::float4& value : randoms)
+        value = random.Next4();
+
+    float sink = 0.f;
+
+    for (const TestLight& light : lights)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            const hlsl::float4& u = randoms[i % randomCount];
+            const hlsl::PolymorphicLightSample lightSample = hlsl::PolymorphicLight::calcSample(light.info, u.xy, light.viewerPosition, 0.f);
+            sink += lightSample.solidAnglePdf + lightSample.position.x;
+        }
+        const double sampleSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // Infinite lights do not emit photons
+        if (light.boundingRadius > 0.f || light.isDelta)
+        {
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < sampleCount; i++)
+            {
+                const hlsl::PolymorphicLightPhotonSample photon = hlsl::PolymorphicLight::calcPhotonSample(light.info, randoms[i % randomCount]);
+                sink += photon.direction.x + photon.position.x;
+            }
+            const double photonSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            report.Note("%-12s calcSample %8.2f Msamples/s, calcPhotonSample %8.2f Msamples/s", light.name,
+                double(sampleCount) / sampleSeconds * 1e-6, double(sampleCount) / photonSeconds * 1e-6);
+        }
+        else
+        {
+            report.Note("%-12s calcSample %8.2f Msamples/s", light.name, double(sampleCount) / sampleSeconds * 1e-6);
+        }
+    }
+
+    report.Note("Benchmark checksum %g", sink);
+}
+
+bool TestLightSampling(const TestOptions& options)
+{
+    TestReport report("LIGHT SAMPLING TEST");
+    report.Note("%u samples per light", options.lightSamplingSamples);
+
+    checkLightSampling(report, options.lightSamplingSamples);
+    benchmarkLightSampling(report, options.lightSamplingSamples);
+
+    return report.Finish();
+}
@@ -0,0 +1,227 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "LocalLightPdfUpdate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace std::chrono;
+
+// Inverse of LinearIndexToZCurve, one bit at a time
+static uint32_t zCurveToLinearIndex(dm::uint2 position)
+{
+    uint32_t index = 0;
+    for (uint32_t bit = 0; bit < 16; bit++)
+        index |= (((position.x >> bit) & 1) << (bit * 2)) | (((position.y >> bit) & 1) << (bit * 2 + 1));
+    return index;
+}
+
+// Index of the texel of 'mipLevel' that covers the mip 0 texel 'texel'
+static uint32_t getAncestorTexel(uint32_t texel, uint32_t mipLevel)
+{
+    return (mipLevel < 16) ? (texel >> (2 * mipLevel)) : 0;
+}
+
+static uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t mipLevels = 1;
+    while ((std::max(width, height) >> mipLevels) > 0)
+        mipLevels++;
+    return mipLevels;
+}
+
+// Checks the Z-curve mapping and the range merging, then applies random light changes and compares the
+// incremental updates with full rebuilds of the mip chain, and logs the timings.
+bool TestLocalLightPdfUpdate(const TestOptions&)
+{
+    TestReport report("LOCAL LIGHT PDF TEST");
+
+    std::mt19937 rng(11);
+
+    {
+        // A 2:1 texture like the ones made by rtxdi::ComputePdfTextureSize
+        const uint32_t width = 256;
+        const uint32_t height = 128;
+        std::vector<bool> visited(size_t(width) * height, false);
+        bool bijective = true;
+        bool parentsMatch = true;
+
+        for (uint32_t index = 0; index < width * height; index++)
+        {
+            const dm::uint2 position = LinearIndexToZCurve(index);
+            if (position.x >= width || position.y >= height || visited[size_t(position.y) * width + position.x] ||
+                zCurveToLinearIndex(position) != index)
+            {
+                bijective = false;
+                break;
+            }
+            visited[size_t(position.y) * width + position.x] = true;
+
+            const dm::uint2 parent = LinearIndexToZCurve(index >> 2);
+            parentsMatch = parentsMatch && parent.x == (position.x >> 1) && parent.y == (position.y >> 1);
+        }
+
+        report.Check("Z-curve covers a 2:1 texture once", bijective);
+        report.Check("Texel i >> 2 is the parent of texel i", parentsMatch);
+    }
+
+    {
+        const uint32_t texelCount = 4096;
+        std::vector<PdfTexelRange> ranges;
+        std::vector<bool> expected(texelCount, false);
+
+        for (uint32_t i = 0; i < 2000; i++)
+        {
+            const uint32_t begin = rng() % texelCount;
+            const uint32_t end = std::min(texelCount, begin + 1 + uint32_t(rng() % 16));
+            AddPdfTexelRange(ranges, begin, end);
+            std::fill(expected.begin() + begin, expected.begin() + end, true);
+        }
+
+        bool separated = true;
+        std::vector<bool> covered(texelCount, false);
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            separated = separated && ranges[i].begin < ranges[i].end && (i == 0 || ranges[i - 1].end < ranges[i].begin);
+            std::fill(covered.begin() + ranges[i].begin, covered.begin() + ranges[i].end, true);
+        }
+
+        report.Check("Changed ranges are sorted and merged", separated);
+        report.Check("Changed ranges cover exactly the changed texels", covered == expected);
+    }
+
+    bool incrementalMatchesFull = true;
+    bool rangesCoverAncestors = true;
+    bool writesMatchRanges = true;
+
+    const dm::uint2 sizes[] = { { 1, 1 }, { 2, 1 }, { 8, 4 }, { 64, 64 }, { 256, 128 } };
+    for (const dm::uint2& size : sizes)
+    {
+        const uint32_t mipLevels = getMipLevelCount(size.x, size.y);
+        const uint32_t texelCount = size.x * size.y;
+        const uint32_t lightCount = texelCount - uint32_t(rng() % (texelCount / 2 + 1));
+
+        std::exponential_distribution<float> flux(0.1f);
+
+        PdfMipChain incremental;
+        incremental.Initialize(size.x, size.y, mipLevels);
+        for (uint32_t light = 0; light < lightCount; light++)
+            incremental.Texel(0, LinearIndexToZCurve(light)) = (rng() % 8 == 0) ? 0.f : flux(rng);
+        GeneratePdfMipsReference(incremental);
+
+        for (uint32_t frame = 0; frame < 40; frame++)
+        {
+            // A few moving meshes and single primitive lights
+            std::vector<PdfTexelRange> changed;
+            const uint32_t changeCount = 1 + uint32_t(rng() % 8);
+            for (uint32_t change = 0; change < changeCount; change++)
+            {
+                const uint32_t begin = uint32_t(rng() % lightCount);
+                const uint32_t end = (change % 2) ? begin + 1 : std::min(lightCount, begin + 1 + uint32_t(rng() % 64));
+                AddPdfTexelRange(changed, begin, end);
+
+                for (uint32_t light = begin; light < end; light++)
+                    incremental.Texel(0, LinearIndexToZCurve(light)) = flux(rng);
+            }
+
+            std::vector<PdfMipUpdateRange> ranges;
+            std::vector<PdfMipUpdateLevel> levels;
+            BuildPdfMipUpdateRanges(changed, mipLevels, ~0u, ranges, levels);
+
+            const uint32_t texelsWritten = UpdatePdfMipsReference(incremental, ranges, levels);
+
+            PdfMipChain full = incremental;
+            GeneratePdfMipsReference(full);
+            incrementalMatchesFull = incrementalMatchesFull && full.levels == incremental.levels;
+
+            // The ranges of every level must be exactly the ancestors of the changed texels
+            uint32_t rangeTexels = 0;
+            for (uint32_t mipLevel = 1; mipLevel < mipLevels; mipLevel++)
+            {
+                std::vector<bool> ancestors(size_t(texelCount), false);
+                for (const PdfTexelRange& range : changed)
+                {
+                    for (uint32_t texel = range.begin; texel < range.end; texel++)
+                        ancestors[getAncestorTexel(texel, mipLevel)] = true;
+                }
+
+                std::vector<bool> covered(size_t(texelCount), false);
+                const PdfMipUpdateLevel& level = levels[mipLevel];
+                for (uint32_t i = 0; i < level.rangeCount; i++)
+                {
+                    const PdfMipUpdateRange& range = ranges[level.firstRange + i];
+                    const uint32_t rangeEnd = (i + 1 < level.rangeCount) ? ranges[level.firstRange + i + 1].threadOffset : level.texelCount;
+                    for (uint32_t thread = range.threadOffset; thread < rangeEnd; thread++)
+                        covered[range.firstTexel + thread - range.threadOffset] = true;
+                }
+
+                rangesCoverAncestors = rangesCoverAncestors && covered == ancestors;
+                rangeTexels += level.texelCount;
+            }
+
+            writesMatchRanges = writesMatchRanges && texelsWritten == rangeTexels;
+        }
+    }
+
+    report.Check("Incremental updates match full rebuilds exactly", incrementalMatchesFull);
+    report.Check("Updated texels are the ancestors of changed ones", rangesCoverAncestors);
+    report.Check("Every updated texel is written once", writesMatchRanges);
+
+    {
+        std::vector<PdfTexelRange> changed;
+        for (uint32_t i = 0; i < 8; i++)
+            AddPdfTexelRange(changed, i * 1024, i * 1024 + 1);
+
+        std::vector<PdfMipUpdateRange> ranges;
+        std::vector<PdfMipUpdateLevel> levels;
+        report.Check("Too many ranges are reported", !BuildPdfMipUpdateRanges(changed, 12, 16, ranges, levels));
+    }
+
+    // Timings for a texture sized for 4M lights where 1024 lights in 16 meshes change
+    const uint32_t benchmarkSize = 2048;
+    const uint32_t benchmarkMips = getMipLevelCount(benchmarkSize, benchmarkSize);
+    PdfMipChain chain;
+    chain.Initialize(benchmarkSize, benchmarkSize, benchmarkMips);
+    for (float& texel : chain.levels[0])
+        texel = float(rng() % 1000);
+
+    auto start = steady_clock::now();
+    GeneratePdfMipsReference(chain);
+    const double fullMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    std::vector<PdfTexelRange> changed;
+    for (uint32_t mesh = 0; mesh < 16; mesh++)
+    {
+        const uint32_t begin = uint32_t(rng() % (benchmarkSize * benchmarkSize - 64));
+        AddPdfTexelRange(changed, begin, begin + 64);
+    }
+
+    start = steady_clock::now();
+    std::vector<PdfMipUpdateRange> ranges;
+    std::vector<PdfMipUpdateLevel> levels;
+    BuildPdfMipUpdateRanges(changed, benchmarkMips, ~0u, ranges, levels);
+    const uint32_t texelsWritten = UpdatePdfMipsReference(chain, ranges, levels);
+    const double incrementalMs = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    uint32_t fullTexels = 0;
+    for (uint32_t mipLevel = 1; mipLevel < benchmarkMips; mipLevel++)
+        fullTexels += uint32_t(chain.levels[mipLevel].size());
+
+    report.Note("%ux%u PDF texture, %d changed ranges", benchmarkSize, benchmarkSize, int(changed.size()));
+    report.Note("%-52s %8.3f ms, %u texels", "Full mip chain", fullMs, fullTexels);
+    report.Note("%-52s %8.3f ms, %u texels in %d ranges", "Incremental update", incrementalMs, texelsWritten, int(ranges.size()));
+
+    return report.Finish();
+}
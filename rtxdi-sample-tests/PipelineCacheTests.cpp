@@ -0,0 +1,181 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "PipelineCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+// Creates fake pipelines that take a known time through the cache and checks the threading, the waits
+// and the cache file round trip
+bool TestPipelineCache(const TestOptions& options)
+{
+    TestReport report("PIPELINE CACHE TEST");
+
+    // Fake pipelines sleep instead of compiling, which is enough to observe the overlap on any number of cores
+    const auto createTime = milliseconds(20);
+    std::atomic<int> running = 0;
+    std::atomic<int> maxRunning = 0;
+
+    auto fakePipeline = [&](std::atomic<int>& calls, std::thread::id* thread = nullptr, bool success = true)
+    {
+        return [&calls, &running, &maxRunning, createTime, thread, success]
+        {
+            const int nowRunning = ++running;
+            int previousMax = maxRunning;
+            while (nowRunning > previousMax && !maxRunning.compare_exchange_weak(previousMax, nowRunning))
+                ;
+            if (thread)
+                *thread = std::this_thread::get_id();
+            std::this_thread::sleep_for(createTime);
+            ++calls;
+            --running;
+            return success;
+        };
+    };
+
+    {
+        PipelineCache cache("", 0);
+        std::atomic<int> calls = 0;
+        std::thread::id thread;
+        cache.Declare("A", nullptr, fakePipeline(calls, &thread));
+        cache.Request("A");
+        const bool created = cache.Wait("A") && cache.Wait("A");
+        report.Check("Without workers pipelines are created on first use", created && calls == 1 && thread == std::this_thread::get_id());
+
+        std::atomic<int> failingCalls = 0;
+        cache.Declare("Failing", nullptr, fakePipeline(failingCalls, nullptr, false));
+        const bool failed = !cache.Wait("Failing") && !cache.Wait("Failing");
+        report.Check("Failed pipelines are reported and not retried", failed && failingCalls == 1 && cache.GetStatistics().failed == 1);
+
+        std::atomic<int> unusedCalls = 0;
+        cache.Declare("Unused", nullptr, fakePipeline(unusedCalls));
+        cache.Clear();
+        const PipelineCache::Statistics statistics = cache.GetStatistics();
+        report.Check("Pipelines that are never used are not created", unusedCalls == 0 && statistics.created == 1 && statistics.skipped == 1);
+    }
+
+    const int pipelineCount = 16;
+    const uint32_t threadCount = 4;
+    double parallelTime = 0.0;
+
+    {
+        PipelineCache cache("", threadCount);
+        std::vector<std::atomic<int>> calls(pipelineCount);
+        maxRunning = 0;
+
+        const auto startTime = steady_clock::now();
+        for (int i = 0; i < pipelineCount; i++)
+        {
+            cache.Declare(std::to_string(i), nullptr, fakePipeline(calls[i]));
+            cache.Request(std::to_string(i));
+        }
+
+        // Wait from several threads at once, like passes recorded in parallel
+        std::atomic<bool> allCreated = true;
+        std::vector<std::thread> waiters;
+        for (int t = 0; t < 3; t++)
+        {
+            waiters.emplace_back([&cache, &allCreated, t]
+            {
+                for (int i = 0; i < pipelineCount; i++)
+                {
+                    if (!cache.Wait(std::to_string((i + t * 5) % pipelineCount)))
+                        allCreated = false;
+                }
+            });
+        }
+        for (std::thread& waiter : waiters)
+            waiter.join();
+        parallelTime = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+        const bool createdOnce = std::all_of(calls.begin(), calls.end(), [](const std::atomic<int>& c) { return c == 1; });
+        report.Check("Requested pipelines are created once", allCreated && createdOnce);
+        report.Check("Pipelines are created concurrently", maxRunning > 1);
+
+        std::atomic<int> preparedCalls = 0;
+        std::thread::id prepareThread;
+        std::thread::id createThread;
+        auto prepare = [&prepareThread] { prepareThread = std::this_thread::get_id(); return true; };
+        cache.Declare("Prepared", prepare, fakePipeline(preparedCalls, &createThread));
+        cache.Request("Prepared");
+        for (int i = 0; i < 100 && preparedCalls == 0; i++)
+            std::this_thread::sleep_for(createTime);
+        const bool prepared = cache.Wait("Prepared");
+        report.Check("Preparation runs on the requesting thread", prepared && preparedCalls == 1 &&
+            prepareThread == std::this_thread::get_id() && createThread != std::this_thread::get_id());
+
+        std::atomic<int> lateCalls = 0;
+        std::thread::id thread;
+        cache.Declare("Late", nullptr, fakePipeline(lateCalls, &thread));
+        const bool created = cache.Wait("Late");
+        report.Check("Waiting for an unrequested pipeline creates it", created && lateCalls == 1 && thread == std::this_thread::get_id());
+
+        std::vector<std::atomic<int>> clearedCalls(pipelineCount);
+        for (int i = 0; i < pipelineCount; i++)
+        {
+            cache.Declare("Cleared" + std::to_string(i), nullptr, fakePipeline(clearedCalls[i]));
+            cache.Request("Cleared" + std::to_string(i));
+        }
+        cache.Clear();
+        const int clearedCount = std::count_if(clearedCalls.begin(), clearedCalls.end(), [](const std::atomic<int>& c) { return c == 1; });
+        std::this_thread::sleep_for(createTime * 2);
+        const int laterCount = std::count_if(clearedCalls.begin(), clearedCalls.end(), [](const std::atomic<int>& c) { return c == 1; });
+        report.Check("Clear waits for running pipelines, drops the queue", running == 0 && clearedCount == laterCount && clearedCount < pipelineCount);
+    }
+
+    const fs::path fileName = options.tempFolder / "PipelineCacheCheck.cache";
+    std::error_code ec;
+    fs::remove(fileName, ec);
+
+    {
+        PipelineCache cache(fileName, threadCount);
+        std::atomic<int> calls = 0;
+        cache.Declare("Used", nullptr, fakePipeline(calls));
+        cache.Declare("Requested but unused", nullptr, fakePipeline(calls));
+        cache.Declare("Never requested", nullptr, fakePipeline(calls));
+        cache.Request("Requested but unused");
+        cache.Wait("Used");
+        std::this_thread::sleep_for(createTime * 2);
+    }
+
+    {
+        PipelineCache cache(fileName, threadCount);
+        std::atomic<int> calls = 0;
+        cache.Declare("Used", nullptr, fakePipeline(calls));
+        cache.Declare("Requested but unused", nullptr, fakePipeline(calls));
+        cache.Declare("Never requested", nullptr, fakePipeline(calls));
+
+        const PipelineCache::Statistics statistics = cache.GetStatistics();
+        report.Check("The pipelines used by the last run are prewarmed", statistics.prewarmed == 1);
+        report.Check("Creation times of unused pipelines are remembered",
+            statistics.skippedTime >= duration<double, std::milli>(createTime).count() && statistics.skippedTime < 1000.0);
+
+        const auto startTime = steady_clock::now();
+        std::this_thread::sleep_for(createTime * 2);
+        cache.Wait("Used");
+        const double waitTime = duration<double, std::milli>(steady_clock::now() - startTime).count();
+        report.Check("Prewarmed pipelines are ready without waiting", cache.GetStatistics().waitTime < waitTime * 0.5);
+    }
+
+    fs::remove(fileName, ec);
+
+    report.Note("%d pipelines of %lld ms on %u threads created in %.1f ms",
+        pipelineCount, (long long)createTime.count(), threadCount, parallelTime);
+
+    return report.Finish();
+}
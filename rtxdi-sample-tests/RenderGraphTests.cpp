@@ -0,0 +1,633 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <random>
+
+// Same as RenderGraph.cpp
+static bool ContainsStates(nvrhi::ResourceStates states, nvrhi::ResourceStates subset)
+{
+    return (uint32_t(states) & uint32_t(subset)) == uint32_t(subset);
+}
+
+// Compiles synthetic pass graphs and checks the schedules, barriers and memory placements
+bool TestRenderGraph(const TestOptions&)
+{
+    TestReport report("RENDER GRAPH TEST");
+
+    const nvrhi::ResourceStates UAV = nvrhi::ResourceStates::UnorderedAccess;
+    const nvrhi::ResourceStates SRV = nvrhi::ResourceStates::ShaderResource;
+    const nvrhi::ResourceStates CopySource = nvrhi::ResourceStates::CopySource;
+
+    auto countBarriers = [](const RenderGraph& graph)
+    {
+        size_t count = 0;
+        for (uint32_t scheduleIndex = 0; scheduleIndex < graph.GetSchedule().size(); scheduleIndex++)
+            count += graph.GetBarriers(scheduleIndex).size();
+        return count;
+    };
+
+    {
+        // A UAV chain through a persistent buffer with a transient intermediate, like the DI resampling passes
+        RenderGraph graph;
+        const auto reservoirs = graph.AddResource("Reservoirs", 1024, 256, false);
+        const auto gradients = graph.AddResource("Gradients", 512, 256, true);
+        graph.AddPass("InitialSamples", {}, { { reservoirs, UAV } });
+        graph.AddPass("TemporalResampling", {}, { { reservoirs, UAV } });
+        graph.AddPass("Gradients", { { reservoirs, UAV } }, { { gradients, UAV } });
+        graph.AddPass("Shade", { { reservoirs, UAV } }, {});
+        graph.AddPass("Confidence", { { gradients, SRV } }, { { reservoirs, UAV } });
+
+        const bool compiled = graph.Compile();
+        report.Check("Chain compiles in declaration order", compiled && graph.GetSchedule() == std::vector<uint32_t>({ 0, 1, 2, 3, 4 }));
+
+        const auto& first = graph.GetBarriers(0);
+        report.Check("First access to an imported UAV gets a UAV barrier",
+            first.size() == 1 && first[0].uavBarrier && first[0].stateBefore == nvrhi::ResourceStates::Unknown);
+        report.Check("UAV write after UAV write gets a UAV barrier", graph.GetBarriers(1).size() == 1 && graph.GetBarriers(1)[0].uavBarrier);
+
+        const auto& gradientsBarriers = graph.GetBarriers(2);
+        report.Check("Transient is discarded at its first write",
+            gradientsBarriers.size() == 2 && gradientsBarriers[1].discard && gradientsBarriers[1].resource == gradients);
+        report.Check("UAV read after UAV read needs no barrier", graph.GetBarriers(3).empty());
+
+        const auto& confidence = graph.GetBarriers(4);
+        report.Check("Transition to SRV and UAV write after reads",
+            confidence.size() == 2 && confidence[0].uavBarrier && confidence[1].stateBefore == UAV && confidence[1].stateAfter == SRV);
+    }
+
+    {
+        // Consecutive reads in different states share one transition
+        RenderGraph graph;
+        const auto texture = graph.AddResource("Texture", 64, 1, false);
+        graph.AddPass("Write", {}, { { texture, UAV } });
+        graph.AddPass("Sample", { { texture, SRV } }, {});
+        graph.AddPass("Copy", { { texture, CopySource } }, {});
+        graph.AddPass("SampleAgain", { { texture, SRV } }, {});
+        graph.Compile();
+
+        const auto& barriers = graph.GetBarriers(1);
+        report.Check("Reads share one combined transition",
+            countBarriers(graph) == 2 && barriers.size() == 1 && barriers[0].stateAfter == (SRV | CopySource));
+    }
+
+    {
+        // Writes that nothing reads are skipped
+        RenderGraph graph;
+        const auto unused = graph.AddResource("Unused", 64, 1, true);
+        const auto output = graph.AddResource("Output", 64, 1, false);
+        const auto temp = graph.AddResource("Temp", 64, 1, true);
+        graph.AddPass("WriteUnused", {}, { { unused, UAV } });
+        graph.AddPass("WriteTemp", {}, { { temp, UAV } });
+        graph.AddPass("ReadUnused", { { unused, UAV } }, { { temp, UAV } });
+        graph.AddPass("NoWrites", { { temp, SRV } }, {});
+        graph.AddPass("WriteOutput", {}, { { output, UAV } });
+        graph.Compile();
+
+        report.Check("Passes that feed a kept pass are not culled",
+            !graph.IsPassCulled(0) && !graph.IsPassCulled(1) && !graph.IsPassCulled(2) && !graph.IsPassCulled(3) && !graph.IsPassCulled(4));
+
+        RenderGraph deadGraph;
+        const auto dead = deadGraph.AddResource("Dead", 64, 1, true);
+        const auto kept = deadGraph.AddResource("Kept", 64, 1, false);
+        deadGraph.AddPass("WriteDead", {}, { { dead, UAV } });
+        deadGraph.AddPass("UpdateDead", { { kept, SRV } }, { { dead, UAV } });
+        deadGraph.AddPass("WriteKept", {}, { { kept, UAV } });
+        deadGraph.Compile();
+        report.Check("Dead transient writers are culled",
+            deadGraph.IsPassCulled(0) && deadGraph.IsPassCulled(1) && !deadGraph.IsPassCulled(2) && deadGraph.GetSchedule().size() == 1);
+    }
+
+    {
+        RenderGraph graph;
+        const auto transient = graph.AddResource("Transient", 64, 1, true);
+        const auto output = graph.AddResource("Output", 64, 1, false);
+        graph.AddPass("ReadFirst", { { transient, SRV } }, { { output, UAV } });
+        report.Check("Reading a transient before writing it fails", !graph.Compile());
+
+        RenderGraph conflict;
+        const auto resource = conflict.AddResource("Resource", 64, 1, false);
+        conflict.AddPass("SampleAndWrite", { { resource, SRV } }, { { resource, UAV } });
+        report.Check("Conflicting states in one pass fail", !conflict.Compile());
+    }
+
+    {
+        // The lighting transients: gradients, then the GSGI G-buffer, then the secondary G-buffer
+        RenderGraph graph;
+        const auto gradients = graph.AddResource("Gradients", 4u << 20, 64 << 10, true);
+        const auto gsgiGBuffer = graph.AddResource("GSGIGBuffer", 1u << 20, 64 << 10, true);
+        const auto secondaryGBuffer = graph.AddResource("SecondaryGBuffer", 96u << 20, 64 << 10, true);
+        const auto lighting = graph.AddResource("DiffuseLighting", 16u << 20, 64 << 10, false);
+        graph.AddPass("ClearGradients", {}, { { gradients, UAV } });
+        graph.AddPass("DIGradients", {}, { { gradients, UAV } });
+        graph.AddPass("Confidence", { { gradients, SRV } }, { { lighting, UAV } });
+        graph.AddPass("GSGISampleGeometry", {}, { { gsgiGBuffer, UAV } });
+        graph.AddPass("GSGICreateLights", { { gsgiGBuffer, UAV } }, { { lighting, UAV } });
+        graph.AddPass("BrdfRayTracing", {}, { { secondaryGBuffer, UAV } });
+        graph.AddPass("GIFinalShading", { { secondaryGBuffer, UAV } }, { { lighting, UAV } });
+        graph.Compile();
+
+        report.Check("Disjoint lifetimes share the same memory",
+            graph.GetTransientOffset(gradients) == 0 && graph.GetTransientOffset(gsgiGBuffer) == 0 &&
+            graph.GetTransientOffset(secondaryGBuffer) == 0 && graph.GetTransientMemorySize() == (96u << 20));
+    }
+
+    {
+        // The light presampling and the virtual lights on the compute queue while the G-buffer is drawn
+        RenderGraph graph;
+        const auto risBuffer = graph.AddResource("RisBuffer", 1u << 20, 64 << 10, false);
+        const auto virtualLights = graph.AddResource("VirtualLights", 1u << 20, 64 << 10, false);
+        const auto gsgiGBuffer = graph.AddResource("GSGIGBuffer", 1u << 20, 64 << 10, true);
+        const auto gbuffer = graph.AddResource("GBuffer", 64u << 20, 64 << 10, false);
+        const auto gradients = graph.AddResource("Gradients", 1u << 20, 64 << 10, true);
+        const auto lighting = graph.AddResource("DiffuseLighting", 16u << 20, 64 << 10, false);
+        graph.SetQueue(nvrhi::CommandQueue::Compute);
+        graph.AddPass("LightSampling", {}, { { risBuffer, UAV } });
+        graph.AddPass("GSGISampleGeometry", {}, { { gsgiGBuffer, UAV } });
+        graph.AddPass("GSGICreateLights", { { gsgiGBuffer, UAV } }, { { virtualLights, UAV } });
+        graph.SetQueue(nvrhi::CommandQueue::Graphics);
+        graph.AddPass("GBufferFill", {}, { { gbuffer, UAV } });
+        graph.AddPass("DIInitialSamples", { { risBuffer, UAV }, { gbuffer, SRV } }, { { gradients, UAV } });
+        graph.AddPass("DIShade", { { gradients, SRV }, { virtualLights, UAV } }, { { lighting, UAV } });
+
+        const bool compiled = graph.Compile();
+        report.Check("Queues keep the declaration order", compiled && graph.GetSchedule() == std::vector<uint32_t>({ 0, 1, 2, 3, 4, 5 }));
+
+        const auto& computeStart = graph.GetWaits(0);
+        report.Check("Compute waits for the work before the graph",
+            computeStart.size() == 1 && computeStart[0].queue == nvrhi::CommandQueue::Graphics &&
+            computeStart[0].scheduleIndex == RenderGraph::c_WorkBeforeGraph && graph.GetWaits(1).empty());
+        report.Check("Independent graphics work doesn't wait", graph.GetWaits(3).empty());
+
+        const auto& diWaits = graph.GetWaits(4);
+        const auto& shadeWaits = graph.GetWaits(5);
+        report.Check("Graphics waits for the pass that it reads",
+            diWaits.size() == 1 && diWaits[0].queue == nvrhi::CommandQueue::Compute && diWaits[0].scheduleIndex == 0 &&
+            shadeWaits.size() == 1 && shadeWaits[0].scheduleIndex == 2);
+        report.Check("No final wait after graphics saw all compute work", graph.GetFinalWaits().empty());
+
+        const auto& diBarriers = graph.GetBarriers(4);
+        const auto risBarrier = std::find_if(diBarriers.begin(), diBarriers.end(),
+            [risBuffer](const RenderGraph::Barrier& barrier) { return barrier.resource == risBuffer; });
+        report.Check("Changing the queue restarts the resource state",
+            risBarrier != diBarriers.end() && risBarrier->stateBefore == nvrhi::ResourceStates::Unknown && risBarrier->uavBarrier);
+
+        const uint64_t gsgiOffset = graph.GetTransientOffset(gsgiGBuffer);
+        const uint64_t gradientsOffset = graph.GetTransientOffset(gradients);
+        report.Check("Transients on unsynchronized queues don't alias",
+            gsgiOffset + (1u << 20) <= gradientsOffset || gradientsOffset + (1u << 20) <= gsgiOffset);
+
+        RenderGraph tail;
+        const auto output = tail.AddResource("Output", 64, 1, false);
+        tail.SetQueue(nvrhi::CommandQueue::Compute);
+        tail.AddPass("Compute", {}, { { output, UAV } });
+        tail.SetQueue(nvrhi::CommandQueue::Graphics);
+        tail.AddPass("Graphics", {}, {});
+        tail.Compile();
+        const auto& finalWaits = tail.GetFinalWaits();
+        report.Check("Graphics joins the other queues at the end",
+            finalWaits.size() == 1 && finalWaits[0].queue == nvrhi::CommandQueue::Compute && finalWaits[0].scheduleIndex == 0);
+    }
+
+    {
+        // The frame split into command lists for parallel recording, all on the graphics queue
+        RenderGraph graph;
+        const auto risBuffer = graph.AddResource("RisBuffer", 1u << 20, 64 << 10, false);
+        const auto gbuffer = graph.AddResource("GBuffer", 64u << 20, 64 << 10, false);
+        const auto lighting = graph.AddResource("DiffuseLighting", 16u << 20, 64 << 10, false);
+        const auto output = graph.AddResource("LdrColor", 16u << 20, 64 << 10, false);
+        graph.AddPass("LightSampling", {}, { { risBuffer, UAV } });
+        graph.BeginCommandList("GBuffer");
+        graph.AddPass("GBufferFill", {}, { { gbuffer, UAV } });
+        graph.BeginCommandList("DirectLighting");
+        graph.AddPass("DIInitialSamples", { { risBuffer, UAV }, { gbuffer, SRV } }, { { lighting, UAV } });
+        graph.AddPass("DIShade", { { gbuffer, SRV } }, { { lighting, UAV } });
+        graph.BeginCommandList("Post");
+        graph.AddPass("Composite", { { lighting, SRV } }, { { output, UAV } });
+
+        const bool compiled = graph.Compile();
+        bool listIndices = compiled && graph.GetCommandListCount() == 4;
+        const uint32_t expectedLists[] = { 0, 1, 2, 2, 3 };
+        for (uint32_t scheduleIndex = 0; listIndices && scheduleIndex < 5; scheduleIndex++)
+            listIndices = graph.GetCommandListIndex(scheduleIndex) == expectedLists[scheduleIndex];
+        report.Check("Each BeginCommandList starts a command list", listIndices);
+
+        bool noWaits = compiled && graph.GetFinalWaits().empty();
+        for (uint32_t scheduleIndex = 0; noWaits && scheduleIndex < 5; scheduleIndex++)
+            noWaits = graph.GetWaits(scheduleIndex).empty();
+        report.Check("Command lists on one queue don't wait", noWaits);
+
+        auto barrierFor = [&graph](uint32_t scheduleIndex, RenderGraph::ResourceHandle resource)
+        {
+            const auto& barriers = graph.GetBarriers(scheduleIndex);
+            const auto barrier = std::find_if(barriers.begin(), barriers.end(),
+                [resource](const RenderGraph::Barrier& b) { return b.resource == resource; });
+            return barrier != barriers.end() ? &*barrier : nullptr;
+        };
+        const RenderGraph::Barrier* gbufferBarrier = compiled ? barrierFor(2, gbuffer) : nullptr;
+        const RenderGraph::Barrier* lightingBarrier = compiled ? barrierFor(3, lighting) : nullptr;
+        report.Check("A new command list restarts the resource state",
+            gbufferBarrier && gbufferBarrier->stateBefore == nvrhi::ResourceStates::Unknown &&
+            lightingBarrier && lightingBarrier->stateBefore == nvrhi::ResourceStates::UnorderedAccess);
+    }
+
+    // Random graphs: check the invariants of the schedule, the barriers and the placement
+    struct RandomAccess
+    {
+        RenderGraph::ResourceHandle resource;
+        nvrhi::ResourceStates state;
+        bool write;
+    };
+
+    std::mt19937 rng(7);
+    const nvrhi::ResourceStates readStates[] = { SRV, CopySource, UAV };
+    bool compiled = true;
+    bool topological = true;
+    bool barriersCover = true;
+    bool barriersMinimal = true;
+    bool placementDisjoint = true;
+    bool placementAligned = true;
+    bool placementBounded = true;
+    uint32_t culledPasses = 0;
+    uint64_t transientBytes = 0;
+    uint64_t memoryBytes = 0;
+
+    for (int iteration = 0; iteration < 1000; iteration++)
+    {
+        RenderGraph graph;
+        const uint32_t resourceCount = 2 + rng() % 8;
+        std::vector<bool> transient(resourceCount);
+        std::vector<bool> written(resourceCount, false);
+        std::vector<uint64_t> sizes(resourceCount);
+        std::vector<uint64_t> alignments(resourceCount);
+        for (uint32_t resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            transient[resourceIndex] = rng() % 2 == 0;
+            sizes[resourceIndex] = 1 + rng() % 100000;
+            alignments[resourceIndex] = uint64_t(1) << (rng() % 17);
+            graph.AddResource("R" + std::to_string(resourceIndex), sizes[resourceIndex], alignments[resourceIndex], transient[resourceIndex]);
+        }
+
+        // At most one access per resource and pass, and transients are written before they are read
+        std::vector<std::vector<RandomAccess>> passAccesses;
+        const uint32_t passCount = 1 + rng() % 24;
+        for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+        {
+            std::vector<RenderGraph::Access> reads;
+            std::vector<RenderGraph::Access> writes;
+            std::vector<RandomAccess> accesses;
+
+            for (uint32_t resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+            {
+                const uint32_t choice = rng() % 6;
+                if (choice == 0 && (!transient[resourceIndex] || written[resourceIndex]))
+                {
+                    const nvrhi::ResourceStates state = readStates[rng() % 3];
+                    reads.push_back({ resourceIndex, state });
+                    accesses.push_back({ resourceIndex, state, false });
+                }
+                else if (choice == 1)
+                {
+                    writes.push_back({ resourceIndex, UAV });
+                    accesses.push_back({ resourceIndex, UAV, true });
+                    written[resourceIndex] = true;
+                }
+            }
+
+            graph.AddPass("P" + std::to_string(passIndex), reads, writes);
+            passAccesses.push_back(accesses);
+        }
+
+        if (!graph.Compile())
+        {
+            compiled = false;
+            continue;
+        }
+
+        const std::vector<uint32_t>& schedule = graph.GetSchedule();
+        std::vector<uint32_t> position(passCount, ~0u);
+        for (uint32_t scheduleIndex = 0; scheduleIndex < schedule.size(); scheduleIndex++)
+            position[schedule[scheduleIndex]] = scheduleIndex;
+
+        for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+        {
+            if (graph.IsPassCulled(passIndex))
+                culledPasses++;
+            topological = topological && graph.IsPassCulled(passIndex) == (position[passIndex] == ~0u);
+        }
+
+        // Passes that access the same resource, with at least one write, keep their declaration order
+        for (uint32_t a = 0; a < passCount; a++)
+        {
+            for (uint32_t b = a + 1; b < passCount; b++)
+            {
+                if (position[a] == ~0u || position[b] == ~0u)
+                    continue;
+
+                for (const RandomAccess& accessA : passAccesses[a])
+                {
+                    for (const RandomAccess& accessB : passAccesses[b])
+                    {
+                        if (accessA.resource == accessB.resource && (accessA.write || accessB.write))
+                            topological = topological && position[a] < position[b];
+                    }
+                }
+            }
+        }
+
+        // Replay the schedule. Each access must find its resource in a matching state without a UAV hazard,
+        // and each barrier must start the resource, change its state or order a UAV hazard.
+        std::vector<nvrhi::ResourceStates> states(resourceCount, nvrhi::ResourceStates::Unknown);
+        std::vector<bool> pendingWrite(resourceCount, false);
+        std::vector<bool> accessed(resourceCount, false);
+        std::vector<uint32_t> firstUse(resourceCount, ~0u);
+        std::vector<uint32_t> lastUse(resourceCount, 0);
+
+        for (uint32_t scheduleIndex = 0; scheduleIndex < schedule.size(); scheduleIndex++)
+        {
+            const std::vector<RandomAccess>& accesses = passAccesses[schedule[scheduleIndex]];
+            std::vector<bool> barrierPlaced(resourceCount, false);
+
+            for (const RenderGraph::Barrier& barrier : graph.GetBarriers(scheduleIndex))
+            {
+                const auto access = std::find_if(accesses.begin(), accesses.end(),
+                    [&barrier](const RandomAccess& a) { return a.resource == barrier.resource; });
+                if (access == accesses.end() || barrierPlaced[barrier.resource])
+                {
+                    barriersMinimal = false;
+                    continue;
+                }
+
+                const nvrhi::ResourceStates state = states[barrier.resource];
+                const bool needed = !accessed[barrier.resource] ||
+                    !ContainsStates(state, access->state) ||
+                    (access->write && state != access->state) ||
+                    (state == UAV && access->state == UAV && (pendingWrite[barrier.resource] || access->write));
+                barriersMinimal = barriersMinimal && needed;
+                barriersCover = barriersCover && barrier.stateBefore == state;
+                barriersCover = barriersCover && barrier.discard == (transient[barrier.resource] && !accessed[barrier.resource]);
+
+                states[barrier.resource] = barrier.stateAfter;
+                pendingWrite[barrier.resource] = false;
+                barrierPlaced[barrier.resource] = true;
+            }
+
+            for (const RandomAccess& access : accesses)
+            {
+                const nvrhi::ResourceStates state = states[access.resource];
+                barriersCover = barriersCover && ContainsStates(state, access.state) && state != nvrhi::ResourceStates::Unknown;
+                barriersCover = barriersCover && (!access.write || state == access.state);
+                barriersCover = barriersCover && !(state == UAV && pendingWrite[access.resource]);
+                barriersCover = barriersCover && !(state == UAV && access.write && accessed[access.resource] && !barrierPlaced[access.resource]);
+
+                pendingWrite[access.resource] = access.write;
+                accessed[access.resource] = true;
+                firstUse[access.resource] = std::min(firstUse[access.resource], scheduleIndex);
+                lastUse[access.resource] = std::max(lastUse[access.resource], scheduleIndex);
+            }
+        }
+
+        // Transient resources with overlapping lifetimes don't share memory
+        uint64_t boundOfSizes = 0;
+        for (uint32_t a = 0; a < resourceCount; a++)
+        {
+            if (!transient[a])
+                continue;
+
+            const uint64_t offsetA = graph.GetTransientOffset(a);
+            boundOfSizes += sizes[a] + alignments[a] - 1;
+            placementAligned = placementAligned && offsetA != RenderGraph::c_NotPlaced && offsetA % alignments[a] == 0;
+            placementBounded = placementBounded && offsetA + sizes[a] <= graph.GetTransientMemorySize();
+
+            for (uint32_t b = a + 1; b < resourceCount; b++)
+            {
+                if (!transient[b] || firstUse[a] == ~0u || firstUse[b] == ~0u)
+                    continue;
+
+                const uint64_t offsetB = graph.GetTransientOffset(b);
+                const bool lifetimesOverlap = firstUse[a] <= lastUse[b] && firstUse[b] <= lastUse[a];
+                const bool memoryOverlaps = offsetA < offsetB + sizes[b] && offsetB < offsetA + sizes[a];
+                placementDisjoint = placementDisjoint && !(lifetimesOverlap && memoryOverlaps);
+            }
+        }
+
+        placementBounded = placementBounded && graph.GetTransientMemorySize() <= boundOfSizes;
+        transientBytes += graph.GetTransientResourceSize();
+        memoryBytes += graph.GetTransientMemorySize();
+    }
+
+    report.Check("Random graphs compile", compiled);
+    report.Check("Random graphs keep dependent passes in order", topological);
+    report.Check("Random graph barriers cover every hazard", barriersCover);
+    report.Check("Random graph barriers are all needed", barriersMinimal);
+    report.Check("Overlapping transient lifetimes use disjoint memory", placementDisjoint);
+    report.Check("Transient offsets are aligned", placementAligned);
+    report.Check("Transient memory is bounded by the resource sizes", placementBounded);
+
+    // Random graphs on two queues: replay the waits and check that they order every conflicting access and every
+    // pair of transient resources that share memory
+    bool waitsCover = true;
+    bool waitsWellFormed = true;
+    bool queueBarriers = true;
+    bool queuePlacementDisjoint = true;
+    bool commandListsConsistent = true;
+    uint32_t waitCount = 0;
+    uint32_t queuePassCount = 0;
+
+    for (int iteration = 0; iteration < 1000; iteration++)
+    {
+        RenderGraph graph;
+        const uint32_t resourceCount = 2 + rng() % 8;
+        std::vector<bool> transient(resourceCount);
+        std::vector<bool> written(resourceCount, false);
+        std::vector<uint64_t> sizes(resourceCount);
+        for (uint32_t resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            transient[resourceIndex] = rng() % 2 == 0;
+            sizes[resourceIndex] = 1 + rng() % 100000;
+            graph.AddResource("R" + std::to_string(resourceIndex), sizes[resourceIndex], 256, transient[resourceIndex]);
+        }
+
+        std::vector<std::vector<RandomAccess>> passAccesses;
+        const uint32_t passCount = 1 + rng() % 24;
+        for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+        {
+            std::vector<RenderGraph::Access> reads;
+            std::vector<RenderGraph::Access> writes;
+            std::vector<RandomAccess> accesses;
+
+            for (uint32_t resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+            {
+                const uint32_t choice = rng() % 6;
+                if (choice == 0 && (!transient[resourceIndex] || written[resourceIndex]))
+                {
+                    reads.push_back({ resourceIndex, UAV });
+                    accesses.push_back({ resourceIndex, UAV, false });
+                }
+                else if (choice == 1)
+                {
+                    writes.push_back({ resourceIndex, UAV });
+                    accesses.push_back({ resourceIndex, UAV, true });
+                    written[resourceIndex] = true;
+                }
+            }
+
+            graph.SetQueue(rng() % 2 ? nvrhi::CommandQueue::Compute : nvrhi::CommandQueue::Graphics);
+            if (rng() % 4 == 0)
+                graph.BeginCommandList("L" + std::to_string(passIndex));
+            graph.AddPass("P" + std::to_string(passIndex), reads, writes);
+            passAccesses.push_back(accesses);
+        }
+
+        if (!graph.Compile())
+        {
+            compiled = false;
+            continue;
+        }
+
+        const std::vector<uint32_t>& schedule = graph.GetSchedule();
+        const size_t scheduleSize = schedule.size();
+        auto queueOf = [&](uint32_t scheduleIndex) { return size_t(graph.GetPassQueue(schedule[scheduleIndex])); };
+
+        // What each queue has finished when a pass starts, -1 for the work before the graph
+        std::vector<std::array<int64_t, 2>> finished(scheduleSize);
+        std::array<std::array<int64_t, 2>, 2> completed = { { { -1, -2 }, { -2, -2 } } };
+
+        auto applyWait = [&](size_t queue, const RenderGraph::QueueWait& wait)
+        {
+            const size_t other = size_t(wait.queue);
+            const int64_t position = wait.scheduleIndex == RenderGraph::c_WorkBeforeGraph ? -1 : int64_t(wait.scheduleIndex);
+            waitsWellFormed = waitsWellFormed && other != queue && other < 2 && position < int64_t(scheduleSize) &&
+                (position < 0 ? other == 0 : queueOf(uint32_t(position)) == other) && position > completed[queue][other];
+            if (position >= 0 && position < int64_t(scheduleSize))
+            {
+                for (size_t third = 0; third < 2; third++)
+                    completed[queue][third] = std::max(completed[queue][third], finished[position][third]);
+            }
+            completed[queue][other] = std::max(completed[queue][other], position);
+            waitCount++;
+        };
+
+        for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+        {
+            const size_t queue = queueOf(scheduleIndex);
+            for (const RenderGraph::QueueWait& wait : graph.GetWaits(scheduleIndex))
+                applyWait(queue, wait);
+
+            finished[scheduleIndex] = completed[queue];
+            finished[scheduleIndex][queue] = scheduleIndex;
+            queuePassCount += queue != 0;
+        }
+
+        for (const RenderGraph::QueueWait& wait : graph.GetFinalWaits())
+            applyWait(0, wait);
+
+        auto isOrdered = [&](uint32_t first, uint32_t second)
+        {
+            return first < second && (queueOf(first) == queueOf(second) || finished[second][queueOf(first)] >= int64_t(first));
+        };
+
+        // Compute starts after the work before the graph, and graphics ends after all passes
+        for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+        {
+            waitsCover = waitsCover && finished[scheduleIndex][0] >= -1;
+            waitsCover = waitsCover && (queueOf(scheduleIndex) == 0 || completed[0][queueOf(scheduleIndex)] >= int64_t(scheduleIndex));
+        }
+
+        std::vector<std::vector<uint32_t>> uses(resourceCount);
+        for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+        {
+            const std::vector<RandomAccess>& accesses = passAccesses[schedule[scheduleIndex]];
+            for (const RandomAccess& access : accesses)
+            {
+                for (uint32_t previous = 0; previous < scheduleIndex; previous++)
+                {
+                    for (const RandomAccess& previousAccess : passAccesses[schedule[previous]])
+                    {
+                        if (previousAccess.resource == access.resource && (previousAccess.write || access.write))
+                            waitsCover = waitsCover && isOrdered(previous, scheduleIndex);
+                    }
+                }
+
+                // The state of a resource is not known anymore in another command list
+                if (!uses[access.resource].empty() &&
+                    graph.GetCommandListIndex(uses[access.resource].back()) != graph.GetCommandListIndex(scheduleIndex))
+                {
+                    const auto& barriers = graph.GetBarriers(scheduleIndex);
+                    const auto barrier = std::find_if(barriers.begin(), barriers.end(),
+                        [&access](const RenderGraph::Barrier& b) { return b.resource == access.resource; });
+                    queueBarriers = queueBarriers && barrier != barriers.end() && barrier->stateBefore == nvrhi::ResourceStates::Unknown;
+                }
+
+                uses[access.resource].push_back(scheduleIndex);
+            }
+        }
+
+        // Each command list belongs to one queue, and the command lists of a queue are submitted in order
+        std::vector<int> listQueues(graph.GetCommandListCount(), -1);
+        listQueues[0] = 0;
+        std::array<uint32_t, 2> lastList = {};
+        for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+        {
+            const uint32_t listIndex = graph.GetCommandListIndex(scheduleIndex);
+            const size_t queue = queueOf(scheduleIndex);
+            if (listIndex >= listQueues.size())
+            {
+                commandListsConsistent = false;
+                continue;
+            }
+            if (listQueues[listIndex] < 0)
+                listQueues[listIndex] = int(queue);
+            commandListsConsistent = commandListsConsistent && listQueues[listIndex] == int(queue) && listIndex >= lastList[queue];
+            lastList[queue] = listIndex;
+        }
+
+        auto isBefore = [&](uint32_t first, uint32_t second)
+        {
+            for (uint32_t firstUse : uses[first])
+                for (uint32_t secondUse : uses[second])
+                    if (!isOrdered(firstUse, secondUse))
+                        return false;
+            return true;
+        };
+
+        for (uint32_t a = 0; a < resourceCount; a++)
+        {
+            for (uint32_t b = a + 1; b < resourceCount; b++)
+            {
+                if (!transient[a] || !transient[b] || uses[a].empty() || uses[b].empty())
+                    continue;
+
+                const uint64_t offsetA = graph.GetTransientOffset(a);
+                const uint64_t offsetB = graph.GetTransientOffset(b);
+                const bool memoryOverlaps = offsetA < offsetB + sizes[b] && offsetB < offsetA + sizes[a];
+                queuePlacementDisjoint = queuePlacementDisjoint && !(memoryOverlaps && !isBefore(a, b) && !isBefore(b, a));
+            }
+        }
+    }
+
+    report.Check("Random queue graphs compile", compiled);
+    report.Check("Queue waits order every conflicting access", waitsCover);
+    report.Check("Queue waits are well formed and all needed", waitsWellFormed);
+    report.Check("Command list changes restart the resource state", queueBarriers);
+    report.Check("Unordered transients on two queues don't alias", queuePlacementDisjoint);
+    report.Check("Command lists keep one queue and their order", commandListsConsistent);
+
+    report.Note("1000 random graphs, %u culled passes, %.1f MB of transient resources in %.1f MB of memory",
+        culledPasses, double(transientBytes) / (1024.0 * 1024.0), double(memoryBytes) / (1024.0 * 1024.0));
+    report.Note("1000 random graphs on two queues, %u compute passes, %u waits", queuePassCount, waitCount);
+
+    return report.Finish();
+}
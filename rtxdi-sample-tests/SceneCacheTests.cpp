@@ -0,0 +1,100 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "SceneCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+// Offsets in the file, see FileHeader and SectionHeader in SceneCache.cpp
+constexpr size_t c_VersionOffset = 4;
+constexpr size_t c_FirstSectionSizeOffset = 32 + 16;
+
+// Writes a synthetic cache, reads it back and checks the contents and the rejection of stale or damaged files,
+// then logs the write and open times. No scene or graphics device is needed.
+bool TestSceneCache(const TestOptions& options)
+{
+    TestReport report("SCENE CACHE TEST");
+    const fs::path fileName = options.tempFolder / "scene_cache_check.cache";
+
+    SceneCacheContents contents;
+    contents.environmentMaps = { "", "/media/environment/first.exr", "/media/environment/second.exr" };
+    contents.numEmissiveMeshes = 8;
+    contents.numEmissiveTriangles = 12345;
+
+    const uint64_t key = 0x0123456789abcdefull;
+
+    const auto writeStart = steady_clock::now();
+    report.Check("Write", SceneCache::Write(fileName, key, contents));
+    const double writeTime = duration<double, std::milli>(steady_clock::now() - writeStart).count();
+
+    SceneCache cache;
+    const auto openStart = steady_clock::now();
+    const bool opened = cache.Open(fileName, key);
+    const double openTime = duration<double, std::milli>(steady_clock::now() - openStart).count();
+    report.Check("Open with the matching key", opened);
+
+    if (opened)
+    {
+        const SceneCacheContents& loaded = cache.GetContents();
+        report.Check("Contents match", loaded.environmentMaps == contents.environmentMaps
+            && loaded.numEmissiveMeshes == contents.numEmissiveMeshes
+            && loaded.numEmissiveTriangles == contents.numEmissiveTriangles);
+    }
+
+    cache.Close();
+    report.Check("Reject a different key", !cache.Open(fileName, key + 1));
+
+    std::vector<uint8_t> fileData;
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    auto writeModified = [&fileName](const std::vector<uint8_t>& data)
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    };
+
+    if (report.Check("Read the file back", fileData.size() > c_FirstSectionSizeOffset + sizeof(uint64_t)))
+    {
+        std::vector<uint8_t> modified = fileData;
+        const uint32_t version = c_SceneCacheVersion + 1;
+        memcpy(modified.data() + c_VersionOffset, &version, sizeof(version));
+        writeModified(modified);
+        report.Check("Reject a different version", !cache.Open(fileName, key));
+
+        modified = fileData;
+        modified.resize(modified.size() / 2);
+        writeModified(modified);
+        report.Check("Reject a truncated file", !cache.Open(fileName, key));
+
+        modified = fileData;
+        const uint64_t sectionSize = modified.size();
+        memcpy(modified.data() + c_FirstSectionSizeOffset, &sectionSize, sizeof(sectionSize));
+        writeModified(modified);
+        report.Check("Reject an out of bounds section", !cache.Open(fileName, key));
+    }
+
+    std::error_code ec;
+    fs::remove(fileName, ec);
+
+    report.Note("Cache size %zu bytes, write %.2f ms, open and validate %.3f ms", fileData.size(), writeTime, openTime);
+
+    return report.Finish();
+}
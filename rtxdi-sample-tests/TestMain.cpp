@@ -0,0 +1,138 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// CPU tests of the sample code that don't need a graphics device.
+// Runs the tests named on the command line, or all of them.
+
+#include "Tests.h"
+
+#include <donut/core/log.h>
+#include <cxxopts.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace donut;
+
+struct TestEntry
+{
+    const char* name;
+    bool (*function)(const TestOptions& options);
+};
+
+static const TestEntry g_Tests[] = {
+    { "BenchmarkComparison", TestBenchmarkComparison },
+    { "BenchmarkResults", TestBenchmarkResults },
+    { "BlasBuildScheduler", TestBlasBuildScheduler },
+    { "BlasDeduplication", TestBlasDeduplication },
+    { "CommandListRecorder", TestCommandListRecorder },
+    { "CpuReference", TestCpuReference },
+    { "DirReGIRTileEncoding", TestDirReGIRTileEncoding },
+    { "EnvironmentAliasTable", TestEnvironmentAliasTable },
+    { "EnvironmentPdf", TestEnvironmentPdf },
+    { "FramePacket", TestFramePacket },
+    { "FrameRecording", TestFrameRecording },
+    { "LightSampling", TestLightSampling },
+    { "LocalLightPdfUpdate", TestLocalLightPdfUpdate },
+    { "PipelineCache", TestPipelineCache },
+    { "RenderGraph", TestRenderGraph },
+    { "SceneCache", TestSceneCache },
+    { "TlasInstanceUpdater", TestTlasInstanceUpdater },
+    { "UploadRingAllocator", TestUploadRingAllocator },
+    { "VirtualLightUpdate", TestVirtualLightUpdate },
+};
+
+int main(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "RTXDI sample CPU tests");
+
+    TestOptions testOptions;
+    std::string tempFolder;
+    std::vector<std::string> testNames;
+    bool help = false;
+    bool list = false;
+
+    options.add_options()
+        ("h,help", "Display this help message", value(help))
+        ("light-sampling-samples", "Number of samples per light of the LightSampling test, default is 1048576", value(testOptions.lightSamplingSamples))
+        ("list", "List the tests and exit", value(list))
+        ("temp-folder", "Folder for the files written by the tests, default is the system temporary folder", value(tempFolder))
+        ("tests", "Names of the tests to run, default is all", value(testNames))
+        ("tlas-instances", "Number of instances of the TlasInstanceUpdater test, default is 100000", value(testOptions.tlasInstances))
+    ;
+    options.parse_positional({ "tests" });
+
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        log::error("%s", e.what());
+        return 1;
+    }
+
+    if (help)
+    {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    if (list)
+    {
+        for (const TestEntry& test : g_Tests)
+            printf("%s\n", test.name);
+        return 0;
+    }
+
+    if (!tempFolder.empty())
+        testOptions.tempFolder = tempFolder;
+
+    std::vector<const TestEntry*> selected;
+    for (const std::string& name : testNames)
+    {
+        const TestEntry* found = nullptr;
+        for (const TestEntry& test : g_Tests)
+        {
+            if (name == test.name)
+                found = &test;
+        }
+
+        if (!found)
+        {
+            log::error("Unknown test '%s', use --list to see the tests", name.c_str());
+            return 1;
+        }
+        selected.push_back(found);
+    }
+
+    if (selected.empty())
+    {
+        for (const TestEntry& test : g_Tests)
+            selected.push_back(&test);
+    }
+
+    uint32_t failures = 0;
+    for (const TestEntry* test : selected)
+    {
+        if (!test->function(testOptions))
+            failures++;
+    }
+
+    if (failures)
+        log::error("%u of %u tests failed", failures, uint32_t(selected.size()));
+    else
+        log::info("All %u tests passed", uint32_t(selected.size()));
+
+    return failures ? 1 : 0;
+}
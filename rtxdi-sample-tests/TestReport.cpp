@@ -0,0 +1,61 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TestReport.h"
+
+#include <donut/core/log.h>
+
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+
+using namespace donut;
+
+TestReport::TestReport(const char* title)
+    : m_Title(title)
+{
+}
+
+bool TestReport::Check(const std::string& name, bool result)
+{
+    assert(name.size() <= c_MaxCheckNameLength);
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-*s %s\n", int(c_MaxCheckNameLength), name.c_str(), result ? "PASS" : "FAIL");
+    m_Checks << line;
+    m_Passed = m_Passed && result;
+
+    return result;
+}
+
+void TestReport::Note(const char* format, ...)
+{
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    m_Notes << line << "\n";
+}
+
+bool TestReport::Finish()
+{
+    std::string table = m_Checks.str();
+    if (m_Notes.tellp() > 0)
+        table += "\n" + m_Notes.str();
+
+    if (m_Passed)
+        log::info("%s >>>\n\n%s<<<", m_Title.c_str(), table.c_str());
+    else
+        log::error("%s FAILED >>>\n\n%s<<<", m_Title.c_str(), table.c_str());
+
+    return m_Passed;
+}
@@ -0,0 +1,41 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <sstream>
+
+// Collects the checks of one test and logs them as a PASS/FAIL table when the test is over
+class TestReport
+{
+public:
+    // Longest check name that keeps the table aligned
+    static constexpr size_t c_MaxCheckNameLength = 52;
+
+    explicit TestReport(const char* title);
+
+    // Returns the result so that a test can stop after a failed precondition
+    bool Check(const std::string& name, bool result);
+
+    // Free-form line after the checks, e.g. timings
+    void Note(const char* format, ...);
+
+    [[nodiscard]] bool Passed() const { return m_Passed; }
+
+    // Logs the table and returns Passed()
+    bool Finish();
+
+private:
+    std::string m_Title;
+    std::stringstream m_Checks;
+    std::stringstream m_Notes;
+    bool m_Passed = true;
+};
@@ -0,0 +1,45 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// Settings of the tests that can be changed on the command line
+struct TestOptions
+{
+    std::filesystem::path tempFolder = std::filesystem::temp_directory_path();
+    uint32_t lightSamplingSamples = 1 << 20; // per light
+    uint32_t tlasInstances = 100000;
+};
+
+// Each test runs on the CPU, logs its report and returns true if all of its checks passed.
+// They are listed in TestMain.cpp.
+
+bool TestBenchmarkComparison(const TestOptions& options);
+bool TestBenchmarkResults(const TestOptions& options);
+bool TestBlasBuildScheduler(const TestOptions& options);
+bool TestBlasDeduplication(const TestOptions& options);
+bool TestCommandListRecorder(const TestOptions& options);
+bool TestCpuReference(const TestOptions& options);
+bool TestDirReGIRTileEncoding(const TestOptions& options);
+bool TestEnvironmentAliasTable(const TestOptions& options);
+bool TestEnvironmentPdf(const TestOptions& options);
+bool TestFramePacket(const TestOptions& options);
+bool TestFrameRecording(const TestOptions& options);
+bool TestLightSampling(const TestOptions& options);
+bool TestLocalLightPdfUpdate(const TestOptions& options);
+bool TestPipelineCache(const TestOptions& options);
+bool TestRenderGraph(const TestOptions& options);
+bool TestSceneCache(const TestOptions& options);
+bool TestTlasInstanceUpdater(const TestOptions& options);
+bool TestUploadRingAllocator(const TestOptions& options);
+bool TestVirtualLightUpdate(const TestOptions& options);
@@ -0,0 +1,158 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "TlasInstanceUpdater.h"
+
+#include <donut/core/math/math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using namespace donut::math;
+using namespace std::chrono;
+
+// Compares full and incremental updates of a synthetic scene where a fraction of the instances moves,
+// checks that the incremental result matches a full rebuild and logs the timings and upload sizes.
+bool TestTlasInstanceUpdater(const TestOptions& options)
+{
+    TestReport report("TLAS INSTANCE UPDATE TEST");
+
+    const uint32_t instanceCount = options.tlasInstances;
+
+    // A synthetic scene: random transforms, a few BLASes, one in a hundred instances moves on every frame
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coordinate(-100.f, 100.f);
+
+    std::vector<affine3> transforms(instanceCount);
+    std::vector<uint64_t> blasAddresses(instanceCount);
+    std::vector<uint8_t> masks(instanceCount);
+    for (uint32_t i = 0; i < instanceCount; i++)
+    {
+        transforms[i] = affine3::identity();
+        transforms[i].m_translation = float3(coordinate(rng), coordinate(rng), coordinate(rng));
+        blasAddresses[i] = 0x10000000ull + (rng() % 64) * 0x10000ull;
+        masks[i] = uint8_t(1 << (rng() % 3));
+    }
+
+    const TlasInstanceUpdater::FillFunction fill = [&](uint32_t begin, uint32_t end, nvrhi::rt::InstanceDesc* instances)
+    {
+        for (uint32_t index = begin; index < end; index++)
+        {
+            nvrhi::rt::InstanceDesc instance;
+            affineToColumnMajor(transforms[index], instance.transform);
+            instance.instanceID = index;
+            instance.instanceMask = masks[index];
+            instance.flags = (index % 7 == 0) ? nvrhi::rt::InstanceFlags::TriangleCullDisable : nvrhi::rt::InstanceFlags::None;
+            instance.blasDeviceAddress = blasAddresses[index];
+            instances[index - begin] = instance;
+        }
+    };
+
+    uint32_t moveFrame = 0;
+    auto moveInstances = [&]()
+    {
+        const uint32_t stride = 100;
+        for (uint32_t index = moveFrame % stride; index < instanceCount; index += stride)
+            transforms[index].m_translation.y += 0.01f;
+        moveFrame++;
+    };
+
+    constexpr uint32_t repetitions = 21;
+    auto median = [](std::vector<double>& times)
+    {
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    };
+
+    auto timeFullUpdate = [&](uint32_t threadCount)
+    {
+        TlasInstanceUpdater updater(threadCount);
+        std::vector<double> times;
+        for (uint32_t i = 0; i < repetitions; i++)
+        {
+            updater.Invalidate();
+            const auto start = steady_clock::now();
+            updater.Update(instanceCount, fill);
+            times.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+        }
+        return median(times);
+    };
+
+    const double fullSerialTime = timeFullUpdate(1);
+    const double fullParallelTime = timeFullUpdate(0);
+
+    TlasInstanceUpdater updater;
+    updater.Update(instanceCount, fill);
+
+    std::vector<double> staticTimes;
+    bool nothingChanged = true;
+    for (uint32_t i = 0; i < repetitions; i++)
+    {
+        const auto start = steady_clock::now();
+        const uint32_t changed = updater.Update(instanceCount, fill);
+        staticTimes.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+        nothingChanged = nothingChanged && changed == 0 && updater.GetChangedRanges().empty();
+    }
+    report.Check("Static scene uploads nothing", nothingChanged);
+
+    std::vector<double> movingTimes;
+    bool rangesCoverChanges = true;
+    uint64_t uploadedInstances = 0;
+    size_t rangeCount = 0;
+    uint32_t changedInstances = 0;
+    for (uint32_t i = 0; i < repetitions; i++)
+    {
+        const std::vector<nvrhi::rt::InstanceDesc> previous = updater.GetInstances();
+        moveInstances();
+
+        const auto start = steady_clock::now();
+        changedInstances = updater.Update(instanceCount, fill);
+        movingTimes.push_back(duration<double, std::milli>(steady_clock::now() - start).count());
+
+        // Every descriptor that differs from the previous frame must be inside a range
+        std::vector<bool> covered(instanceCount, false);
+        for (const TlasInstanceRange& range : updater.GetChangedRanges())
+        {
+            for (uint32_t index = range.begin; index < range.begin + range.count && index < instanceCount; index++)
+                covered[index] = true;
+            uploadedInstances += range.count;
+        }
+        for (uint32_t index = 0; index < instanceCount; index++)
+        {
+            if (!covered[index] && memcmp(&previous[index], &updater.GetInstances()[index], sizeof(nvrhi::rt::InstanceDesc)) != 0)
+                rangesCoverChanges = false;
+        }
+        rangeCount = updater.GetChangedRanges().size();
+    }
+    report.Check("Changed ranges cover every changed instance", rangesCoverChanges);
+
+    {
+        TlasInstanceUpdater reference(1);
+        reference.Update(instanceCount, fill);
+        report.Check("Incremental result matches a full rebuild", instanceCount == 0 ||
+            memcmp(reference.GetInstances().data(), updater.GetInstances().data(), size_t(instanceCount) * sizeof(nvrhi::rt::InstanceDesc)) == 0);
+    }
+
+    const double fullUploadSize = double(instanceCount) * sizeof(nvrhi::rt::InstanceDesc) / 1024.0;
+    const double incrementalUploadSize = double(uploadedInstances) / repetitions * sizeof(nvrhi::rt::InstanceDesc) / 1024.0;
+
+    report.Note("%u instances, %u moving, %d upload ranges", instanceCount, changedInstances, int(rangeCount));
+    report.Note("Full update, 1 thread:            %8.3f ms, %9.1f KB upload", fullSerialTime, fullUploadSize);
+    report.Note("Full update, all threads:         %8.3f ms, %9.1f KB upload", fullParallelTime, fullUploadSize);
+    report.Note("Incremental update, static:       %8.3f ms, %9.1f KB upload", median(staticTimes), 0.0);
+    report.Note("Incremental update, 1%% moving:    %8.3f ms, %9.1f KB upload", median(movingTimes), incrementalUploadSize);
+
+    return report.Finish();
+}
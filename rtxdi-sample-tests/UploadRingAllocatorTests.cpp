@@ -0,0 +1,169 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "UploadRingAllocator.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+// Checks the alignment, wraparound and frame release logic with random frames that complete
+// after a random latency, like frames in flight on the GPU
+bool TestUploadRingAllocator(const TestOptions&)
+{
+    TestReport report("UPLOAD RING TEST");
+
+    {
+        UploadRingAllocator allocator(1024);
+        const uint64_t first = allocator.Allocate(100, 1);
+        const uint64_t aligned = allocator.Allocate(16, 256);
+        report.Check("Allocations follow each other with alignment", first == 0 && aligned == 256);
+
+        allocator.Allocate(600, 16);
+        const uint64_t wrapped = allocator.Allocate(200, 16);
+        report.Check("Allocations that don't fit in the current frame fail", wrapped == UploadRingAllocator::c_InvalidOffset);
+
+        const uint64_t frame = allocator.EndFrame();
+        report.Check("Allocations fail while the frame is in flight", allocator.Allocate(200, 16) == UploadRingAllocator::c_InvalidOffset);
+
+        allocator.Release(frame);
+        report.Check("Released frames free the whole ring", allocator.GetUsedSize() == 0 && allocator.Allocate(1024, 16) == 0);
+        report.Check("Allocations larger than the ring fail", allocator.Allocate(1025, 1) == UploadRingAllocator::c_InvalidOffset);
+    }
+
+    {
+        // Frame 0 uses the start of the ring, frame 1 the end. Once frame 0 completes,
+        // an allocation that doesn't fit at the end of the ring wraps around to the start.
+        UploadRingAllocator allocator(1000);
+        allocator.Allocate(400, 1);
+        const uint64_t frame0 = allocator.EndFrame();
+        allocator.Allocate(500, 1);
+        const uint64_t frame1 = allocator.EndFrame();
+
+        report.Check("Wrapping needs the space at the start of the ring", allocator.Allocate(200, 1) == UploadRingAllocator::c_InvalidOffset);
+        allocator.Release(frame0);
+        const uint64_t wrapped = allocator.Allocate(200, 1);
+        report.Check("Allocations wrap around to the start of the ring", wrapped == 0 && allocator.GetUsedSize() == 500 + 100 + 200);
+
+        allocator.EndFrame();
+        allocator.Release(frame1);
+        report.Check("Skipped bytes belong to the frame that wrapped", allocator.GetUsedSize() == 100 + 200);
+
+        allocator.Allocate(100, 1);
+        allocator.EndFrame();
+        allocator.Release(frame1 + 2);
+        report.Check("Release also frees the earlier frames", allocator.GetUsedSize() == 0 && allocator.GetFramesInFlight() == 0);
+    }
+
+    // Random frames with a random GPU latency. Allocations that fail wait for the oldest frame in flight
+    // like UploadRingBuffer, and fall back to a direct write when nothing is left in flight.
+    struct LiveAllocation
+    {
+        uint64_t frame;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::mt19937 rng(3);
+    const uint64_t capacity = 64 * 1024;
+    UploadRingAllocator allocator(capacity);
+    std::vector<LiveAllocation> live;
+    std::deque<std::pair<uint64_t, uint32_t>> framesInFlight; // frame, frames until completion
+
+    bool aligned = true;
+    bool disjoint = true;
+    bool usedCoversLive = true;
+    bool oversizedRejected = true;
+    uint32_t allocations = 0;
+    uint32_t wraps = 0;
+    uint32_t waits = 0;
+    uint32_t fallbacks = 0;
+    uint64_t previousEnd = 0;
+
+    auto releaseOldest = [&]()
+    {
+        const uint64_t frame = framesInFlight.front().first;
+        framesInFlight.pop_front();
+        allocator.Release(frame);
+        live.erase(std::remove_if(live.begin(), live.end(), [frame](const LiveAllocation& allocation) { return allocation.frame <= frame; }), live.end());
+    };
+
+    for (uint64_t frame = 0; frame < 5000; frame++)
+    {
+        // The GPU completes frames in order
+        for (auto& inFlight : framesInFlight)
+            inFlight.second = inFlight.second > 0 ? inFlight.second - 1 : 0;
+        while (!framesInFlight.empty() && framesInFlight.front().second == 0)
+            releaseOldest();
+
+        const uint32_t allocationCount = uint32_t(rng() % 12);
+        for (uint32_t i = 0; i < allocationCount; i++)
+        {
+            // Mostly small constants and light lists, sometimes larger than the ring
+            const uint64_t size = (rng() % 500 == 0) ? capacity + 1 : 1 + rng() % 8192;
+            const uint64_t alignment = uint64_t(1) << (rng() % 9);
+
+            uint64_t offset = allocator.Allocate(size, alignment);
+            while (offset == UploadRingAllocator::c_InvalidOffset && !framesInFlight.empty())
+            {
+                releaseOldest();
+                waits++;
+                offset = allocator.Allocate(size, alignment);
+            }
+
+            if (offset == UploadRingAllocator::c_InvalidOffset)
+            {
+                // Only the current frame uses the ring, or the allocation is too large for it
+                fallbacks++;
+                continue;
+            }
+
+            oversizedRejected = oversizedRejected && size <= capacity;
+
+            aligned = aligned && (offset % alignment) == 0 && offset + size <= capacity;
+            for (const LiveAllocation& other : live)
+                disjoint = disjoint && (offset + size <= other.offset || other.offset + other.size <= offset);
+
+            if (offset < previousEnd)
+                wraps++;
+            previousEnd = offset + size;
+
+            live.push_back({ frame, offset, size });
+            allocations++;
+        }
+
+        allocator.EndFrame();
+        framesInFlight.push_back({ frame, 1 + uint32_t(rng() % 3) });
+
+        uint64_t liveBytes = 0;
+        for (const LiveAllocation& allocation : live)
+            liveBytes += allocation.size;
+        usedCoversLive = usedCoversLive && allocator.GetUsedSize() >= liveBytes && allocator.GetUsedSize() <= capacity;
+    }
+
+    while (!framesInFlight.empty())
+        releaseOldest();
+
+    report.Check("Random allocations are aligned and inside the ring", aligned);
+    report.Check("Allocations of frames in flight never overlap", disjoint);
+    report.Check("Used size covers the allocations in flight", usedCoversLive);
+    report.Check("Allocations larger than the ring never succeed", oversizedRejected);
+    report.Check("Random allocations wrap around", wraps > 0);
+    report.Check("Everything is released after the last frame", allocator.GetUsedSize() == 0 && allocator.GetFramesInFlight() == 0);
+
+    report.Note("%u allocations in 5000 frames, %u wraparounds, %u waits for the GPU, %u fallbacks",
+        allocations, wraps, waits, fallbacks);
+
+    return report.Finish();
+}
@@ -0,0 +1,233 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Tests.h"
+#include "TestReport.h"
+
+#include "VirtualLightUpdate.h"
+
+#include <random>
+#include <vector>
+
+// Same as VirtualLightUpdate.cpp
+static constexpr uint32_t c_FramesToLowerStride = 16;
+
+// Runs the update modes over many frames and checks the ages of the lights, then drives the budget controller with
+// simulated GPU timings
+bool TestVirtualLightUpdate(const TestOptions&)
+{
+    TestReport report("VIRTUAL LIGHT UPDATE TEST");
+
+    const uint32_t lifespan = 5;
+    const uint32_t samples = 101; // odd, so that the phases of a stride don't have the same number of lights
+
+    // Mirrors PrepareLights.hlsl on the two halves of the light buffer, each light holds the frame that created it.
+    // Returns false if a light in the current half isn't the newest one once the ring is complete.
+    struct LightBufferModel
+    {
+        std::vector<int64_t> newest = std::vector<int64_t>(lifespan * samples, -1);
+        std::vector<int64_t> halves[2] = { std::vector<int64_t>(lifespan * samples, -2), std::vector<int64_t>(lifespan * samples, -3) };
+
+        bool Apply(const VirtualLightUpdate& update, int64_t frame, bool complete)
+        {
+            std::vector<int64_t>& current = halves[frame & 1];
+            const std::vector<int64_t>& previous = halves[!(frame & 1)];
+
+            for (uint32_t block = 0; block < lifespan; block++)
+            {
+                for (uint32_t light = 0; light < samples; light++)
+                {
+                    const uint32_t index = block * samples + light;
+                    if (block == update.block && light % update.stride == update.phase)
+                        current[index] = newest[index] = frame;
+                    else if (block == update.block || block == update.previousBlock)
+                        current[index] = previous[index];
+                }
+            }
+
+            return !complete || current == newest;
+        }
+    };
+
+    // Runs a mode from a reset and checks the order of the updates and the ages of the lights
+    auto runMode = [&](uint32_t stride, uint32_t interval, uint32_t frames, uint32_t maxAge, bool& ordered, bool& young, bool& coherent)
+    {
+        VirtualLightScheduler scheduler;
+        scheduler.Resize(samples, lifespan);
+        LightBufferModel model;
+
+        ordered = true;
+        young = true;
+        coherent = true;
+        uint32_t previousBlock = c_NoVirtualLightBlock;
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            const VirtualLightUpdate update = scheduler.Advance(stride, interval);
+            coherent = coherent && model.Apply(update, frame, scheduler.IsComplete());
+
+            const uint32_t updateIndex = frame / interval;
+            const bool expectActive = frame % interval == 0;
+            ordered = ordered && update.active == expectActive && update.previousBlock == previousBlock;
+            if (expectActive)
+            {
+                ordered = ordered && update.block == (updateIndex / stride) % lifespan && update.phase == updateIndex % stride &&
+                    update.lightCount == GetVirtualLightUpdateCount(samples, stride, update.phase);
+            }
+            previousBlock = update.block;
+
+            if (frame >= lifespan * stride * interval)
+                young = young && scheduler.GetMaxAge() <= maxAge;
+        }
+    };
+
+    bool ordered, young, coherent;
+    runMode(1, 1, 100, lifespan - 1, ordered, young, coherent);
+    report.Check("Full updates replace one block per frame in order", ordered);
+    report.Check("Full updates keep lights for the lifespan", young && coherent);
+
+    runMode(2, 1, 200, 2 * lifespan - 1, ordered, young, coherent);
+    report.Check("Checkerboard alternates the phases of each block", ordered);
+    report.Check("Checkerboard keeps lights for twice the lifespan", young && coherent);
+
+    runMode(1, 2, 200, 2 * lifespan - 1, ordered, young, coherent);
+    report.Check("Half rate updates a block every other frame", ordered);
+    report.Check("Half rate keeps lights for twice the lifespan", young && coherent);
+
+    {
+        uint32_t total[4] = {};
+        for (uint32_t stride = 1, i = 0; stride <= c_MaxVirtualLightUpdateStride; stride *= 2, i++)
+        {
+            for (uint32_t phase = 0; phase < stride; phase++)
+                total[i] += GetVirtualLightUpdateCount(samples, stride, phase);
+        }
+        report.Check("The phases of a stride cover the block once", total[0] == samples && total[1] == samples && total[2] == samples && total[3] == samples);
+    }
+
+    {
+        // The adaptive mode changes the stride at any time, the oldest lights must still go first
+        std::mt19937 rng(5);
+        VirtualLightScheduler scheduler;
+        scheduler.Resize(samples, lifespan);
+        LightBufferModel model;
+
+        bool bounded = true;
+        bool stable = true;
+        bool completeInTime = true;
+        for (uint32_t frame = 0; frame < 2000; frame++)
+        {
+            const uint32_t stride = 1u << std::uniform_int_distribution<uint32_t>(0, 3)(rng);
+            const VirtualLightUpdate update = scheduler.Advance(stride, 1);
+            stable = stable && model.Apply(update, frame, scheduler.IsComplete()) && update.stride == stride;
+
+            if (frame == lifespan * c_MaxVirtualLightUpdateStride - 1)
+                completeInTime = scheduler.IsComplete();
+            if (frame >= lifespan * c_MaxVirtualLightUpdateStride)
+                bounded = bounded && scheduler.GetMaxAge() < lifespan * c_MaxVirtualLightUpdateStride;
+        }
+        report.Check("Random strides replace the oldest lights first", bounded && completeInTime);
+        report.Check("Random strides keep the light buffer halves in sync", stable);
+
+        scheduler.Resize(samples, lifespan + 1);
+        const bool emptyAfterResize = !scheduler.IsComplete();
+        scheduler.Advance(1, 1);
+        report.Check("Resizing the ring restarts it from the first block", emptyAfterResize && !scheduler.IsComplete() && scheduler.GetAge(0, 0) == 0);
+
+        const uint32_t lastBlock = scheduler.Advance(1, 1).block;
+        const VirtualLightUpdate frozen = scheduler.Hold();
+        const VirtualLightUpdate stillFrozen = scheduler.Hold();
+        report.Check("Frozen lights hand over the last updated block", !frozen.active && frozen.previousBlock == lastBlock &&
+            stillFrozen.previousBlock == c_NoVirtualLightBlock && scheduler.GetAge(lastBlock, 0) == 2);
+
+        scheduler.Resize(0, 0);
+        report.Check("An empty ring is never updated", !scheduler.Advance(1, 1).active && scheduler.Advance(1, 1).previousBlock == c_NoVirtualLightBlock);
+    }
+
+    // A simulated GPU: the GI passes cost a fixed part plus a part proportional to the number of lights, with noise.
+    // The time of a frame is returned at the end of the next one and reaches the controller two frames later, like the Profiler's timer queries.
+    struct SimulatedGpu
+    {
+        double fixedCost = 0.3;
+        double fullLightCost = 8.0;
+        std::mt19937 rng{ 11 };
+        std::vector<double> pending;
+
+        double Frame(uint32_t stride)
+        {
+            const double noise = std::uniform_real_distribution<double>(0.95, 1.05)(rng);
+            pending.push_back((fixedCost + fullLightCost / stride) * noise);
+
+            if (pending.size() < 2)
+                return 0.0;
+
+            const double measured = pending.front();
+            pending.erase(pending.begin());
+            return measured;
+        }
+
+        double Cost(uint32_t stride) const { return fixedCost + fullLightCost / stride; }
+    };
+
+    {
+        SimulatedGpu gpu;
+        VirtualLightBudgetController controller(2);
+        double budget = 3.0;
+        double measured = 0.0;
+
+        // 8.3 ms for full updates, the stride that fits 3 ms is 4
+        uint32_t stride = 1;
+        uint32_t changes = 0;
+        bool withinBudget = true;
+        for (uint32_t frame = 0; frame < 400; frame++)
+        {
+            const uint32_t newStride = controller.Update(measured, budget);
+            if (frame >= 100 && newStride != stride)
+                changes++;
+            stride = newStride;
+            measured = gpu.Frame(stride);
+
+            if (frame >= 100)
+                withinBudget = withinBudget && gpu.Cost(stride) <= budget;
+        }
+        report.Check("Adaptive stride settles within the budget", withinBudget && stride == 4);
+        report.Check("Adaptive stride doesn't oscillate with noise", changes == 0);
+
+        // The GI work gets four times heavier: the stride must follow before many frames are over budget
+        gpu.fullLightCost = 20.0;
+        uint32_t framesOverBudget = 0;
+        for (uint32_t frame = 0; frame < 100; frame++)
+        {
+            stride = controller.Update(measured, budget);
+            measured = gpu.Frame(stride);
+            if (gpu.Cost(stride) > budget)
+                framesOverBudget++;
+        }
+        report.Check("A heavier scene raises the stride within 4 frames", framesOverBudget <= 4 && stride == 8);
+
+        // A larger budget brings back full updates, one step per headroom period
+        gpu.fullLightCost = 8.0;
+        budget = 12.0;
+        uint32_t framesToFull = 0;
+        while (stride != 1 && framesToFull < 200)
+        {
+            stride = controller.Update(measured, budget);
+            measured = gpu.Frame(stride);
+            framesToFull++;
+        }
+        report.Check("A larger budget returns to full updates", stride == 1 && framesToFull <= 3 * (c_FramesToLowerStride + 8));
+
+        // Frames without a measurement, e.g. with the profiler off, keep the stride
+        bool kept = true;
+        for (uint32_t frame = 0; frame < 50; frame++)
+            kept = kept && controller.Update(0.0, budget) == 1;
+        report.Check("Missing measurements keep the stride", kept);
+    }
+
+    return report.Finish();
+}
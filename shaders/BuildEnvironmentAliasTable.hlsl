@@ -0,0 +1,193 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// GPU version of BuildEnvironmentAliasTable in EnvironmentAliasTable.cpp, used for the procedural sky that
+// changes with the sun. Each row is built by one thread with Vose's method, then a single thread builds the
+// marginal table from the row weights, then the row probabilities are multiplied into the texel probabilities.
+
+#include "ShaderParameters.h"
+#include "HelperFunctions.hlsli"
+#include "EnvironmentAliasTable.hlsli"
+#include <donut/shaders/vulkan.hlsli>
+
+Texture2D<float4> t_EnvironmentMap : register(t0);
+RWStructuredBuffer<uint2> u_AliasTable : register(u0);
+RWStructuredBuffer<uint2> u_AliasMarginal : register(u1);
+RWBuffer<uint> u_Worklist : register(u2);
+RWBuffer<float> u_RowWeights : register(u3);
+
+VK_PUSH_CONSTANT ConstantBuffer<EnvironmentAliasTableConstants> g_Const : register(b0);
+
+// Same as PreprocessEnvironmentMap.hlsl without the float16 clamp
+float getPixelWeight(uint2 position)
+{
+    float3 color = t_EnvironmentMap[position].rgb;
+    float luma = max(calcLuminance(color), 0);
+
+    // Do not sample invalid colors.
+    if (isinf(luma) || isnan(luma))
+        return 0;
+
+    float elevation = ((float(position.y) + 0.5) / float(g_Const.size.y) - 0.5) * c_pi;
+    float relativeSolidAngle = cos(elevation);
+
+    return min(luma * relativeSolidAngle, 3.402823466e+38);
+}
+
+[numthreads(64, 1, 1)]
+void buildRows(uint y : SV_DispatchThreadID)
+{
+    const uint width = g_Const.size.x;
+    if (y >= g_Const.size.y)
+        return;
+
+    const uint base = y * width;
+
+    float sum = 0;
+    for (uint x = 0; x < width; x++)
+        sum += getPixelWeight(uint2(x, y));
+
+    u_RowWeights[y] = sum;
+
+    if (!(sum > 0))
+    {
+        // Never sampled, the probability of the row is zero
+        for (uint x = 0; x < width; x++)
+            u_AliasTable[base + x] = uint2(asuint(1.0 / float(width)), x | (0xffff << 16));
+        return;
+    }
+
+    // The scaled weights are kept in the probability slots until the thresholds are known.
+    // Small entries grow from the front of the worklist and large ones from the back.
+    const float scale = float(width) / sum;
+    uint smallCount = 0;
+    uint largeBegin = width;
+    for (uint x = 0; x < width; x++)
+    {
+        float scaled = getPixelWeight(uint2(x, y)) * scale;
+        u_AliasTable[base + x] = uint2(asuint(scaled), x | (0xffff << 16));
+
+        if (scaled < 1.0)
+            u_Worklist[base + smallCount++] = x;
+        else
+            u_Worklist[base + --largeBegin] = x;
+    }
+
+    while (smallCount > 0 && largeBegin < width)
+    {
+        uint small = u_Worklist[base + --smallCount];
+        uint large = u_Worklist[base + largeBegin++];
+
+        float smallScaled = asfloat(u_AliasTable[base + small].x);
+        float largeScaled = asfloat(u_AliasTable[base + large].x);
+
+        u_AliasTable[base + small].y = large | (quantizeEnvironmentAliasThreshold(smallScaled) << 16);
+
+        largeScaled = (largeScaled + smallScaled) - 1.0;
+        u_AliasTable[base + large].x = asuint(largeScaled);
+
+        if (largeScaled < 1.0)
+            u_Worklist[base + smallCount++] = large;
+        else
+            u_Worklist[base + --largeBegin] = large;
+    }
+
+    // Probabilities implied by the quantized thresholds
+    for (uint x = 0; x < width; x++)
+        u_AliasTable[base + x].x = 0;
+
+    for (uint x = 0; x < width; x++)
+    {
+        uint aliasAndThreshold = u_AliasTable[base + x].y;
+        float threshold = getEnvironmentAliasThreshold(aliasAndThreshold);
+        uint alias = aliasAndThreshold & 0xffff;
+
+        u_AliasTable[base + x].x = asuint(asfloat(u_AliasTable[base + x].x) + threshold);
+        u_AliasTable[base + alias].x = asuint(asfloat(u_AliasTable[base + alias].x) + (1.0 - threshold));
+    }
+
+    for (uint x = 0; x < width; x++)
+        u_AliasTable[base + x].x = asuint(asfloat(u_AliasTable[base + x].x) / float(width));
+}
+
+[numthreads(1, 1, 1)]
+void buildMarginal()
+{
+    const uint height = g_Const.size.y;
+
+    float sum = 0;
+    for (uint y = 0; y < height; y++)
+    {
+        u_AliasMarginal[y] = uint2(asuint(1.0), y);
+        sum += u_RowWeights[y];
+    }
+
+    if (!(sum > 0))
+    {
+        // Nothing to sample, the texel probabilities become zero
+        for (uint y = 0; y < height; y++)
+            u_RowWeights[y] = 0;
+        return;
+    }
+
+    const float scale = float(height) / sum;
+    uint smallCount = 0;
+    uint largeBegin = height;
+    for (uint y = 0; y < height; y++)
+    {
+        float scaled = u_RowWeights[y] * scale;
+        u_RowWeights[y] = scaled;
+
+        if (scaled < 1.0)
+            u_Worklist[smallCount++] = y;
+        else
+            u_Worklist[--largeBegin] = y;
+    }
+
+    while (smallCount > 0 && largeBegin < height)
+    {
+        uint small = u_Worklist[--smallCount];
+        uint large = u_Worklist[largeBegin++];
+
+        float smallScaled = u_RowWeights[small];
+        float largeScaled = (u_RowWeights[large] + smallScaled) - 1.0;
+
+        u_AliasMarginal[small] = uint2(asuint(smallScaled), large);
+        u_RowWeights[large] = largeScaled;
+
+        if (largeScaled < 1.0)
+            u_Worklist[smallCount++] = large;
+        else
+            u_Worklist[--largeBegin] = large;
+    }
+
+    // Row probabilities implied by the thresholds
+    for (uint y = 0; y < height; y++)
+        u_RowWeights[y] = 0;
+
+    for (uint y = 0; y < height; y++)
+    {
+        uint2 row = u_AliasMarginal[y];
+        float threshold = asfloat(row.x);
+
+        u_RowWeights[y] += threshold / float(height);
+        u_RowWeights[row.y] += (1.0 - threshold) / float(height);
+    }
+}
+
+[numthreads(16, 16, 1)]
+void applyRowProbabilities(uint2 position : SV_DispatchThreadID)
+{
+    if (any(position >= g_Const.size))
+        return;
+
+    uint index = position.y * g_Const.size.x + position.x;
+    u_AliasTable[index].x = asuint(asfloat(u_AliasTable[index].x) * u_RowWeights[position.y]);
+}
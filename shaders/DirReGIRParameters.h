@@ -13,6 +13,20 @@
 #define DirReGIRSampling_DIFFUSE 2
 #define DirReGIRSampling_BRDF 3
 
+#define DirReGIRTileEncoding_FULL 0
+#define DirReGIRTileEncoding_PACKED 1
+#define DirReGIRTileEncoding_PACKED_INDEX_ONLY 2
+
+// Packed 32-bit tile entry layout: [31:21] log2 weight code, [20] compact flag, [19:0] light index.
+// Weight code 0 means zero weight, codes 1..2047 map linearly onto [MIN_LOG2_WEIGHT, MAX_LOG2_WEIGHT].
+#define DIRREGIR_PACKED_INDEX_MASK 0x000fffffu
+#define DIRREGIR_PACKED_INVALID_INDEX 0x000fffffu
+#define DIRREGIR_PACKED_COMPACT_BIT 0x00100000u
+#define DIRREGIR_PACKED_WEIGHT_SHIFT 21
+#define DIRREGIR_PACKED_WEIGHT_MAX_CODE 0x7ffu
+#define DIRREGIR_PACKED_MIN_LOG2_WEIGHT -32.0
+#define DIRREGIR_PACKED_MAX_LOG2_WEIGHT 32.0
+
 
 #ifdef __cplusplus
 //#include <stdint.h>
@@ -31,9 +45,17 @@ enum class DirReGIRSampling : uint32_t
     BRDF = DirReGIRSampling_BRDF
 };
 
+enum class DirReGIRTileEncoding : uint32_t
+{
+    Full = DirReGIRTileEncoding_FULL,
+    Packed = DirReGIRTileEncoding_PACKED,
+    PackedIndexOnly = DirReGIRTileEncoding_PACKED_INDEX_ONLY
+};
+
 #else
 #define ReGIRType uint32_t
 #define DirReGIRSampling uint32_t
+#define DirReGIRTileEncoding uint32_t
 #endif
 
 #endif // RTXDI_DIRREGIR_PARAMETERS_H
\ No newline at end of file
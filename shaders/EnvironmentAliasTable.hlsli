@@ -0,0 +1,63 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#ifndef ENVIRONMENT_ALIAS_TABLE_HLSLI
+#define ENVIRONMENT_ALIAS_TABLE_HLSLI
+
+// Alias tables of the environment map, see EnvironmentAliasTable.h for the layout.
+// Texel entries: x = probability of the texel as float bits, y = alias column | unorm16 threshold << 16.
+// Marginal entries: x = threshold as float bits, y = alias row.
+
+float getEnvironmentAliasThreshold(uint aliasAndThreshold)
+{
+    return float(aliasAndThreshold >> 16) / 65535.0;
+}
+
+// Texels with a non-zero weight keep a non-zero threshold, so that every one of them can be sampled
+uint quantizeEnvironmentAliasThreshold(float threshold)
+{
+    uint quantized = uint(saturate(threshold) * 65535.0 + 0.5);
+    return (threshold > 0) ? max(quantized, 1) : 0;
+}
+
+// Picks a texel with 3 fetches: the row, the column, and the probability of the alias when it is taken.
+// The random numbers are the row, row alias, column and column alias choices.
+uint2 sampleEnvironmentAliasTable(
+    StructuredBuffer<uint2> table,
+    StructuredBuffer<uint2> marginal,
+    uint2 size,
+    float4 random,
+    out float pdf)
+{
+    uint y = min(uint(random.x * float(size.y)), size.y - 1);
+    uint2 row = marginal[y];
+    if (random.y >= asfloat(row.x))
+        y = row.y;
+
+    uint x = min(uint(random.z * float(size.x)), size.x - 1);
+    uint2 texel = table[y * size.x + x];
+    if (random.w >= getEnvironmentAliasThreshold(texel.y))
+    {
+        x = texel.y & 0xffff;
+        texel = table[y * size.x + x];
+    }
+
+    pdf = asfloat(texel.x);
+    return uint2(x, y);
+}
+
+// Probability of sampling the texel that contains 'uv' out of the whole map, same scale as the PDF texture lookup
+float evaluateEnvironmentAliasTablePdf(StructuredBuffer<uint2> table, uint2 size, float2 uv)
+{
+    uint2 texel = min(uint2(uv * float2(size)), size - 1);
+    return asfloat(table[texel.y * size.x + texel.x].x);
+}
+
+#endif // ENVIRONMENT_ALIAS_TABLE_HLSLI
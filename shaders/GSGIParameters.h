@@ -64,8 +64,8 @@ struct VirtualLight_Parameters
     float clampingRatio;
     uint32_t includeInBrdfLightSampling;
     uint32_t totalVirtualLights;
-    int pad;
-    int pad2;
+    uint32_t updateStride; // the GI passes create every updateStride-th light of the current block...
+    uint32_t updatePhase;  // ...starting with this one
     int pad3;
 };
 
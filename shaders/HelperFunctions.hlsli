@@ -11,9 +11,16 @@
 #ifndef HELPER_FUNCTIONS_HLSLI
 #define HELPER_FUNCTIONS_HLSLI
 
+#ifndef __cplusplus
 #include <donut/shaders/utils.hlsli>
 #include <rtxdi/RtxdiMath.hlsli>
 
+// Spellings that differ when the light sampling headers are compiled as C++, see src/CpuReference/HlslCompat.h
+#define HLSL_OUT(type) out type
+#define HLSL_INOUT(type) inout type
+#define HLSL_ZERO(type) (type)0
+#endif
+
 static const float c_pi = 3.1415926535;
 
 struct RandomSamplerState
@@ -34,7 +41,7 @@ RandomSamplerState initRandomSampler(uint2 pixelPos, uint frameIndex)
     return state;
 }
 
-uint murmur3(inout RandomSamplerState r)
+uint murmur3(HLSL_INOUT(RandomSamplerState) r)
 {
 #define ROT32(x, y) ((x << y) | (x >> (32 - y)))
 
@@ -67,7 +74,7 @@ uint murmur3(inout RandomSamplerState r)
     return hash;
 }
 
-float sampleUniformRng(inout RandomSamplerState r)
+float sampleUniformRng(HLSL_INOUT(RandomSamplerState) r)
 {
     uint v = murmur3(r);
     const uint one = asuint(1.f);
@@ -104,7 +111,7 @@ float2 sampleDisk(float2 rand)
     return float2(cos(angle), sin(angle)) * sqrt(rand.y);
 }
 
-float3 sampleCosHemisphere(float2 rand, out float solidAnglePdf)
+float3 sampleCosHemisphere(float2 rand, HLSL_OUT(float) solidAnglePdf)
 {
     float2 tangential = sampleDisk(rand);
     float elevation = sqrt(saturate(1.0 - rand.y));
@@ -114,7 +121,7 @@ float3 sampleCosHemisphere(float2 rand, out float solidAnglePdf)
     return float3(tangential.xy, elevation);
 }
 
-float3 sampleSphere(float2 rand, out float solidAnglePdf)
+float3 sampleSphere(float2 rand, HLSL_OUT(float) solidAnglePdf)
 {
     // See (6-8) in https://mathworld.wolfram.com/SpherePointPicking.html
 
@@ -140,7 +147,7 @@ float calcLuminance(float3 color)
 }
 
 /*https://graphics.pixar.com/library/OrthonormalB/paper.pdf*/
-void branchlessONB(in float3 n, out float3 b1, out float3 b2)
+void branchlessONB(in float3 n, HLSL_OUT(float3) b1, HLSL_OUT(float3) b2)
 {
     float sign = n.z >= 0.0f ? 1.0f : -1.0f;
     float a = -1.0f / (sign + n.z);
@@ -154,7 +161,7 @@ float3 sphericalDirection(float sinTheta, float cosTheta, float sinPhi, float co
     return sinTheta * cosPhi * x + sinTheta * sinPhi * y + cosTheta * z;
 }
 
-void getReflectivity(float metalness, float3 baseColor, out float3 o_albedo, out float3 o_baseReflectivity)
+void getReflectivity(float metalness, float3 baseColor, HLSL_OUT(float3) o_albedo, HLSL_OUT(float3) o_baseReflectivity)
 {
     const float dielectricSpecular = 0.04;
     o_albedo = lerp(baseColor * (1.0 - dielectricSpecular), 0, metalness);
@@ -200,7 +207,7 @@ float2 directionToEquirectUV(float3 normalizedDirection)
     return uv;
 }
 
-float3 equirectUVToDirection(float2 uv, out float cosElevation)
+float3 equirectUVToDirection(float2 uv, HLSL_OUT(float) cosElevation)
 {
     float azimuth = (uv.x + 0.25) * (2 * c_pi);
     float elevation = (0.5 - uv.y) * c_pi;
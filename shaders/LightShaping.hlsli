@@ -33,6 +33,10 @@ LightShaping unpackLightShaping(PolymorphicLightInfo lightInfo)
 
 float evaluateIesProfile(int profileIndex, float3 emissionDirection_, float3 lightPrimaryAxis)
 {
+#ifdef __cplusplus
+    // Host builds have no profile textures, IES shaping is ignored
+    return 1.0;
+#else
     if (profileIndex < 0)
         return 1.0;
 
@@ -57,6 +61,7 @@ float evaluateIesProfile(int profileIndex, float3 emissionDirection_, float3 lig
     float iesMultiplier = iesProfileTexture.SampleLevel(IES_SAMPLER, float2(normAngle, normTangentAngle), 0).x;
 
     return iesMultiplier;
+#endif
 }
 
 float3 evaluateLightShaping(LightShaping shaping, float3 surfacePosition, float3 lightSamplePosition)
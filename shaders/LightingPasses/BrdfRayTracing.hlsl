@@ -40,7 +40,15 @@ void RayGen()
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
     if (!RAB_IsSurfaceValid(surface))
+    {
+        // The secondary G-buffer shares memory with other resources, so it has no valid contents from earlier frames
+        if (g_Const.enableBrdfIndirect)
+        {
+            uint gbufferIndex = RTXDI_ReservoirPositionToPointer(g_Const.restirGI.reservoirBufferParams, GlobalIndex, 0);
+            u_SecondaryGBuffer[gbufferIndex] = (SecondaryGBufferData)0;
+        }
         return;
+    }
 
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex, 5);
     
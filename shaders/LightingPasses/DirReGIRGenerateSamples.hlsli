@@ -2,6 +2,7 @@
 
 #include "RtxdiApplicationBridge.hlsli"
 #include "../DirReGIRParameters.h"
+#include "DirReGIRTileEncoding.hlsli"
 
 #include <rtxdi/InitialSamplingFunctions.hlsli>
 #include <rtxdi/RtxdiParameters.h>
@@ -97,16 +98,29 @@ void SelectNextLocalLightWithDirectionalReGIR(
     
     uint bufferIndex = (cellIndex * 16 * 16) + (bufferLoc.y * 16) + bufferLoc.x;
     
-    uint2 tileData = u_DirReGIRBuffer[bufferIndex];
-    lightIndex = tileData.x & RTXDI_LIGHT_INDEX_MASK;
-    invSourcePdf = asfloat(tileData.y);
+    bool valid;
+    bool compact;
     
-    if (lightIndex == INVALID_LIGHT_INDEX)
+    if (g_Const.dirReGIRTileEncoding == DirReGIRTileEncoding_FULL)
+    {
+        uint2 tileData = u_DirReGIRBuffer[bufferIndex];
+        lightIndex = tileData.x & RTXDI_LIGHT_INDEX_MASK;
+        invSourcePdf = asfloat(tileData.y);
+        valid = lightIndex != INVALID_LIGHT_INDEX;
+        compact = (tileData.x & RTXDI_LIGHT_COMPACT_BIT) != 0;
+    }
+    else
+    {
+        valid = UnpackDirReGIRTileEntry(u_DirReGIRPackedBuffer[bufferIndex], lightIndex, compact, invSourcePdf);
+    }
+    
+    if (!valid)
     {
         lightInfo = RAB_EmptyLightInfo();
         lightIndex = 0;
+        invSourcePdf = 0;
     }
-    else if ((tileData.x & RTXDI_LIGHT_COMPACT_BIT) != 0)
+    else if (compact)
     {
         uint4 packedData1, packedData2;
         packedData1 = u_DirReGIRLightDataBuffer[bufferIndex * 2 + 0];
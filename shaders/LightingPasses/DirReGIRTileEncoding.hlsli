@@ -0,0 +1,50 @@
+#ifndef DIRREGIR_TILE_ENCODING_HLSLI
+#define DIRREGIR_TILE_ENCODING_HLSLI
+
+#include "../DirReGIRParameters.h"
+
+// Must match the CPU implementation in src/DirReGIRTileEncoding.cpp
+
+uint EncodeDirReGIRWeight(float weight)
+{
+    if (!(weight > 0))
+        return 0;
+
+    float t = saturate((log2(weight) - DIRREGIR_PACKED_MIN_LOG2_WEIGHT)
+        / (DIRREGIR_PACKED_MAX_LOG2_WEIGHT - DIRREGIR_PACKED_MIN_LOG2_WEIGHT));
+    return uint(round(t * float(DIRREGIR_PACKED_WEIGHT_MAX_CODE - 1))) + 1;
+}
+
+float DecodeDirReGIRWeight(uint code)
+{
+    if (code == 0)
+        return 0;
+
+    float t = float(code - 1) / float(DIRREGIR_PACKED_WEIGHT_MAX_CODE - 1);
+    return exp2(t * (DIRREGIR_PACKED_MAX_LOG2_WEIGHT - DIRREGIR_PACKED_MIN_LOG2_WEIGHT) + DIRREGIR_PACKED_MIN_LOG2_WEIGHT);
+}
+
+// Light indices that do not fit into the packed index field are stored as invalid entries.
+// The host switches to DirReGIRTileEncoding_FULL when the light buffer is that large, see IsDirReGIRPackedEncodingSupported.
+uint PackDirReGIRTileEntry(uint lightIndex, bool compact, float weight)
+{
+    uint weightCode = EncodeDirReGIRWeight(weight);
+
+    if (lightIndex >= DIRREGIR_PACKED_INVALID_INDEX || weightCode == 0)
+        return DIRREGIR_PACKED_INVALID_INDEX;
+
+    return (weightCode << DIRREGIR_PACKED_WEIGHT_SHIFT)
+        | (compact ? DIRREGIR_PACKED_COMPACT_BIT : 0)
+        | lightIndex;
+}
+
+bool UnpackDirReGIRTileEntry(uint packed, out uint lightIndex, out bool compact, out float weight)
+{
+    lightIndex = packed & DIRREGIR_PACKED_INDEX_MASK;
+    compact = (packed & DIRREGIR_PACKED_COMPACT_BIT) != 0;
+    weight = DecodeDirReGIRWeight(packed >> DIRREGIR_PACKED_WEIGHT_SHIFT);
+
+    return lightIndex != DIRREGIR_PACKED_INVALID_INDEX;
+}
+
+#endif // DIRREGIR_TILE_ENCODING_HLSLI
@@ -11,6 +11,11 @@
 void main(uint GlobalIndex : SV_DispatchThreadID)
 {
     uint gbufferIndex = globalIndexToGBufferPointer(GlobalIndex);
+
+    // Partial updates sample fewer points than the buffer holds, skip the stale ones
+    if (gbufferIndex * g_Const.vLights.updateStride + g_Const.vLights.updatePhase >= g_Const.gsgi.samplesPerFrame)
+        return;
+
     GSGIGBufferData gsgiGBufferData = u_GSGIGBuffer[gbufferIndex];
     
     int gbufferIndexInt = int(gbufferIndex);
@@ -1,6 +1,7 @@
 #pragma pack_matrix(row_major)
 
 #include "RtxdiApplicationBridge.hlsli"
+#include "DirReGIRTileEncoding.hlsli"
 
 #include <rtxdi/PresamplingFunctions.hlsli>
 
@@ -38,7 +39,10 @@ void main(uint GlobalIndex : SV_DispatchThreadID)
     float cellRadius;
     if (!RTXDI_ReGIR_CellIndexToWorldPos(g_Const.regir, int(cellIndex), cellCenter, cellRadius))
     {
-        u_DirReGIRBuffer[bufferIndex] = uint2(INVALID_LIGHT_INDEX, asuint(0.0f));
+        if (g_Const.dirReGIRTileEncoding == DirReGIRTileEncoding_FULL)
+            u_DirReGIRBuffer[bufferIndex] = uint2(INVALID_LIGHT_INDEX, asuint(0.0f));
+        else
+            u_DirReGIRPackedBuffer[bufferIndex] = DIRREGIR_PACKED_INVALID_INDEX;
         return;
     }
 
@@ -135,7 +139,8 @@ void main(uint GlobalIndex : SV_DispatchThreadID)
         weight = (targetPdf > 0) ? weightSumArray[threadX][threadY] / (targetPdf * nSamplesArray[threadX][threadY]) : 0;
     }
     
-    if (weight > 0)
+    // The index-only encoding never copies light data, lights are always loaded from the light buffer
+    if (weight > 0 && g_Const.dirReGIRTileEncoding != DirReGIRTileEncoding_PACKED_INDEX_ONLY)
     {
         uint4 data1, data2;
         if (packCompactLightInfo(lightInfo, data1, data2))
@@ -146,6 +151,14 @@ void main(uint GlobalIndex : SV_DispatchThreadID)
         }
     }
 
+    if (g_Const.dirReGIRTileEncoding != DirReGIRTileEncoding_FULL)
+    {
+        u_DirReGIRPackedBuffer[bufferIndex] = (lightIndex != INVALID_LIGHT_INDEX)
+            ? PackDirReGIRTileEntry(lightIndex, compact, weight)
+            : DIRREGIR_PACKED_INVALID_INDEX;
+        return;
+    }
+
     if (compact)
     {
         lightIndex |= RTXDI_LIGHT_COMPACT_BIT;
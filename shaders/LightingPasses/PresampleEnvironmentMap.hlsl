@@ -12,11 +12,50 @@
 
 #include <rtxdi/PresamplingFunctions.hlsli>
 
+// Same RIS buffer contents as RTXDI_PresampleEnvironmentMap, with the texel picked from the alias tables in constant time
+void presampleEnvironmentAliasTable(
+    inout RAB_RandomSamplerState rng,
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_RISBufferSegmentParameters params)
+{
+    if (sampleInTile >= params.tileSize)
+        return;
+
+    float4 random;
+    random.x = RAB_GetNextRandom(rng);
+    random.y = RAB_GetNextRandom(rng);
+    random.z = RAB_GetNextRandom(rng);
+    random.w = RAB_GetNextRandom(rng);
+
+    float pdf;
+    uint2 texelPosition = sampleEnvironmentAliasTable(
+        t_EnvironmentAliasTable,
+        t_EnvironmentAliasMarginal,
+        g_Const.environmentPdfTextureSize,
+        random,
+        pdf);
+
+    float2 uv = (float2(texelPosition) + 0.5) / float2(g_Const.environmentPdfTextureSize);
+    uint packedUv = uint(saturate(uv.x) * 0xffff) | (uint(saturate(uv.y) * 0xffff) << 16);
+
+    float invPdf = (pdf > 0) ? 1.0 / pdf : 0;
+
+    uint risBufferPtr = params.bufferOffset + tileIndex * params.tileSize + sampleInTile;
+    u_RisBuffer[risBufferPtr] = uint2(packedUv, asuint(invPdf));
+}
+
 [numthreads(RTXDI_PRESAMPLING_GROUP_SIZE, 1, 1)] 
 void main(uint2 GlobalIndex : SV_DispatchThreadID) 
 {    
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex.xy, 0);
 
+    if (g_Const.environmentAliasTable)
+    {
+        presampleEnvironmentAliasTable(rng, GlobalIndex.y, GlobalIndex.x, g_Const.environmentLightRISBufferSegmentParams);
+        return;
+    }
+
     RTXDI_PresampleEnvironmentMap(
         rng,
         t_EnvironmentPdfTexture,
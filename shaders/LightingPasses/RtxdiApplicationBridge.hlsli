@@ -35,6 +35,7 @@ between the bridge functions.
 #include "../ShaderParameters.h"
 #include "../SceneGeometry.hlsli"
 #include "../GBufferHelpers.hlsli"
+#include "../EnvironmentAliasTable.hlsli"
 
 // G-buffer resources
 Texture2D<float> t_GBufferDepth : register(t0);
@@ -66,6 +67,8 @@ Texture2D t_EnvironmentPdfTexture : register(t23);
 Texture2D t_LocalLightPdfTexture : register(t24);
 StructuredBuffer<uint> t_GeometryInstanceToLight : register(t25);
 StructuredBuffer<uint> t_PrimitiveInstanceToLight : register(t26);
+StructuredBuffer<uint2> t_EnvironmentAliasTable : register(t27);
+StructuredBuffer<uint2> t_EnvironmentAliasMarginal : register(t28);
 
 // Screen-sized UAVs
 RWStructuredBuffer<RTXDI_PackedDIReservoir> u_LightReservoirs : register(u0);
@@ -87,6 +90,7 @@ RWStructuredBuffer<PolymorphicLightInfo> u_VirtualLightDataBuffer : register(u16
 RWBuffer<int> u_GSGIGridBuffer : register(u17);
 RWBuffer<uint2> u_DirReGIRBuffer : register(u18);
 RWBuffer<uint4> u_DirReGIRLightDataBuffer : register(u19);
+RWBuffer<uint> u_DirReGIRPackedBuffer : register(u20);
 
 // Other
 ConstantBuffer<ResamplingConstants> g_Const : register(b0);
@@ -518,7 +522,8 @@ float2 RAB_GetEnvironmentMapRandXYFromDir(float3 worldDir)
 }
 
 // Computes the probability of a particular direction being sampled from the environment map
-// relative to all the other possible directions, based on the environment map pdf texture.
+// relative to all the other possible directions, based on the environment map pdf texture
+// or on the probabilities stored in the alias table.
 float RAB_EvaluateEnvironmentMapSamplingPdf(float3 L)
 {
     if (!g_Const.restirDI.initialSamplingParams.environmentMapImportanceSampling)
@@ -526,6 +531,9 @@ float RAB_EvaluateEnvironmentMapSamplingPdf(float3 L)
 
     float2 uv = RAB_GetEnvironmentMapRandXYFromDir(L);
 
+    if (g_Const.environmentAliasTable)
+        return evaluateEnvironmentAliasTablePdf(t_EnvironmentAliasTable, g_Const.environmentPdfTextureSize, uv);
+
     uint2 pdfTextureSize = g_Const.environmentPdfTextureSize.xy;
     uint2 texelPosition = uint2(pdfTextureSize * uv);
     float texelValue = t_EnvironmentPdfTexture[texelPosition].r;
@@ -737,6 +745,12 @@ bool RAB_StoreCompactLightInfo(uint linearIndex, RAB_LightInfo lightInfo)
 // Returns the new index, or a negative number if the light does not exist in the other frame.
 int RAB_TranslateLightIndex(uint lightIndex, bool currentToPrevious)
 {
+    // Static lights are not written by PrepareLights on most frames, so they have no entries in the mapping buffer.
+    // They are stored at the same offset in both halves of the light buffer.
+    uint relativeIndex = (lightIndex >= g_Const.lightBufferStride) ? lightIndex - g_Const.lightBufferStride : lightIndex;
+    if (relativeIndex >= g_Const.staticLightRange.x && relativeIndex < g_Const.staticLightRange.y)
+        return int((lightIndex >= g_Const.lightBufferStride) ? relativeIndex : relativeIndex + g_Const.lightBufferStride);
+
     // In this implementation, the mapping buffer contains both forward and reverse mappings,
     // stored at different offsets, so we don't care about the currentToPrevious parameter.
     uint mappedIndexPlusOne = t_LightIndexMappingBuffer[lightIndex];
@@ -13,7 +13,9 @@
 
 #include "HelperFunctions.hlsli"
 #include "LightShaping.hlsli"
+#ifndef __cplusplus
 #include <rtxdi/RtxdiHelpers.hlsli>
+#endif
 
 #define LIGHT_SAMPING_EPSILON 1e-10
 #define DISTANT_LIGHT_DISTANCE 10000.0
@@ -54,10 +56,10 @@ float3 unpackLightColor(PolymorphicLightInfo lightInfo)
 {
     float3 color = Unpack_R8G8B8_UFLOAT(lightInfo.colorTypeAndFlags);
     float radiance = unpackLightRadiance(lightInfo.logRadiance & 0xffff);
-    return color * radiance.xxx;
+    return color * radiance;
 }
 
-void packLightColor(float3 radiance, inout PolymorphicLightInfo lightInfo)
+void packLightColor(float3 radiance, HLSL_INOUT(PolymorphicLightInfo) lightInfo)
 {   
     float intensity = max(radiance.r, max(radiance.g, radiance.b));
 
@@ -68,14 +70,14 @@ void packLightColor(float3 radiance, inout PolymorphicLightInfo lightInfo)
         uint packedRadiance = min(uint32_t(ceil(logRadiance * 65534.0)) + 1, 0xffffu);
         float unpackedRadiance = unpackLightRadiance(packedRadiance);
 
-        float3 normalizedRadiance = saturate(radiance.rgb / unpackedRadiance.xxx);
+        float3 normalizedRadiance = saturate(radiance / unpackedRadiance);
 
         lightInfo.logRadiance |= packedRadiance;
         lightInfo.colorTypeAndFlags |= Pack_R8G8B8_UFLOAT(normalizedRadiance);
     }
 }
 
-bool packCompactLightInfo(PolymorphicLightInfo lightInfo, out uint4 res1, out uint4 res2)
+bool packCompactLightInfo(PolymorphicLightInfo lightInfo, HLSL_OUT(uint4) res1, HLSL_OUT(uint4) res2)
 {
     if (unpackLightShaping(lightInfo).isSpot)
     {
@@ -84,7 +86,7 @@ bool packCompactLightInfo(PolymorphicLightInfo lightInfo, out uint4 res1, out ui
         return false;
     }
 
-    res1.xyz = asuint(lightInfo.center.xyz);
+    res1.xyz = asuint(lightInfo.center);
     res1.w = lightInfo.colorTypeAndFlags;
 
     res2.x = lightInfo.direction1;
@@ -96,8 +98,8 @@ bool packCompactLightInfo(PolymorphicLightInfo lightInfo, out uint4 res1, out ui
 
 PolymorphicLightInfo unpackCompactLightInfo(const uint4 data1, const uint4 data2)
 {
-    PolymorphicLightInfo lightInfo = (PolymorphicLightInfo)0;
-    lightInfo.center.xyz = asfloat(data1.xyz);
+    PolymorphicLightInfo lightInfo = HLSL_ZERO(PolymorphicLightInfo);
+    lightInfo.center = asfloat(data1.xyz);
     lightInfo.colorTypeAndFlags = data1.w;
     lightInfo.direction1 = data2.x;
     lightInfo.direction2 = data2.y;
@@ -1021,7 +1023,7 @@ struct TriangleLight
 
     PolymorphicLightInfo Store()
     {
-        PolymorphicLightInfo lightInfo = (PolymorphicLightInfo)0;
+        PolymorphicLightInfo lightInfo = HLSL_ZERO(PolymorphicLightInfo);
 
         packLightColor(radiance, lightInfo);
         lightInfo.center = base + (edge1 + edge2) / 3.0;
@@ -1070,11 +1072,14 @@ struct EnvironmentLight
         }
 
         float3 sampleRadiance = radianceScale;
+#ifndef __cplusplus
+        // Host builds have no textures and treat the environment as uniform
         if (textureIndex >= 0)
         {
             Texture2D texture = t_BindlessTextures[textureIndex];
             sampleRadiance *= texture.SampleLevel(ENVIRONMENT_SAMPLER, textureUV, 0).xyz;
         }
+#endif
 
         // Inf / NaN guard.
         // Sometimes EXR files might contain those values (e.g. when saved by Photoshop).
@@ -1115,7 +1120,7 @@ struct PolymorphicLight
         in const float clampDistanceRatio
     )
     {
-        PolymorphicLightSample lightSample = (PolymorphicLightSample)0;
+        PolymorphicLightSample lightSample = HLSL_ZERO(PolymorphicLightSample);
 
         switch (getLightType(lightInfo))
         {
@@ -1144,7 +1149,7 @@ struct PolymorphicLight
         in const float4 random
     )
     {
-        PolymorphicLightPhotonSample photonSample = (PolymorphicLightPhotonSample) 0;
+        PolymorphicLightPhotonSample photonSample = HLSL_ZERO(PolymorphicLightPhotonSample);
 
         switch (getLightType(lightInfo))
         {
@@ -1167,10 +1172,10 @@ struct PolymorphicLight
                 photonSample = TriangleLight::Create(lightInfo).calcPhotonSample(random);
                 break;
             case PolymorphicLightType::kDirectional:
-                photonSample = (PolymorphicLightPhotonSample) 0;
+                photonSample = HLSL_ZERO(PolymorphicLightPhotonSample);
                 break;
             case PolymorphicLightType::kEnvironment:
-                photonSample = (PolymorphicLightPhotonSample) 0;
+                photonSample = HLSL_ZERO(PolymorphicLightPhotonSample);
                 break;
             case PolymorphicLightType::kVirtual:
                 photonSample = VirtualLight::Create(lightInfo).calcPhotonSample(random);
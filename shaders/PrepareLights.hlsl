@@ -87,16 +87,18 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
             
             PolymorphicLightInfo lightInfo = (PolymorphicLightInfo) 0;
             
-            if ((blockIndex == g_Const.virtualLightsCurrentFrameBlock) && !g_Const.lockVirtualLights)
+            bool updatedOnThisFrame = (blockIndex == g_Const.virtualLightsCurrentFrameBlock) && !g_Const.lockVirtualLights;
+            if (updatedOnThisFrame && (virtualLightIndex % g_Const.virtualLightsUpdateStride) == g_Const.virtualLightsUpdatePhase)
             {
                 // If we're in the block for the current frame, grab the light from the virtual lights buffer
-                lightInfo = t_VirtualLights[virtualLightIndex];
+                lightInfo = t_VirtualLights[virtualLightIndex / g_Const.virtualLightsUpdateStride];
                 prevBufferPtr = -1;
                 u_LightDataBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = lightInfo;
             }
-            else if (blockIndex == g_Const.virtualLightsPreviousFrameBlock)
+            else if (updatedOnThisFrame || blockIndex == g_Const.virtualLightsPreviousFrameBlock)
             {
-                // If it's from the previous frame, we need to copy it over from that section of the light buffer
+                // If it's from the previous frame, or a light of the current block that a partial update skips,
+                // we need to copy it over from that section of the light buffer
                 lightInfo = u_LightDataBuffer[g_Const.previousFrameLightOffset + prevBufferPtr];
                 u_LightDataBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = lightInfo;
             }
@@ -88,7 +88,11 @@ struct PrepareLightsConstants
     uint lockVirtualLights;
     uint addVirtualLightsToGeometryMap;
     uint taskBufferOffset;
-    uint pad;
+    uint virtualLightsUpdateStride;
+    uint virtualLightsUpdatePhase;
+    uint pad1;
+    uint pad2;
+    uint pad3;
 };
 
 struct PrepareLightsTask
@@ -113,6 +117,22 @@ struct PreprocessEnvironmentMapConstants
     uint numDestMipLevels;
 };
 
+struct EnvironmentAliasTableConstants
+{
+    uint2 size;
+    uint2 pad;
+};
+
+struct LocalLightPdfUpdateConstants
+{
+    uint2 sourceSize; // size of the mip level above destMipLevel
+    uint destMipLevel;
+    uint firstRange;
+    uint rangeCount;
+    uint texelCount;
+    uint2 pad;
+};
+
 struct GBufferConstants
 {
     PlanarViewConstants view;
@@ -236,7 +256,7 @@ struct ResamplingConstants
     uint enableBrdfIndirect;
     uint enableBrdfAdditiveBlend;    
     uint enableAccumulation; // StoreShadingOutput
-    uint pad1;
+    uint lightBufferStride; // RAB_TranslateLightIndex
 
     SceneConstants sceneConstants;
 
@@ -252,7 +272,8 @@ struct ResamplingConstants
     BRDFPathTracing_Parameters brdfPT;
 
     uint visualizeRegirCells;
-    uint3 pad2;
+    uint environmentAliasTable;
+    uint2 staticLightRange; // lights with the same index in both halves of the light buffer, see PrepareLightsPass
     
     uint2 environmentPdfTextureSize;
     uint2 localLightPdfTextureSize;
@@ -265,6 +286,9 @@ struct ResamplingConstants
     DirReGIRSampling dirReGIRSampling;
     uint bypassDirectionalDirReGIRBuild;
     float dirReGIRBrdfUniformProbability;
+
+    DirReGIRTileEncoding dirReGIRTileEncoding;
+    uint3 pad3;
 };
 
 struct PerPassConstants
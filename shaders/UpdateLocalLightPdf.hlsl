@@ -0,0 +1,56 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Recomputes the texels of one mip level of the local light PDF texture that cover changed lights,
+// see LocalLightPdfUpdate.h. UpdatePdfMipsReference in LocalLightPdfUpdate.cpp does the same on the CPU.
+
+#include "ShaderParameters.h"
+#include <rtxdi/RtxdiMath.hlsli>
+#include <donut/shaders/vulkan.hlsli>
+
+RWTexture2D<float> u_PdfMips[] : register(u0);
+StructuredBuffer<uint2> t_UpdateRanges : register(t0);
+
+VK_PUSH_CONSTANT ConstantBuffer<LocalLightPdfUpdateConstants> g_Const : register(b0);
+
+[numthreads(64, 1, 1)]
+void main(uint dispatchThreadId : SV_DispatchThreadID)
+{
+    if (dispatchThreadId >= g_Const.texelCount)
+        return;
+
+    // Find the last range that starts at or before this thread, .x = first texel, .y = first thread
+    uint left = g_Const.firstRange;
+    uint right = g_Const.firstRange + g_Const.rangeCount - 1;
+    while (left < right)
+    {
+        uint middle = (left + right + 1) / 2;
+        if (t_UpdateRanges[middle].y <= dispatchThreadId)
+            left = middle;
+        else
+            right = middle - 1;
+    }
+
+    uint2 range = t_UpdateRanges[left];
+    uint texel = range.x + (dispatchThreadId - range.y);
+
+    // The children of a texel are the next 4 texels in Z-curve order on the level above.
+    // Texels outside of that level count as zero, like in PreprocessEnvironmentMap.hlsl.
+    RWTexture2D<float> src = u_PdfMips[g_Const.destMipLevel - 1];
+    float sum = 0;
+    for (uint child = 0; child < 4; child++)
+    {
+        uint2 sourcePos = RTXDI_LinearIndexToZCurve(texel * 4 + child);
+        if (all(sourcePos < g_Const.sourceSize))
+            sum += src[sourcePos];
+    }
+
+    u_PdfMips[g_Const.destMipLevel][RTXDI_LinearIndexToZCurve(texel)] = sum * 0.25;
+}
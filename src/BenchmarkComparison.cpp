@@ -0,0 +1,205 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BenchmarkComparison.h"
+#include "BenchmarkResults.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <sstream>
+
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& first, const std::vector<double>& second)
+{
+    MannWhitneyResult result;
+
+    const size_t n1 = first.size();
+    const size_t n2 = second.size();
+    if (n1 == 0 || n2 == 0)
+        return result;
+
+    struct Sample
+    {
+        double value;
+        bool isSecond;
+    };
+
+    std::vector<Sample> samples;
+    samples.reserve(n1 + n2);
+    for (double value : first)
+        samples.push_back({ value, false });
+    for (double value : second)
+        samples.push_back({ value, true });
+
+    std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) { return a.value < b.value; });
+
+    // Assign average ranks to ties and accumulate the tie correction term
+    const double n = double(n1 + n2);
+    double rankSumSecond = 0.0;
+    double tieCorrection = 0.0;
+
+    for (size_t i = 0; i < samples.size(); )
+    {
+        size_t j = i + 1;
+        while (j < samples.size() && samples[j].value == samples[i].value)
+            j++;
+
+        const double averageRank = 0.5 * double(i + 1 + j);
+        for (size_t k = i; k < j; k++)
+        {
+            if (samples[k].isSecond)
+                rankSumSecond += averageRank;
+        }
+
+        const double tieCount = double(j - i);
+        tieCorrection += tieCount * tieCount * tieCount - tieCount;
+
+        i = j;
+    }
+
+    result.u = rankSumSecond - double(n2) * double(n2 + 1) * 0.5;
+
+    const double meanU = double(n1) * double(n2) * 0.5;
+    const double varianceU = double(n1) * double(n2) / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+
+    if (varianceU <= 0.0)
+        return result; // All samples are equal
+
+    const double sigma = std::sqrt(varianceU);
+    const double delta = result.u - meanU;
+    result.z = delta / sigma;
+
+    const double zGreater = (delta - 0.5) / sigma;
+    const double zLess = (delta + 0.5) / sigma;
+    result.pGreater = 0.5 * std::erfc(zGreater / std::sqrt(2.0));
+    result.pLess = 0.5 * std::erfc(-zLess / std::sqrt(2.0));
+
+    return result;
+}
+
+bool BenchmarkComparison::HasRegressions() const
+{
+    return std::any_of(sections.begin(), sections.end(),
+        [](const SectionComparison& section) { return section.status == SectionComparisonStatus::Regression; });
+}
+
+static const BenchmarkSection* findSection(const BenchmarkResults& results, const std::string& name)
+{
+    for (const BenchmarkSection& section : results.sections)
+    {
+        if (section.name == name)
+            return &section;
+    }
+    return nullptr;
+}
+
+BenchmarkComparison CompareBenchmarkResults(
+    const BenchmarkResults& baseline,
+    const BenchmarkResults& current,
+    const BenchmarkComparisonSettings& settings)
+{
+    BenchmarkComparison comparison;
+
+    for (const BenchmarkSection& baselineSection : baseline.sections)
+    {
+        SectionComparison result;
+        result.name = baselineSection.name;
+        result.baselineMedian = ComputeBenchmarkStatistics(baselineSection.frameTimes).p50;
+
+        const BenchmarkSection* currentSection = findSection(current, baselineSection.name);
+        if (!currentSection)
+        {
+            result.status = SectionComparisonStatus::MissingInCurrent;
+            comparison.sections.push_back(result);
+            continue;
+        }
+
+        result.currentMedian = ComputeBenchmarkStatistics(currentSection->frameTimes).p50;
+
+        const double delta = result.currentMedian - result.baselineMedian;
+        result.relativeChange = (result.baselineMedian > 0.0) ? delta / result.baselineMedian : 0.0;
+
+        const MannWhitneyResult test = MannWhitneyUTest(baselineSection.frameTimes, currentSection->frameTimes);
+        const bool significantChange = std::abs(delta) > settings.minAbsoluteDelta
+            && std::abs(result.relativeChange) > settings.relativeThreshold;
+
+        if (delta > 0.0)
+        {
+            result.pValue = test.pGreater;
+            if (significantChange && test.pGreater < settings.significanceLevel)
+                result.status = SectionComparisonStatus::Regression;
+        }
+        else
+        {
+            result.pValue = test.pLess;
+            if (significantChange && test.pLess < settings.significanceLevel)
+                result.status = SectionComparisonStatus::Improvement;
+        }
+
+        comparison.sections.push_back(result);
+    }
+
+    for (const BenchmarkSection& currentSection : current.sections)
+    {
+        if (findSection(baseline, currentSection.name))
+            continue;
+
+        SectionComparison result;
+        result.name = currentSection.name;
+        result.currentMedian = ComputeBenchmarkStatistics(currentSection.frameTimes).p50;
+        result.status = SectionComparisonStatus::MissingInBaseline;
+        comparison.sections.push_back(result);
+    }
+
+    return comparison;
+}
+
+static const char* getStatusText(SectionComparisonStatus status)
+{
+    switch (status)
+    {
+    case SectionComparisonStatus::Regression: return "REGRESSION";
+    case SectionComparisonStatus::Improvement: return "improved";
+    case SectionComparisonStatus::MissingInBaseline: return "new";
+    case SectionComparisonStatus::MissingInCurrent: return "missing";
+    default: return "";
+    }
+}
+
+std::string FormatBenchmarkComparison(const BenchmarkComparison& comparison)
+{
+    size_t nameWidth = 7;
+    for (const SectionComparison& section : comparison.sections)
+        nameWidth = std::max(nameWidth, section.name.size());
+
+    std::stringstream text;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-*s %12s %12s %9s %9s  %s\n", int(nameWidth), "Section", "Base p50 ms", "Curr p50 ms", "Change", "p-value", "Status");
+    text << line;
+
+    for (const SectionComparison& section : comparison.sections)
+    {
+        if (section.status == SectionComparisonStatus::MissingInBaseline || section.status == SectionComparisonStatus::MissingInCurrent)
+        {
+            snprintf(line, sizeof(line), "%-*s %12.3f %12.3f %9s %9s  %s\n", int(nameWidth), section.name.c_str(),
+                section.baselineMedian, section.currentMedian, "-", "-", getStatusText(section.status));
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "%-*s %12.3f %12.3f %+8.1f%% %9.2g  %s\n", int(nameWidth), section.name.c_str(),
+                section.baselineMedian, section.currentMedian, section.relativeChange * 100.0, section.pValue, getStatusText(section.status));
+        }
+        text << line;
+    }
+
+    return text.str();
+}
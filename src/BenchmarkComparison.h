@@ -0,0 +1,70 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct BenchmarkResults;
+
+struct BenchmarkComparisonSettings
+{
+    // A section regresses when its median time grows by more than this fraction of the baseline median...
+    double relativeThreshold = 0.05;
+    // ...and by more than this many milliseconds, which keeps tiny sections from flagging on timer noise...
+    double minAbsoluteDelta = 0.02;
+    // ...and the Mann-Whitney U test rejects "not slower" at this significance level.
+    double significanceLevel = 0.01;
+};
+
+struct MannWhitneyResult
+{
+    double u = 0.0; // U statistic of the second sample
+    double z = 0.0;
+    double pGreater = 1.0; // one-sided p-value for "second sample tends to be larger"
+    double pLess = 1.0; // one-sided p-value for "second sample tends to be smaller"
+};
+
+// Normal approximation with tie and continuity correction, intended for sample sizes of 20 or more.
+MannWhitneyResult MannWhitneyUTest(const std::vector<double>& first, const std::vector<double>& second);
+
+enum class SectionComparisonStatus
+{
+    Unchanged,
+    Regression,
+    Improvement,
+    MissingInBaseline,
+    MissingInCurrent
+};
+
+struct SectionComparison
+{
+    std::string name;
+    double baselineMedian = 0.0;
+    double currentMedian = 0.0;
+    double relativeChange = 0.0;
+    double pValue = 1.0;
+    SectionComparisonStatus status = SectionComparisonStatus::Unchanged;
+};
+
+struct BenchmarkComparison
+{
+    std::vector<SectionComparison> sections;
+
+    bool HasRegressions() const;
+};
+
+BenchmarkComparison CompareBenchmarkResults(
+    const BenchmarkResults& baseline,
+    const BenchmarkResults& current,
+    const BenchmarkComparisonSettings& settings);
+
+std::string FormatBenchmarkComparison(const BenchmarkComparison& comparison);
@@ -0,0 +1,254 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BenchmarkResults.h"
+
+#include <json/reader.h>
+#include <json/writer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+
+double ComputePercentile(const std::vector<double>& sortedSamples, double percentile)
+{
+    if (sortedSamples.empty())
+        return 0.0;
+
+    const double position = std::clamp(percentile, 0.0, 100.0) * 0.01 * double(sortedSamples.size() - 1);
+    const size_t lower = size_t(std::floor(position));
+    const size_t upper = std::min(lower + 1, sortedSamples.size() - 1);
+    const double fraction = position - double(lower);
+
+    return sortedSamples[lower] + (sortedSamples[upper] - sortedSamples[lower]) * fraction;
+}
+
+BenchmarkStatistics ComputeBenchmarkStatistics(std::vector<double> samples)
+{
+    BenchmarkStatistics stats;
+
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / double(samples.size());
+    if (samples.size() > 1)
+    {
+        double squaredDeviations = 0.0;
+        for (double sample : samples)
+            squaredDeviations += (sample - stats.mean) * (sample - stats.mean);
+        stats.stddev = std::sqrt(squaredDeviations / double(samples.size() - 1));
+    }
+    stats.p50 = ComputePercentile(samples, 50.0);
+    stats.p95 = ComputePercentile(samples, 95.0);
+    stats.p99 = ComputePercentile(samples, 99.0);
+
+    return stats;
+}
+
+static double mean(const std::vector<uint32_t>& values)
+{
+    if (values.empty())
+        return 0.0;
+
+    return std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+}
+
+void BenchmarkResultsToJson(const BenchmarkResults& results, Json::Value& root)
+{
+    root = Json::Value(Json::objectValue);
+    root["renderer"] = results.renderer;
+    root["width"] = results.width;
+    root["height"] = results.height;
+    root["frameCount"] = results.frameCount;
+
+    Json::Value& sections = root["sections"];
+    sections = Json::Value(Json::arrayValue);
+
+    for (const BenchmarkSection& section : results.sections)
+    {
+        const BenchmarkStatistics stats = ComputeBenchmarkStatistics(section.frameTimes);
+
+        Json::Value node(Json::objectValue);
+        node["name"] = section.name;
+        node["min"] = stats.min;
+        node["mean"] = stats.mean;
+        node["stddev"] = stats.stddev;
+        node["p50"] = stats.p50;
+        node["p95"] = stats.p95;
+        node["p99"] = stats.p99;
+        node["max"] = stats.max;
+        node["meanRayCount"] = mean(section.rayCounts);
+        node["meanHitCount"] = mean(section.hitCounts);
+
+        Json::Value& frameTimes = node["frameTimes"];
+        frameTimes = Json::Value(Json::arrayValue);
+        for (double time : section.frameTimes)
+            frameTimes.append(time);
+
+        Json::Value& rayCounts = node["rayCounts"];
+        rayCounts = Json::Value(Json::arrayValue);
+        for (uint32_t count : section.rayCounts)
+            rayCounts.append(count);
+
+        Json::Value& hitCounts = node["hitCounts"];
+        hitCounts = Json::Value(Json::arrayValue);
+        for (uint32_t count : section.hitCounts)
+            hitCounts.append(count);
+
+        sections.append(node);
+    }
+}
+
+static bool readUInt(const Json::Value& value, uint32_t& result)
+{
+    if (!value.isUInt())
+        return false;
+
+    result = value.asUInt();
+    return true;
+}
+
+static bool readUIntArray(const Json::Value& value, std::vector<uint32_t>& result)
+{
+    if (!value.isArray())
+        return false;
+
+    for (const Json::Value& element : value)
+    {
+        if (!element.isUInt())
+            return false;
+        result.push_back(element.asUInt());
+    }
+
+    return true;
+}
+
+bool BenchmarkResultsFromJson(const Json::Value& root, BenchmarkResults& results)
+{
+    // The file may come from anywhere, so check every type before jsoncpp's accessors get to throw on a mismatch
+    if (!root.isObject() || !root["sections"].isArray() || !root["renderer"].isString())
+        return false;
+
+    results = BenchmarkResults();
+    results.renderer = root["renderer"].asString();
+
+    if (!readUInt(root["width"], results.width) ||
+        !readUInt(root["height"], results.height) ||
+        !readUInt(root["frameCount"], results.frameCount))
+        return false;
+
+    for (const Json::Value& node : root["sections"])
+    {
+        if (!node.isObject() || !node["name"].isString() || !node["frameTimes"].isArray())
+            return false;
+
+        BenchmarkSection section;
+        section.name = node["name"].asString();
+
+        for (const Json::Value& time : node["frameTimes"])
+        {
+            if (!time.isNumeric())
+                return false;
+            section.frameTimes.push_back(time.asDouble());
+        }
+
+        if (!readUIntArray(node["rayCounts"], section.rayCounts) ||
+            !readUIntArray(node["hitCounts"], section.hitCounts))
+            return false;
+
+        results.sections.push_back(std::move(section));
+    }
+
+    return true;
+}
+
+std::string BenchmarkResultsToCsv(const BenchmarkResults& results)
+{
+    std::stringstream text;
+    text.precision(6);
+
+    text << "section,min_ms,mean_ms,stddev_ms,p50_ms,p95_ms,p99_ms,max_ms,mean_rays,mean_hits" << std::endl;
+    for (const BenchmarkSection& section : results.sections)
+    {
+        const BenchmarkStatistics stats = ComputeBenchmarkStatistics(section.frameTimes);
+
+        text << "\"" << section.name << "\"," << stats.min << "," << stats.mean << "," << stats.stddev << "," << stats.p50 << ","
+            << stats.p95 << "," << stats.p99 << "," << stats.max << ","
+            << mean(section.rayCounts) << "," << mean(section.hitCounts) << std::endl;
+    }
+
+    // Raw per-frame timings, one column per section. Sections that didn't run on every frame have fewer samples.
+    text << std::endl << "frame";
+    for (const BenchmarkSection& section : results.sections)
+        text << ",\"" << section.name << "\"";
+    text << std::endl;
+
+    for (uint32_t frame = 0; frame < results.frameCount; frame++)
+    {
+        text << frame;
+        for (const BenchmarkSection& section : results.sections)
+        {
+            text << ",";
+            if (frame < section.frameTimes.size())
+                text << section.frameTimes[frame];
+        }
+        text << std::endl;
+    }
+
+    return text.str();
+}
+
+bool WriteBenchmarkResults(const BenchmarkResults& results, const std::filesystem::path& fileName)
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    if (fileName.extension() == ".csv")
+    {
+        file << BenchmarkResultsToCsv(results);
+    }
+    else
+    {
+        Json::Value root;
+        BenchmarkResultsToJson(results, root);
+
+        Json::StreamWriterBuilder builder;
+        builder.settings_["indentation"] = "  ";
+        builder.settings_["precision"] = 6;
+        std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+        writer->write(root, &file);
+        file << std::endl;
+    }
+
+    return file.good();
+}
+
+bool ReadBenchmarkResults(const std::filesystem::path& fileName, BenchmarkResults& results)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &root, &errors))
+        return false;
+
+    return BenchmarkResultsFromJson(root, results);
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+struct BenchmarkStatistics
+{
+    double min = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0; // sample standard deviation, 0 for a single sample
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Per-frame samples of one profiler section, all vectors have one entry per recorded frame in which the section ran.
+struct BenchmarkSection
+{
+    std::string name;
+    std::vector<double> frameTimes; // milliseconds
+    std::vector<uint32_t> rayCounts;
+    std::vector<uint32_t> hitCounts;
+};
+
+struct BenchmarkResults
+{
+    std::string renderer;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frameCount = 0;
+    std::vector<BenchmarkSection> sections;
+};
+
+// Linearly interpolates between the closest ranks, 'percentile' is in [0, 100].
+double ComputePercentile(const std::vector<double>& sortedSamples, double percentile);
+BenchmarkStatistics ComputeBenchmarkStatistics(std::vector<double> samples);
+
+void BenchmarkResultsToJson(const BenchmarkResults& results, Json::Value& root);
+// Returns false if any value is missing or has the wrong type.
+bool BenchmarkResultsFromJson(const Json::Value& root, BenchmarkResults& results);
+std::string BenchmarkResultsToCsv(const BenchmarkResults& results);
+
+// Writes CSV if the file extension is .csv, JSON otherwise.
+bool WriteBenchmarkResults(const BenchmarkResults& results, const std::filesystem::path& fileName);
+
+// Reads a JSON file previously written by WriteBenchmarkResults.
+bool ReadBenchmarkResults(const std::filesystem::path& fileName, BenchmarkResults& results);
@@ -0,0 +1,100 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BlasBuildScheduler.h"
+
+#include <algorithm>
+
+static uint64_t alignScratchSize(uint64_t size, uint64_t alignment)
+{
+    return alignment > 1 ? (size + alignment - 1) / alignment * alignment : size;
+}
+
+namespace
+{
+    // Max tree over the space left in each batch, finds the first batch that fits an item in O(log n)
+    class FirstFitTree
+    {
+    public:
+        explicit FirstFitTree(size_t capacity)
+        {
+            while (m_LeafCount < capacity)
+                m_LeafCount *= 2;
+            m_Nodes.resize(m_LeafCount * 2, 0);
+        }
+
+        void Set(size_t index, uint64_t spaceLeft)
+        {
+            size_t node = index + m_LeafCount;
+            m_Nodes[node] = spaceLeft;
+            for (node /= 2; node >= 1; node /= 2)
+                m_Nodes[node] = std::max(m_Nodes[node * 2], m_Nodes[node * 2 + 1]);
+        }
+
+        // Returns the lowest index with at least 'size' space left, or SIZE_MAX
+        [[nodiscard]] size_t FindFirst(uint64_t size) const
+        {
+            if (m_Nodes[1] < size)
+                return SIZE_MAX;
+
+            size_t node = 1;
+            while (node < m_LeafCount)
+                node = (m_Nodes[node * 2] >= size) ? node * 2 : node * 2 + 1;
+
+            return node - m_LeafCount;
+        }
+
+    private:
+        size_t m_LeafCount = 1;
+        std::vector<uint64_t> m_Nodes;
+    };
+}
+
+std::vector<BlasBuildBatch> ScheduleBlasBuilds(const std::vector<BlasBuildItem>& items, uint64_t scratchBudget, uint64_t scratchAlignment)
+{
+    std::vector<BlasBuildItem> sortedItems = items;
+    std::sort(sortedItems.begin(), sortedItems.end(), [](const BlasBuildItem& a, const BlasBuildItem& b)
+    {
+        return a.scratchSize != b.scratchSize ? a.scratchSize > b.scratchSize : a.id < b.id;
+    });
+
+    std::vector<BlasBuildBatch> batches;
+    FirstFitTree spaceLeft(items.size());
+
+    for (const BlasBuildItem& item : sortedItems)
+    {
+        const uint64_t size = alignScratchSize(item.scratchSize, scratchAlignment);
+
+        if (size > scratchBudget)
+        {
+            // Space left stays at zero, nothing else goes into this batch
+            BlasBuildBatch& batch = batches.emplace_back();
+            batch.ids.push_back(item.id);
+            batch.scratchSize = size;
+            batch.overBudget = true;
+            continue;
+        }
+
+        // The tree stores the space left plus one, so that the unused leaves never match, even for zero-size items
+        size_t index = spaceLeft.FindFirst(size + 1);
+        if (index >= batches.size())
+        {
+            index = batches.size();
+            batches.emplace_back();
+        }
+
+        BlasBuildBatch& batch = batches[index];
+        batch.ids.push_back(item.id);
+        batch.scratchSize += size;
+        spaceLeft.Set(index, scratchBudget - batch.scratchSize + 1);
+    }
+
+    return batches;
+}
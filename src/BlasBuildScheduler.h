@@ -0,0 +1,32 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct BlasBuildItem
+{
+    uint32_t id = 0;
+    uint64_t scratchSize = 0;
+};
+
+struct BlasBuildBatch
+{
+    std::vector<uint32_t> ids;
+    uint64_t scratchSize = 0; // sum of the aligned scratch sizes of the builds
+    bool overBudget = false; // a single build that does not fit into the budget on its own
+};
+
+// Splits BLAS builds into batches whose total scratch memory fits into the budget, using first-fit decreasing:
+// builds are sorted by scratch size, largest first, and each one goes into the first batch with enough space left.
+// The result is deterministic, ties are broken by id. Builds larger than the budget get a batch of their own.
+std::vector<BlasBuildBatch> ScheduleBlasBuilds(const std::vector<BlasBuildItem>& items, uint64_t scratchBudget, uint64_t scratchAlignment);
@@ -0,0 +1,118 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BlasDeduplication.h"
+#include "ContentHash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+using namespace donut::math;
+
+uint64_t HashBlasMesh(const BlasMeshView& mesh)
+{
+    if (!mesh.shareable)
+        return 0;
+
+    ContentHasher hasher;
+    hasher.AddWord(mesh.geometries.size());
+    for (const BlasGeometryRange& geometry : mesh.geometries)
+    {
+        hasher.AddWord((uint64_t(geometry.vertexOffset) << 32) | geometry.vertexCount);
+        hasher.AddWord((uint64_t(geometry.indexOffset) << 32) | geometry.indexCount);
+        hasher.AddWord(geometry.opaque ? 1 : 0);
+    }
+    hasher.Add(mesh.positions, size_t(mesh.vertexCount) * sizeof(float3));
+    hasher.Add(mesh.indices, size_t(mesh.indexCount) * sizeof(uint32_t));
+    return hasher.Get();
+}
+
+bool AreBlasMeshesEqual(const BlasMeshView& a, const BlasMeshView& b)
+{
+    if (!a.shareable || !b.shareable)
+        return false;
+
+    if (a.vertexCount != b.vertexCount || a.indexCount != b.indexCount || a.geometries.size() != b.geometries.size())
+        return false;
+
+    for (size_t i = 0; i < a.geometries.size(); i++)
+    {
+        const BlasGeometryRange& ga = a.geometries[i];
+        const BlasGeometryRange& gb = b.geometries[i];
+        if (ga.vertexOffset != gb.vertexOffset || ga.vertexCount != gb.vertexCount ||
+            ga.indexOffset != gb.indexOffset || ga.indexCount != gb.indexCount || ga.opaque != gb.opaque)
+            return false;
+    }
+
+    // Bitwise comparison, same as the hash: -0 and +0 are different, which only costs a missed share
+    return memcmp(a.positions, b.positions, size_t(a.vertexCount) * sizeof(float3)) == 0
+        && memcmp(a.indices, b.indices, size_t(a.indexCount) * sizeof(uint32_t)) == 0;
+}
+
+std::vector<uint64_t> HashBlasMeshes(const std::vector<BlasMeshView>& meshes, uint32_t threadCount)
+{
+    std::vector<uint64_t> hashes(meshes.size(), 0);
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, uint32_t(meshes.size()));
+
+    // One mesh at a time from a shared counter, mesh sizes vary too much for a static split
+    std::atomic<size_t> nextMesh = 0;
+    auto worker = [&]()
+    {
+        for (size_t index = nextMesh++; index < meshes.size(); index = nextMesh++)
+            hashes[index] = HashBlasMesh(meshes[index]);
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < threadCount; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return hashes;
+}
+
+std::vector<uint32_t> FindDuplicateBlasMeshes(const std::vector<BlasMeshView>& meshes, const std::vector<uint64_t>& hashes)
+{
+    std::vector<uint32_t> owners(meshes.size());
+    std::unordered_map<uint64_t, std::vector<uint32_t>> candidates;
+
+    for (uint32_t index = 0; index < uint32_t(meshes.size()); index++)
+    {
+        owners[index] = index;
+
+        if (!meshes[index].shareable)
+            continue;
+
+        // Usually a single candidate, several only if the hash collides
+        std::vector<uint32_t>& sameHash = candidates[hashes[index]];
+        for (uint32_t candidate : sameHash)
+        {
+            if (AreBlasMeshesEqual(meshes[candidate], meshes[index]))
+            {
+                owners[index] = candidate;
+                break;
+            }
+        }
+
+        if (owners[index] == index)
+            sameHash.push_back(index);
+    }
+
+    return owners;
+}
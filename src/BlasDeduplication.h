@@ -0,0 +1,50 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+
+#include <cstdint>
+#include <vector>
+
+// One geometry of a mesh as it goes into the BLAS, offsets are relative to the start of the mesh
+struct BlasGeometryRange
+{
+    uint32_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    bool opaque = false;
+};
+
+// Everything that determines the contents of a non-skinned BLAS
+struct BlasMeshView
+{
+    const dm::float3* positions = nullptr;
+    const uint32_t* indices = nullptr;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    std::vector<BlasGeometryRange> geometries;
+    bool shareable = false; // skinned meshes, or meshes without CPU data, always get their own BLAS
+};
+
+// Hash of the positions, indices, geometry ranges and opaque flags. Meshes that are not shareable hash to zero.
+uint64_t HashBlasMesh(const BlasMeshView& mesh);
+
+// Exact comparison of everything that goes into the hash
+bool AreBlasMeshesEqual(const BlasMeshView& a, const BlasMeshView& b);
+
+// Hashes the meshes on 'threadCount' threads, zero means all cores
+std::vector<uint64_t> HashBlasMeshes(const std::vector<BlasMeshView>& meshes, uint32_t threadCount);
+
+// For each mesh, returns the index of the first mesh with identical geometry, i.e. the one whose BLAS it can use.
+// Meshes with equal hashes are compared in full, so a hash collision never makes different meshes share a BLAS.
+std::vector<uint32_t> FindDuplicateBlasMeshes(const std::vector<BlasMeshView>& meshes, const std::vector<uint64_t>& hashes);
@@ -0,0 +1,115 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CommandListRecorder.h"
+
+#include <cassert>
+#include <chrono>
+
+using namespace std::chrono;
+
+CommandListRecorder::CommandListRecorder(nvrhi::IDevice* device, uint32_t threadCount)
+    : m_Device(device)
+{
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_Threads.emplace_back(&CommandListRecorder::WorkerThread, this);
+}
+
+CommandListRecorder::~CommandListRecorder()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Terminate = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& thread : m_Threads)
+        thread.join();
+}
+
+nvrhi::ICommandList* CommandListRecorder::GetCommandList(nvrhi::CommandQueue queue, uint32_t slot)
+{
+    assert(m_Device);
+
+    std::vector<nvrhi::CommandListHandle>& commandLists = m_CommandLists[size_t(queue)];
+    while (commandLists.size() <= slot)
+        commandLists.push_back(m_Device->createCommandList(nvrhi::CommandListParameters().setQueueType(queue)));
+
+    return commandLists[slot];
+}
+
+void CommandListRecorder::Run(const std::vector<Job>& jobs)
+{
+    const auto start = steady_clock::now();
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Jobs = &jobs;
+        m_NextJob = 0;
+        m_DoneJobs = 0;
+        m_JobTime = 0.0;
+        m_Generation++;
+    }
+    m_WorkAvailable.notify_all();
+
+    RunJobs();
+
+    std::unique_lock lock(m_Mutex);
+    m_WorkDone.wait(lock, [this, &jobs] { return m_DoneJobs == jobs.size(); });
+    m_Jobs = nullptr;
+
+    m_Statistics.jobs = uint32_t(jobs.size());
+    m_Statistics.wallTime = duration<double, std::milli>(steady_clock::now() - start).count();
+    m_Statistics.jobTime = m_JobTime;
+}
+
+void CommandListRecorder::RunJobs()
+{
+    while (true)
+    {
+        const Job* job;
+        {
+            std::lock_guard lock(m_Mutex);
+            if (!m_Jobs || m_NextJob >= m_Jobs->size())
+                return;
+            job = &(*m_Jobs)[m_NextJob++];
+        }
+
+        const auto start = steady_clock::now();
+        (*job)();
+        const double jobTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        {
+            std::lock_guard lock(m_Mutex);
+            m_JobTime += jobTime;
+            if (++m_DoneJobs == m_Jobs->size())
+                m_WorkDone.notify_all();
+        }
+    }
+}
+
+void CommandListRecorder::WorkerThread()
+{
+    uint64_t generation = 0;
+
+    std::unique_lock lock(m_Mutex);
+    while (true)
+    {
+        m_WorkAvailable.wait(lock, [this, generation] { return m_Terminate || m_Generation != generation; });
+        if (m_Terminate)
+            return;
+
+        generation = m_Generation;
+
+        lock.unlock();
+        RunJobs();
+        lock.lock();
+    }
+}
@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records the command lists of a frame on worker threads. The jobs of one Run go to the workers and the calling
+// thread at once, each job usually records one command list from start to end. The jobs must not share state
+// that isn't thread-safe, such as a shader factory or a pipeline cache of a donut pass.
+// The command lists are created on first use and reused in the following frames.
+class CommandListRecorder
+{
+public:
+    typedef std::function<void()> Job;
+
+    struct Statistics
+    {
+        uint32_t jobs = 0;
+        double wallTime = 0.0; // ms from the start of Run until all jobs are done
+        double jobTime = 0.0;  // ms summed over all jobs
+    };
+
+    // Zero threads runs every job on the calling thread. The device can be null when no command lists are needed.
+    CommandListRecorder(nvrhi::IDevice* device, uint32_t threadCount);
+    ~CommandListRecorder();
+
+    // The same queue and slot return the same command list in every frame
+    nvrhi::ICommandList* GetCommandList(nvrhi::CommandQueue queue, uint32_t slot);
+
+    // Returns when all jobs are done. The jobs start in order, the calling thread takes part.
+    void Run(const std::vector<Job>& jobs);
+
+    [[nodiscard]] uint32_t GetThreadCount() const { return uint32_t(m_Threads.size()); }
+    [[nodiscard]] const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::array<std::vector<nvrhi::CommandListHandle>, size_t(nvrhi::CommandQueue::Count)> m_CommandLists;
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkDone;
+    const std::vector<Job>* m_Jobs = nullptr;
+    size_t m_NextJob = 0;
+    size_t m_DoneJobs = 0;
+    uint64_t m_Generation = 0;
+    bool m_Terminate = false;
+    double m_JobTime = 0.0;
+
+    Statistics m_Statistics;
+
+    void WorkerThread();
+
+    // Takes jobs until there are none left
+    void RunJobs();
+};
@@ -11,7 +11,6 @@
 #include "CompositingPass.h"
 #include "RenderTargets.h"
 #include "SampleScene.h"
-#include "UserInterface.h"
 
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/View.h>
@@ -113,7 +112,10 @@ void CompositingPass::Render(
     const donut::engine::IView& viewPrev,
     const uint32_t denoiserMode,
     const bool checkerboard,
-    const UIData& ui,
+    const bool enableTextures,
+    const float noiseMix,
+    const float noiseClampLow,
+    const float noiseClampHigh,
     const EnvironmentLight& environmentLight)
 {
     commandList->beginMarker("Compositing");
@@ -121,16 +123,16 @@ void CompositingPass::Render(
     CompositingConstants constants = {};
     view.FillPlanarViewConstants(constants.view);
     viewPrev.FillPlanarViewConstants(constants.viewPrev);
-    constants.enableTextures = ui.enableTextures;
+    constants.enableTextures = enableTextures;
     constants.denoiserMode = denoiserMode;
     constants.checkerboard = checkerboard;
     constants.enableEnvironmentMap = (environmentLight.textureIndex >= 0);
     constants.environmentMapTextureIndex = (environmentLight.textureIndex >= 0) ? environmentLight.textureIndex : 0;
     constants.environmentScale = environmentLight.radianceScale.x;
     constants.environmentRotation = environmentLight.rotation;
-    constants.noiseMix = ui.noiseMix;
-    constants.noiseClampLow = ui.noiseClampLow;
-    constants.noiseClampHigh = ui.noiseClampHigh;
+    constants.noiseMix = noiseMix;
+    constants.noiseClampLow = noiseClampLow;
+    constants.noiseClampHigh = noiseClampHigh;
     commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
     nvrhi::ComputeState state;
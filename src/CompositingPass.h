@@ -23,7 +23,6 @@ namespace donut::engine
 
 class RenderTargets;
 class EnvironmentLight;
-struct UIData;
 
 class CompositingPass
 {
@@ -61,7 +60,10 @@ public:
         const donut::engine::IView& viewPrev,
         uint32_t denoiserMode,
         bool checkerboard,
-        const UIData& ui,
+        bool enableTextures,
+        float noiseMix,
+        float noiseClampLow,
+        float noiseClampHigh,
         const EnvironmentLight& environmentLight);
 
     void NextFrame();
@@ -0,0 +1,65 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Word-at-a-time hash for large blobs such as meshes and images, a byte-wise hash is too slow for those.
+// Not a cryptographic hash: users that cannot tolerate collisions must compare the contents.
+class ContentHasher
+{
+public:
+    void Add(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        size_t offset = 0;
+
+        for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, bytes + offset, sizeof(word));
+            AddWord(word);
+        }
+
+        if (offset < size)
+        {
+            uint64_t word = 0;
+            memcpy(&word, bytes + offset, size - offset);
+            AddWord(word);
+        }
+
+        AddWord(size);
+    }
+
+    void AddWord(uint64_t word)
+    {
+        m_State ^= mix(word);
+        m_State = ((m_State << 29) | (m_State >> 35)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // Never zero, so that zero can mean "no hash"
+    [[nodiscard]] uint64_t Get() const
+    {
+        return std::max(mix(m_State), uint64_t(1));
+    }
+
+private:
+    uint64_t m_State = 0x243F6A8885A308D3ull;
+
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+};
@@ -0,0 +1,176 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+
+static const std::chrono::steady_clock::time_point g_Epoch = std::chrono::steady_clock::now();
+
+CpuProfiler::CpuProfiler()
+{
+    // The GPU sections only have durations, see Profiler::ResolvePreviousFrame
+    m_GpuTrack.name = "GPU (synthetic layout)";
+}
+
+CpuProfiler& CpuProfiler::Get()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+uint64_t CpuProfiler::Now()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_Epoch).count());
+}
+
+void CpuProfiler::Enable(bool enable)
+{
+    m_Enabled.store(enable, std::memory_order_relaxed);
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::GetThreadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_RegistryMutex);
+
+        auto newBuffer = std::make_unique<ThreadBuffer>();
+        newBuffer->threadIndex = uint32_t(m_ThreadBuffers.size()) + 1;
+        newBuffer->name = "CPU " + std::to_string(newBuffer->threadIndex);
+
+        buffer = newBuffer.get();
+        m_ThreadBuffers.push_back(std::move(newBuffer));
+    }
+
+    return *buffer;
+}
+
+void CpuProfiler::AppendEvent(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end)
+{
+    // Only the owning thread writes to a buffer, the release store publishes the event to WriteChromeTrace.
+    // The events are allocated on the first one, so threads that run while the profiler is disabled cost nothing.
+    if (buffer.events.empty())
+        buffer.events.resize(c_EventsPerThread);
+
+    const size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= buffer.events.size())
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[index] = Event{ name, start, end };
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+    ThreadBuffer& buffer = GetThreadBuffer();
+
+    std::lock_guard<std::mutex> lock(m_RegistryMutex);
+    buffer.name = name;
+}
+
+void CpuProfiler::RecordEvent(const char* name, uint64_t start, uint64_t end)
+{
+    if (!IsEnabled())
+        return;
+
+    AppendEvent(GetThreadBuffer(), name, start, end);
+}
+
+void CpuProfiler::RecordGpuEvent(const char* name, uint64_t start, uint64_t end)
+{
+    if (!IsEnabled())
+        return;
+
+    AppendEvent(m_GpuTrack, name, start, end);
+}
+
+static void writeEscapedString(FILE* file, const char* s)
+{
+    fputc('"', file);
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', file);
+        fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::filesystem::path& fileName)
+{
+    FILE* file = fopen(fileName.string().c_str(), "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_RegistryMutex);
+
+    std::vector<const ThreadBuffer*> tracks;
+    tracks.push_back(&m_GpuTrack);
+    for (const auto& buffer : m_ThreadBuffers)
+        tracks.push_back(buffer.get());
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (const ThreadBuffer* track : tracks)
+    {
+        const char* category = (track == &m_GpuTrack) ? "gpu" : "cpu";
+        const size_t count = track->count.load(std::memory_order_acquire);
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", track->threadIndex);
+        writeEscapedString(file, track->name.c_str());
+        fprintf(file, "}}");
+        first = false;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const Event& event = track->events[i];
+
+            fprintf(file, ",\n{\"name\":");
+            writeEscapedString(file, event.name);
+            fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                category, track->threadIndex, double(event.start) * 1e-3, double(event.end - event.start) * 1e-3);
+        }
+
+        const uint32_t dropped = track->dropped.load(std::memory_order_relaxed);
+        if (dropped != 0)
+        {
+            fprintf(file, ",\n{\"name\":\"%u events dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":0}",
+                dropped, track->threadIndex);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    const bool success = ferror(file) == 0;
+    fclose(file);
+    return success;
+}
+
+CpuProfilerScope::CpuProfilerScope(const char* name)
+    : m_Name(name)
+    , m_Active(CpuProfiler::Get().IsEnabled())
+{
+    if (m_Active)
+        m_Start = CpuProfiler::Now();
+}
+
+CpuProfilerScope::~CpuProfilerScope()
+{
+    if (m_Active)
+        CpuProfiler::Get().RecordEvent(m_Name, m_Start, CpuProfiler::Now());
+}
@@ -0,0 +1,87 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records named CPU scopes into per-thread buffers and exports them as a Chrome trace_event JSON file.
+// Each thread only appends to its own buffer, so recording does not take any locks after the first event on a thread.
+// The event storage of a thread is allocated when it records its first event, not when it is registered or named.
+// Event names are not copied and must be string literals or otherwise outlive the profiler.
+class CpuProfiler
+{
+private:
+    struct Event
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    struct ThreadBuffer
+    {
+        uint32_t threadIndex = 0;
+        std::string name;
+        std::vector<Event> events;
+        std::atomic<size_t> count = 0;
+        std::atomic<uint32_t> dropped = 0;
+    };
+
+    static constexpr size_t c_EventsPerThread = 256 * 1024;
+
+    std::atomic<bool> m_Enabled = false;
+    std::mutex m_RegistryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_ThreadBuffers;
+    ThreadBuffer m_GpuTrack;
+
+    CpuProfiler();
+    ThreadBuffer& GetThreadBuffer();
+    static void AppendEvent(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end);
+
+public:
+    static CpuProfiler& Get();
+
+    // Nanoseconds since the profiler was created
+    static uint64_t Now();
+
+    void Enable(bool enable);
+    bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+    void SetThreadName(const char* name);
+    void RecordEvent(const char* name, uint64_t start, uint64_t end);
+    void RecordGpuEvent(const char* name, uint64_t start, uint64_t end); // on the "GPU (synthetic layout)" track
+
+    bool WriteChromeTrace(const std::filesystem::path& fileName);
+};
+
+class CpuProfilerScope
+{
+private:
+    const char* m_Name;
+    uint64_t m_Start = 0;
+    bool m_Active;
+
+public:
+    explicit CpuProfilerScope(const char* name);
+    ~CpuProfilerScope();
+
+    // Non-copyable and non-movable
+    CpuProfilerScope(const CpuProfilerScope&) = delete;
+    CpuProfilerScope(const CpuProfilerScope&&) = delete;
+    CpuProfilerScope& operator=(const CpuProfilerScope&) = delete;
+    CpuProfilerScope& operator=(const CpuProfilerScope&&) = delete;
+};
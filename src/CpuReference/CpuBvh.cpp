@@ -0,0 +1,313 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CpuBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace donut::math;
+
+namespace
+{
+    constexpr uint32_t c_NumBins = 12;
+    constexpr uint32_t c_MaxLeafTriangles = 4;
+    constexpr uint32_t c_MaxTraversalDepth = 64;
+
+    struct Bounds
+    {
+        float3 mins = float3(std::numeric_limits<float>::max());
+        float3 maxs = float3(-std::numeric_limits<float>::max());
+
+        void Grow(const float3& p)
+        {
+            mins = min(mins, p);
+            maxs = max(maxs, p);
+        }
+
+        void Grow(const Bounds& b)
+        {
+            mins = min(mins, b.mins);
+            maxs = max(maxs, b.maxs);
+        }
+
+        [[nodiscard]] float HalfArea() const
+        {
+            if (any(maxs < mins))
+                return 0.f;
+
+            const float3 e = maxs - mins;
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    struct BuildTask
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    bool intersectBounds(const float3& boundsMin, const float3& boundsMax, const float3& origin, const float3& invDirection, float tMin, float tMax, float& tEntry)
+    {
+        const float3 t0 = (boundsMin - origin) * invDirection;
+        const float3 t1 = (boundsMax - origin) * invDirection;
+        const float3 tNear = min(t0, t1);
+        const float3 tFar = max(t0, t1);
+
+        tEntry = std::max(tMin, std::max(tNear.x, std::max(tNear.y, tNear.z)));
+        const float tExit = std::min(tMax, std::min(tFar.x, std::min(tFar.y, tFar.z)));
+
+        return tEntry <= tExit;
+    }
+}
+
+void CpuBvh::Build(const std::vector<float3>& trianglePositions)
+{
+    const uint32_t triangleCount = uint32_t(trianglePositions.size() / 3);
+
+    m_Nodes.clear();
+    m_Triangles.clear();
+    m_TriangleIndices.resize(triangleCount);
+
+    if (triangleCount == 0)
+        return;
+
+    std::vector<Bounds> triangleBounds(triangleCount);
+    std::vector<float3> centroids(triangleCount);
+
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        triangleBounds[i].Grow(trianglePositions[i * 3 + 0]);
+        triangleBounds[i].Grow(trianglePositions[i * 3 + 1]);
+        triangleBounds[i].Grow(trianglePositions[i * 3 + 2]);
+        centroids[i] = (triangleBounds[i].mins + triangleBounds[i].maxs) * 0.5f;
+        m_TriangleIndices[i] = i;
+    }
+
+    m_Nodes.reserve(triangleCount * 2);
+    m_Nodes.emplace_back();
+
+    std::vector<BuildTask> stack;
+    stack.push_back({ 0, 0, triangleCount });
+
+    while (!stack.empty())
+    {
+        const BuildTask task = stack.back();
+        stack.pop_back();
+
+        Bounds nodeBounds;
+        Bounds centroidBounds;
+        for (uint32_t i = task.first; i < task.first + task.count; i++)
+        {
+            nodeBounds.Grow(triangleBounds[m_TriangleIndices[i]]);
+            centroidBounds.Grow(centroids[m_TriangleIndices[i]]);
+        }
+
+        m_Nodes[task.node].boundsMin = nodeBounds.mins;
+        m_Nodes[task.node].boundsMax = nodeBounds.maxs;
+
+        // Find the best binned SAH split over all three axes
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        float bestCost = float(task.count) * nodeBounds.HalfArea();
+
+        if (task.count > c_MaxLeafTriangles)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float extentMin = centroidBounds.mins[axis];
+                const float extent = centroidBounds.maxs[axis] - extentMin;
+                if (extent <= 0.f)
+                    continue;
+
+                Bounds binBounds[c_NumBins];
+                uint32_t binCounts[c_NumBins] = {};
+                const float binScale = float(c_NumBins) / extent;
+
+                for (uint32_t i = task.first; i < task.first + task.count; i++)
+                {
+                    const uint32_t triangle = m_TriangleIndices[i];
+                    const uint32_t bin = std::min(uint32_t((centroids[triangle][axis] - extentMin) * binScale), c_NumBins - 1);
+                    binBounds[bin].Grow(triangleBounds[triangle]);
+                    binCounts[bin]++;
+                }
+
+                // Sweep from the right to get the cost of every right side, then from the left
+                float rightCosts[c_NumBins] = {};
+                Bounds rightBounds;
+                uint32_t rightCount = 0;
+                for (uint32_t bin = c_NumBins - 1; bin > 0; bin--)
+                {
+                    rightBounds.Grow(binBounds[bin]);
+                    rightCount += binCounts[bin];
+                    rightCosts[bin] = float(rightCount) * rightBounds.HalfArea();
+                }
+
+                Bounds leftBounds;
+                uint32_t leftCount = 0;
+                for (uint32_t bin = 0; bin < c_NumBins - 1; bin++)
+                {
+                    leftBounds.Grow(binBounds[bin]);
+                    leftCount += binCounts[bin];
+
+                    if (leftCount == 0 || leftCount == task.count)
+                        continue;
+
+                    const float cost = float(leftCount) * leftBounds.HalfArea() + rightCosts[bin + 1];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = bin + 1;
+                    }
+                }
+            }
+        }
+
+        if (bestAxis < 0)
+        {
+            m_Nodes[task.node].leftOrFirst = task.first;
+            m_Nodes[task.node].triangleCount = task.count;
+            continue;
+        }
+
+        const float extentMin = centroidBounds.mins[bestAxis];
+        const float binScale = float(c_NumBins) / (centroidBounds.maxs[bestAxis] - extentMin);
+
+        auto middle = std::partition(
+            m_TriangleIndices.begin() + task.first,
+            m_TriangleIndices.begin() + task.first + task.count,
+            [&](uint32_t triangle)
+            {
+                const uint32_t bin = std::min(uint32_t((centroids[triangle][bestAxis] - extentMin) * binScale), c_NumBins - 1);
+                return bin < bestSplit;
+            });
+
+        const uint32_t leftCount = uint32_t(middle - m_TriangleIndices.begin()) - task.first;
+        const uint32_t leftChild = uint32_t(m_Nodes.size());
+
+        m_Nodes.emplace_back();
+        m_Nodes.emplace_back();
+        m_Nodes[task.node].leftOrFirst = leftChild;
+        m_Nodes[task.node].triangleCount = 0;
+
+        stack.push_back({ leftChild, task.first, leftCount });
+        stack.push_back({ leftChild + 1, task.first + leftCount, task.count - leftCount });
+    }
+
+    m_Triangles.resize(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        const uint32_t triangle = m_TriangleIndices[i];
+        const float3 v0 = trianglePositions[triangle * 3 + 0];
+        m_Triangles[i].v0 = v0;
+        m_Triangles[i].edge1 = trianglePositions[triangle * 3 + 1] - v0;
+        m_Triangles[i].edge2 = trianglePositions[triangle * 3 + 2] - v0;
+    }
+}
+
+template<bool AnyHit>
+bool CpuBvh::Traverse(const CpuRay& ray, CpuRayHit& hit) const
+{
+    if (m_Nodes.empty())
+        return false;
+
+    const float3 invDirection = float3(
+        1.f / (ray.direction.x != 0.f ? ray.direction.x : 1e-20f),
+        1.f / (ray.direction.y != 0.f ? ray.direction.y : 1e-20f),
+        1.f / (ray.direction.z != 0.f ? ray.direction.z : 1e-20f));
+
+    float tMax = ray.tMax;
+    bool found = false;
+
+    uint32_t stack[c_MaxTraversalDepth];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = m_Nodes[stack[--stackSize]];
+
+        float tEntry;
+        if (!intersectBounds(node.boundsMin, node.boundsMax, ray.origin, invDirection, ray.tMin, tMax, tEntry))
+            continue;
+
+        if (node.triangleCount == 0)
+        {
+            // Visit the nearer child first
+            const Node& left = m_Nodes[node.leftOrFirst];
+            const Node& right = m_Nodes[node.leftOrFirst + 1];
+            float tLeft, tRight;
+            const bool hitLeft = intersectBounds(left.boundsMin, left.boundsMax, ray.origin, invDirection, ray.tMin, tMax, tLeft);
+            const bool hitRight = intersectBounds(right.boundsMin, right.boundsMax, ray.origin, invDirection, ray.tMin, tMax, tRight);
+
+            if (hitLeft && hitRight && stackSize + 2 <= c_MaxTraversalDepth)
+            {
+                const bool leftFirst = tLeft <= tRight;
+                stack[stackSize++] = node.leftOrFirst + (leftFirst ? 1 : 0);
+                stack[stackSize++] = node.leftOrFirst + (leftFirst ? 0 : 1);
+            }
+            else if (hitLeft && stackSize < c_MaxTraversalDepth)
+                stack[stackSize++] = node.leftOrFirst;
+            else if (hitRight && stackSize < c_MaxTraversalDepth)
+                stack[stackSize++] = node.leftOrFirst + 1;
+
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.triangleCount; i++)
+        {
+            // Moller-Trumbore, double-sided
+            const Triangle& triangle = m_Triangles[i];
+            const float3 p = cross(ray.direction, triangle.edge2);
+            const float det = dot(triangle.edge1, p);
+            if (std::abs(det) < 1e-12f)
+                continue;
+
+            const float invDet = 1.f / det;
+            const float3 s = ray.origin - triangle.v0;
+            const float u = dot(s, p) * invDet;
+            if (u < 0.f || u > 1.f)
+                continue;
+
+            const float3 q = cross(s, triangle.edge1);
+            const float v = dot(ray.direction, q) * invDet;
+            if (v < 0.f || u + v > 1.f)
+                continue;
+
+            const float t = dot(triangle.edge2, q) * invDet;
+            if (t < ray.tMin || t >= tMax)
+                continue;
+
+            if (AnyHit)
+                return true;
+
+            tMax = t;
+            found = true;
+            hit.t = t;
+            hit.triangleIndex = m_TriangleIndices[i];
+            hit.barycentrics = float2(u, v);
+        }
+    }
+
+    return found;
+}
+
+bool CpuBvh::Intersect(const CpuRay& ray, CpuRayHit& hit) const
+{
+    return Traverse<false>(ray, hit);
+}
+
+bool CpuBvh::IsOccluded(const CpuRay& ray) const
+{
+    CpuRayHit hit;
+    return Traverse<true>(ray, hit);
+}
@@ -0,0 +1,68 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <vector>
+
+struct CpuRay
+{
+    dm::float3 origin;
+    dm::float3 direction;
+    float tMin = 0.f;
+    float tMax = 1e30f;
+};
+
+struct CpuRayHit
+{
+    float t = 0.f;
+    uint32_t triangleIndex = ~0u;
+    dm::float2 barycentrics = 0.f; // weights of the second and third vertices
+};
+
+// A simple binned SAH bounding volume hierarchy over world-space triangles,
+// used by the CPU reference renderer for primary and visibility rays.
+class CpuBvh
+{
+public:
+    // Builds the hierarchy over triangles stored as 3 consecutive vertices each.
+    // Triangle indices reported in hits refer to the order of the input triangles.
+    void Build(const std::vector<dm::float3>& trianglePositions);
+
+    bool Intersect(const CpuRay& ray, CpuRayHit& hit) const;
+    bool IsOccluded(const CpuRay& ray) const;
+
+    [[nodiscard]] uint32_t GetTriangleCount() const { return uint32_t(m_TriangleIndices.size()); }
+    [[nodiscard]] uint32_t GetNodeCount() const { return uint32_t(m_Nodes.size()); }
+
+private:
+    struct Node
+    {
+        dm::float3 boundsMin;
+        uint32_t leftOrFirst = 0; // index of the left child for interior nodes, of the first triangle for leaves
+        dm::float3 boundsMax;
+        uint32_t triangleCount = 0; // 0 for interior nodes
+    };
+
+    struct Triangle
+    {
+        dm::float3 v0;
+        dm::float3 edge1;
+        dm::float3 edge2;
+    };
+
+    std::vector<Node> m_Nodes;
+    std::vector<Triangle> m_Triangles; // in leaf order
+    std::vector<uint32_t> m_TriangleIndices; // leaf order -> input order
+
+    template<bool AnyHit>
+    bool Traverse(const CpuRay& ray, CpuRayHit& hit) const;
+};
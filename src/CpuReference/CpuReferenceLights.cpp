@@ -0,0 +1,34 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CpuReferenceLights.h"
+#include "HlslCompat.h"
+
+namespace hlsl
+{
+namespace
+{
+#define in
+#include "../../shaders/PolymorphicLight.hlsli"
+#undef in
+}
+}
+
+CpuLightSample SampleCpuReferenceLight(const PolymorphicLightInfo& lightInfo, const dm::float2& random, const dm::float3& viewerPosition, float clampDistanceRatio)
+{
+    const hlsl::PolymorphicLightSample lightSample = hlsl::PolymorphicLight::calcSample(lightInfo, random, viewerPosition, clampDistanceRatio);
+
+    CpuLightSample sample;
+    sample.position = lightSample.position;
+    sample.normal = lightSample.normal;
+    sample.radiance = lightSample.radiance;
+    sample.solidAnglePdf = lightSample.solidAnglePdf;
+    return sample;
+}
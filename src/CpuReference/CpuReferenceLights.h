@@ -0,0 +1,28 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+
+#include "../../shaders/ShaderParameters.h"
+
+struct CpuLightSample
+{
+    dm::float3 position;
+    dm::float3 normal;
+    dm::float3 radiance;
+    float solidAnglePdf = 0.f;
+};
+
+// Samples the light with PolymorphicLight::calcSample, compiled for the host from the same PolymorphicLight.hlsli
+// as the shaders, see HlslCompat.h. The host build has no textures, which makes two differences with the shaders:
+// environment lights are uniform instead of textured, and IES profiles are ignored. The spot shaping is applied.
+CpuLightSample SampleCpuReferenceLight(const PolymorphicLightInfo& lightInfo, const dm::float2& random, const dm::float3& viewerPosition, float clampDistanceRatio);
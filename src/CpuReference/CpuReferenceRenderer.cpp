@@ -0,0 +1,633 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CpuReferenceRenderer.h"
+#include "../ImageDiff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+using namespace donut::math;
+using namespace std::chrono;
+
+namespace
+{
+    enum RandomPass : uint32_t
+    {
+        RandomPass_InitialSampling = 1,
+        RandomPass_TemporalResampling,
+        RandomPass_SpatialResampling
+    };
+
+    float calcLuminance(const float3& color)
+    {
+        return dot(color, float3(0.299f, 0.587f, 0.114f));
+    }
+
+    uint32_t hashUint(uint32_t x)
+    {
+        // PCG hash
+        const uint32_t state = x * 747796405u + 2891336453u;
+        const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    float3 schlickFresnel(const float3& f0, float VdotH)
+    {
+        const float m = std::pow(1.f - saturate(VdotH), 5.f);
+        return f0 + (float3(1.f) - f0) * m;
+    }
+
+    float ggxNormalDistribution(float alpha, float NdotH)
+    {
+        const float a2 = alpha * alpha;
+        const float d = NdotH * NdotH * (a2 - 1.f) + 1.f;
+        return a2 / (PI_f * d * d);
+    }
+
+    float smithG1(float alpha, float NdotX)
+    {
+        const float a2 = alpha * alpha;
+        return 2.f * NdotX / (NdotX + std::sqrt(a2 + (1.f - a2) * NdotX * NdotX));
+    }
+
+    bool checkNeighborSimilarity(float depth, const float3& normal, float neighborDepth, const float3& neighborNormal, float depthThreshold, float normalThreshold)
+    {
+        return std::abs(depth - neighborDepth) <= depthThreshold * std::max(depth, neighborDepth)
+            && dot(normal, neighborNormal) >= normalThreshold;
+    }
+}
+
+std::string CpuReferenceStats::GetAsText() const
+{
+    const double pixels = double(width) * double(height) * double(frameCount);
+    const double seconds = totalTime * 1e-3;
+
+    auto passLine = [this](std::stringstream& text, const char* name, double time)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "%-22s %10.3f ms/frame\n", name, frameCount > 0 ? time / frameCount : 0.0);
+        text << line;
+    };
+
+    std::stringstream text;
+    char line[256];
+    snprintf(line, sizeof(line), "CPU reference: %ux%u, %u frame(s), %u thread(s)\n", width, height, frameCount, threadCount);
+    text << line;
+
+    passLine(text, "G-buffer", gbufferTime);
+    passLine(text, "Initial sampling", initialSamplingTime);
+    passLine(text, "Temporal resampling", temporalResamplingTime);
+    passLine(text, "Spatial resampling", spatialResamplingTime);
+    passLine(text, "Shading", shadingTime);
+    passLine(text, "Total", totalTime);
+
+    snprintf(line, sizeof(line), "Throughput: %.3f Mpixels/s, %.3f Mrays/s\n",
+        seconds > 0.0 ? pixels / seconds * 1e-6 : 0.0,
+        seconds > 0.0 ? double(rayCount) / seconds * 1e-6 : 0.0);
+    text << line;
+
+    return text.str();
+}
+
+float CpuReferenceRenderer::RandomSampler::Next()
+{
+    state = hashUint(state);
+    return float(state >> 8) * (1.f / float(1u << 24));
+}
+
+CpuReferenceRenderer::CpuReferenceRenderer(uint32_t threadCount, uint32_t tileSize)
+    : m_ThreadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+    , m_TileSize(std::max(1u, tileSize))
+{
+    m_Stats.threadCount = m_ThreadCount;
+}
+
+void CpuReferenceRenderer::SetScene(std::shared_ptr<const CpuReferenceScene> scene)
+{
+    m_Scene = std::move(scene);
+    m_Bvh.Build(m_Scene->trianglePositions);
+
+    ResetHistory();
+}
+
+void CpuReferenceRenderer::ResetHistory()
+{
+    m_HistoryValid = false;
+}
+
+void CpuReferenceRenderer::ResetStats()
+{
+    m_Stats = CpuReferenceStats();
+    m_Stats.threadCount = m_ThreadCount;
+}
+
+double CpuReferenceRenderer::ParallelForTiles(const std::function<void(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)>& function)
+{
+    const auto startTime = steady_clock::now();
+
+    const uint32_t tilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+    const uint32_t tilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+    const uint32_t tileCount = tilesX * tilesY;
+
+    std::atomic<uint32_t> nextTile = 0;
+
+    auto worker = [&]()
+    {
+        uint64_t rayCount = 0;
+
+        for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+        {
+            const uint32_t x0 = (tile % tilesX) * m_TileSize;
+            const uint32_t y0 = (tile / tilesX) * m_TileSize;
+            function(x0, y0, std::min(x0 + m_TileSize, m_Width), std::min(y0 + m_TileSize, m_Height), rayCount);
+        }
+
+        m_RayCount += rayCount;
+    };
+
+    const uint32_t threadCount = std::min(m_ThreadCount, tileCount);
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (uint32_t i = 1; i < threadCount; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+
+CpuReferenceRenderer::RandomSampler CpuReferenceRenderer::GetRandomSampler(uint32_t x, uint32_t y, uint32_t frameIndex, uint32_t pass) const
+{
+    RandomSampler sampler;
+    sampler.state = hashUint(hashUint(hashUint(x + y * m_Width) + frameIndex) + pass);
+    return sampler;
+}
+
+CpuLightSample CpuReferenceRenderer::GetLightSample(const Reservoir& reservoir, const Surface& surface) const
+{
+    if (!reservoir.IsValid() || reservoir.lightIndex >= m_Scene->lights.size())
+        return CpuLightSample();
+
+    return SampleCpuReferenceLight(m_Scene->lights[reservoir.lightIndex], reservoir.uv, surface.position, m_ClampDistanceRatio);
+}
+
+float3 CpuReferenceRenderer::ShadeSurface(const Surface& surface, const float3& viewerPosition, const CpuLightSample& lightSample) const
+{
+    if (!surface.valid || lightSample.solidAnglePdf <= 0.f)
+        return 0.f;
+
+    const float3 L = normalize(lightSample.position - surface.position);
+    const float3 V = normalize(viewerPosition - surface.position);
+    const float NdotL = dot(surface.normal, L);
+    const float NdotV = dot(surface.normal, V);
+
+    if (NdotL <= 0.f || NdotV <= 0.f)
+        return 0.f;
+
+    const float3 H = normalize(L + V);
+    const float NdotH = saturate(dot(surface.normal, H));
+    const float alpha = std::max(surface.roughness * surface.roughness, 1e-3f);
+
+    const float3 specular = schlickFresnel(surface.specularF0, dot(V, H))
+        * (ggxNormalDistribution(alpha, NdotH) * smithG1(alpha, NdotL) * smithG1(alpha, NdotV) / (4.f * NdotL * NdotV));
+    const float3 diffuse = surface.diffuseAlbedo * (1.f / PI_f);
+
+    return (diffuse + specular) * lightSample.radiance * (NdotL / lightSample.solidAnglePdf);
+}
+
+float CpuReferenceRenderer::GetTargetPdf(const Surface& surface, const float3& viewerPosition, const CpuLightSample& lightSample) const
+{
+    return calcLuminance(ShadeSurface(surface, viewerPosition, lightSample));
+}
+
+bool CpuReferenceRenderer::IsVisible(const Surface& surface, const CpuLightSample& lightSample, uint64_t& rayCount) const
+{
+    const float3 toLight = lightSample.position - surface.position;
+    const float distance = length(toLight);
+    if (distance <= 0.f)
+        return false;
+
+    const float offset = 1e-3f * std::max(1.f, surface.viewDepth * 0.01f);
+
+    CpuRay ray;
+    ray.direction = toLight / distance;
+    ray.origin = surface.position + surface.normal * offset;
+    ray.tMin = 0.f;
+    ray.tMax = distance * 0.999f - offset;
+
+    rayCount++;
+    return ray.tMax <= 0.f || !m_Bvh.IsOccluded(ray);
+}
+
+bool CpuReferenceRenderer::StreamSample(Reservoir& reservoir, uint32_t lightIndex, const float2& uv, float targetPdf, float weight, float random)
+{
+    if (!(weight > 0.f) || !std::isfinite(weight))
+        return false;
+
+    reservoir.weightSum += weight;
+
+    if (random * reservoir.weightSum <= weight)
+    {
+        reservoir.lightIndex = lightIndex;
+        reservoir.uv = uv;
+        reservoir.targetPdf = targetPdf;
+        return true;
+    }
+
+    return false;
+}
+
+void CpuReferenceRenderer::TraceGBuffer(const ResamplingConstants& constants)
+{
+    const PlanarViewConstants& view = constants.view;
+    const float3 cameraPosition = view.cameraDirectionOrPosition.xyz();
+
+    m_Stats.gbufferTime += ParallelForTiles([&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            Surface& surface = m_GBuffer[x + y * m_Width];
+            surface = Surface();
+
+            // Same ray setup as setupPrimaryRay in GBufferHelpers.hlsli
+            const float2 uv = (float2(float(x), float(y)) + 0.5f) * view.viewportSizeInv;
+            const float4 clipPos = float4(uv.x * 2.f - 1.f, 1.f - uv.y * 2.f, 1.f / 256.f, 1.f);
+            float4 worldPos = clipPos * view.matClipToWorld;
+            const float3 target = worldPos.xyz() / worldPos.w;
+
+            CpuRay ray;
+            ray.origin = cameraPosition;
+            ray.direction = normalize(target - cameraPosition);
+            ray.tMin = 0.f;
+            ray.tMax = 1000.f;
+
+            rayCount++;
+            CpuRayHit hit;
+            if (!m_Bvh.Intersect(ray, hit))
+                continue;
+
+            const float3* vertices = &m_Scene->trianglePositions[hit.triangleIndex * 3];
+            const float3 normal = normalize(cross(vertices[1] - vertices[0], vertices[2] - vertices[0]));
+            const CpuReferenceMaterial& material = m_Scene->materials[m_Scene->triangleMaterials[hit.triangleIndex]];
+
+            surface.position = ray.origin + ray.direction * hit.t;
+            surface.normal = dot(normal, ray.direction) > 0.f ? -normal : normal;
+            surface.diffuseAlbedo = material.diffuseAlbedo;
+            surface.specularF0 = material.specularF0;
+            surface.roughness = material.roughness;
+            surface.viewDepth = (float4(surface.position, 1.f) * view.matWorldToClip).w;
+            surface.valid = std::isfinite(surface.normal.x) && std::isfinite(surface.normal.y) && std::isfinite(surface.normal.z);
+        }
+    });
+}
+
+void CpuReferenceRenderer::GenerateInitialSamples(const ResamplingConstants& constants)
+{
+    const ReSTIRDI_InitialSamplingParameters& params = constants.restirDI.initialSamplingParams;
+    const RTXDI_LightBufferRegion& localRegion = constants.lightBufferParams.localLightBufferRegion;
+    const RTXDI_LightBufferRegion& infiniteRegion = constants.lightBufferParams.infiniteLightBufferRegion;
+    const float3 cameraPosition = constants.view.cameraDirectionOrPosition.xyz();
+
+    struct Strategy
+    {
+        uint32_t firstLight;
+        uint32_t numLights;
+        uint32_t numSamples;
+    };
+
+    const Strategy strategies[] = {
+        { localRegion.firstLightIndex, localRegion.numLights, localRegion.numLights > 0 ? params.numPrimaryLocalLightSamples : 0 },
+        { infiniteRegion.firstLightIndex, infiniteRegion.numLights, infiniteRegion.numLights > 0 ? params.numPrimaryInfiniteLightSamples : 0 }
+    };
+
+    m_Stats.initialSamplingTime += ParallelForTiles([&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            const Surface& surface = m_GBuffer[x + y * m_Width];
+            Reservoir& reservoir = m_Reservoirs[x + y * m_Width];
+            reservoir = Reservoir();
+
+            if (!surface.valid)
+                continue;
+
+            RandomSampler rng = GetRandomSampler(x, y, constants.frameIndex, RandomPass_InitialSampling);
+
+            // RIS over uniformly selected lights; each strategy covers a disjoint set of lights,
+            // so the candidates are weighted by the inverse selection pdf over the sample count.
+            for (const Strategy& strategy : strategies)
+            {
+                for (uint32_t i = 0; i < strategy.numSamples; i++)
+                {
+                    const uint32_t lightIndex = strategy.firstLight + std::min(uint32_t(rng.Next() * float(strategy.numLights)), strategy.numLights - 1);
+                    const float2 uv = float2(rng.Next(), rng.Next());
+
+                    if (lightIndex >= m_Scene->lights.size())
+                        continue;
+
+                    const CpuLightSample lightSample = SampleCpuReferenceLight(m_Scene->lights[lightIndex], uv, surface.position, m_ClampDistanceRatio);
+                    const float targetPdf = GetTargetPdf(surface, cameraPosition, lightSample);
+                    const float weight = targetPdf * float(strategy.numLights) / float(strategy.numSamples);
+
+                    StreamSample(reservoir, lightIndex, uv, targetPdf, weight, rng.Next());
+                }
+            }
+
+            reservoir.M = 1.f;
+            reservoir.W = reservoir.targetPdf > 0.f ? reservoir.weightSum / reservoir.targetPdf : 0.f;
+
+            if (params.enableInitialVisibility && reservoir.IsValid())
+            {
+                if (!IsVisible(surface, GetLightSample(reservoir, surface), rayCount))
+                    reservoir.W = 0.f;
+            }
+        }
+    });
+}
+
+void CpuReferenceRenderer::TemporalResampling(const ResamplingConstants& constants)
+{
+    const ReSTIRDI_TemporalResamplingParameters& params = constants.restirDI.temporalResamplingParams;
+    const float3 cameraPosition = constants.view.cameraDirectionOrPosition.xyz();
+    const float3 prevCameraPosition = constants.prevView.cameraDirectionOrPosition.xyz();
+    const bool biasCorrection = params.temporalBiasCorrection != ReSTIRDI_TemporalBiasCorrectionMode::Off;
+    const bool raytracedBiasCorrection = params.temporalBiasCorrection == ReSTIRDI_TemporalBiasCorrectionMode::Raytraced;
+
+    m_Stats.temporalResamplingTime += ParallelForTiles([&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            const Surface& surface = m_GBuffer[x + y * m_Width];
+            const Reservoir current = m_Reservoirs[x + y * m_Width];
+
+            if (!surface.valid)
+                continue;
+
+            // Reproject the surface into the previous frame
+            const float4 prevClipPos = float4(surface.position, 1.f) * constants.prevView.matWorldToClip;
+            if (prevClipPos.w <= 0.f)
+                continue;
+
+            const float2 prevUv = float2(prevClipPos.x / prevClipPos.w * 0.5f + 0.5f, 0.5f - prevClipPos.y / prevClipPos.w * 0.5f);
+            const int prevX = int(std::floor(prevUv.x * constants.prevView.viewportSize.x));
+            const int prevY = int(std::floor(prevUv.y * constants.prevView.viewportSize.y));
+            if (prevX < 0 || prevY < 0 || prevX >= int(m_Width) || prevY >= int(m_Height))
+                continue;
+
+            const Surface& prevSurface = m_PrevGBuffer[prevX + prevY * m_Width];
+            Reservoir previous = m_PrevReservoirs[prevX + prevY * m_Width];
+
+            if (!prevSurface.valid || !previous.IsValid() ||
+                !checkNeighborSimilarity(prevClipPos.w, surface.normal, prevSurface.viewDepth, prevSurface.normal, params.temporalDepthThreshold, params.temporalNormalThreshold))
+                continue;
+
+            previous.M = std::min(previous.M, float(params.maxHistoryLength) * std::max(current.M, 1.f));
+
+            RandomSampler rng = GetRandomSampler(x, y, constants.frameIndex, RandomPass_TemporalResampling);
+
+            Reservoir combined;
+            combined.M = current.M + previous.M;
+            bool selectedPrevious = false;
+
+            if (current.IsValid())
+                StreamSample(combined, current.lightIndex, current.uv, current.targetPdf, current.targetPdf * current.W * current.M, rng.Next());
+
+            const float previousTargetPdf = GetTargetPdf(surface, cameraPosition, GetLightSample(previous, surface));
+            if (StreamSample(combined, previous.lightIndex, previous.uv, previousTargetPdf, previousTargetPdf * previous.W * previous.M, rng.Next()))
+                selectedPrevious = true;
+
+            if (!combined.IsValid() || combined.targetPdf <= 0.f)
+            {
+                combined.W = 0.f;
+                m_Reservoirs[x + y * m_Width] = combined;
+                continue;
+            }
+
+            float normalization = combined.M;
+            if (biasCorrection)
+            {
+                // Only count the reservoirs whose surface could have produced the selected sample
+                normalization = current.M;
+                const CpuLightSample selectedAtPrevious = GetLightSample(combined, prevSurface);
+                bool previousCanProduce = selectedPrevious || GetTargetPdf(prevSurface, prevCameraPosition, selectedAtPrevious) > 0.f;
+
+                if (previousCanProduce && raytracedBiasCorrection)
+                    previousCanProduce = IsVisible(prevSurface, selectedAtPrevious, rayCount);
+
+                if (previousCanProduce)
+                    normalization += previous.M;
+            }
+
+            combined.W = normalization > 0.f ? combined.weightSum / (combined.targetPdf * normalization) : 0.f;
+            m_Reservoirs[x + y * m_Width] = combined;
+        }
+    });
+}
+
+void CpuReferenceRenderer::SpatialResampling(const ResamplingConstants& constants)
+{
+    const ReSTIRDI_SpatialResamplingParameters& params = constants.restirDI.spatialResamplingParams;
+    const float3 cameraPosition = constants.view.cameraDirectionOrPosition.xyz();
+    const bool biasCorrection = params.spatialBiasCorrection != ReSTIRDI_SpatialBiasCorrectionMode::Off;
+    const bool raytracedBiasCorrection = params.spatialBiasCorrection == ReSTIRDI_SpatialBiasCorrectionMode::Raytraced;
+    const uint32_t maxNeighbors = std::min(params.numSpatialSamples, 32u);
+
+    m_Stats.spatialResamplingTime += ParallelForTiles([&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)
+    {
+        uint32_t neighborPixels[32];
+
+        for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            const uint32_t pixel = x + y * m_Width;
+            const Surface& surface = m_GBuffer[pixel];
+            const Reservoir& center = m_Reservoirs[pixel];
+            Reservoir& output = m_SpatialReservoirs[pixel];
+            output = center;
+
+            if (!surface.valid)
+                continue;
+
+            RandomSampler rng = GetRandomSampler(x, y, constants.frameIndex, RandomPass_SpatialResampling);
+
+            Reservoir combined;
+            combined.M = center.M;
+            int selected = -1;
+
+            if (center.IsValid())
+                StreamSample(combined, center.lightIndex, center.uv, center.targetPdf, center.targetPdf * center.W * center.M, rng.Next());
+
+            uint32_t numNeighbors = 0;
+            for (uint32_t i = 0; i < maxNeighbors; i++)
+            {
+                const float angle = 2.f * PI_f * rng.Next();
+                const float radius = std::sqrt(rng.Next()) * params.spatialSamplingRadius;
+                const int nx = int(x) + int(std::round(std::cos(angle) * radius));
+                const int ny = int(y) + int(std::round(std::sin(angle) * radius));
+
+                if (nx < 0 || ny < 0 || nx >= int(m_Width) || ny >= int(m_Height) || (nx == int(x) && ny == int(y)))
+                    continue;
+
+                const uint32_t neighborPixel = uint32_t(nx) + uint32_t(ny) * m_Width;
+                const Surface& neighborSurface = m_GBuffer[neighborPixel];
+                const Reservoir& neighbor = m_Reservoirs[neighborPixel];
+
+                if (!neighborSurface.valid ||
+                    !checkNeighborSimilarity(surface.viewDepth, surface.normal, neighborSurface.viewDepth, neighborSurface.normal, params.spatialDepthThreshold, params.spatialNormalThreshold))
+                    continue;
+
+                neighborPixels[numNeighbors++] = neighborPixel;
+                combined.M += neighbor.M;
+
+                if (!neighbor.IsValid())
+                    continue;
+
+                const float targetPdf = GetTargetPdf(surface, cameraPosition, GetLightSample(neighbor, surface));
+                if (StreamSample(combined, neighbor.lightIndex, neighbor.uv, targetPdf, targetPdf * neighbor.W * neighbor.M, rng.Next()))
+                    selected = int(numNeighbors - 1);
+            }
+
+            if (!combined.IsValid() || combined.targetPdf <= 0.f)
+            {
+                combined.W = 0.f;
+                output = combined;
+                continue;
+            }
+
+            float normalization = combined.M;
+            if (biasCorrection)
+            {
+                normalization = center.M;
+                for (uint32_t i = 0; i < numNeighbors; i++)
+                {
+                    const Surface& neighborSurface = m_GBuffer[neighborPixels[i]];
+                    const CpuLightSample selectedAtNeighbor = GetLightSample(combined, neighborSurface);
+                    bool neighborCanProduce = int(i) == selected || GetTargetPdf(neighborSurface, cameraPosition, selectedAtNeighbor) > 0.f;
+
+                    if (neighborCanProduce && raytracedBiasCorrection)
+                        neighborCanProduce = IsVisible(neighborSurface, selectedAtNeighbor, rayCount);
+
+                    if (neighborCanProduce)
+                        normalization += m_Reservoirs[neighborPixels[i]].M;
+                }
+            }
+
+            combined.W = normalization > 0.f ? combined.weightSum / (combined.targetPdf * normalization) : 0.f;
+            output = combined;
+        }
+    });
+
+    std::swap(m_Reservoirs, m_SpatialReservoirs);
+}
+
+void CpuReferenceRenderer::ShadeSamples(const ResamplingConstants& constants)
+{
+    const ReSTIRDI_ShadingParameters& params = constants.restirDI.shadingParams;
+    const float3 cameraPosition = constants.view.cameraDirectionOrPosition.xyz();
+
+    m_Stats.shadingTime += ParallelForTiles([&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            const uint32_t pixel = x + y * m_Width;
+            const Surface& surface = m_GBuffer[pixel];
+            Reservoir& reservoir = m_Reservoirs[pixel];
+            m_Output[pixel] = 0.f;
+
+            if (!surface.valid || !reservoir.IsValid() || reservoir.W <= 0.f)
+                continue;
+
+            const CpuLightSample lightSample = GetLightSample(reservoir, surface);
+
+            if (params.enableFinalVisibility && !IsVisible(surface, lightSample, rayCount))
+            {
+                // Same as the shading pass: an occluded sample is not reused by later frames
+                reservoir.W = 0.f;
+                continue;
+            }
+
+            m_Output[pixel] = ShadeSurface(surface, cameraPosition, lightSample) * reservoir.W;
+        }
+    });
+}
+
+void CpuReferenceRenderer::RenderFrame(const ResamplingConstants& constants, rtxdi::ReSTIRDI_ResamplingMode resamplingMode)
+{
+    if (!m_Scene)
+        return;
+
+    const uint32_t width = uint32_t(constants.view.viewportSize.x);
+    const uint32_t height = uint32_t(constants.view.viewportSize.y);
+
+    if (width != m_Width || height != m_Height)
+    {
+        m_Width = width;
+        m_Height = height;
+        m_GBuffer.assign(size_t(width) * height, Surface());
+        m_PrevGBuffer.assign(size_t(width) * height, Surface());
+        m_Reservoirs.assign(size_t(width) * height, Reservoir());
+        m_SpatialReservoirs.assign(size_t(width) * height, Reservoir());
+        m_PrevReservoirs.assign(size_t(width) * height, Reservoir());
+        m_Output.assign(size_t(width) * height, float3(0.f));
+        m_HistoryValid = false;
+    }
+
+    const auto startTime = steady_clock::now();
+    m_RayCount = 0;
+    m_ClampDistanceRatio = constants.vLights.clampingRatio;
+
+    const bool enableTemporal = m_HistoryValid && (
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::Temporal ||
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial ||
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::FusedSpatiotemporal);
+
+    const bool enableSpatial =
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::Spatial ||
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial ||
+        resamplingMode == rtxdi::ReSTIRDI_ResamplingMode::FusedSpatiotemporal;
+
+    TraceGBuffer(constants);
+    GenerateInitialSamples(constants);
+
+    if (enableTemporal)
+        TemporalResampling(constants);
+
+    if (enableSpatial)
+        SpatialResampling(constants);
+
+    ShadeSamples(constants);
+
+    std::swap(m_GBuffer, m_PrevGBuffer);
+    std::swap(m_Reservoirs, m_PrevReservoirs);
+    m_HistoryValid = true;
+
+    m_Stats.width = m_Width;
+    m_Stats.height = m_Height;
+    m_Stats.frameCount++;
+    m_Stats.rayCount += m_RayCount;
+    m_Stats.totalTime += duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+
+bool CpuReferenceRenderer::SaveOutput(const std::filesystem::path& fileName) const
+{
+    return WritePfm(fileName, m_Width, m_Height, m_Output.data());
+}
@@ -0,0 +1,158 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "CpuBvh.h"
+#include "CpuReferenceLights.h"
+
+#include <rtxdi/ReSTIRDI.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CpuReferenceMaterial
+{
+    dm::float3 diffuseAlbedo = 0.5f;
+    dm::float3 specularF0 = 0.04f;
+    float roughness = 0.5f;
+};
+
+// Flattened world-space scene consumed by the CPU reference renderer.
+// The light buffer uses the same layout as the GPU one: local lights first, then infinite lights,
+// with the regions described by ResamplingConstants::lightBufferParams.
+struct CpuReferenceScene
+{
+    std::vector<dm::float3> trianglePositions; // 3 vertices per triangle
+    std::vector<uint32_t> triangleMaterials;
+    std::vector<CpuReferenceMaterial> materials;
+    std::vector<PolymorphicLightInfo> lights;
+};
+
+struct CpuReferenceStats
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t threadCount = 0;
+    uint32_t frameCount = 0;
+
+    // Accumulated over all rendered frames, in milliseconds
+    double gbufferTime = 0.0;
+    double initialSamplingTime = 0.0;
+    double temporalResamplingTime = 0.0;
+    double spatialResamplingTime = 0.0;
+    double shadingTime = 0.0;
+    double totalTime = 0.0;
+
+    uint64_t rayCount = 0;
+
+    [[nodiscard]] std::string GetAsText() const;
+};
+
+// Multi-threaded CPU implementation of the ReSTIR DI pipeline of this sample:
+// G-buffer, initial RIS sampling, temporal resampling, spatial resampling and shading with visibility,
+// mirroring DIGenerateInitialSamples, DITemporalResampling, DISpatialResampling and DIShadeSamples.
+// It is meant as a ground truth for algorithmic changes and runs without a GPU.
+// The lights are sampled with the shader code, see SampleCpuReferenceLight. Differences with the GPU path:
+// materials are untextured, normals are geometric, environment lights are ignored, the initial candidates are
+// selected uniformly instead of from the presampled tiles or ReGIR, the fused resampling mode runs as separate
+// temporal and spatial passes, and pairwise bias correction falls back to the basic mode.
+class CpuReferenceRenderer
+{
+public:
+    explicit CpuReferenceRenderer(uint32_t threadCount = 0, uint32_t tileSize = 16);
+
+    void SetScene(std::shared_ptr<const CpuReferenceScene> scene);
+
+    // Renders one frame. Reservoirs and the G-buffer of the previous call are used for temporal resampling.
+    void RenderFrame(const ResamplingConstants& constants, rtxdi::ReSTIRDI_ResamplingMode resamplingMode);
+
+    void ResetHistory();
+    void ResetStats();
+
+    [[nodiscard]] const std::vector<dm::float3>& GetOutput() const { return m_Output; }
+    [[nodiscard]] const CpuReferenceStats& GetStats() const { return m_Stats; }
+    [[nodiscard]] const CpuBvh& GetBvh() const { return m_Bvh; }
+
+    bool SaveOutput(const std::filesystem::path& fileName) const;
+
+private:
+    struct Surface
+    {
+        dm::float3 position = 0.f;
+        dm::float3 normal = 0.f;
+        dm::float3 diffuseAlbedo = 0.f;
+        dm::float3 specularF0 = 0.f;
+        float roughness = 1.f;
+        float viewDepth = 0.f;
+        bool valid = false;
+    };
+
+    struct Reservoir
+    {
+        uint32_t lightIndex = ~0u;
+        dm::float2 uv = 0.f;
+        float weightSum = 0.f;
+        float targetPdf = 0.f;
+        float M = 0.f;
+        float W = 0.f;
+
+        [[nodiscard]] bool IsValid() const { return lightIndex != ~0u; }
+    };
+
+    struct RandomSampler
+    {
+        uint32_t state;
+        float Next();
+    };
+
+    std::shared_ptr<const CpuReferenceScene> m_Scene;
+    CpuBvh m_Bvh;
+
+    uint32_t m_ThreadCount;
+    uint32_t m_TileSize;
+
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    bool m_HistoryValid = false;
+    float m_ClampDistanceRatio = 0.f; // of the virtual lights, from the constants of the frame
+
+    std::vector<Surface> m_GBuffer;
+    std::vector<Surface> m_PrevGBuffer;
+    std::vector<Reservoir> m_Reservoirs;
+    std::vector<Reservoir> m_SpatialReservoirs;
+    std::vector<Reservoir> m_PrevReservoirs;
+    std::vector<dm::float3> m_Output;
+
+    CpuReferenceStats m_Stats;
+    std::atomic<uint64_t> m_RayCount = 0;
+
+    // Runs the function over all screen tiles on the worker threads and returns the elapsed time in ms
+    double ParallelForTiles(const std::function<void(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint64_t& rayCount)>& function);
+
+    RandomSampler GetRandomSampler(uint32_t x, uint32_t y, uint32_t frameIndex, uint32_t pass) const;
+
+    CpuLightSample GetLightSample(const Reservoir& reservoir, const Surface& surface) const;
+    dm::float3 ShadeSurface(const Surface& surface, const dm::float3& viewerPosition, const CpuLightSample& lightSample) const;
+    float GetTargetPdf(const Surface& surface, const dm::float3& viewerPosition, const CpuLightSample& lightSample) const;
+    bool IsVisible(const Surface& surface, const CpuLightSample& lightSample, uint64_t& rayCount) const;
+
+    static bool StreamSample(Reservoir& reservoir, uint32_t lightIndex, const dm::float2& uv, float targetPdf, float weight, float random);
+
+    void TraceGBuffer(const ResamplingConstants& constants);
+    void GenerateInitialSamples(const ResamplingConstants& constants);
+    void TemporalResampling(const ResamplingConstants& constants);
+    void SpatialResampling(const ResamplingConstants& constants);
+    void ShadeSamples(const ResamplingConstants& constants);
+};
@@ -0,0 +1,130 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CpuReferenceScene.h"
+#include "../PrepareLightsPass.h"
+#include "../SampleScene.h"
+
+#include <donut/engine/Scene.h>
+#include <donut/engine/SceneGraph.h>
+
+#include <unordered_map>
+
+using namespace donut::math;
+using namespace donut::engine;
+
+namespace
+{
+    CpuReferenceMaterial convertMaterial(const Material& material)
+    {
+        CpuReferenceMaterial result;
+
+        if (material.useSpecularGlossModel)
+        {
+            result.diffuseAlbedo = material.baseOrDiffuseColor;
+            result.specularF0 = material.specularColor;
+            result.roughness = 1.f - material.roughness; // glossiness in this model
+        }
+        else
+        {
+            result.diffuseAlbedo = material.baseOrDiffuseColor * (1.f - material.metalness);
+            result.specularF0 = lerp(float3(0.04f), material.baseOrDiffuseColor, material.metalness);
+            result.roughness = material.roughness;
+        }
+
+        return result;
+    }
+}
+
+std::shared_ptr<CpuReferenceScene> BuildCpuReferenceScene(const Scene& scene, RTXDI_LightBufferParameters& outLightBufferParams)
+{
+    auto result = std::make_shared<CpuReferenceScene>();
+    std::unordered_map<const Material*, uint32_t> materialIndices;
+
+    std::vector<PolymorphicLightInfo> finiteLights;
+    std::vector<PolymorphicLightInfo> infiniteLights;
+
+    for (const auto& instance : scene.GetSceneGraph()->GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+        const auto* node = instance->GetNode();
+        if (!mesh || !mesh->buffers || !node || mesh->buffers->positionData.empty() || mesh->buffers->indexData.empty())
+            continue;
+
+        const affine3 localToWorld = node->GetLocalToWorldTransformFloat();
+        const auto& positions = mesh->buffers->positionData;
+        const auto& indices = mesh->buffers->indexData;
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            const Material* material = geometry->material.get();
+            uint32_t materialIndex = 0;
+
+            auto found = materialIndices.find(material);
+            if (found != materialIndices.end())
+                materialIndex = found->second;
+            else
+            {
+                materialIndex = uint32_t(result->materials.size());
+                result->materials.push_back(material ? convertMaterial(*material) : CpuReferenceMaterial());
+                materialIndices[material] = materialIndex;
+            }
+
+            const bool isEmissive = material && any(material->emissiveColor != 0.f) && material->emissiveIntensity > 0.f;
+            const float3 emissiveRadiance = isEmissive ? material->emissiveColor * material->emissiveIntensity : float3(0.f);
+
+            const uint32_t firstIndex = mesh->indexOffset + geometry->indexOffsetInMesh;
+            const uint32_t firstVertex = mesh->vertexOffset + geometry->vertexOffsetInMesh;
+
+            for (uint32_t triangle = 0; triangle < geometry->numIndices / 3; triangle++)
+            {
+                float3 vertices[3];
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    const uint32_t index = indices[firstIndex + triangle * 3 + corner];
+                    vertices[corner] = localToWorld.transformPoint(positions[firstVertex + index]);
+                    result->trianglePositions.push_back(vertices[corner]);
+                }
+
+                result->triangleMaterials.push_back(materialIndex);
+
+                if (isEmissive)
+                    finiteLights.push_back(ConvertTriangleLight(vertices[0], vertices[1], vertices[2], emissiveRadiance));
+            }
+        }
+    }
+
+    for (const auto& light : scene.GetSceneGraph()->GetLights())
+    {
+        // The host build of PolymorphicLight.hlsli can't sample the environment map texture
+        if (light->GetLightType() == LightType_Environment)
+            continue;
+
+        PolymorphicLightInfo polymorphic = {};
+        if (!ConvertLight(*light, polymorphic, false))
+            continue;
+
+        if (light->GetLightType() == LightType_Directional)
+            infiniteLights.push_back(polymorphic);
+        else
+            finiteLights.push_back(polymorphic);
+    }
+
+    outLightBufferParams = {};
+    outLightBufferParams.localLightBufferRegion.firstLightIndex = 0;
+    outLightBufferParams.localLightBufferRegion.numLights = uint32_t(finiteLights.size());
+    outLightBufferParams.infiniteLightBufferRegion.firstLightIndex = uint32_t(finiteLights.size());
+    outLightBufferParams.infiniteLightBufferRegion.numLights = uint32_t(infiniteLights.size());
+
+    result->lights = std::move(finiteLights);
+    result->lights.insert(result->lights.end(), infiniteLights.begin(), infiniteLights.end());
+
+    return result;
+}
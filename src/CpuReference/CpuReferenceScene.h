@@ -0,0 +1,23 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "CpuReferenceRenderer.h"
+
+namespace donut::engine
+{
+    class Scene;
+}
+
+// Flattens the loaded scene into world-space triangles, untextured materials and a light buffer
+// laid out like the one produced by PrepareLightsPass: emissive triangles and finite lights first,
+// then infinite lights. Meshes without CPU-side geometry (e.g. skinned) are skipped.
+std::shared_ptr<CpuReferenceScene> BuildCpuReferenceScene(const donut::engine::Scene& scene, RTXDI_LightBufferParameters& outLightBufferParams);
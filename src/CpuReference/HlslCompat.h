@@ -0,0 +1,353 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+// A thin subset of HLSL for compiling shader headers as C++, currently HelperFunctions.hlsli,
+// LightShaping.hlsli and PolymorphicLight.hlsli. Shader headers are meant to be included inside an unnamed
+// namespace in the hlsl namespace with the 'in' keyword defined away, see CpuReferenceLights.cpp. The unnamed
+// namespace keeps their free functions local, so that more than one file can include them.
+// Only the vector types, swizzles and intrinsics used by those headers are provided.
+
+#include "../HalfFloat.h"
+#include "../../shaders/ShaderParameters.h"
+
+#include <donut/core/math/math.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Parameter qualifiers and zero initialization, see the HLSL definitions in HelperFunctions.hlsli
+#define HLSL_OUT(type) type&
+#define HLSL_INOUT(type) type&
+#define HLSL_ZERO(type) type{}
+
+namespace hlsl
+{
+    using uint = uint32_t;
+
+    template<typename T, int N>
+    struct vec;
+
+    // Swizzle of the components I... of an N-component vector, lives in a union with the vector storage
+    template<typename T, int N, int... I>
+    struct swizzle
+    {
+        T data[N];
+
+        operator vec<T, sizeof...(I)>() const
+        {
+            return vec<T, sizeof...(I)>(data[I]...);
+        }
+
+        swizzle& operator=(const vec<T, sizeof...(I)>& v)
+        {
+            int k = 0;
+            ((data[I] = v[k++]), ...);
+            return *this;
+        }
+    };
+
+    template<typename T, int N>
+    struct vec_storage;
+
+    template<typename T>
+    struct vec_storage<T, 2>
+    {
+        union
+        {
+            T data[2];
+            struct { T x, y; };
+            struct { T r, g; };
+            swizzle<T, 2, 0, 1> xy;
+        };
+    };
+
+    template<typename T>
+    struct vec_storage<T, 3>
+    {
+        union
+        {
+            T data[3];
+            struct { T x, y, z; };
+            struct { T r, g, b; };
+            swizzle<T, 3, 0, 1> xy;
+            swizzle<T, 3, 0, 1, 2> xyz;
+            swizzle<T, 3, 0, 1, 2> rgb;
+        };
+    };
+
+    template<typename T>
+    struct vec_storage<T, 4>
+    {
+        union
+        {
+            T data[4];
+            struct { T x, y, z, w; };
+            struct { T r, g, b, a; };
+            swizzle<T, 4, 0, 1> xy;
+            swizzle<T, 4, 2, 3> zw;
+            swizzle<T, 4, 0, 1, 2> xyz;
+            swizzle<T, 4, 0, 1, 2> rgb;
+        };
+    };
+
+    // The operators and intrinsics taking vectors are hidden friends, so that scalars, swizzles
+    // and donut vectors convert implicitly the same way HLSL arguments do.
+    template<typename T, int N>
+    struct vec : vec_storage<T, N>
+    {
+        using vec_storage<T, N>::data;
+
+        vec() = default;
+
+        vec(T s)
+        {
+            for (int i = 0; i < N; i++)
+                data[i] = s;
+        }
+
+        template<typename... Args, typename = std::enable_if_t<sizeof...(Args) == N && (std::is_arithmetic_v<Args> && ...)>>
+        vec(Args... args)
+        {
+            int i = 0;
+            ((data[i++] = T(args)), ...);
+        }
+
+        template<int M = N, typename = std::enable_if_t<M == 3>>
+        vec(const vec<T, 2>& v, T s)
+        {
+            data[0] = v.x; data[1] = v.y; data[2] = s;
+        }
+
+        template<int M = N, typename = std::enable_if_t<M == 4>>
+        vec(const vec<T, 3>& v, T s)
+        {
+            data[0] = v.x; data[1] = v.y; data[2] = v.z; data[3] = s;
+        }
+
+        vec(const dm::vector<T, N>& v)
+        {
+            for (int i = 0; i < N; i++)
+                data[i] = v[i];
+        }
+
+        operator dm::vector<T, N>() const
+        {
+            dm::vector<T, N> result;
+            for (int i = 0; i < N; i++)
+                result[i] = data[i];
+            return result;
+        }
+
+        T& operator[](int i) { return data[i]; }
+        const T& operator[](int i) const { return data[i]; }
+
+#define HLSL_COMPAT_BINARY_OP(op) \
+        friend vec operator op(const vec& a, const vec& b) { vec r; for (int i = 0; i < N; i++) r[i] = a[i] op b[i]; return r; } \
+        friend vec operator op(const vec& a, T b) { vec r; for (int i = 0; i < N; i++) r[i] = a[i] op b; return r; } \
+        friend vec operator op(T a, const vec& b) { vec r; for (int i = 0; i < N; i++) r[i] = a op b[i]; return r; } \
+        vec& operator op##=(const vec& b) { for (int i = 0; i < N; i++) data[i] = data[i] op b[i]; return *this; } \
+        vec& operator op##=(T b) { for (int i = 0; i < N; i++) data[i] = data[i] op b; return *this; }
+
+        HLSL_COMPAT_BINARY_OP(+)
+        HLSL_COMPAT_BINARY_OP(-)
+        HLSL_COMPAT_BINARY_OP(*)
+        HLSL_COMPAT_BINARY_OP(/)
+#undef HLSL_COMPAT_BINARY_OP
+
+        friend vec operator-(const vec& a) { vec r; for (int i = 0; i < N; i++) r[i] = -a[i]; return r; }
+
+        friend T dot(const vec& a, const vec& b) { T r = 0; for (int i = 0; i < N; i++) r += a[i] * b[i]; return r; }
+        friend T length(const vec& a) { return std::sqrt(dot(a, a)); }
+        friend vec normalize(const vec& a) { return a / length(a); }
+        friend vec abs(const vec& a) { vec r; for (int i = 0; i < N; i++) r[i] = std::abs(a[i]); return r; }
+        friend vec min(const vec& a, const vec& b) { vec r; for (int i = 0; i < N; i++) r[i] = a[i] < b[i] ? a[i] : b[i]; return r; }
+        friend vec max(const vec& a, const vec& b) { vec r; for (int i = 0; i < N; i++) r[i] = a[i] > b[i] ? a[i] : b[i]; return r; }
+        friend vec lerp(const vec& a, const vec& b, T t) { return a + (b - a) * t; }
+
+        friend vec saturate(const vec& a)
+        {
+            vec r;
+            for (int i = 0; i < N; i++)
+                r[i] = a[i] < T(0) ? T(0) : (a[i] > T(1) ? T(1) : a[i]);
+            return r;
+        }
+
+        template<int M = N, typename = std::enable_if_t<M == 3>>
+        friend vec cross(const vec& a, const vec& b)
+        {
+            return vec(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+        }
+    };
+
+    typedef vec<float, 2> float2;
+    typedef vec<float, 3> float3;
+    typedef vec<float, 4> float4;
+    typedef vec<uint, 2> uint2;
+    typedef vec<uint, 3> uint3;
+    typedef vec<uint, 4> uint4;
+
+    using std::sqrt;
+    using std::sin;
+    using std::cos;
+    using std::asin;
+    using std::acos;
+    using std::atan2;
+    using std::exp2;
+    using std::log2;
+    using std::ceil;
+    using std::floor;
+    using std::abs;
+    using std::isinf;
+    using std::isnan;
+
+    // Mixed float and double arguments are common in HLSL code because of unsuffixed literals
+    template<typename A, typename B, typename = std::enable_if_t<std::is_arithmetic_v<A> && std::is_arithmetic_v<B>>>
+    std::common_type_t<A, B> min(A a, B b) { return a < b ? a : b; }
+
+    template<typename A, typename B, typename = std::enable_if_t<std::is_arithmetic_v<A> && std::is_arithmetic_v<B>>>
+    std::common_type_t<A, B> max(A a, B b) { return a > b ? a : b; }
+
+    template<typename T>
+    T square(T x) { return x * x; }
+
+    inline float saturate(float x) { return x < 0.f ? 0.f : (x > 1.f ? 1.f : x); }
+    inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+    inline float rcp(float x) { return 1.f / x; }
+
+    inline float smoothstep(float edge0, float edge1, float x)
+    {
+        const float t = saturate((x - edge0) / (edge1 - edge0));
+        return t * t * (3.f - 2.f * t);
+    }
+
+    inline void sincos(float x, float& s, float& c)
+    {
+        s = std::sin(x);
+        c = std::cos(x);
+    }
+
+    inline uint asuint(float x)
+    {
+        uint result;
+        std::memcpy(&result, &x, sizeof(result));
+        return result;
+    }
+
+    inline float asfloat(uint x)
+    {
+        float result;
+        std::memcpy(&result, &x, sizeof(result));
+        return result;
+    }
+
+    inline uint3 asuint(const float3& v) { return uint3(asuint(v.x), asuint(v.y), asuint(v.z)); }
+    inline float3 asfloat(const uint3& v) { return float3(asfloat(v.x), asfloat(v.y), asfloat(v.z)); }
+
+    inline float f16tof32(uint x) { return Fp16ToFp32(x & 0xffff); }
+
+    inline uint f32tof16(float x)
+    {
+        // Round to nearest even, denormals flush to zero like the f16 conversions on most GPUs
+        const uint u = asuint(x);
+        const uint sign = (u >> 16) & 0x8000;
+        const int exponent = int((u >> 23) & 0xff) - 127 + 15;
+        uint mantissa = u & 0x7fffff;
+
+        if (((u >> 23) & 0xff) == 0xff)
+            return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+        if (exponent <= 0)
+            return sign;
+        if (exponent >= 31)
+            return sign | 0x7c00;
+
+        uint result = (uint(exponent) << 10) | (mantissa >> 13);
+        const uint remainder = mantissa & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+            result++;
+        return sign | result;
+    }
+
+    // Donut and RTXDI shader library functions used by the shader headers
+
+    inline float3 octToNdirUnorm32(uint packed)
+    {
+        float2 p;
+        p.x = saturate(float(packed & 0xffff) / float(0xfffe)) * 2.f - 1.f;
+        p.y = saturate(float(packed >> 16) / float(0xfffe)) * 2.f - 1.f;
+
+        float3 n = float3(p.x, p.y, 1.f - std::abs(p.x) - std::abs(p.y));
+        if (n.z < 0.f)
+        {
+            const float x = (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+            const float y = (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+            n.x = x;
+            n.y = y;
+        }
+
+        return normalize(n);
+    }
+
+    inline uint ndirToOctUnorm32(const float3& n)
+    {
+        float2 p = float2(n.x, n.y) / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+        if (n.z < 0.f)
+        {
+            p = float2(
+                (1.f - std::abs(p.y)) * (p.x >= 0.f ? 1.f : -1.f),
+                (1.f - std::abs(p.x)) * (p.y >= 0.f ? 1.f : -1.f));
+        }
+
+        const uint x = uint(std::floor(saturate(p.x * 0.5f + 0.5f) * float(0xfffe) + 0.5f));
+        const uint y = uint(std::floor(saturate(p.y * 0.5f + 0.5f) * float(0xfffe) + 0.5f));
+        return x | (y << 16);
+    }
+
+    // The light color is written by PrepareLightsPass.cpp as 8-bit unorm
+    inline float3 Unpack_R8G8B8_UFLOAT(uint packed)
+    {
+        return float3(float(packed & 0xff), float((packed >> 8) & 0xff), float((packed >> 16) & 0xff)) / 255.f;
+    }
+
+    inline uint Pack_R8G8B8_UFLOAT(const float3& color)
+    {
+        const float3 c = saturate(color);
+        return uint(std::floor(c.x * 255.f + 0.5f))
+            | (uint(std::floor(c.y * 255.f + 0.5f)) << 8)
+            | (uint(std::floor(c.z * 255.f + 0.5f)) << 16);
+    }
+
+    inline uint RTXDI_JenkinsHash(uint a)
+    {
+        a = (a + 0x7ed55d16) + (a << 12);
+        a = (a ^ 0xc761c23c) ^ (a >> 19);
+        a = (a + 0x165667b1) + (a << 5);
+        a = (a + 0xd3a2646c) ^ (a << 9);
+        a = (a + 0xfd7046c5) + (a << 3);
+        a = (a ^ 0xb55a4f09) ^ (a >> 16);
+        return a;
+    }
+
+    inline uint RTXDI_ZCurveToLinearIndex(uint2 xy)
+    {
+        uint b = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            b |= (xy.x & 1u) << (2 * i);
+            b |= (xy.y & 1u) << (2 * i + 1);
+            xy.x >>= 1;
+            xy.y >>= 1;
+        }
+        return b;
+    }
+}
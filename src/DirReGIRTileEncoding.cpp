@@ -0,0 +1,60 @@
+/***************************************************************************
+ # Copyright (c) 2020-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "DirReGIRTileEncoding.h"
+#include "../shaders/DirReGIRParameters.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t EncodeDirReGIRWeight(float weight)
+{
+    if (!(weight > 0.f))
+        return 0;
+
+    const float t = std::clamp((std::log2(weight) - float(DIRREGIR_PACKED_MIN_LOG2_WEIGHT))
+        / float(DIRREGIR_PACKED_MAX_LOG2_WEIGHT - DIRREGIR_PACKED_MIN_LOG2_WEIGHT), 0.f, 1.f);
+    return uint32_t(std::round(t * float(DIRREGIR_PACKED_WEIGHT_MAX_CODE - 1))) + 1;
+}
+
+float DecodeDirReGIRWeight(uint32_t code)
+{
+    if (code == 0)
+        return 0.f;
+
+    const float t = float(code - 1) / float(DIRREGIR_PACKED_WEIGHT_MAX_CODE - 1);
+    return std::exp2(t * float(DIRREGIR_PACKED_MAX_LOG2_WEIGHT - DIRREGIR_PACKED_MIN_LOG2_WEIGHT) + float(DIRREGIR_PACKED_MIN_LOG2_WEIGHT));
+}
+
+uint32_t PackDirReGIRTileEntry(uint32_t lightIndex, bool compact, float weight)
+{
+    const uint32_t weightCode = EncodeDirReGIRWeight(weight);
+
+    if (lightIndex >= DIRREGIR_PACKED_INVALID_INDEX || weightCode == 0)
+        return DIRREGIR_PACKED_INVALID_INDEX;
+
+    return (weightCode << DIRREGIR_PACKED_WEIGHT_SHIFT)
+        | (compact ? DIRREGIR_PACKED_COMPACT_BIT : 0u)
+        | lightIndex;
+}
+
+bool UnpackDirReGIRTileEntry(uint32_t packed, uint32_t& lightIndex, bool& compact, float& weight)
+{
+    lightIndex = packed & DIRREGIR_PACKED_INDEX_MASK;
+    compact = (packed & DIRREGIR_PACKED_COMPACT_BIT) != 0;
+    weight = DecodeDirReGIRWeight(packed >> DIRREGIR_PACKED_WEIGHT_SHIFT);
+
+    return lightIndex != DIRREGIR_PACKED_INVALID_INDEX;
+}
+
+bool IsDirReGIRPackedEncodingSupported(uint32_t lightBufferElements)
+{
+    return lightBufferElements <= DIRREGIR_PACKED_INVALID_INDEX;
+}
@@ -0,0 +1,25 @@
+/***************************************************************************
+ # Copyright (c) 2020-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// CPU implementation of the packed 32-bit DirReGIR tile entry format,
+// must match shaders/LightingPasses/DirReGIRTileEncoding.hlsli
+
+uint32_t EncodeDirReGIRWeight(float weight);
+float DecodeDirReGIRWeight(uint32_t code);
+uint32_t PackDirReGIRTileEntry(uint32_t lightIndex, bool compact, float weight);
+bool UnpackDirReGIRTileEntry(uint32_t packed, uint32_t& lightIndex, bool& compact, float& weight);
+
+// The packed entries store light indices below DIRREGIR_PACKED_INVALID_INDEX, and the indices address both halves
+// of the light buffer. Larger buffers must use DirReGIRTileEncoding::Full.
+bool IsDirReGIRPackedEncodingSupported(uint32_t lightBufferElements);
@@ -0,0 +1,213 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentAliasTable.h"
+#include "EnvironmentPdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+// Texels with a non-zero weight keep a non-zero threshold, so that every one of them can be sampled
+static uint32_t quantizeThreshold(float threshold)
+{
+    const uint32_t quantized = uint32_t(std::min(std::max(threshold, 0.f), 1.f) * 65535.f + 0.5f);
+    return (threshold > 0.f) ? std::max(quantized, 1u) : 0u;
+}
+
+// Same expression as the shader
+static float getTexelThreshold(const EnvironmentAliasTexel& texel)
+{
+    return float(texel.aliasAndThreshold >> 16) / 65535.f;
+}
+
+// Vose's method. 'scaled' holds the weights times n over their sum and is modified. Entries that end up
+// without a partner because of rounding keep a threshold of 1, which 'threshold' is initialized with.
+static void buildAlias(float* scaled, uint32_t n, uint32_t* stack, float* threshold, uint32_t* alias)
+{
+    // Small entries grow from the front of the stack and large ones from the back, they never overlap
+    uint32_t smallCount = 0;
+    uint32_t largeBegin = n;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        threshold[i] = 1.f;
+        alias[i] = i;
+
+        if (scaled[i] < 1.f)
+            stack[smallCount++] = i;
+        else
+            stack[--largeBegin] = i;
+    }
+
+    while (smallCount > 0 && largeBegin < n)
+    {
+        const uint32_t small = stack[--smallCount];
+        const uint32_t large = stack[largeBegin++];
+
+        threshold[small] = scaled[small];
+        alias[small] = large;
+
+        scaled[large] = (scaled[large] + scaled[small]) - 1.f;
+        if (scaled[large] < 1.f)
+            stack[smallCount++] = large;
+        else
+            stack[--largeBegin] = large;
+    }
+}
+
+namespace
+{
+    struct RowScratch
+    {
+        std::vector<float> weights;
+        std::vector<float> scaled;
+        std::vector<uint32_t> stack;
+        std::vector<float> threshold;
+        std::vector<uint32_t> alias;
+        std::vector<double> probability;
+
+        explicit RowScratch(uint32_t n)
+            : weights(n), scaled(n), stack(n), threshold(n), alias(n), probability(n)
+        { }
+    };
+}
+
+// Builds the conditional table of one row and stores the probabilities of the columns in it, returns the row weight
+static double buildRow(const float* pixels, uint32_t width, uint32_t y, uint32_t height, RowScratch& scratch, EnvironmentAliasTexel* texels)
+{
+    ComputeEnvironmentWeightRow(pixels, width, y, height, std::numeric_limits<float>::max(), scratch.weights.data());
+
+    double sum = 0.0;
+    for (uint32_t x = 0; x < width; x++)
+        sum += scratch.weights[x];
+
+    if (!(sum > 0.0))
+    {
+        // Never sampled, the probability of the row is zero
+        for (uint32_t x = 0; x < width; x++)
+            texels[x] = EnvironmentAliasTexel{ 1.f / float(width), x | (0xffffu << 16) };
+        return 0.0;
+    }
+
+    const double scale = double(width) / sum;
+    for (uint32_t x = 0; x < width; x++)
+        scratch.scaled[x] = float(double(scratch.weights[x]) * scale);
+
+    buildAlias(scratch.scaled.data(), width, scratch.stack.data(), scratch.threshold.data(), scratch.alias.data());
+
+    for (uint32_t x = 0; x < width; x++)
+    {
+        texels[x].aliasAndThreshold = scratch.alias[x] | (quantizeThreshold(scratch.threshold[x]) << 16);
+        scratch.probability[x] = 0.0;
+    }
+
+    // Probabilities implied by the quantized thresholds
+    for (uint32_t x = 0; x < width; x++)
+    {
+        const double threshold = getTexelThreshold(texels[x]);
+        scratch.probability[x] += threshold;
+        scratch.probability[texels[x].aliasAndThreshold & 0xffff] += 1.0 - threshold;
+    }
+
+    for (uint32_t x = 0; x < width; x++)
+        texels[x].pdf = float(scratch.probability[x] / width);
+
+    return sum;
+}
+
+bool BuildEnvironmentAliasTable(const float* pixels, uint32_t width, uint32_t height, uint32_t threadCount, EnvironmentAliasTable& result)
+{
+    if (width == 0 || height == 0 || width > c_EnvironmentAliasTableMaxWidth)
+        return false;
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    result.width = width;
+    result.height = height;
+    result.texels.resize(size_t(width) * height);
+    result.rows.resize(height);
+
+    std::vector<double> rowWeights(height);
+
+    ParallelForRows(height, threadCount, [&](uint32_t y0, uint32_t y1)
+    {
+        RowScratch scratch(width);
+        for (uint32_t y = y0; y < y1; y++)
+        {
+            rowWeights[y] = buildRow(pixels + size_t(y) * width * 4, width, y, height, scratch,
+                result.texels.data() + size_t(y) * width);
+        }
+    });
+
+    // The marginal table keeps float thresholds, it is small
+    double sum = 0.0;
+    for (double weight : rowWeights)
+        sum += weight;
+
+    RowScratch scratch(height);
+    std::vector<double> rowProbabilities(height, 0.0);
+
+    if (sum > 0.0)
+    {
+        for (uint32_t y = 0; y < height; y++)
+            scratch.scaled[y] = float(rowWeights[y] * double(height) / sum);
+
+        buildAlias(scratch.scaled.data(), height, scratch.stack.data(), scratch.threshold.data(), scratch.alias.data());
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const double threshold = scratch.threshold[y];
+            rowProbabilities[y] += threshold / height;
+            rowProbabilities[scratch.alias[y]] += (1.0 - threshold) / height;
+        }
+    }
+    else
+    {
+        // Nothing to sample, uniform tables with zero probabilities
+        for (uint32_t y = 0; y < height; y++)
+        {
+            scratch.threshold[y] = 1.f;
+            scratch.alias[y] = y;
+        }
+    }
+
+    for (uint32_t y = 0; y < height; y++)
+        result.rows[y] = EnvironmentAliasRow{ scratch.threshold[y], scratch.alias[y] };
+
+    ParallelForRows(height, threadCount, [&](uint32_t y0, uint32_t y1)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+        {
+            EnvironmentAliasTexel* texels = result.texels.data() + size_t(y) * width;
+            for (uint32_t x = 0; x < width; x++)
+                texels[x].pdf = float(double(texels[x].pdf) * rowProbabilities[y]);
+        }
+    });
+
+    return true;
+}
+
+void SampleEnvironmentAliasTable(const EnvironmentAliasTable& table, float rowRandom, float rowAliasRandom,
+    float columnRandom, float columnAliasRandom, uint32_t& x, uint32_t& y, float& pdf)
+{
+    y = std::min(uint32_t(rowRandom * float(table.height)), table.height - 1);
+    const EnvironmentAliasRow& row = table.rows[y];
+    if (rowAliasRandom >= row.threshold)
+        y = row.alias;
+
+    const EnvironmentAliasTexel* texels = table.texels.data() + size_t(y) * table.width;
+    x = std::min(uint32_t(columnRandom * float(table.width)), table.width - 1);
+    if (columnAliasRandom >= getTexelThreshold(texels[x]))
+        x = texels[x].aliasAndThreshold & 0xffff;
+
+    pdf = texels[x].pdf;
+}
@@ -0,0 +1,54 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Alias tables for sampling an equirectangular environment map in constant time, as an alternative to
+// descending the PDF mip chain. The marginal table picks a row, then the conditional table of that row picks
+// a column, see EnvironmentAliasTable.hlsli. The weights are the same as in PreprocessEnvironmentMap.hlsl
+// but in full float range. The column thresholds are stored with 16 bits, so the probability stored with
+// every texel is computed from the quantized thresholds: it is the exact probability of sampling that texel.
+// BuildEnvironmentAliasTable.hlsl is the GPU version of this builder, used for the procedural sky.
+
+// The alias column is stored in 16 bits
+constexpr uint32_t c_EnvironmentAliasTableMaxWidth = 65536;
+
+// Matches the uint2 entries of t_EnvironmentAliasTable
+struct EnvironmentAliasTexel
+{
+    float pdf; // probability of sampling this texel out of the whole map
+    uint32_t aliasAndThreshold; // alias column in the low 16 bits, unorm16 threshold in the high 16 bits
+};
+
+// Matches the uint2 entries of t_EnvironmentAliasMarginal
+struct EnvironmentAliasRow
+{
+    float threshold;
+    uint32_t alias;
+};
+
+struct EnvironmentAliasTable
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<EnvironmentAliasTexel> texels;
+    std::vector<EnvironmentAliasRow> rows;
+};
+
+// Pixels are RGBA float, tightly packed. Uses 'threadCount' threads, zero means all cores.
+// Returns false if the map is too wide for the table format.
+bool BuildEnvironmentAliasTable(const float* pixels, uint32_t width, uint32_t height, uint32_t threadCount, EnvironmentAliasTable& result);
+
+// Same lookup as the shader, the random numbers are in [0, 1)
+void SampleEnvironmentAliasTable(const EnvironmentAliasTable& table, float rowRandom, float rowAliasRandom,
+    float columnRandom, float columnAliasRandom, uint32_t& x, uint32_t& y, float& pdf);
@@ -0,0 +1,147 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentAliasTablePass.h"
+#include "EnvironmentAliasTable.h"
+#include "RtxdiResources.h"
+#include <donut/engine/ShaderFactory.h>
+#include <nvrhi/utils.h>
+
+#include <donut/core/math/math.h>
+#include <donut/core/log.h>
+
+using namespace donut::math;
+
+#include "../shaders/ShaderParameters.h"
+
+EnvironmentAliasTablePass::EnvironmentAliasTablePass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+    nvrhi::ITexture* sourceEnvironmentMap,
+    const RtxdiResources& resources)
+    : m_Device(device)
+    , m_SourceTexture(sourceEnvironmentMap)
+    , m_TableBuffer(resources.EnvironmentAliasTableBuffer)
+    , m_MarginalBuffer(resources.EnvironmentAliasMarginalBuffer)
+{
+    donut::log::debug("Initializing EnvironmentAliasTablePass...");
+
+    nvrhi::BindingLayoutDesc bindingLayoutDesc;
+    bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    bindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(EnvironmentAliasTableConstants)),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(3)
+    };
+    m_BindingLayout = device->createBindingLayout(bindingLayoutDesc);
+
+    auto createPipeline = [&](const char* entryName)
+    {
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.bindingLayouts = { m_BindingLayout };
+        pipelineDesc.CS = shaderFactory->CreateShader("app/BuildEnvironmentAliasTable.hlsl", entryName, nullptr, nvrhi::ShaderType::Compute);
+        return device->createComputePipeline(pipelineDesc);
+    };
+
+    m_BuildRowsPipeline = createPipeline("buildRows");
+    m_BuildMarginalPipeline = createPipeline("buildMarginal");
+    m_ApplyRowProbabilitiesPipeline = createPipeline("applyRowProbabilities");
+}
+
+void EnvironmentAliasTablePass::CreateBindingSet()
+{
+    const auto& sourceDesc = m_SourceTexture->getDesc();
+
+    // Only needed while building, so they are not created when the tables come from the CPU
+    nvrhi::BufferDesc worklistDesc;
+    worklistDesc.byteSize = sizeof(uint32_t) * sourceDesc.width * sourceDesc.height;
+    worklistDesc.format = nvrhi::Format::R32_UINT;
+    worklistDesc.canHaveTypedViews = true;
+    worklistDesc.canHaveUAVs = true;
+    worklistDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    worklistDesc.keepInitialState = true;
+    worklistDesc.debugName = "EnvironmentAliasWorklist";
+    m_WorklistBuffer = m_Device->createBuffer(worklistDesc);
+
+    nvrhi::BufferDesc rowWeightsDesc = worklistDesc;
+    rowWeightsDesc.byteSize = sizeof(float) * sourceDesc.height;
+    rowWeightsDesc.format = nvrhi::Format::R32_FLOAT;
+    rowWeightsDesc.debugName = "EnvironmentAliasRowWeights";
+    m_RowWeightsBuffer = m_Device->createBuffer(rowWeightsDesc);
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(EnvironmentAliasTableConstants)),
+        nvrhi::BindingSetItem::Texture_SRV(0, m_SourceTexture),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_TableBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_MarginalBuffer),
+        nvrhi::BindingSetItem::TypedBuffer_UAV(2, m_WorklistBuffer),
+        nvrhi::BindingSetItem::TypedBuffer_UAV(3, m_RowWeightsBuffer)
+    };
+    m_BindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+}
+
+bool EnvironmentAliasTablePass::Upload(nvrhi::ICommandList* commandList, const EnvironmentAliasTable& table)
+{
+    const auto& sourceDesc = m_SourceTexture->getDesc();
+    const size_t tableSize = sizeof(EnvironmentAliasTexel) * table.texels.size();
+    const size_t marginalSize = sizeof(EnvironmentAliasRow) * table.rows.size();
+
+    if (table.width != sourceDesc.width || table.height != sourceDesc.height ||
+        tableSize != m_TableBuffer->getDesc().byteSize || marginalSize != m_MarginalBuffer->getDesc().byteSize)
+        return false;
+
+    commandList->beginMarker("UploadEnvironmentAliasTable");
+    commandList->writeBuffer(m_TableBuffer, table.texels.data(), tableSize);
+    commandList->writeBuffer(m_MarginalBuffer, table.rows.data(), marginalSize);
+    commandList->endMarker();
+
+    return true;
+}
+
+void EnvironmentAliasTablePass::Build(nvrhi::ICommandList* commandList)
+{
+    const auto& sourceDesc = m_SourceTexture->getDesc();
+    if (sourceDesc.width > c_EnvironmentAliasTableMaxWidth ||
+        m_TableBuffer->getDesc().byteSize != sizeof(EnvironmentAliasTexel) * sourceDesc.width * sourceDesc.height)
+    {
+        donut::log::warning("The environment map alias tables cannot be built for a %ux%u map", sourceDesc.width, sourceDesc.height);
+        return;
+    }
+
+    if (!m_BindingSet)
+        CreateBindingSet();
+
+    commandList->beginMarker("BuildEnvironmentAliasTable");
+
+    EnvironmentAliasTableConstants constants{};
+    constants.size = { sourceDesc.width, sourceDesc.height };
+
+    auto dispatch = [&](nvrhi::IComputePipeline* pipeline, uint32_t x, uint32_t y)
+    {
+        nvrhi::ComputeState state;
+        state.pipeline = pipeline;
+        state.bindings = { m_BindingSet };
+        commandList->setComputeState(state);
+        commandList->setPushConstants(&constants, sizeof(constants));
+        commandList->dispatch(x, y, 1);
+
+        commandList->clearState(); // make sure nvrhi inserts a barrier
+    };
+
+    dispatch(m_BuildRowsPipeline, div_ceil(sourceDesc.height, 64), 1);
+    dispatch(m_BuildMarginalPipeline, 1, 1);
+    dispatch(m_ApplyRowProbabilitiesPipeline, div_ceil(sourceDesc.width, 16), div_ceil(sourceDesc.height, 16));
+
+    commandList->endMarker();
+}
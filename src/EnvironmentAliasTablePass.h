@@ -0,0 +1,54 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+class RtxdiResources;
+struct EnvironmentAliasTable;
+
+// Fills the environment map alias tables in RtxdiResources, either from tables built on the CPU
+// or with BuildEnvironmentAliasTable.hlsl when there are none, e.g. for the procedural sky.
+class EnvironmentAliasTablePass
+{
+private:
+    nvrhi::DeviceHandle m_Device;
+    nvrhi::ComputePipelineHandle m_BuildRowsPipeline;
+    nvrhi::ComputePipelineHandle m_BuildMarginalPipeline;
+    nvrhi::ComputePipelineHandle m_ApplyRowProbabilitiesPipeline;
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::BindingSetHandle m_BindingSet;
+    nvrhi::TextureHandle m_SourceTexture;
+    nvrhi::BufferHandle m_TableBuffer;
+    nvrhi::BufferHandle m_MarginalBuffer;
+    nvrhi::BufferHandle m_WorklistBuffer;
+    nvrhi::BufferHandle m_RowWeightsBuffer;
+
+    void CreateBindingSet();
+
+public:
+    EnvironmentAliasTablePass(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        nvrhi::ITexture* sourceEnvironmentMap,
+        const RtxdiResources& resources);
+
+    // Returns false if the tables were built for a map of a different size
+    bool Upload(nvrhi::ICommandList* commandList, const EnvironmentAliasTable& table);
+
+    void Build(nvrhi::ICommandList* commandList);
+};
@@ -0,0 +1,237 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentMapStreamer.h"
+#include "EnvironmentPdfCache.h"
+#include "EnvironmentAliasTable.h"
+
+#include <donut/engine/TextureCache.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace donut;
+using namespace std::chrono;
+
+EnvironmentMapStreamer::EnvironmentMapStreamer(
+    nvrhi::IDevice* device,
+    std::shared_ptr<engine::TextureCache> textureCache,
+    std::shared_ptr<vfs::IFileSystem> fileSystem,
+    const EnvironmentPdfCache* pdfCache)
+    : m_Device(device)
+    , m_TextureCache(std::move(textureCache))
+    , m_FileSystem(std::move(fileSystem))
+    , m_PdfCache(pdfCache)
+{
+    m_Thread = std::thread(&EnvironmentMapStreamer::ThreadProc, this);
+}
+
+EnvironmentMapStreamer::~EnvironmentMapStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Exiting = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+void EnvironmentMapStreamer::Request(const std::string& path, bool buildAliasTable)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingPath = path;
+        m_PendingBuildAliasTable = buildAliasTable;
+        m_PendingRequestId = ++m_RequestId;
+    }
+    m_Condition.notify_all();
+}
+
+void EnvironmentMapStreamer::Cancel()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_PendingPath.clear();
+    ++m_RequestId;
+}
+
+void EnvironmentMapStreamer::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_PendingPath.empty() && !m_Busy; });
+}
+
+// The decoded pixels are only kept until the texture is finalized by ProcessRenderingThreadCommands in Poll.
+// Maps that were already in the texture cache, or in a format that can't be converted, are built on the GPU instead.
+static std::shared_ptr<EnvironmentAliasTable> buildAliasTable(const std::shared_ptr<engine::LoadedTexture>& texture)
+{
+    const auto textureData = std::dynamic_pointer_cast<engine::TextureData>(texture);
+    if (!textureData)
+        return nullptr;
+
+    const std::shared_ptr<vfs::IBlob> data = textureData->data;
+    if (!data || textureData->dataLayout.empty() || textureData->dataLayout[0].empty() ||
+        !EnvironmentPdfCache::IsFormatSupported(textureData->format))
+    {
+        log::info("The alias tables of %s will be built on the GPU", texture->path.c_str());
+        return nullptr;
+    }
+
+    const auto start = steady_clock::now();
+    const engine::TextureSubresourceData& layout = textureData->dataLayout[0][0];
+
+    std::vector<float> pixels;
+    EnvironmentPdfCache::ConvertPixels(static_cast<const uint8_t*>(data->data()) + layout.dataOffset, layout.rowPitch,
+        textureData->format, textureData->width, textureData->height, pixels);
+
+    auto table = std::make_shared<EnvironmentAliasTable>();
+    if (!BuildEnvironmentAliasTable(pixels.data(), textureData->width, textureData->height, 0, *table))
+        return nullptr;
+
+    log::info("Built the alias tables of %s in %.1f ms", texture->path.c_str(),
+        duration<double, std::milli>(steady_clock::now() - start).count());
+    return table;
+}
+
+void EnvironmentMapStreamer::ThreadProc()
+{
+    while (true)
+    {
+        Completed completed;
+        bool buildAlias = false;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return !m_PendingPath.empty() || m_Exiting; });
+
+            if (m_Exiting)
+                return;
+
+            completed.map.path = std::move(m_PendingPath);
+            completed.requestId = m_PendingRequestId;
+            buildAlias = m_PendingBuildAliasTable;
+            m_PendingPath.clear();
+            m_Busy = true;
+        }
+
+        const auto start = steady_clock::now();
+        StreamedEnvironmentMap& map = completed.map;
+
+        // Decodes the file here, the texture is created and uploaded by ProcessRenderingThreadCommands in Poll
+        std::shared_ptr<engine::LoadedTexture> texture = m_TextureCache->LoadTextureFromFileDeferred(map.path, false);
+        if (m_TextureCache->IsTextureLoaded(texture))
+        {
+            map.texture = texture;
+
+            if (buildAlias)
+                map.aliasTable = buildAliasTable(texture);
+
+            // The file is still in the OS cache at this point, reading it again to hash it is cheap
+            const auto file = m_PdfCache ? m_FileSystem->readFile(map.path) : nullptr;
+            if (file)
+                m_PdfCache->Lookup(map.path, file->data(), file->size(), map.pdfKey, map.pdfMips);
+
+            log::info("Loaded the environment map %s in the background in %.1f ms", map.path.c_str(),
+                duration<double, std::milli>(steady_clock::now() - start).count());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Completed.push_back(std::move(completed));
+            m_Busy = false;
+        }
+        m_Condition.notify_all();
+    }
+}
+
+bool EnvironmentMapStreamer::Poll(engine::CommonRenderPasses& commonPasses, StreamedEnvironmentMap& result)
+{
+    std::vector<Completed> completed;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Completed.empty())
+            return false;
+
+        completed.swap(m_Completed);
+    }
+
+    // Creates and uploads the textures decoded by the background thread
+    m_TextureCache->ProcessRenderingThreadCommands(commonPasses, 0.f);
+    m_TextureCache->LoadingFinished();
+
+    bool ready = false;
+    for (Completed& item : completed)
+    {
+        if (item.requestId == m_RequestId)
+        {
+            result = std::move(item.map);
+            ready = true;
+        }
+        else
+        {
+            // Superseded by a later request
+            Retire(item.map.texture);
+        }
+    }
+
+    if (ready && result.texture)
+    {
+        // The file may have been requested again while its previous texture was waiting to be released
+        for (RetiredTexture& retired : m_Retired)
+        {
+            if (retired.texture == result.texture)
+                retired.texture = nullptr;
+        }
+    }
+
+    return ready;
+}
+
+void EnvironmentMapStreamer::Retire(std::shared_ptr<engine::LoadedTexture> texture)
+{
+    if (texture)
+        m_Retired.push_back(RetiredTexture{ std::move(texture), nullptr });
+}
+
+void EnvironmentMapStreamer::EndFrame()
+{
+    for (RetiredTexture& retired : m_Retired)
+    {
+        if (retired.eventQuery)
+            continue;
+
+        // The frame that was just submitted is the first one that doesn't use the texture
+        if (!m_FreeEventQueries.empty())
+        {
+            retired.eventQuery = std::move(m_FreeEventQueries.back());
+            m_FreeEventQueries.pop_back();
+            m_Device->resetEventQuery(retired.eventQuery);
+        }
+        else
+        {
+            retired.eventQuery = m_Device->createEventQuery();
+        }
+
+        m_Device->setEventQuery(retired.eventQuery, nvrhi::CommandQueue::Graphics);
+    }
+
+    m_Retired.erase(std::remove_if(m_Retired.begin(), m_Retired.end(), [this](RetiredTexture& retired)
+        {
+            if (!m_Device->pollEventQuery(retired.eventQuery))
+                return false;
+
+            if (retired.texture)
+                m_TextureCache->UnloadTexture(retired.texture);
+
+            m_FreeEventQueries.push_back(std::move(retired.eventQuery));
+            return true;
+        }), m_Retired.end());
+}
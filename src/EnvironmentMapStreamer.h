@@ -0,0 +1,114 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "EnvironmentPdf.h"
+
+#include <nvrhi/nvrhi.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace donut::engine
+{
+    class TextureCache;
+    class CommonRenderPasses;
+    struct LoadedTexture;
+}
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+class EnvironmentPdfCache;
+struct EnvironmentAliasTable;
+
+struct StreamedEnvironmentMap
+{
+    std::string path;
+    std::shared_ptr<donut::engine::LoadedTexture> texture; // null if the file couldn't be loaded
+    uint64_t pdfKey = 0; // zero if the PDF cache is disabled
+    EnvironmentPdfMips pdfMips; // empty if the PDF is not cached
+    std::shared_ptr<const EnvironmentAliasTable> aliasTable; // null if not requested or the pixels are not available
+};
+
+// Decodes environment maps on a background thread while the current one stays in use, so that switching maps
+// doesn't stall rendering. The replaced maps are released once the GPU has completed the frames that used them,
+// because releasing their bindless descriptors earlier would let a new texture overwrite a slot that is still read.
+class EnvironmentMapStreamer
+{
+private:
+    struct Completed
+    {
+        uint32_t requestId = 0;
+        StreamedEnvironmentMap map;
+    };
+
+    struct RetiredTexture
+    {
+        std::shared_ptr<donut::engine::LoadedTexture> texture;
+        nvrhi::EventQueryHandle eventQuery;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::TextureCache> m_TextureCache;
+    std::shared_ptr<donut::vfs::IFileSystem> m_FileSystem;
+    const EnvironmentPdfCache* m_PdfCache;
+
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::string m_PendingPath;
+    uint32_t m_PendingRequestId = 0;
+    bool m_PendingBuildAliasTable = false;
+    std::vector<Completed> m_Completed;
+    bool m_Busy = false;
+    bool m_Exiting = false;
+
+    // Only used on the rendering thread
+    uint32_t m_RequestId = 0;
+    std::vector<RetiredTexture> m_Retired;
+    std::vector<nvrhi::EventQueryHandle> m_FreeEventQueries;
+
+    void ThreadProc();
+
+public:
+    EnvironmentMapStreamer(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::TextureCache> textureCache,
+        std::shared_ptr<donut::vfs::IFileSystem> fileSystem,
+        const EnvironmentPdfCache* pdfCache);
+    ~EnvironmentMapStreamer();
+
+    // Starts loading a file, replaces any earlier request that has not completed yet.
+    // With 'buildAliasTable', the alias tables are also built from the decoded pixels on the background thread.
+    void Request(const std::string& path, bool buildAliasTable);
+
+    // Drops the last request, e.g. when switching to the procedural sky
+    void Cancel();
+
+    // Blocks until the background thread has finished the last request
+    void Wait();
+
+    // Call at the start of a frame. Uploads the decoded textures and returns true when the last request has completed.
+    bool Poll(donut::engine::CommonRenderPasses& commonPasses, StreamedEnvironmentMap& result);
+
+    // Keeps a replaced map and its descriptor alive until the frames that may use it have completed
+    void Retire(std::shared_ptr<donut::engine::LoadedTexture> texture);
+
+    // Call after executing the command list of a frame
+    void EndFrame();
+};
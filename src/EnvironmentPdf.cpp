@@ -0,0 +1,338 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentPdf.h"
+#include "ContentHash.h"
+#include "HalfFloat.h"
+
+#include <donut/core/math/math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENVIRONMENT_PDF_SSE2 1
+#include <emmintrin.h>
+#else
+#define ENVIRONMENT_PDF_SSE2 0
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr float c_MaxWeight = 65504.f; // maximum value that can be encoded in a float16 texture
+static constexpr uint32_t c_MipLevelsPerPass = 5; // see GenerateMipsPass::Process
+static constexpr uint32_t c_EnvironmentPdfCacheMagic = 0x46445045; // "EPDF"
+
+namespace
+{
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(CacheHeader) == 32);
+}
+
+uint32_t GetEnvironmentPdfMipLevels(uint32_t width, uint32_t height)
+{
+    return uint32_t(ceilf(::log2f(float(std::max(width, height))))) + 1;
+}
+
+static uint32_t getMipSize(uint32_t size, uint32_t level)
+{
+    return std::max(1u, size >> level);
+}
+
+// Elevation of the row center in the equirectangular projection, same expression as the shader
+static float getRowSolidAngle(uint32_t y, uint32_t height)
+{
+    const float elevation = ((float(y) + 0.5f) / float(height) - 0.5f) * dm::PI_f;
+    return cosf(elevation);
+}
+
+static float getPixelWeight(const float* rgba, float solidAngle, float maxWeight)
+{
+    const float luma = rgba[0] * 0.299f + rgba[1] * 0.587f + rgba[2] * 0.114f;
+
+    // Do not sample invalid colors, negative and NaN luminance count as zero
+    if (!(luma > 0.f) || std::isinf(luma))
+        return 0.f;
+
+    return std::min(luma * solidAngle, maxWeight);
+}
+
+void ComputeEnvironmentWeightRow(const float* pixels, uint32_t width, uint32_t y, uint32_t height, float maxWeight, float* weights)
+{
+    const float solidAngle = getRowSolidAngle(y, height);
+    uint32_t x = 0;
+
+#if ENVIRONMENT_PDF_SSE2
+    const __m128 lumaR = _mm_set1_ps(0.299f);
+    const __m128 lumaG = _mm_set1_ps(0.587f);
+    const __m128 lumaB = _mm_set1_ps(0.114f);
+    const __m128 angle = _mm_set1_ps(solidAngle);
+    const __m128 maxWeights = _mm_set1_ps(maxWeight);
+    const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 r = _mm_loadu_ps(pixels + x * 4 + 0);
+        __m128 g = _mm_loadu_ps(pixels + x * 4 + 4);
+        __m128 b = _mm_loadu_ps(pixels + x * 4 + 8);
+        __m128 a = _mm_loadu_ps(pixels + x * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        __m128 luma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, lumaR), _mm_mul_ps(g, lumaG)), _mm_mul_ps(b, lumaB));
+
+        // maxps returns the second operand for NaN, which matches the scalar path; then drop infinities
+        luma = _mm_max_ps(luma, zero);
+        luma = _mm_and_ps(luma, _mm_cmplt_ps(luma, infinity));
+
+        _mm_storeu_ps(weights + x, _mm_min_ps(_mm_mul_ps(luma, angle), maxWeights));
+    }
+#endif
+
+    for (; x < width; x++)
+        weights[x] = getPixelWeight(pixels + x * 4, solidAngle, maxWeight);
+}
+
+// The first level of a pass reads the texture in 'x, y' order, the wave reductions that follow read Z-order lanes
+static float reduceQuad(float x0y0, float x1y0, float x0y1, float x1y1, bool textureOrder)
+{
+    return textureOrder
+        ? (x0y0 + x0y1 + x1y0 + x1y1) * 0.25f
+        : (x0y0 + x1y0 + x0y1 + x1y1) * 0.25f;
+}
+
+static void reduceRow(const float* row0, const float* row1, uint32_t sourceWidth, uint32_t destWidth, bool textureOrder, float* dest)
+{
+    uint32_t x = 0;
+
+#if ENVIRONMENT_PDF_SSE2
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (; x + 4 <= destWidth && x * 2 + 8 <= sourceWidth; x += 4)
+    {
+        const __m128 a0 = _mm_loadu_ps(row0 + x * 2);
+        const __m128 b0 = _mm_loadu_ps(row0 + x * 2 + 4);
+        const __m128 a1 = _mm_loadu_ps(row1 + x * 2);
+        const __m128 b1 = _mm_loadu_ps(row1 + x * 2 + 4);
+
+        const __m128 x0y0 = _mm_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 x1y0 = _mm_shuffle_ps(a0, b0, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 x0y1 = _mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 x1y1 = _mm_shuffle_ps(a1, b1, _MM_SHUFFLE(3, 1, 3, 1));
+
+        const __m128 sum = textureOrder
+            ? _mm_add_ps(_mm_add_ps(_mm_add_ps(x0y0, x0y1), x1y0), x1y1)
+            : _mm_add_ps(_mm_add_ps(_mm_add_ps(x0y0, x1y0), x0y1), x1y1);
+
+        _mm_storeu_ps(dest + x, _mm_mul_ps(sum, quarter));
+    }
+#endif
+
+    // Reads outside of the source level return zero, like UAV loads
+    for (; x < destWidth; x++)
+    {
+        const uint32_t x0 = x * 2;
+        const uint32_t x1 = x * 2 + 1;
+        dest[x] = reduceQuad(
+            x0 < sourceWidth ? row0[x0] : 0.f,
+            x1 < sourceWidth ? row0[x1] : 0.f,
+            x0 < sourceWidth ? row1[x0] : 0.f,
+            x1 < sourceWidth ? row1[x1] : 0.f,
+            textureOrder);
+    }
+}
+
+void ParallelForRows(uint32_t rowCount, uint32_t threadCount, const std::function<void(uint32_t y0, uint32_t y1)>& function)
+{
+    constexpr uint32_t bandHeight = 16;
+    const uint32_t bandCount = (rowCount + bandHeight - 1) / bandHeight;
+    std::atomic<uint32_t> nextBand = 0;
+
+    auto worker = [&]()
+    {
+        for (uint32_t band = nextBand++; band < bandCount; band = nextBand++)
+            function(band * bandHeight, std::min(rowCount, (band + 1) * bandHeight));
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < std::min(threadCount, bandCount); i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void ComputeEnvironmentPdfMips(const float* pixels, uint32_t width, uint32_t height, uint32_t threadCount, EnvironmentPdfMips& result)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    const uint32_t mipLevels = GetEnvironmentPdfMipLevels(width, height);
+
+    result.width = width;
+    result.height = height;
+    result.levels.resize(mipLevels);
+
+    std::vector<float> source(size_t(width) * height);
+    std::vector<float> dest;
+
+    ParallelForRows(height, threadCount, [&](uint32_t y0, uint32_t y1)
+    {
+        for (uint32_t y = y0; y < y1; y++)
+            ComputeEnvironmentWeightRow(pixels + size_t(y) * width * 4, width, y, height, c_MaxWeight, source.data() + size_t(y) * width);
+    });
+
+    result.levels[0].resize(source.size());
+    ParallelForRows(height, threadCount, [&](uint32_t y0, uint32_t y1)
+    {
+        for (size_t i = size_t(y0) * width; i < size_t(y1) * width; i++)
+            result.levels[0][i] = Fp32ToFp16(source[i]);
+    });
+
+    std::vector<float> zeroRow(width, 0.f);
+
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        const uint32_t sourceLevel = level - 1;
+        const uint32_t sourceWidth = getMipSize(width, sourceLevel);
+        const uint32_t sourceHeight = getMipSize(height, sourceLevel);
+        const uint32_t destWidth = getMipSize(width, level);
+        const uint32_t destHeight = getMipSize(height, level);
+        const bool passStart = (sourceLevel % c_MipLevelsPerPass) == 0;
+
+        // The shader passes after the first one load their source level from the float16 texture
+        if (passStart && sourceLevel > 0)
+        {
+            for (size_t i = 0; i < size_t(sourceWidth) * sourceHeight; i++)
+                source[i] = Fp16ToFp32(result.levels[sourceLevel][i]);
+        }
+
+        dest.resize(size_t(destWidth) * destHeight);
+        std::vector<uint16_t>& destLevel = result.levels[level];
+        destLevel.resize(dest.size());
+
+        // Small levels are not worth starting threads for
+        ParallelForRows(destHeight, destHeight >= 64 ? threadCount : 1, [&](uint32_t y0, uint32_t y1)
+        {
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                const float* row0 = source.data() + size_t(y * 2) * sourceWidth;
+                const float* row1 = (y * 2 + 1 < sourceHeight) ? row0 + sourceWidth : zeroRow.data();
+                float* destRow = dest.data() + size_t(y) * destWidth;
+
+                reduceRow(row0, row1, sourceWidth, destWidth, passStart, destRow);
+
+                for (uint32_t x = 0; x < destWidth; x++)
+                    destLevel[size_t(y) * destWidth + x] = Fp32ToFp16(destRow[x]);
+            }
+        });
+
+        std::swap(source, dest);
+    }
+}
+
+uint64_t HashEnvironmentMapFile(const void* data, size_t size)
+{
+    ContentHasher hasher;
+    hasher.AddWord(c_EnvironmentPdfCacheVersion);
+    hasher.Add(data, size);
+    return hasher.Get();
+}
+
+bool WriteEnvironmentPdfCache(const fs::path& fileName, uint64_t key, const EnvironmentPdfMips& mips)
+{
+    CacheHeader header{};
+    header.magic = c_EnvironmentPdfCacheMagic;
+    header.version = c_EnvironmentPdfCacheVersion;
+    header.key = key;
+    header.width = mips.width;
+    header.height = mips.height;
+    header.mipLevels = uint32_t(mips.levels.size());
+
+    // Write into a temporary file first, a partially written cache must never replace a valid one
+    const fs::path tempFileName = fs::path(fileName).concat(".tmp");
+    FILE* file = fopen(tempFileName.string().c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const std::vector<uint16_t>& level : mips.levels)
+        success = success && fwrite(level.data(), sizeof(uint16_t), level.size(), file) == level.size();
+    fclose(file);
+
+    std::error_code ec;
+    if (success)
+        fs::rename(tempFileName, fileName, ec);
+
+    if (!success || ec)
+    {
+        fs::remove(tempFileName, ec);
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadEnvironmentPdfCache(const fs::path& fileName, uint64_t key, EnvironmentPdfMips& mips)
+{
+    FILE* file = fopen(fileName.string().c_str(), "rb");
+    if (!file)
+        return false;
+
+    CacheHeader header{};
+    bool success = fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == c_EnvironmentPdfCacheMagic
+        && header.version == c_EnvironmentPdfCacheVersion
+        && header.key == key
+        && header.width > 0 && header.height > 0
+        && header.mipLevels == GetEnvironmentPdfMipLevels(header.width, header.height);
+
+    if (success)
+    {
+        mips.width = header.width;
+        mips.height = header.height;
+        mips.levels.resize(header.mipLevels);
+
+        for (uint32_t level = 0; success && level < header.mipLevels; level++)
+        {
+            mips.levels[level].resize(size_t(getMipSize(header.width, level)) * getMipSize(header.height, level));
+            success = fread(mips.levels[level].data(), sizeof(uint16_t), mips.levels[level].size(), file) == mips.levels[level].size();
+        }
+
+        // Trailing data means that the file is not what the header says
+        uint8_t extra;
+        success = success && fread(&extra, 1, 1, file) == 0;
+    }
+
+    fclose(file);
+
+    if (!success)
+        mips = EnvironmentPdfMips();
+
+    return success;
+}
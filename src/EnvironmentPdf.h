@@ -0,0 +1,48 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+// CPU implementation of PreprocessEnvironmentMap.hlsl: the importance sampling weight of every pixel is
+// its luminance times the relative solid angle of its row, clamped to the float16 range, and every mip level
+// averages 2x2 pixels of the previous one, reading zeros outside of it like the shader does.
+// The shader keeps 5 levels in registers per pass, so the levels that start a pass are read back as float16 here too.
+
+constexpr uint32_t c_EnvironmentPdfCacheVersion = 1;
+
+struct EnvironmentPdfMips
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::vector<uint16_t>> levels; // R16_FLOAT texels of every mip level, tightly packed rows
+};
+
+// Full mip chain up to 1x1, same as the EnvironmentPdf texture in RtxdiResources
+uint32_t GetEnvironmentPdfMipLevels(uint32_t width, uint32_t height);
+
+// Importance sampling weights of row 'y' of RGBA float pixels, clamped to 'maxWeight'. Uses SSE2 where available.
+void ComputeEnvironmentWeightRow(const float* pixels, uint32_t width, uint32_t y, uint32_t height, float maxWeight, float* weights);
+
+// Splits the rows into bands that 'threadCount' threads take from a shared counter
+void ParallelForRows(uint32_t rowCount, uint32_t threadCount, const std::function<void(uint32_t y0, uint32_t y1)>& function);
+
+// Pixels are RGBA float, tightly packed. Uses SSE2 where available and 'threadCount' threads, zero means all cores.
+void ComputeEnvironmentPdfMips(const float* pixels, uint32_t width, uint32_t height, uint32_t threadCount, EnvironmentPdfMips& result);
+
+// Cache key of an environment map file, from its contents
+uint64_t HashEnvironmentMapFile(const void* data, size_t size);
+
+bool WriteEnvironmentPdfCache(const std::filesystem::path& fileName, uint64_t key, const EnvironmentPdfMips& mips);
+bool ReadEnvironmentPdfCache(const std::filesystem::path& fileName, uint64_t key, EnvironmentPdfMips& mips);
@@ -0,0 +1,252 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentPdfCache.h"
+#include "HalfFloat.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace donut;
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+static uint32_t getBytesPerPixel(nvrhi::Format format)
+{
+    switch (format)
+    {
+    case nvrhi::Format::RGBA16_FLOAT: return 8;
+    case nvrhi::Format::RGB32_FLOAT: return 12;
+    case nvrhi::Format::RGBA32_FLOAT: return 16;
+    default: return 0;
+    }
+}
+
+EnvironmentPdfCache::EnvironmentPdfCache(nvrhi::IDevice* device, const fs::path& folder)
+    : m_Device(device)
+    , m_Folder(folder)
+{
+    std::error_code ec;
+    fs::create_directories(m_Folder, ec);
+}
+
+EnvironmentPdfCache::~EnvironmentPdfCache()
+{
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+fs::path EnvironmentPdfCache::GetFileName(uint64_t key) const
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.envpdf", (unsigned long long)key);
+    return m_Folder / fileName;
+}
+
+bool EnvironmentPdfCache::IsFormatSupported(nvrhi::Format format)
+{
+    return getBytesPerPixel(format) != 0;
+}
+
+void EnvironmentPdfCache::ConvertPixels(const void* data, size_t rowPitch, nvrhi::Format format, uint32_t width, uint32_t height, std::vector<float>& pixels)
+{
+    pixels.resize(size_t(width) * height * 4);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = static_cast<const uint8_t*>(data) + y * rowPitch;
+        float* dest = pixels.data() + size_t(y) * width * 4;
+
+        if (format == nvrhi::Format::RGBA16_FLOAT)
+        {
+            const uint16_t* source = reinterpret_cast<const uint16_t*>(row);
+            for (uint32_t i = 0; i < width * 4; i++)
+                dest[i] = Fp16ToFp32(source[i]);
+        }
+        else if (format == nvrhi::Format::RGB32_FLOAT)
+        {
+            const float* source = reinterpret_cast<const float*>(row);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                memcpy(&dest[x * 4], &source[x * 3], sizeof(float) * 3);
+                dest[x * 4 + 3] = 1.f;
+            }
+        }
+        else
+        {
+            memcpy(dest, row, size_t(width) * 4 * sizeof(float));
+        }
+    }
+}
+
+bool EnvironmentPdfCache::Lookup(const std::string& name, const void* fileData, size_t fileSize, uint64_t& key, EnvironmentPdfMips& mips) const
+{
+    const auto start = steady_clock::now();
+
+    key = HashEnvironmentMapFile(fileData, fileSize);
+
+    if (!ReadEnvironmentPdfCache(GetFileName(key), key, mips))
+    {
+        log::info("The environment map PDF of %s is not cached, it will be generated on the GPU", name.c_str());
+        return false;
+    }
+
+    log::info("Loaded the environment map PDF of %s from the cache in %.1f ms", name.c_str(),
+        duration<double, std::milli>(steady_clock::now() - start).count());
+    return true;
+}
+
+void EnvironmentPdfCache::SetEnvironmentMap(const std::string& name, uint64_t key, EnvironmentPdfMips mips)
+{
+    m_Name = name;
+    m_Key = key;
+    m_Mips = std::move(mips);
+}
+
+void EnvironmentPdfCache::Clear()
+{
+    m_Name.clear();
+    m_Key = 0;
+    m_Mips = EnvironmentPdfMips();
+}
+
+bool EnvironmentPdfCache::Upload(nvrhi::ICommandList* commandList, nvrhi::ITexture* pdfTexture)
+{
+    if (m_Key == 0)
+        return false;
+
+    if (m_Mips.levels.empty())
+    {
+        // A chain computed from an earlier capture of this map, e.g. when the PDF texture is re-created
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_ComputedKey == m_Key)
+            m_Mips = m_ComputedMips;
+    }
+
+    const nvrhi::TextureDesc& desc = pdfTexture->getDesc();
+    if (desc.width != m_Mips.width || desc.height != m_Mips.height || desc.mipLevels != uint32_t(m_Mips.levels.size()))
+        return false;
+
+    for (uint32_t level = 0; level < desc.mipLevels; level++)
+    {
+        const size_t rowPitch = size_t(std::max(1u, desc.width >> level)) * sizeof(uint16_t);
+        commandList->writeTexture(pdfTexture, 0, level, m_Mips.levels[level].data(), rowPitch);
+    }
+
+    return true;
+}
+
+void EnvironmentPdfCache::Capture(nvrhi::ICommandList* commandList, nvrhi::ITexture* environmentMap)
+{
+    if (m_Key == 0 || !m_Mips.levels.empty() || m_Key == m_CaptureKey)
+        return;
+
+    const nvrhi::TextureDesc& desc = environmentMap->getDesc();
+    if (!IsFormatSupported(desc.format))
+    {
+        log::warning("The environment map PDF of %s cannot be cached, its texture format is not supported", m_Name.c_str());
+        return;
+    }
+
+    if (!m_StagingTexture || m_StagingTexture->getDesc().width != desc.width ||
+        m_StagingTexture->getDesc().height != desc.height || m_StagingTexture->getDesc().format != desc.format)
+    {
+        nvrhi::TextureDesc stagingDesc;
+        stagingDesc.width = desc.width;
+        stagingDesc.height = desc.height;
+        stagingDesc.format = desc.format;
+        stagingDesc.debugName = "EnvironmentPdfCacheStaging";
+        m_StagingTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+    }
+
+    if (!m_EventQuery)
+        m_EventQuery = m_Device->createEventQuery();
+
+    // Only the first mip level of the environment map is used to generate the PDF
+    commandList->copyTexture(m_StagingTexture, nvrhi::TextureSlice(), environmentMap, nvrhi::TextureSlice());
+
+    m_CaptureKey = m_Key;
+    m_CaptureRecorded = true;
+    m_CaptureSubmitted = false;
+}
+
+void EnvironmentPdfCache::EndFrame()
+{
+    if (m_CaptureRecorded)
+    {
+        m_Device->resetEventQuery(m_EventQuery);
+        m_Device->setEventQuery(m_EventQuery, nvrhi::CommandQueue::Graphics);
+        m_CaptureRecorded = false;
+        m_CaptureSubmitted = true;
+    }
+
+    // Never wait for the copy, it is only needed by the next switch to this environment map
+    if (m_CaptureSubmitted && m_Device->pollEventQuery(m_EventQuery))
+    {
+        m_CaptureSubmitted = false;
+        ReadCapture();
+    }
+}
+
+void EnvironmentPdfCache::ReadCapture()
+{
+    const nvrhi::TextureDesc& desc = m_StagingTexture->getDesc();
+
+    size_t rowPitch = 0;
+    const uint8_t* mappedData = static_cast<const uint8_t*>(m_Device->mapStagingTexture(
+        m_StagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+    if (!mappedData)
+    {
+        log::warning("Couldn't map the environment map readback texture, the PDF of %s will not be cached", m_Name.c_str());
+        return;
+    }
+
+    const uint32_t bytesPerPixel = getBytesPerPixel(desc.format);
+    const size_t rowSize = size_t(desc.width) * bytesPerPixel;
+    std::vector<uint8_t> data(rowSize * desc.height);
+    for (uint32_t row = 0; row < desc.height; row++)
+        memcpy(data.data() + row * rowSize, mappedData + row * rowPitch, rowSize);
+
+    m_Device->unmapStagingTexture(m_StagingTexture);
+
+    // One chain at a time, each takes a fraction of a second
+    if (m_Thread.joinable())
+        m_Thread.join();
+
+    m_Thread = std::thread([this, data = std::move(data), rowSize, desc, key = m_CaptureKey, name = m_Name]()
+    {
+        const auto start = steady_clock::now();
+        std::vector<float> pixels;
+        ConvertPixels(data.data(), rowSize, desc.format, desc.width, desc.height, pixels);
+
+        EnvironmentPdfMips mips;
+        ComputeEnvironmentPdfMips(pixels.data(), desc.width, desc.height, 0, mips);
+
+        const fs::path fileName = GetFileName(key);
+        if (WriteEnvironmentPdfCache(fileName, key, mips))
+        {
+            log::info("Saved the environment map PDF of %s to %s in %.1f ms", name.c_str(), fileName.generic_string().c_str(),
+                duration<double, std::milli>(steady_clock::now() - start).count());
+        }
+        else
+        {
+            log::warning("Failed to write the environment map PDF cache file %s", fileName.generic_string().c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ComputedKey = key;
+        m_ComputedMips = std::move(mips);
+    });
+}
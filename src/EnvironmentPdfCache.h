@@ -0,0 +1,78 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "EnvironmentPdf.h"
+
+#include <nvrhi/nvrhi.h>
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps the importance sampling PDF mip chains of environment map files on disk, keyed by the file contents.
+// On a hit, the chain is uploaded into the PDF texture instead of running PreprocessEnvironmentMap.hlsl.
+// On a miss, the GPU pass runs as before and the environment map is read back without stalling, then the chain
+// is computed and written to disk on a background thread, so the next switch to the same file is a hit.
+class EnvironmentPdfCache
+{
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::filesystem::path m_Folder;
+
+    std::string m_Name;
+    uint64_t m_Key = 0;
+    EnvironmentPdfMips m_Mips;
+
+    nvrhi::StagingTextureHandle m_StagingTexture;
+    nvrhi::EventQueryHandle m_EventQuery;
+    uint64_t m_CaptureKey = 0;
+    bool m_CaptureRecorded = false;
+    bool m_CaptureSubmitted = false;
+
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    uint64_t m_ComputedKey = 0;
+    EnvironmentPdfMips m_ComputedMips;
+
+    [[nodiscard]] std::filesystem::path GetFileName(uint64_t key) const;
+    void ReadCapture();
+
+public:
+    EnvironmentPdfCache(nvrhi::IDevice* device, const std::filesystem::path& folder);
+    ~EnvironmentPdfCache();
+
+    // Computes the key of an environment map file from its contents and reads its PDF, returns true on a hit.
+    // Only reads files, so it can run on a loader thread.
+    bool Lookup(const std::string& name, const void* fileData, size_t fileSize, uint64_t& key, EnvironmentPdfMips& mips) const;
+
+    // Makes a looked up environment map the current one, 'mips' is empty after a miss
+    void SetEnvironmentMap(const std::string& name, uint64_t key, EnvironmentPdfMips mips);
+
+    // Used for the procedural sky: it depends on the sun parameters, so it is never cached
+    void Clear();
+
+    // Writes the cached chain into the PDF texture, returns false when there is none that matches the texture
+    bool Upload(nvrhi::ICommandList* commandList, nvrhi::ITexture* pdfTexture);
+
+    // Records a copy of the environment map after Upload has missed
+    void Capture(nvrhi::ICommandList* commandList, nvrhi::ITexture* environmentMap);
+
+    // Call after executing the command list that contains the capture
+    void EndFrame();
+
+    [[nodiscard]] static bool IsFormatSupported(nvrhi::Format format);
+
+    // Converts rows of a supported format to tightly packed RGBA float pixels
+    static void ConvertPixels(const void* data, size_t rowPitch, nvrhi::Format format, uint32_t width, uint32_t height, std::vector<float>& pixels);
+};
@@ -0,0 +1,256 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameCapture.h"
+#include "ImageDiff.h"
+#include "HalfFloat.h"
+
+#include <donut/core/log.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+namespace fs = std::filesystem;
+
+static uint32_t getBytesPerPixel(nvrhi::Format format)
+{
+    switch (format)
+    {
+    case nvrhi::Format::RGBA16_FLOAT: return 8;
+    case nvrhi::Format::RGBA32_FLOAT: return 16;
+    default: return 0;
+    }
+}
+
+bool FrameCapture::IsFormatSupported(nvrhi::Format format)
+{
+    return getBytesPerPixel(format) != 0;
+}
+
+FrameCapture::FrameCapture(nvrhi::IDevice* device, const fs::path& outputFolder, uint32_t latency)
+    : m_Device(device)
+    , m_OutputFolder(outputFolder)
+    , m_Latency(latency)
+{
+    if (!fs::exists(m_OutputFolder))
+    {
+        log::info("Creating folder '%s'", m_OutputFolder.generic_string().c_str());
+        fs::create_directories(m_OutputFolder);
+    }
+
+    m_WriterThread = std::thread(&FrameCapture::WriterThreadProc, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        m_Exiting = true;
+    }
+    m_QueueCondition.notify_all();
+    m_WriterThread.join();
+
+    log::info("Frame capture: %u file(s) written into '%s'%s", m_FilesWritten, m_OutputFolder.generic_string().c_str(),
+        m_FilesFailed ? ", some files could not be written" : "");
+}
+
+FrameCapture::Slot* FrameCapture::GetFreeSlot(const nvrhi::TextureDesc& desc)
+{
+    Slot* reusableSlot = nullptr;
+    for (Slot& slot : m_Slots)
+    {
+        if (slot.recorded || slot.submitted)
+            continue;
+
+        if (slot.desc.width == desc.width && slot.desc.height == desc.height && slot.desc.format == desc.format)
+            return &slot;
+
+        reusableSlot = &slot;
+    }
+
+    // The ring only grows until it holds 'latency' frames worth of captures, EndFrame reads the older slots back
+    if (!reusableSlot)
+        reusableSlot = &m_Slots.emplace_back();
+
+    nvrhi::TextureDesc stagingDesc;
+    stagingDesc.width = desc.width;
+    stagingDesc.height = desc.height;
+    stagingDesc.format = desc.format;
+    stagingDesc.debugName = "FrameCaptureStaging";
+
+    reusableSlot->desc = stagingDesc;
+    reusableSlot->stagingTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+    if (!reusableSlot->eventQuery)
+        reusableSlot->eventQuery = m_Device->createEventQuery();
+
+    return reusableSlot;
+}
+
+bool FrameCapture::Capture(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, const char* name, uint32_t frameIndex)
+{
+    const nvrhi::TextureDesc& desc = texture->getDesc();
+    if (!IsFormatSupported(desc.format))
+    {
+        log::warning("Frame capture: texture '%s' has an unsupported format, only RGBA16_FLOAT and RGBA32_FLOAT can be saved", name);
+        return false;
+    }
+
+    Slot* slot = GetFreeSlot(desc);
+    slot->name = name;
+    slot->frameIndex = frameIndex;
+    slot->recorded = true;
+
+    commandList->copyTexture(slot->stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
+
+    return true;
+}
+
+void FrameCapture::EndFrame(uint32_t frameIndex)
+{
+    for (Slot& slot : m_Slots)
+    {
+        if (!slot.recorded)
+            continue;
+
+        m_Device->resetEventQuery(slot.eventQuery);
+        m_Device->setEventQuery(slot.eventQuery, nvrhi::CommandQueue::Graphics);
+        slot.recorded = false;
+        slot.submitted = true;
+        slot.submitFrameIndex = frameIndex;
+    }
+
+    for (Slot& slot : m_Slots)
+    {
+        if (!slot.submitted)
+            continue;
+
+        // Only block when the copy is 'latency' frames old, which normally never happens
+        if (!m_Device->pollEventQuery(slot.eventQuery))
+        {
+            if (frameIndex - slot.submitFrameIndex < m_Latency)
+                continue;
+
+            m_Device->waitEventQuery(slot.eventQuery);
+        }
+
+        ReadSlot(slot);
+    }
+}
+
+void FrameCapture::Flush()
+{
+    for (Slot& slot : m_Slots)
+    {
+        if (slot.recorded)
+            log::warning("Frame capture: '%s' for frame %u was recorded but never submitted", slot.name.c_str(), slot.frameIndex);
+        slot.recorded = false;
+
+        if (!slot.submitted)
+            continue;
+
+        m_Device->waitEventQuery(slot.eventQuery);
+        ReadSlot(slot);
+    }
+
+    std::unique_lock<std::mutex> lock(m_QueueMutex);
+    m_QueueCondition.wait(lock, [this]() { return m_Queue.empty() && !m_Busy; });
+}
+
+void FrameCapture::ReadSlot(Slot& slot)
+{
+    slot.submitted = false;
+
+    size_t rowPitch = 0;
+    const uint8_t* mappedData = static_cast<const uint8_t*>(m_Device->mapStagingTexture(
+        slot.stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+    if (!mappedData)
+    {
+        log::error("Frame capture: couldn't map the readback texture for '%s'", slot.name.c_str());
+        return;
+    }
+
+    char fileName[256];
+    snprintf(fileName, sizeof(fileName), "%s_%05u.pfm", slot.name.c_str(), slot.frameIndex);
+
+    WriteJob job;
+    job.fileName = m_OutputFolder / fileName;
+    job.format = slot.desc.format;
+    job.width = slot.desc.width;
+    job.height = slot.desc.height;
+
+    // Only the copy happens on this thread, conversion and file IO are left to the writer
+    const size_t rowSize = size_t(job.width) * getBytesPerPixel(job.format);
+    job.data.resize(rowSize * job.height);
+    for (uint32_t row = 0; row < job.height; row++)
+        memcpy(job.data.data() + row * rowSize, mappedData + row * rowPitch, rowSize);
+
+    m_Device->unmapStagingTexture(slot.stagingTexture);
+
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        m_Queue.push_back(std::move(job));
+    }
+    m_QueueCondition.notify_all();
+}
+
+void FrameCapture::WriterThreadProc()
+{
+    std::vector<float3> pixels;
+
+    while (true)
+    {
+        WriteJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_QueueMutex);
+            m_QueueCondition.wait(lock, [this]() { return !m_Queue.empty() || m_Exiting; });
+
+            if (m_Queue.empty())
+                return;
+
+            job = std::move(m_Queue.front());
+            m_Queue.pop_front();
+            m_Busy = true;
+        }
+
+        pixels.resize(size_t(job.width) * job.height);
+
+        if (job.format == nvrhi::Format::RGBA16_FLOAT)
+        {
+            const uint16_t* source = reinterpret_cast<const uint16_t*>(job.data.data());
+            for (size_t i = 0; i < pixels.size(); i++)
+                pixels[i] = float3(Fp16ToFp32(source[i * 4 + 0]), Fp16ToFp32(source[i * 4 + 1]), Fp16ToFp32(source[i * 4 + 2]));
+        }
+        else
+        {
+            const float* source = reinterpret_cast<const float*>(job.data.data());
+            for (size_t i = 0; i < pixels.size(); i++)
+                pixels[i] = float3(source[i * 4 + 0], source[i * 4 + 1], source[i * 4 + 2]);
+        }
+
+        const bool success = WritePfm(job.fileName, job.width, job.height, pixels.data());
+        if (!success)
+            log::error("Frame capture: failed to write '%s'", job.fileName.generic_string().c_str());
+
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            if (success)
+                ++m_FilesWritten;
+            else
+                ++m_FilesFailed;
+            m_Busy = false;
+        }
+        m_QueueCondition.notify_all();
+    }
+}
@@ -0,0 +1,83 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Saves render targets from multiple frames as float PFM files without stalling the GPU.
+// Textures are copied into a ring of staging textures, mapped once their copy has completed or
+// after 'latency' frames at the latest, and converted and written to disk on a background thread.
+// Supports RGBA16_FLOAT and RGBA32_FLOAT textures, the alpha channel is dropped.
+class FrameCapture
+{
+private:
+    struct Slot
+    {
+        nvrhi::StagingTextureHandle stagingTexture;
+        nvrhi::EventQueryHandle eventQuery;
+        nvrhi::TextureDesc desc;
+        std::string name;
+        uint32_t frameIndex = 0;
+        uint32_t submitFrameIndex = 0;
+        bool recorded = false;
+        bool submitted = false;
+    };
+
+    struct WriteJob
+    {
+        std::filesystem::path fileName;
+        nvrhi::Format format = nvrhi::Format::UNKNOWN;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> data; // tightly packed rows
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::filesystem::path m_OutputFolder;
+    uint32_t m_Latency;
+    std::vector<Slot> m_Slots;
+
+    std::thread m_WriterThread;
+    std::mutex m_QueueMutex;
+    std::condition_variable m_QueueCondition;
+    std::deque<WriteJob> m_Queue;
+    bool m_Busy = false;
+    bool m_Exiting = false;
+    uint32_t m_FilesWritten = 0;
+    uint32_t m_FilesFailed = 0;
+
+    Slot* GetFreeSlot(const nvrhi::TextureDesc& desc);
+    void ReadSlot(Slot& slot);
+    void WriterThreadProc();
+
+public:
+    FrameCapture(nvrhi::IDevice* device, const std::filesystem::path& outputFolder, uint32_t latency);
+    ~FrameCapture();
+
+    // Records a copy of the texture into the command list, the file is named <name>_<frameIndex>.pfm
+    bool Capture(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, const char* name, uint32_t frameIndex);
+
+    // Call after executing the command list that contains the captures for this frame
+    void EndFrame(uint32_t frameIndex);
+
+    // Waits for all pending captures to be read back and written
+    void Flush();
+
+    [[nodiscard]] static bool IsFormatSupported(nvrhi::Format format);
+};
@@ -0,0 +1,110 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FramePacket.h"
+#include "CpuProfiler.h"
+#include "PrepareLightsPass.h"
+
+#include <cassert>
+#include <chrono>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+using namespace std::chrono;
+
+FramePacketBuilder::FramePacketBuilder(bool useWorkerThread)
+{
+    if (useWorkerThread)
+        m_Thread = std::thread(&FramePacketBuilder::WorkerThread, this);
+}
+
+FramePacketBuilder::~FramePacketBuilder()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Terminate = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+void FramePacketBuilder::Begin(uint32_t frameIndex, BuildFunction build)
+{
+    assert(!m_Started);
+    m_Started = true;
+
+    m_Packets[m_BuildIndex].frameIndex = frameIndex;
+
+    if (!m_Thread.joinable())
+    {
+        Build(build);
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Build = std::move(build);
+        m_Building = true;
+    }
+    m_WorkAvailable.notify_one();
+}
+
+const FramePacket& FramePacketBuilder::Wait()
+{
+    assert(m_Started);
+    m_Started = false;
+
+    const auto start = steady_clock::now();
+
+    if (m_Thread.joinable())
+    {
+        std::unique_lock lock(m_Mutex);
+        m_WorkDone.wait(lock, [this] { return !m_Building; });
+        m_Build = nullptr;
+    }
+
+    m_Statistics.buildTime = m_BuildTime;
+    m_Statistics.waitTime = duration<double, std::milli>(steady_clock::now() - start).count();
+
+    const FramePacket& packet = m_Packets[m_BuildIndex];
+    m_BuildIndex ^= 1;
+    return packet;
+}
+
+void FramePacketBuilder::Build(const BuildFunction& build)
+{
+    const auto start = steady_clock::now();
+    build(m_Packets[m_BuildIndex]);
+    m_BuildTime = duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+void FramePacketBuilder::WorkerThread()
+{
+    CpuProfiler::Get().SetThreadName("Frame Packet Thread");
+
+    std::unique_lock lock(m_Mutex);
+    while (true)
+    {
+        m_WorkAvailable.wait(lock, [this] { return m_Terminate || m_Building; });
+        if (m_Terminate)
+            return;
+
+        // Begin and Wait don't touch the build function or the packet while m_Building is set
+        lock.unlock();
+        Build(m_Build);
+        lock.lock();
+
+        m_Building = false;
+        m_WorkDone.notify_all();
+    }
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PrepareLightsTask;
+struct PolymorphicLightInfo;
+
+// Inputs of the light tasks of one frame, taken from the UI on the main thread
+struct LightTaskSettings
+{
+    uint32_t frameIndex = 0;
+    bool enableImportanceSampledEnvironmentLight = false;
+    bool enableVirtualLights = false;
+    uint32_t virtualLightsSamplesPerFrame = 0;
+    uint32_t virtualLightsSampleLifespan = 1;
+    uint32_t virtualLightsCurrentBlock = 0;  // from VirtualLightScheduler, c_NoVirtualLightBlock when none
+    uint32_t virtualLightsPreviousBlock = 0;
+    uint32_t virtualLightsUpdateStride = 1;
+    uint32_t virtualLightsUpdatePhase = 0;
+    bool virtualLightsRingComplete = true;
+    bool lockVirtualLights = false;
+    bool addVirtualLightsToGeometryMap = false;
+    bool incrementalLocalLightPdf = false;
+    bool enableStaticLightRegion = false;
+};
+
+// CPU data of one frame that the passes upload, built away from the recording thread.
+// The vectors keep their capacity when the packet is built again.
+struct FramePacket
+{
+    uint32_t frameIndex = 0;
+
+    // Light tasks for PrepareLightsPass, built by LightTaskBuilder
+    LightTaskSettings lightTaskSettings;
+    std::vector<PrepareLightsTask> lightTasks;
+    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    std::vector<uint32_t> geometryInstanceToLight;
+    uint32_t lightCount = 0;       // lights in one half of the light buffer, including the virtual lights
+    uint32_t taskBufferOffset = 0; // light index of the first task thread, the current virtual light block comes before
+    uint32_t infiniteLightCount = 0;
+    uint32_t environmentLightCount = 0;
+    dm::uint2 staticLightRange = 0u;
+    bool clearLocalLightPdf = false;
+};
+
+// Builds the packet of a frame on a worker thread while the calling thread records other work, and hands it over
+// at Wait. There are two packets: the one being built and the one returned by the last Wait, which stays valid
+// until the next Wait. The build function must not touch what the caller changes between Begin and Wait.
+class FramePacketBuilder
+{
+public:
+    typedef std::function<void(FramePacket&)> BuildFunction;
+
+    struct Statistics
+    {
+        double buildTime = 0.0; // ms spent in the build function on the last frame
+        double waitTime = 0.0;  // ms that the last Wait blocked for
+    };
+
+    // Without the worker thread, Begin builds the packet on the calling thread
+    explicit FramePacketBuilder(bool useWorkerThread);
+    ~FramePacketBuilder();
+
+    // Starts building the packet of a frame, Wait must be called before the next Begin
+    void Begin(uint32_t frameIndex, BuildFunction build);
+
+    // Returns the packet started by the last Begin once it is built
+    const FramePacket& Wait();
+
+    [[nodiscard]] bool UsesWorkerThread() const { return m_Thread.joinable(); }
+    [[nodiscard]] const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+    FramePacket m_Packets[2];
+    uint32_t m_BuildIndex = 0;
+    bool m_Started = false;
+
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkDone;
+    BuildFunction m_Build;
+    bool m_Building = false;
+    bool m_Terminate = false;
+    double m_BuildTime = 0.0;
+
+    Statistics m_Statistics;
+
+    void WorkerThread();
+    void Build(const BuildFunction& build);
+};
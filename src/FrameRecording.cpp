@@ -0,0 +1,262 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameRecording.h"
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+// File layout, all values little-endian:
+//   uint32 magic, uint32 version, string sceneName, uint64 uiLayout, uint32 frameCount, frames...
+// Frame:
+//   float elapsedTime, int32 benchmarkFrame, float3 cameraPosition, float3 cameraDirection, float3 cameraUp,
+//   uint16 fieldChangeCount, { uint16 fieldId, uint16 size, bytes }...
+//   uint16 lightChangeCount, { uint32 lightIndex, double3 translation, double4 rotation, double3 scaling, string parameters }...
+// Strings are stored as uint32 length followed by the characters.
+
+// Smallest encoded sizes, used to reject counts that cannot fit in the data before allocating for them
+constexpr size_t c_MinFrameSize = sizeof(float) + sizeof(int32_t) + sizeof(dm::float3) * 3 + sizeof(uint16_t) * 2;
+constexpr size_t c_MinFieldChangeSize = sizeof(uint16_t) * 2;
+constexpr size_t c_MinLightChangeSize = sizeof(uint32_t) + sizeof(dm::double3) * 2 + sizeof(dm::double4) + sizeof(uint32_t);
+
+namespace
+{
+    class Writer
+    {
+    public:
+        explicit Writer(std::vector<uint8_t>& output) : m_Output(output) { }
+
+        template<typename T>
+        void Write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            WriteBytes(&value, sizeof(T));
+        }
+
+        void WriteBytes(const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            m_Output.insert(m_Output.end(), bytes, bytes + size);
+        }
+
+        void WriteString(const std::string& s)
+        {
+            Write(uint32_t(s.size()));
+            WriteBytes(s.data(), s.size());
+        }
+
+    private:
+        std::vector<uint8_t>& m_Output;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : m_Data(data), m_Size(size) { }
+
+        template<typename T>
+        bool Read(T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return ReadBytes(&value, sizeof(T));
+        }
+
+        bool ReadBytes(void* data, size_t size)
+        {
+            if (size > m_Size - m_Offset)
+                return false;
+
+            memcpy(data, m_Data + m_Offset, size);
+            m_Offset += size;
+            return true;
+        }
+
+        bool ReadString(std::string& s)
+        {
+            uint32_t length;
+            if (!Read(length) || length > m_Size - m_Offset)
+                return false;
+
+            s.assign(reinterpret_cast<const char*>(m_Data + m_Offset), length);
+            m_Offset += length;
+            return true;
+        }
+
+        bool AtEnd() const { return m_Offset == m_Size; }
+        size_t Remaining() const { return m_Size - m_Offset; }
+
+    private:
+        const uint8_t* m_Data;
+        size_t m_Size;
+        size_t m_Offset = 0;
+    };
+}
+
+void SerializeFrameRecording(const FrameRecording& recording, std::vector<uint8_t>& output)
+{
+    output.clear();
+    Writer writer(output);
+
+    writer.Write(c_FrameRecordingMagic);
+    writer.Write(c_FrameRecordingVersion);
+    writer.WriteString(recording.sceneName);
+    writer.Write(recording.uiLayout);
+    writer.Write(uint32_t(recording.frames.size()));
+
+    for (const RecordedFrame& frame : recording.frames)
+    {
+        writer.Write(frame.elapsedTime);
+        writer.Write(frame.benchmarkFrame);
+        writer.Write(frame.cameraPosition);
+        writer.Write(frame.cameraDirection);
+        writer.Write(frame.cameraUp);
+
+        writer.Write(uint16_t(frame.fieldChanges.size()));
+        for (const RecordedFieldChange& change : frame.fieldChanges)
+        {
+            writer.Write(change.fieldId);
+            writer.Write(uint16_t(change.data.size()));
+            writer.WriteBytes(change.data.data(), change.data.size());
+        }
+
+        writer.Write(uint16_t(frame.lightChanges.size()));
+        for (const RecordedLightChange& change : frame.lightChanges)
+        {
+            writer.Write(change.lightIndex);
+            writer.Write(change.translation);
+            writer.Write(dm::double4(change.rotation.x, change.rotation.y, change.rotation.z, change.rotation.w));
+            writer.Write(change.scaling);
+            writer.WriteString(change.parameters);
+        }
+    }
+}
+
+bool DeserializeFrameRecording(const uint8_t* data, size_t size, FrameRecording& recording, std::string& error)
+{
+    Reader reader(data, size);
+    recording = FrameRecording();
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!reader.Read(magic) || magic != c_FrameRecordingMagic)
+    {
+        error = "not a frame recording file";
+        return false;
+    }
+
+    if (!reader.Read(version) || version != c_FrameRecordingVersion)
+    {
+        error = "unsupported frame recording version " + std::to_string(version);
+        return false;
+    }
+
+    uint32_t frameCount = 0;
+    if (!reader.ReadString(recording.sceneName) || !reader.Read(recording.uiLayout) || !reader.Read(frameCount))
+    {
+        error = "truncated header";
+        return false;
+    }
+
+    if (uint64_t(frameCount) * c_MinFrameSize > reader.Remaining())
+    {
+        error = std::to_string(frameCount) + " frames do not fit in the file";
+        return false;
+    }
+
+    recording.frames.resize(frameCount);
+
+    for (uint32_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        RecordedFrame& frame = recording.frames[frameIndex];
+        bool valid = reader.Read(frame.elapsedTime)
+            && reader.Read(frame.benchmarkFrame)
+            && reader.Read(frame.cameraPosition)
+            && reader.Read(frame.cameraDirection)
+            && reader.Read(frame.cameraUp);
+
+        uint16_t fieldChangeCount = 0;
+        valid = valid && reader.Read(fieldChangeCount) && fieldChangeCount * c_MinFieldChangeSize <= reader.Remaining();
+        frame.fieldChanges.resize(valid ? fieldChangeCount : 0);
+        for (RecordedFieldChange& change : frame.fieldChanges)
+        {
+            uint16_t dataSize = 0;
+            valid = valid && reader.Read(change.fieldId) && reader.Read(dataSize);
+            if (valid)
+            {
+                change.data.resize(dataSize);
+                valid = reader.ReadBytes(change.data.data(), dataSize);
+            }
+        }
+
+        uint16_t lightChangeCount = 0;
+        valid = valid && reader.Read(lightChangeCount) && lightChangeCount * c_MinLightChangeSize <= reader.Remaining();
+        frame.lightChanges.resize(valid ? lightChangeCount : 0);
+        for (RecordedLightChange& change : frame.lightChanges)
+        {
+            dm::double4 rotation;
+            valid = valid
+                && reader.Read(change.lightIndex)
+                && reader.Read(change.translation)
+                && reader.Read(rotation)
+                && reader.Read(change.scaling)
+                && reader.ReadString(change.parameters);
+            change.rotation = dm::dquat(rotation.w, rotation.x, rotation.y, rotation.z);
+        }
+
+        if (!valid)
+        {
+            error = "truncated data in frame " + std::to_string(frameIndex);
+            return false;
+        }
+    }
+
+    if (!reader.AtEnd())
+    {
+        error = "unexpected data after the last frame";
+        return false;
+    }
+
+    return true;
+}
+
+bool SaveFrameRecording(const std::filesystem::path& fileName, const FrameRecording& recording)
+{
+    std::vector<uint8_t> data;
+    SerializeFrameRecording(recording, data);
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    return file.good();
+}
+
+bool LoadFrameRecording(const std::filesystem::path& fileName, FrameRecording& recording, std::string& error)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        error = "cannot open the file";
+        return false;
+    }
+
+    std::vector<uint8_t> data(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+    if (!file.good())
+    {
+        error = "cannot read the file";
+        return false;
+    }
+
+    return DeserializeFrameRecording(data.data(), data.size(), recording, error);
+}
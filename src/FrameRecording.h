@@ -0,0 +1,64 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Binary log of per-frame application inputs, used to replay interactive sessions deterministically.
+// The format is versioned, readers reject files with a different version.
+
+constexpr uint32_t c_FrameRecordingMagic = 0x52584452; // 'RDXR'
+constexpr uint32_t c_FrameRecordingVersion = 2;
+
+// New value of one UIData field, identified by a stable field ID (see InputRecorder.cpp)
+struct RecordedFieldChange
+{
+    uint16_t fieldId = 0;
+    std::vector<uint8_t> data;
+};
+
+struct RecordedLightChange
+{
+    uint32_t lightIndex = 0;
+    dm::double3 translation = 0.0;
+    dm::dquat rotation = dm::dquat::identity();
+    dm::double3 scaling = 1.0;
+    std::string parameters; // JSON produced by Light::Store
+};
+
+struct RecordedFrame
+{
+    float elapsedTime = 0.f;
+    int32_t benchmarkFrame = -1;
+    dm::float3 cameraPosition = 0.f;
+    dm::float3 cameraDirection = dm::float3(0.f, 0.f, 1.f);
+    dm::float3 cameraUp = dm::float3(0.f, 1.f, 0.f);
+    std::vector<RecordedFieldChange> fieldChanges;
+    std::vector<RecordedLightChange> lightChanges;
+};
+
+struct FrameRecording
+{
+    std::string sceneName;
+    uint64_t uiLayout = 0; // layout signature of the recorded UIData fields, see InputRecorder.cpp
+    std::vector<RecordedFrame> frames;
+};
+
+void SerializeFrameRecording(const FrameRecording& recording, std::vector<uint8_t>& output);
+bool DeserializeFrameRecording(const uint8_t* data, size_t size, FrameRecording& recording, std::string& error);
+
+bool SaveFrameRecording(const std::filesystem::path& fileName, const FrameRecording& recording);
+bool LoadFrameRecording(const std::filesystem::path& fileName, FrameRecording& recording, std::string& error);
@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "HalfFloat.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+float Fp16ToFp32(uint32_t value)
+{
+    const uint32_t sign = (value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    float result;
+    if (exponent == 0)
+        result = ldexpf(float(mantissa), -24);
+    else if (exponent == 31)
+        result = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+    else
+        result = ldexpf(float(mantissa | 0x400), int(exponent) - 25);
+
+    return sign ? -result : result;
+}
+
+uint16_t Fp32ToFp16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff)
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    const int halfExponent = int(exponent) - 127 + 15;
+    if (halfExponent >= 31)
+        return uint16_t(sign | 0x7c00);
+
+    if (halfExponent <= 0)
+    {
+        // Denormal or zero: shift the mantissa with the implicit one into place
+        if (halfExponent < -10)
+            return uint16_t(sign);
+
+        mantissa |= 0x800000;
+        const uint32_t shift = uint32_t(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return uint16_t(sign | half);
+    }
+
+    uint32_t half = (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++; // may carry into the exponent, up to infinity, which is correct
+
+    return uint16_t(sign | half);
+}
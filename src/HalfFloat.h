@@ -0,0 +1,17 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// IEEE half-precision conversions for reading back and writing FP16 textures on the CPU
+float Fp16ToFp32(uint32_t value);
+uint16_t Fp32ToFp16(float value); // round to nearest even, overflows to infinity
@@ -0,0 +1,123 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "IesProfileRegistry.h"
+#include "SampleScene.h"
+
+#include <donut/engine/IesProfile.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+
+#include <chrono>
+
+using namespace donut;
+using namespace std::chrono;
+
+IesProfileRegistry::IesProfileRegistry(engine::IesProfileLoader& loader)
+    : m_Loader(loader)
+{
+}
+
+void IesProfileRegistry::LoadProfiles(vfs::IFileSystem& fs, const std::string& folder)
+{
+    std::vector<std::string> profileNames;
+    fs.enumerateFiles(folder, { ".ies" }, vfs::enumerate_to_vector(profileNames));
+
+    for (const std::string& profileName : profileNames)
+    {
+        auto profile = m_Loader.LoadIesProfile(fs, folder + "/" + profileName);
+
+        if (profile)
+        {
+            m_ProfileIndices[profile->name] = uint32_t(m_Profiles.size());
+            m_Profiles.push_back(profile);
+        }
+    }
+}
+
+std::shared_ptr<engine::IesProfile> IesProfileRegistry::FindProfile(const std::string& name) const
+{
+    auto it = m_ProfileIndices.find(name);
+    return (it != m_ProfileIndices.end()) ? m_Profiles[it->second] : nullptr;
+}
+
+int IesProfileRegistry::BakeProfile(const std::string& name, nvrhi::ICommandList* commandList, uint32_t& bakedCount)
+{
+    const std::shared_ptr<engine::IesProfile> profile = FindProfile(name);
+    if (!profile)
+        return -1;
+
+    // Baking is a no-op for profiles that already have a texture
+    if (!profile->texture)
+    {
+        m_Loader.BakeIesProfile(*profile, commandList);
+        ++bakedCount;
+    }
+
+    return profile->textureIndex;
+}
+
+void IesProfileRegistry::AssignProfiles(const engine::SceneGraph& sceneGraph, nvrhi::ICommandList* commandList)
+{
+    const auto start = steady_clock::now();
+    uint32_t assignedCount = 0;
+    uint32_t missingCount = 0;
+    uint32_t bakedCount = 0;
+
+    // All referenced profiles are baked into the same command list, so there are no first-use bakes during rendering
+    for (const auto& light : sceneGraph.GetLights())
+    {
+        if (light->GetLightType() != LightType_Spot)
+            continue;
+
+        SpotLightWithProfile& spotLight = static_cast<SpotLightWithProfile&>(*light);
+
+        spotLight.profileTextureIndex = spotLight.profileName.empty()
+            ? -1
+            : BakeProfile(spotLight.profileName, commandList, bakedCount);
+
+        if (spotLight.profileTextureIndex >= 0)
+            ++assignedCount;
+        else if (!spotLight.profileName.empty())
+            ++missingCount;
+    }
+
+    m_ChangedLights.clear();
+
+    if (missingCount)
+        log::warning("%u spot lights use IES profiles that were not found", missingCount);
+
+    log::info("Assigned IES profiles to %u spot lights, baked %u profiles in %.2f ms", assignedCount, bakedCount,
+        duration<double, std::milli>(steady_clock::now() - start).count());
+}
+
+void IesProfileRegistry::MarkChanged(const std::shared_ptr<SpotLightWithProfile>& light)
+{
+    m_ChangedLights.push_back(light);
+}
+
+void IesProfileRegistry::UpdateChangedLights(nvrhi::ICommandList* commandList)
+{
+    uint32_t bakedCount = 0;
+
+    for (const std::weak_ptr<SpotLightWithProfile>& weakLight : m_ChangedLights)
+    {
+        const std::shared_ptr<SpotLightWithProfile> light = weakLight.lock();
+        if (!light)
+            continue;
+
+        light->profileTextureIndex = light->profileName.empty()
+            ? -1
+            : BakeProfile(light->profileName, commandList, bakedCount);
+    }
+
+    m_ChangedLights.clear();
+}
@@ -0,0 +1,66 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace donut::engine
+{
+    struct IesProfile;
+    class IesProfileLoader;
+    class SceneGraph;
+}
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+class SpotLightWithProfile;
+
+// The IES profiles found in the assets folder, with a name lookup. Spot lights keep the bindless texture index
+// of their profile in SpotLightWithProfile::profileTextureIndex, which is resolved once when the scene is loaded,
+// and again only for the lights whose profile is changed later.
+class IesProfileRegistry
+{
+private:
+    donut::engine::IesProfileLoader& m_Loader;
+    std::vector<std::shared_ptr<donut::engine::IesProfile>> m_Profiles;
+    std::unordered_map<std::string, uint32_t> m_ProfileIndices;
+    std::vector<std::weak_ptr<SpotLightWithProfile>> m_ChangedLights;
+
+    // Returns the bindless texture index of a profile, or -1 if there is no profile with that name
+    int BakeProfile(const std::string& name, nvrhi::ICommandList* commandList, uint32_t& bakedCount);
+
+public:
+    explicit IesProfileRegistry(donut::engine::IesProfileLoader& loader);
+
+    void LoadProfiles(donut::vfs::IFileSystem& fs, const std::string& folder);
+
+    [[nodiscard]] const std::vector<std::shared_ptr<donut::engine::IesProfile>>& GetProfiles() const { return m_Profiles; }
+
+    // Returns nullptr if there is no profile with that name
+    [[nodiscard]] std::shared_ptr<donut::engine::IesProfile> FindProfile(const std::string& name) const;
+
+    // Resolves the profiles of all spot lights in the scene and bakes the ones that are referenced
+    void AssignProfiles(const donut::engine::SceneGraph& sceneGraph, nvrhi::ICommandList* commandList);
+
+    // Call after changing the profile name of a light, it is resolved by the next UpdateChangedLights
+    void MarkChanged(const std::shared_ptr<SpotLightWithProfile>& light);
+
+    // Resolves the profiles of the lights marked since the last call, baking them if needed
+    void UpdateChangedLights(nvrhi::ICommandList* commandList);
+};
@@ -0,0 +1,501 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ImageDiff.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+using namespace donut::math;
+
+bool WritePfm(const std::filesystem::path& fileName, uint32_t width, uint32_t height, const float3* pixels)
+{
+    FILE* file = fopen(fileName.string().c_str(), "wb");
+    if (!file)
+        return false;
+
+    // Little-endian PFM, rows are stored bottom to top
+    fprintf(file, "PF\n%u %u\n-1.0\n", width, height);
+
+    bool success = true;
+    for (uint32_t row = 0; row < height && success; row++)
+    {
+        const float3* rowData = pixels + size_t(height - 1 - row) * width;
+        success = fwrite(rowData, sizeof(float3), width, file) == width;
+    }
+
+    fclose(file);
+    return success;
+}
+
+bool ReadPfm(const std::filesystem::path& fileName, FloatImage& image)
+{
+    FILE* file = fopen(fileName.string().c_str(), "rb");
+    if (!file)
+        return false;
+
+    char magic[3] = {};
+    int width = 0;
+    int height = 0;
+    float scale = 0.f;
+    if (fscanf(file, "%2s %d %d %f", magic, &width, &height, &scale) != 4 || width <= 0 || height <= 0 || fgetc(file) == EOF)
+    {
+        fclose(file);
+        return false;
+    }
+
+    const bool color = strcmp(magic, "PF") == 0;
+    if (!color && strcmp(magic, "Pf") != 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    const uint32_t channels = color ? 3 : 1;
+    std::vector<float> data(size_t(width) * height * channels);
+    const bool success = fread(data.data(), sizeof(float), data.size(), file) == data.size();
+    fclose(file);
+
+    if (!success)
+        return false;
+
+    // A positive scale means big-endian data
+    if (scale > 0.f)
+    {
+        for (float& value : data)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+            memcpy(&value, &bits, sizeof(bits));
+        }
+    }
+
+    image.width = uint32_t(width);
+    image.height = uint32_t(height);
+    image.pixels.resize(size_t(width) * height);
+
+    for (uint32_t row = 0; row < image.height; row++)
+    {
+        const float* source = &data[size_t(image.height - 1 - row) * width * channels];
+        float3* destination = &image.pixels[size_t(row) * width];
+        for (uint32_t x = 0; x < image.width; x++)
+        {
+            destination[x] = color
+                ? float3(source[x * 3 + 0], source[x * 3 + 1], source[x * 3 + 2])
+                : float3(source[x]);
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+    constexpr float c_Pi = 3.14159265358979f;
+
+    // FLIP constants
+    constexpr float c_Qc = 0.7f;
+    constexpr float c_Qf = 0.5f;
+    constexpr float c_Pc = 0.4f;
+    constexpr float c_Pt = 0.95f;
+    constexpr float c_Gw = 0.082f;
+
+    // Sum of two Gaussians in the spatial domain per YyCxCz channel: a1, b1, a2, b2
+    constexpr float c_CsfParameters[3][4] = {
+        { 1.f, 0.0047f, 0.f, 1e-5f },
+        { 1.f, 0.0053f, 0.f, 1e-5f },
+        { 34.1f, 0.04f, 13.5f, 0.025f }
+    };
+
+    // D65 reference white of linear sRGB
+    const float3 c_WhitePoint = float3(0.950428545f, 1.f, 1.088900371f);
+
+    class RowScheduler
+    {
+    public:
+        explicit RowScheduler(uint32_t threadCount)
+            : m_ThreadCount(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+        { }
+
+        // Runs the function over bands of rows on all threads
+        void Run(uint32_t height, const std::function<void(uint32_t y0, uint32_t y1)>& function) const
+        {
+            constexpr uint32_t bandHeight = 16;
+            const uint32_t bandCount = (height + bandHeight - 1) / bandHeight;
+            std::atomic<uint32_t> nextBand = 0;
+
+            auto worker = [&]()
+            {
+                for (uint32_t band = nextBand++; band < bandCount; band = nextBand++)
+                    function(band * bandHeight, std::min(height, (band + 1) * bandHeight));
+            };
+
+            std::vector<std::thread> threads;
+            for (uint32_t i = 1; i < std::min(m_ThreadCount, bandCount); i++)
+                threads.emplace_back(worker);
+
+            worker();
+
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+
+    private:
+        uint32_t m_ThreadCount;
+    };
+
+    typedef std::vector<float> Plane;
+
+    // Convolution with a separable kernel, clamping at the image borders
+    void convolve(const Plane& source, Plane& destination, Plane& temp, uint32_t width, uint32_t height,
+        const std::vector<float>& kernelX, const std::vector<float>& kernelY, const RowScheduler& scheduler)
+    {
+        const int radiusX = int(kernelX.size() / 2);
+        const int radiusY = int(kernelY.size() / 2);
+
+        scheduler.Run(height, [&](uint32_t y0, uint32_t y1)
+        {
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                for (int x = 0; x < int(width); x++)
+                {
+                    float sum = 0.f;
+                    for (int k = -radiusX; k <= radiusX; k++)
+                        sum += kernelX[k + radiusX] * source[size_t(y) * width + std::clamp(x + k, 0, int(width) - 1)];
+                    temp[size_t(y) * width + x] = sum;
+                }
+            }
+        });
+
+        scheduler.Run(height, [&](uint32_t y0, uint32_t y1)
+        {
+            for (int y = int(y0); y < int(y1); y++)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    float sum = 0.f;
+                    for (int k = -radiusY; k <= radiusY; k++)
+                        sum += kernelY[k + radiusY] * temp[size_t(std::clamp(y + k, 0, int(height) - 1)) * width + x];
+                    destination[size_t(y) * width + x] = sum;
+                }
+            }
+        });
+    }
+
+    std::vector<float> gaussianKernel(float b, float pixelsPerDegree)
+    {
+        const int radius = std::max(1, int(std::ceil(3.f * std::sqrt(b / (2.f * c_Pi * c_Pi)) * pixelsPerDegree)));
+        std::vector<float> kernel(2 * radius + 1);
+        float sum = 0.f;
+        for (int i = -radius; i <= radius; i++)
+        {
+            const float x = float(i) / pixelsPerDegree;
+            kernel[i + radius] = std::exp(-c_Pi * c_Pi * x * x / b);
+            sum += kernel[i + radius];
+        }
+        for (float& weight : kernel)
+            weight /= sum;
+        return kernel;
+    }
+
+    // 2D weight of one CSF Gaussian relative to the other, given unnormalized 1D kernels
+    float gaussianWeight(float a, float b, float pixelsPerDegree)
+    {
+        const int radius = std::max(1, int(std::ceil(3.f * std::sqrt(b / (2.f * c_Pi * c_Pi)) * pixelsPerDegree)));
+        float sum = 0.f;
+        for (int i = -radius; i <= radius; i++)
+        {
+            const float x = float(i) / pixelsPerDegree;
+            sum += std::exp(-c_Pi * c_Pi * x * x / b);
+        }
+        return a * std::sqrt(c_Pi / b) * sum * sum;
+    }
+
+    float3 linearRgbToXyz(const float3& c)
+    {
+        return float3(
+            0.4124564f * c.x + 0.3575761f * c.y + 0.1804375f * c.z,
+            0.2126729f * c.x + 0.7151522f * c.y + 0.0721750f * c.z,
+            0.0193339f * c.x + 0.1191920f * c.y + 0.9503041f * c.z);
+    }
+
+    float3 xyzToLinearRgb(const float3& c)
+    {
+        return float3(
+            3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+            -0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+            0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z);
+    }
+
+    float3 xyzToYCxCz(const float3& c)
+    {
+        const float3 n = c / c_WhitePoint;
+        return float3(116.f * n.y - 16.f, 500.f * (n.x - n.y), 200.f * (n.y - n.z));
+    }
+
+    float3 yCxCzToXyz(const float3& c)
+    {
+        const float y = (c.x + 16.f) / 116.f;
+        return float3(c.y / 500.f + y, y, y - c.z / 200.f) * c_WhitePoint;
+    }
+
+    float3 xyzToHuntLab(const float3& c)
+    {
+        auto f = [](float t)
+        {
+            constexpr float delta = 6.f / 29.f;
+            return t > delta * delta * delta ? std::cbrt(t) : t / (3.f * delta * delta) + 4.f / 29.f;
+        };
+
+        const float3 n = c / c_WhitePoint;
+        const float l = 116.f * f(n.y) - 16.f;
+        const float a = 500.f * (f(n.x) - f(n.y));
+        const float b = 200.f * (f(n.y) - f(n.z));
+
+        // Hunt adjustment
+        return float3(l, 0.01f * l * a, 0.01f * l * b);
+    }
+
+    float hyab(const float3& a, const float3& b)
+    {
+        const float3 d = a - b;
+        return std::abs(d.x) + std::sqrt(d.y * d.y + d.z * d.z);
+    }
+
+    float3 toneMap(const float3& c, float exposure)
+    {
+        const float3 e = max(c * exposure, float3(0.f));
+        return e / (e + 1.f);
+    }
+
+    // Tone mapped color in YyCxCz after the CSF filter, and the luminance for the feature detection
+    struct FilteredImage
+    {
+        Plane channels[3];
+        Plane luminance;
+    };
+
+    FilteredImage filterImage(const FloatImage& image, const ImageDiffSettings& settings, const RowScheduler& scheduler)
+    {
+        const size_t pixelCount = image.pixels.size();
+
+        FilteredImage result;
+        Plane unfiltered[3];
+        for (Plane& plane : unfiltered)
+            plane.resize(pixelCount);
+        result.luminance.resize(pixelCount);
+
+        scheduler.Run(image.height, [&](uint32_t y0, uint32_t y1)
+        {
+            for (size_t i = size_t(y0) * image.width; i < size_t(y1) * image.width; i++)
+            {
+                const float3 xyz = linearRgbToXyz(toneMap(image.pixels[i], settings.exposure));
+                const float3 ycxcz = xyzToYCxCz(xyz);
+                unfiltered[0][i] = ycxcz.x;
+                unfiltered[1][i] = ycxcz.y;
+                unfiltered[2][i] = ycxcz.z;
+                result.luminance[i] = xyz.y;
+            }
+        });
+
+        Plane temp(pixelCount);
+        Plane term(pixelCount);
+        for (int channel = 0; channel < 3; channel++)
+        {
+            const float* csf = c_CsfParameters[channel];
+            const std::vector<float> kernel1 = gaussianKernel(csf[1], settings.pixelsPerDegree);
+            result.channels[channel].resize(pixelCount);
+            convolve(unfiltered[channel], result.channels[channel], temp, image.width, image.height, kernel1, kernel1, scheduler);
+
+            if (csf[2] > 0.f)
+            {
+                const std::vector<float> kernel2 = gaussianKernel(csf[3], settings.pixelsPerDegree);
+                convolve(unfiltered[channel], term, temp, image.width, image.height, kernel2, kernel2, scheduler);
+
+                const float weight1 = gaussianWeight(csf[0], csf[1], settings.pixelsPerDegree);
+                const float weight2 = gaussianWeight(csf[2], csf[3], settings.pixelsPerDegree);
+                const float blend = weight2 / (weight1 + weight2);
+                for (size_t i = 0; i < pixelCount; i++)
+                    result.channels[channel][i] = lerp(result.channels[channel][i], term[i], blend);
+            }
+        }
+
+        return result;
+    }
+
+    // Edge and point detection kernels on the achromatic channel, as separable pairs along x
+    void featureKernels(float pixelsPerDegree, std::vector<float>& gaussian, std::vector<float>& edge, std::vector<float>& point)
+    {
+        const float sigma = 0.5f * c_Gw * pixelsPerDegree;
+        const int radius = int(std::ceil(3.f * sigma));
+        gaussian.resize(2 * radius + 1);
+        edge.resize(2 * radius + 1);
+        point.resize(2 * radius + 1);
+
+        float gaussianSum = 0.f, edgePositive = 0.f, pointPositive = 0.f, pointNegative = 0.f;
+        for (int i = -radius; i <= radius; i++)
+        {
+            const float x = float(i);
+            const float g = std::exp(-x * x / (2.f * sigma * sigma));
+            gaussian[i + radius] = g;
+            edge[i + radius] = -x * g;
+            point[i + radius] = (x * x / (sigma * sigma) - 1.f) * g;
+
+            gaussianSum += g;
+            edgePositive += std::max(edge[i + radius], 0.f);
+            pointPositive += std::max(point[i + radius], 0.f);
+            pointNegative -= std::min(point[i + radius], 0.f);
+        }
+
+        for (size_t i = 0; i < gaussian.size(); i++)
+        {
+            gaussian[i] /= gaussianSum;
+            edge[i] /= edgePositive;
+            point[i] /= point[i] > 0.f ? pointPositive : pointNegative;
+        }
+    }
+
+    void detectFeatures(const Plane& luminance, uint32_t width, uint32_t height, float pixelsPerDegree,
+        Plane& edges, Plane& points, const RowScheduler& scheduler)
+    {
+        std::vector<float> gaussian, edge, point;
+        featureKernels(pixelsPerDegree, gaussian, edge, point);
+
+        const size_t pixelCount = luminance.size();
+        Plane temp(pixelCount), gradientX(pixelCount), gradientY(pixelCount);
+        edges.resize(pixelCount);
+        points.resize(pixelCount);
+
+        convolve(luminance, gradientX, temp, width, height, edge, gaussian, scheduler);
+        convolve(luminance, gradientY, temp, width, height, gaussian, edge, scheduler);
+        for (size_t i = 0; i < pixelCount; i++)
+            edges[i] = std::sqrt(gradientX[i] * gradientX[i] + gradientY[i] * gradientY[i]);
+
+        convolve(luminance, gradientX, temp, width, height, point, gaussian, scheduler);
+        convolve(luminance, gradientY, temp, width, height, gaussian, point, scheduler);
+        for (size_t i = 0; i < pixelCount; i++)
+            points[i] = std::sqrt(gradientX[i] * gradientX[i] + gradientY[i] * gradientY[i]);
+    }
+}
+
+ImageDiffMetrics CompareImages(const FloatImage& test, const FloatImage& reference, const ImageDiffSettings& settings)
+{
+    ImageDiffMetrics metrics;
+    if (test.width != reference.width || test.height != reference.height || test.IsEmpty())
+        return metrics;
+
+    const RowScheduler scheduler(settings.threadCount);
+    const uint32_t width = reference.width;
+    const uint32_t height = reference.height;
+
+    const FilteredImage filteredTest = filterImage(test, settings, scheduler);
+    const FilteredImage filteredReference = filterImage(reference, settings, scheduler);
+
+    Plane testEdges, testPoints, referenceEdges, referencePoints;
+    detectFeatures(filteredTest.luminance, width, height, settings.pixelsPerDegree, testEdges, testPoints, scheduler);
+    detectFeatures(filteredReference.luminance, width, height, settings.pixelsPerDegree, referenceEdges, referencePoints, scheduler);
+
+    const float maxColorDifference = std::pow(hyab(
+        xyzToHuntLab(linearRgbToXyz(float3(0.f, 1.f, 0.f))),
+        xyzToHuntLab(linearRgbToXyz(float3(0.f, 0.f, 1.f)))), c_Qc);
+
+    struct BandSums
+    {
+        double squaredError = 0.0;
+        double relativeSquaredError = 0.0;
+        double flip = 0.0;
+        double maxFlip = 0.0;
+    };
+
+    const uint32_t bandCount = (height + 15) / 16;
+    std::vector<BandSums> bands(bandCount);
+
+    scheduler.Run(height, [&](uint32_t y0, uint32_t y1)
+    {
+        BandSums& sums = bands[y0 / 16];
+        for (size_t i = size_t(y0) * width; i < size_t(y1) * width; i++)
+        {
+            const float3 hdrTest = test.pixels[i];
+            const float3 hdrReference = reference.pixels[i];
+            const float3 hdrDifference = hdrTest - hdrReference;
+            sums.relativeSquaredError += dot(hdrDifference * hdrDifference, 1.f / (hdrReference * hdrReference + 0.01f)) / 3.0;
+
+            const float3 ldrDifference = toneMap(hdrTest, settings.exposure) - toneMap(hdrReference, settings.exposure);
+            sums.squaredError += dot(ldrDifference, ldrDifference) / 3.0;
+
+            auto filteredColor = [i](const FilteredImage& image)
+            {
+                const float3 ycxcz = float3(image.channels[0][i], image.channels[1][i], image.channels[2][i]);
+                const float3 rgb = saturate(xyzToLinearRgb(yCxCzToXyz(ycxcz)));
+                return xyzToHuntLab(linearRgbToXyz(rgb));
+            };
+
+            float colorDifference = std::pow(hyab(filteredColor(filteredTest), filteredColor(filteredReference)), c_Qc);
+            if (colorDifference < c_Pc * maxColorDifference)
+                colorDifference *= c_Pt / (c_Pc * maxColorDifference);
+            else
+                colorDifference = c_Pt + (colorDifference - c_Pc * maxColorDifference) / (maxColorDifference - c_Pc * maxColorDifference) * (1.f - c_Pt);
+
+            const float featureDifference = std::pow(std::max(
+                std::abs(testEdges[i] - referenceEdges[i]),
+                std::abs(testPoints[i] - referencePoints[i])) / std::sqrt(2.f), c_Qf);
+
+            const double flip = std::pow(colorDifference, 1.f - featureDifference);
+            sums.flip += flip;
+            sums.maxFlip = std::max(sums.maxFlip, flip);
+        }
+    });
+
+    BandSums total;
+    for (const BandSums& band : bands)
+    {
+        total.squaredError += band.squaredError;
+        total.relativeSquaredError += band.relativeSquaredError;
+        total.flip += band.flip;
+        total.maxFlip = std::max(total.maxFlip, band.maxFlip);
+    }
+
+    const double pixelCount = double(width) * double(height);
+    const double mse = total.squaredError / pixelCount;
+    metrics.psnr = mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : INFINITY;
+    metrics.relativeMse = total.relativeSquaredError / pixelCount;
+    metrics.meanFlip = total.flip / pixelCount;
+    metrics.maxFlip = total.maxFlip;
+
+    return metrics;
+}
+
+std::string FormatImageDiffMetrics(const std::vector<std::pair<std::string, ImageDiffMetrics>>& results)
+{
+    size_t nameWidth = 5;
+    for (const auto& [name, metrics] : results)
+        nameWidth = std::max(nameWidth, name.size());
+
+    std::stringstream ss;
+    char line[512];
+    snprintf(line, sizeof(line), "%-*s %10s %12s %10s %10s\n", int(nameWidth), "Image", "PSNR (dB)", "relMSE", "FLIP mean", "FLIP max");
+    ss << line;
+
+    for (const auto& [name, metrics] : results)
+    {
+        snprintf(line, sizeof(line), "%-*s %10.2f %12.5g %10.4f %10.4f\n", int(nameWidth), name.c_str(),
+            metrics.psnr, metrics.relativeMse, metrics.meanFlip, metrics.maxFlip);
+        ss << line;
+    }
+
+    return ss.str();
+}
@@ -0,0 +1,57 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct FloatImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<dm::float3> pixels; // rows top to bottom
+
+    [[nodiscard]] bool IsEmpty() const { return pixels.empty(); }
+};
+
+// Little-endian 3-channel PFM files, as written by --cpu-reference and --capture-output
+bool WritePfm(const std::filesystem::path& fileName, uint32_t width, uint32_t height, const dm::float3* pixels);
+bool ReadPfm(const std::filesystem::path& fileName, FloatImage& image);
+
+struct ImageDiffSettings
+{
+    // Scale applied to both images before tone mapping them into [0, 1] for PSNR and FLIP
+    float exposure = 1.f;
+
+    // Observer distance used by the FLIP contrast sensitivity filters, 67 corresponds to a 0.7 m
+    // distance from a 24" 4K monitor
+    float pixelsPerDegree = 67.f;
+
+    uint32_t threadCount = 0; // 0 means all cores
+};
+
+struct ImageDiffMetrics
+{
+    double psnr = 0.0; // dB, on the tone mapped images
+    double relativeMse = 0.0; // on the HDR values, mean of (test - reference)^2 / (reference^2 + 0.01)
+    double meanFlip = 0.0; // mean of the per-pixel FLIP error map, in [0, 1]
+    double maxFlip = 0.0;
+};
+
+// Compares two images of the same size. The FLIP metric follows the LDR-FLIP paper (Andersson et al. 2020)
+// applied to Reinhard tone mapped images: CSF filtering in YyCxCz, Hunt-adjusted HyAB color difference,
+// and edge and point feature differences on the achromatic channel.
+ImageDiffMetrics CompareImages(const FloatImage& test, const FloatImage& reference, const ImageDiffSettings& settings);
+
+std::string FormatImageDiffMetrics(const std::vector<std::pair<std::string, ImageDiffMetrics>>& results);
@@ -0,0 +1,377 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "InputRecorder.h"
+#include "SampleScene.h"
+#include "UserInterface.h"
+
+#include <donut/app/Camera.h>
+#include <donut/core/log.h>
+#include <json/reader.h>
+#include <json/writer.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+using namespace donut;
+
+namespace
+{
+    struct RecordedField
+    {
+        uint16_t id;
+        void* data;
+        size_t size;
+        size_t alignment;
+    };
+
+    // Field IDs are part of the file format: never reuse or renumber them, only append new ones.
+    // Only trivially copyable fields that do not hold pointers can be listed here.
+    #define RECORDED_FIELD(id, field) RecordedField{ id, &ui.field, sizeof(ui.field), alignof(decltype(ui.field)) }
+
+    enum : uint16_t
+    {
+        FieldId_EnvironmentMapIndex = 14
+    };
+
+    std::vector<RecordedField> getRecordedFields(UIData& ui)
+    {
+        return {
+            RECORDED_FIELD(1, enableTextures),
+            RECORDED_FIELD(2, framesToAccumulate),
+            RECORDED_FIELD(3, enableToneMapping),
+            RECORDED_FIELD(4, enablePixelJitter),
+            RECORDED_FIELD(5, rasterizeGBuffer),
+            RECORDED_FIELD(6, enableBloom),
+            RECORDED_FIELD(7, exposureBias),
+            RECORDED_FIELD(8, verticalFov),
+            RECORDED_FIELD(9, aaMode),
+            RECORDED_FIELD(10, directLightingMode),
+            RECORDED_FIELD(11, indirectLightingMode),
+            RECORDED_FIELD(12, enableAnimations),
+            RECORDED_FIELD(13, animationSpeed),
+            RECORDED_FIELD(FieldId_EnvironmentMapIndex, environmentMapIndex),
+            RECORDED_FIELD(15, environmentMapImportanceSampling),
+            RECORDED_FIELD(16, environmentIntensityBias),
+            RECORDED_FIELD(17, environmentRotation),
+            RECORDED_FIELD(18, enableDenoiser),
+            RECORDED_FIELD(19, noiseMix),
+            RECORDED_FIELD(20, noiseClampLow),
+            RECORDED_FIELD(21, noiseClampHigh),
+            RECORDED_FIELD(22, resolutionScale),
+            RECORDED_FIELD(23, regirDynamicParameters),
+            RECORDED_FIELD(24, freezeRegirPosition),
+            RECORDED_FIELD(25, visualizationMode),
+            RECORDED_FIELD(26, debugRenderOutputBuffer),
+            RECORDED_FIELD(27, gbufferSettings),
+            RECORDED_FIELD(28, restirDI),
+            RECORDED_FIELD(29, restirGI),
+            RECORDED_FIELD(30, taaParams),
+            RECORDED_FIELD(31, temporalJitter),
+            RECORDED_FIELD(32, lightingSettings.enablePreviousTLAS),
+            RECORDED_FIELD(33, lightingSettings.enableAlphaTestedGeometry),
+            RECORDED_FIELD(34, lightingSettings.enableTransparentGeometry),
+            RECORDED_FIELD(35, lightingSettings.enableRayCounts),
+            RECORDED_FIELD(36, lightingSettings.visualizeRegirCells),
+            RECORDED_FIELD(37, lightingSettings.enableGradients),
+            RECORDED_FIELD(38, lightingSettings.gradientLogDarknessBias),
+            RECORDED_FIELD(39, lightingSettings.gradientSensitivity),
+            RECORDED_FIELD(40, lightingSettings.confidenceHistoryLength),
+            RECORDED_FIELD(41, lightingSettings.reGIRType),
+            RECORDED_FIELD(42, lightingSettings.dirReGIRSampling),
+            RECORDED_FIELD(43, lightingSettings.dirReGIRBrdfUniformProbability),
+            RECORDED_FIELD(44, lightingSettings.bypassDirectionalDirReGIRBuild),
+            RECORDED_FIELD(45, lightingSettings.dirReGIRTileEncoding),
+            RECORDED_FIELD(46, lightingSettings.brdfptParams),
+            RECORDED_FIELD(47, lightingSettings.gsgiParams),
+            RECORDED_FIELD(48, lightingSettings.pmgiParams),
+            RECORDED_FIELD(49, lightingSettings.vlightParams),
+            RECORDED_FIELD(53, lightingSettings.environmentAliasTable),
+            RECORDED_FIELD(54, incrementalLocalLightPdf),
+            RECORDED_FIELD(55, staticLightRegion),
+            RECORDED_FIELD(56, virtualLightUpdateMode),
+            RECORDED_FIELD(57, virtualLightBudget),
+#ifdef WITH_NRD
+            RECORDED_FIELD(50, reblurSettings),
+            RECORDED_FIELD(51, relaxSettings),
+            RECORDED_FIELD(52, denoisingMethod),
+#endif
+        };
+    }
+
+    #undef RECORDED_FIELD
+
+    // The recorded fields are stored as raw bytes, so the members of the recorded structs must be in the same place
+    // when a recording is replayed. The structs of this repository are listed here, the ones of the SDK and NRD
+    // only contribute their size and alignment.
+    #define MEMBER_LAYOUT(type, member) offsetof(type, member), sizeof(type::member)
+
+    const size_t c_RecordedMemberLayouts[] = {
+        MEMBER_LAYOUT(GBufferSettings, roughnessOverride),
+        MEMBER_LAYOUT(GBufferSettings, metalnessOverride),
+        MEMBER_LAYOUT(GBufferSettings, enableRoughnessOverride),
+        MEMBER_LAYOUT(GBufferSettings, enableMetalnessOverride),
+        MEMBER_LAYOUT(GBufferSettings, normalMapScale),
+        MEMBER_LAYOUT(GBufferSettings, enableAlphaTestedGeometry),
+        MEMBER_LAYOUT(GBufferSettings, enableTransparentGeometry),
+        MEMBER_LAYOUT(GBufferSettings, textureLodBias),
+        MEMBER_LAYOUT(GBufferSettings, enableMaterialReadback),
+        MEMBER_LAYOUT(GBufferSettings, materialReadbackPosition),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), numLocalLightUniformSamples),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), numLocalLightPowerRISSamples),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), numLocalLightReGIRRISSamples),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), resamplingMode),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), initialSamplingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), temporalResamplingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), spatialResamplingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirDI), shadingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirGI), resamplingMode),
+        MEMBER_LAYOUT(decltype(UIData::restirGI), temporalResamplingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirGI), spatialResamplingParams),
+        MEMBER_LAYOUT(decltype(UIData::restirGI), finalShadingParams),
+        MEMBER_LAYOUT(BRDFPathTracing_Parameters, enableIndirectEmissiveSurfaces),
+        MEMBER_LAYOUT(BRDFPathTracing_Parameters, enableSecondaryResampling),
+        MEMBER_LAYOUT(BRDFPathTracing_Parameters, enableReSTIRGI),
+        MEMBER_LAYOUT(BRDFPathTracing_Parameters, materialOverrideParams),
+        MEMBER_LAYOUT(BRDFPathTracing_Parameters, secondarySurfaceReSTIRDIParams),
+        MEMBER_LAYOUT(BRDFPathTracing_MaterialOverrideParameters, roughnessOverride),
+        MEMBER_LAYOUT(BRDFPathTracing_MaterialOverrideParameters, metalnessOverride),
+        MEMBER_LAYOUT(BRDFPathTracing_MaterialOverrideParameters, minSecondaryRoughness),
+        MEMBER_LAYOUT(BRDFPathTracing_SecondarySurfaceReSTIRDIParameters, initialSamplingParams),
+        MEMBER_LAYOUT(BRDFPathTracing_SecondarySurfaceReSTIRDIParameters, spatialResamplingParams),
+        MEMBER_LAYOUT(GSGI_Parameters, samplesPerFrame),
+        MEMBER_LAYOUT(GSGI_Parameters, sampleLifespan),
+        MEMBER_LAYOUT(GSGI_Parameters, sampleOriginOffset),
+        MEMBER_LAYOUT(GSGI_Parameters, resamplingMode),
+        MEMBER_LAYOUT(GSGI_Parameters, scalingFactor),
+        MEMBER_LAYOUT(GSGI_Parameters, lightSize),
+        MEMBER_LAYOUT(GSGI_Parameters, clampingDistance),
+        MEMBER_LAYOUT(PMGI_Parameters, samplesPerFrame),
+        MEMBER_LAYOUT(PMGI_Parameters, sampleLifespan),
+        MEMBER_LAYOUT(PMGI_Parameters, scalingFactor),
+        MEMBER_LAYOUT(PMGI_Parameters, lightSize),
+        MEMBER_LAYOUT(PMGI_Parameters, clampingDistance),
+        MEMBER_LAYOUT(PMGI_Parameters, invTotalVirtualLights),
+        MEMBER_LAYOUT(VirtualLight_Parameters, virtualLightContribution),
+        MEMBER_LAYOUT(VirtualLight_Parameters, lockLights),
+        MEMBER_LAYOUT(VirtualLight_Parameters, clampingRatio),
+        MEMBER_LAYOUT(VirtualLight_Parameters, includeInBrdfLightSampling),
+        MEMBER_LAYOUT(VirtualLight_Parameters, totalVirtualLights),
+        MEMBER_LAYOUT(VirtualLight_Parameters, updateStride),
+        MEMBER_LAYOUT(VirtualLight_Parameters, updatePhase),
+    };
+
+    #undef MEMBER_LAYOUT
+
+    // FNV-1a over the ID, size and alignment of every recorded field and the member layouts above.
+    // The recording stores it in its header, and a replay needs the same value.
+    uint64_t getRecordedUILayout(UIData& ui)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto add = [&hash](uint64_t value)
+        {
+            for (uint32_t byte = 0; byte < sizeof(value); byte++)
+            {
+                hash ^= (value >> (byte * 8)) & 0xff;
+                hash *= 0x100000001b3ull;
+            }
+        };
+
+        for (const RecordedField& field : getRecordedFields(ui))
+        {
+            add(field.id);
+            add(field.size);
+            add(field.alignment);
+        }
+
+        for (size_t value : c_RecordedMemberLayouts)
+            add(value);
+
+        return hash;
+    }
+
+    RecordedLightChange getLightState(const engine::Light& light, uint32_t lightIndex)
+    {
+        RecordedLightChange state;
+        state.lightIndex = lightIndex;
+
+        if (const auto* node = light.GetNode())
+        {
+            state.translation = node->GetTranslation();
+            state.rotation = node->GetRotation();
+            state.scaling = node->GetScaling();
+        }
+
+        Json::Value parameters(Json::objectValue);
+        light.Store(parameters);
+
+        Json::StreamWriterBuilder builder;
+        builder.settings_["indentation"] = "";
+        state.parameters = Json::writeString(builder, parameters);
+
+        return state;
+    }
+
+    bool lightStateEqual(const RecordedLightChange& a, const RecordedLightChange& b)
+    {
+        return all(a.translation == b.translation)
+            && a.rotation == b.rotation
+            && all(a.scaling == b.scaling)
+            && a.parameters == b.parameters;
+    }
+}
+
+InputRecorder::InputRecorder(UIData& ui, const std::string& sceneName)
+    : m_ui(ui)
+{
+    m_Recording.sceneName = sceneName;
+    m_Recording.uiLayout = getRecordedUILayout(ui);
+}
+
+void InputRecorder::RecordFrame(float elapsedTime, const app::FirstPersonCamera& camera, SampleScene& scene)
+{
+    RecordedFrame& frame = m_Recording.frames.emplace_back();
+    frame.elapsedTime = elapsedTime;
+    frame.benchmarkFrame = m_ui.animationFrame.value_or(-1);
+    frame.cameraPosition = camera.GetPosition();
+    frame.cameraDirection = camera.GetDir();
+    frame.cameraUp = camera.GetUp();
+
+    // The first frame stores every field, later frames only the ones that changed
+    const std::vector<RecordedField> fields = getRecordedFields(m_ui);
+    const bool firstFrame = m_PreviousFieldValues.empty();
+    m_PreviousFieldValues.resize(fields.size());
+
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        std::vector<uint8_t>& previous = m_PreviousFieldValues[i];
+        const uint8_t* current = static_cast<const uint8_t*>(fields[i].data);
+
+        if (!firstFrame && memcmp(previous.data(), current, fields[i].size) == 0)
+            continue;
+
+        previous.assign(current, current + fields[i].size);
+        frame.fieldChanges.push_back({ fields[i].id, previous });
+    }
+
+    const auto& lights = scene.GetSceneGraph()->GetLights();
+    m_PreviousLightState.resize(lights.size());
+
+    for (uint32_t lightIndex = 0; lightIndex < uint32_t(lights.size()); lightIndex++)
+    {
+        RecordedLightChange state = getLightState(*lights[lightIndex], lightIndex);
+
+        if (!firstFrame && lightStateEqual(state, m_PreviousLightState[lightIndex]))
+            continue;
+
+        m_PreviousLightState[lightIndex] = state;
+        frame.lightChanges.push_back(std::move(state));
+    }
+}
+
+bool InputRecorder::Save(const std::filesystem::path& fileName) const
+{
+    return SaveFrameRecording(fileName, m_Recording);
+}
+
+InputReplayer::InputReplayer(UIData& ui)
+    : m_ui(ui)
+{
+}
+
+bool InputReplayer::Load(const std::filesystem::path& fileName, const std::string& sceneName)
+{
+    std::string error;
+    if (!LoadFrameRecording(fileName, m_Recording, error))
+    {
+        log::error("Failed to load the input recording %s: %s", fileName.string().c_str(), error.c_str());
+        return false;
+    }
+
+    if (m_Recording.uiLayout != getRecordedUILayout(m_ui))
+    {
+        log::error("The input recording %s was made by a build with a different layout of the recorded UI settings",
+            fileName.string().c_str());
+        m_Recording = FrameRecording();
+        return false;
+    }
+
+    if (m_Recording.sceneName != sceneName)
+    {
+        log::warning("The input recording %s was made with a different scene (%s)",
+            fileName.string().c_str(), m_Recording.sceneName.c_str());
+    }
+
+    m_NextFrame = 0;
+    return true;
+}
+
+float InputReplayer::ApplyNextFrame(app::FirstPersonCamera& camera, SampleScene& scene)
+{
+    if (IsFinished())
+        return 0.f;
+
+    const RecordedFrame& frame = m_Recording.frames[m_NextFrame++];
+
+    camera.LookAt(frame.cameraPosition, frame.cameraPosition + frame.cameraDirection, frame.cameraUp);
+
+    if (frame.benchmarkFrame >= 0)
+        m_ui.animationFrame = frame.benchmarkFrame;
+    else
+        m_ui.animationFrame.reset();
+
+    const std::vector<RecordedField> fields = getRecordedFields(m_ui);
+
+    for (const RecordedFieldChange& change : frame.fieldChanges)
+    {
+        auto field = std::find_if(fields.begin(), fields.end(), [&change](const RecordedField& f) { return f.id == change.fieldId; });
+
+        if (field == fields.end() || field->size != change.data.size())
+        {
+            log::warning("Skipping unknown or incompatible recorded UI field %d", change.fieldId);
+            continue;
+        }
+
+        if (memcmp(field->data, change.data.data(), field->size) == 0)
+            continue;
+
+        memcpy(field->data, change.data.data(), field->size);
+        m_ui.resetAccumulation = true;
+
+        if (change.fieldId == FieldId_EnvironmentMapIndex)
+            m_ui.environmentMapDirty = 2;
+    }
+
+    const auto& lights = scene.GetSceneGraph()->GetLights();
+
+    for (const RecordedLightChange& change : frame.lightChanges)
+    {
+        if (change.lightIndex >= lights.size())
+            continue;
+
+        engine::Light& light = *lights[change.lightIndex];
+
+        Json::Value parameters;
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        if (reader->parse(change.parameters.data(), change.parameters.data() + change.parameters.size(), &parameters, nullptr))
+            light.Load(parameters);
+
+        if (auto* node = light.GetNode())
+        {
+            node->SetTranslation(change.translation);
+            node->SetRotation(change.rotation);
+            node->SetScaling(change.scaling);
+        }
+    }
+
+    return frame.elapsedTime;
+}
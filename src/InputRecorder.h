@@ -0,0 +1,62 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "FrameRecording.h"
+
+struct UIData;
+class SampleScene;
+
+namespace donut::app
+{
+    class FirstPersonCamera;
+}
+
+// Captures the camera, the replayable UIData fields, the frame time and the scene light state once per frame.
+// Only the UI fields and lights that changed since the previous frame are stored.
+class InputRecorder
+{
+private:
+    UIData& m_ui;
+    FrameRecording m_Recording;
+    std::vector<std::vector<uint8_t>> m_PreviousFieldValues;
+    std::vector<RecordedLightChange> m_PreviousLightState;
+
+public:
+    InputRecorder(UIData& ui, const std::string& sceneName);
+
+    void RecordFrame(float elapsedTime, const donut::app::FirstPersonCamera& camera, SampleScene& scene);
+    bool Save(const std::filesystem::path& fileName) const;
+
+    [[nodiscard]] size_t GetFrameCount() const { return m_Recording.frames.size(); }
+};
+
+// Drives the application from a recording: one recorded frame is applied per rendered frame,
+// and the recorded frame time replaces the wall clock time.
+class InputReplayer
+{
+private:
+    UIData& m_ui;
+    FrameRecording m_Recording;
+    size_t m_NextFrame = 0;
+
+public:
+    explicit InputReplayer(UIData& ui);
+
+    bool Load(const std::filesystem::path& fileName, const std::string& sceneName);
+
+    // Applies the next recorded frame and returns its elapsed time
+    float ApplyNextFrame(donut::app::FirstPersonCamera& camera, SampleScene& scene);
+
+    [[nodiscard]] bool IsStarted() const { return m_NextFrame > 0; }
+    [[nodiscard]] bool IsFinished() const { return m_NextFrame >= m_Recording.frames.size(); }
+    [[nodiscard]] size_t GetFrameCount() const { return m_Recording.frames.size(); }
+};
@@ -12,8 +12,10 @@
 #include "RenderTargets.h"
 #include "RtxdiResources.h"
 #include "Profiler.h"
+#include "CpuProfiler.h"
 #include "SampleScene.h"
 #include "GBufferPass.h"
+#include "VirtualLightUpdate.h"
 
 #include <donut/engine/Scene.h>
 #include <donut/engine/CommonRenderPasses.h>
@@ -23,6 +25,7 @@
 #include <nvrhi/utils.h>
 #include <rtxdi/ImportanceSamplingContext.h>
 
+#include <algorithm>
 #include <utility>
 
 #if WITH_NRD
@@ -107,6 +110,8 @@ VirtualLight_Parameters getDefaultVirtualLightParams()
     params.clampingRatio = 0.0;
     params.includeInBrdfLightSampling = false;
     params.totalVirtualLights = 0;
+    params.updateStride = 1;
+    params.updatePhase = 0;
     return params;
 }
 
@@ -116,7 +121,9 @@ LightingPasses::LightingPasses(
     std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
     std::shared_ptr<donut::engine::Scene> scene,
     std::shared_ptr<Profiler> profiler,
-    nvrhi::IBindingLayout* bindlessLayout
+    nvrhi::IBindingLayout* bindlessLayout,
+    const std::filesystem::path& pipelineCacheFileName,
+    uint32_t pipelineThreadCount
 )
     : m_Device(device)
     , m_BindlessLayout(bindlessLayout)
@@ -124,6 +131,7 @@ LightingPasses::LightingPasses(
     , m_CommonPasses(std::move(commonPasses))
     , m_Scene(std::move(scene))
     , m_Profiler(std::move(profiler))
+    , m_PipelineCache(std::make_unique<PipelineCache>(pipelineCacheFileName, pipelineThreadCount))
 {
     // The binding layout descriptor must match the binding set descriptor defined in CreateBindingSet(...) below
 
@@ -157,6 +165,8 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(24),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(25),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(26),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(27),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(28),
 
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
@@ -176,8 +186,9 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(17),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(18),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(19),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(20),
 
-        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::ConstantBuffer(0),
         nvrhi::BindingLayoutItem::PushConstants(1, sizeof(PerPassConstants)),
         nvrhi::BindingLayoutItem::Sampler(0),
         nvrhi::BindingLayoutItem::Sampler(1),
@@ -185,7 +196,11 @@ LightingPasses::LightingPasses(
 
     m_BindingLayout = m_Device->createBindingLayout(globalBindingLayoutDesc);
 
-    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(ResamplingConstants), "ResamplingConstants", 16));
+    // Not volatile: the constants are written on the queue of the light sampling pass and read on all queues
+    nvrhi::BufferDesc constantBufferDesc = nvrhi::utils::CreateStaticConstantBufferDesc(sizeof(ResamplingConstants), "ResamplingConstants");
+    constantBufferDesc.initialState = nvrhi::ResourceStates::ConstantBuffer;
+    constantBufferDesc.keepInitialState = true;
+    m_ConstantBuffer = m_Device->createBuffer(constantBufferDesc);
 }
 
 void LightingPasses::CreateBindingSet(
@@ -194,6 +209,8 @@ void LightingPasses::CreateBindingSet(
     const RenderTargets& renderTargets,
     const RtxdiResources& resources)
 {
+    CpuProfilerScope cpuScope("LightingPasses::CreateBindingSet");
+
     assert(&renderTargets);
     assert(&resources);
 
@@ -230,6 +247,8 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(24, resources.LocalLightPdfTexture),
             nvrhi::BindingSetItem::StructuredBuffer_SRV(25, resources.GeometryInstanceToLightBuffer),
             nvrhi::BindingSetItem::StructuredBuffer_SRV(26, resources.PrimitiveInstanceToLightBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(27, resources.EnvironmentAliasTableBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(28, resources.EnvironmentAliasMarginalBuffer),
 
             nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightReservoirBuffer),
             nvrhi::BindingSetItem::Texture_UAV(1, renderTargets.DiffuseLighting),
@@ -249,6 +268,7 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::TypedBuffer_UAV(17, resources.GSGIGridBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(18, resources.DirReGIRBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(19, resources.DirReGIRLightDataBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(20, resources.DirReGIRPackedBuffer),
 
             nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
             nvrhi::BindingSetItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -272,28 +292,105 @@ void LightingPasses::CreateBindingSet(
     m_LocalLightPdfTextureSize.x = localLightPdfDesc.width;
     m_LocalLightPdfTextureSize.y = localLightPdfDesc.height;
 
+    SetResources(renderTargets, resources);
+}
+
+void LightingPasses::SetResources(const RenderTargets& renderTargets, const RtxdiResources& resources)
+{
     m_LightReservoirBuffer = resources.LightReservoirBuffer;
     m_SecondarySurfaceBuffer = resources.SecondaryGBuffer;
     m_GSGIGBuffer = resources.GSGIGBuffer;
     m_GSGIReservoirBuffer = resources.GSGIReservoirBuffer;
     m_GIReservoirBuffer = resources.GIReservoirBuffer;
     m_GSGIGridBuffer = resources.GSGIGridBuffer;
+    m_VirtualLightBuffer = resources.VirtualLightBuffer;
+
+    m_LightSamplingBuffers.clear();
+    for (nvrhi::IBuffer* buffer : { resources.RisBuffer.Get(), resources.RisLightDataBuffer.Get(),
+        resources.DirReGIRBuffer.Get(), resources.DirReGIRLightDataBuffer.Get(), resources.DirReGIRPackedBuffer.Get() })
+    {
+        if (buffer)
+            m_LightSamplingBuffers.push_back(buffer);
+    }
+    m_DiffuseLightingTexture = renderTargets.DiffuseLighting;
+    m_SpecularLightingTexture = renderTargets.SpecularLighting;
+    m_GradientsTexture = renderTargets.Gradients;
+}
+
+void LightingPasses::DeclareComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
+{
+    std::string key = shaderName;
+    for (const auto& macro : macros)
+        key += " " + macro.name + "=" + macro.definition;
+
+    pass.Shader = nullptr;
+    pass.Pipeline = nullptr;
+    m_PipelineKeys[&pass] = key;
+
+    m_PipelineCache->Declare(key, [this, &pass, shaderName, macros]
+    {
+        donut::log::debug("Initializing ComputePass %s...", shaderName);
+
+        pass.Shader = m_ShaderFactory->CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
+        return pass.Shader != nullptr;
+    },
+    [this, &pass]
+    {
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.bindingLayouts = { m_BindingLayout, m_BindlessLayout };
+        pipelineDesc.CS = pass.Shader;
+        pass.Pipeline = m_Device->createComputePipeline(pipelineDesc);
+        return pass.Pipeline != nullptr;
+    });
+}
+
+void LightingPasses::DeclareRayTracingPass(RayTracingPass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery)
+{
+    std::string key = shaderName;
+    for (const auto& macro : macros)
+        key += " " + macro.name + "=" + macro.definition;
+    key += useRayQuery ? " (ray query)" : " (ray tracing pipeline)";
+
+    pass = RayTracingPass();
+    m_PipelineKeys[&pass] = key;
+
+    m_PipelineCache->Declare(key, [this, &pass, shaderName, macros, useRayQuery]
+    {
+        donut::log::debug("Initializing RayTracingPass %s...", shaderName);
+
+        return pass.LoadShaders(*m_ShaderFactory, shaderName, macros, useRayQuery);
+    },
+    [this, &pass]
+    {
+        return pass.CreatePipeline(m_Device, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    });
 }
 
-void LightingPasses::CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
+// The keys are only looked up here, passes may wait for their pipelines on several recording threads at once
+void LightingPasses::RequestPipeline(const void* pass)
 {
-    donut::log::debug("Initializing ComputePass %s...", shaderName);
+    if (!m_PipelineRequestsEnabled)
+        return;
+
+    auto it = m_PipelineKeys.find(pass);
+    if (it != m_PipelineKeys.end())
+        m_PipelineCache->Request(it->second);
+}
 
-    pass.Shader = m_ShaderFactory->CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
+bool LightingPasses::WaitForPipeline(const void* pass)
+{
+    auto it = m_PipelineKeys.find(pass);
+    if (it == m_PipelineKeys.end())
+        return false;
 
-    nvrhi::ComputePipelineDesc pipelineDesc;
-    pipelineDesc.bindingLayouts = { m_BindingLayout, m_BindlessLayout };
-    pipelineDesc.CS = pass.Shader;
-    pass.Pipeline = m_Device->createComputePipeline(pipelineDesc);
+    return m_PipelineCache->Wait(it->second);
 }
 
 void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection)
 {
+    if (!WaitForPipeline(&pass))
+        return;
+
     commandList->beginMarker(passName);
     m_Profiler->BeginSection(commandList, profilerSection);
 
@@ -314,6 +411,9 @@ void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, Comput
 
 void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet)
 {
+    if (!WaitForPipeline(&pass))
+        return;
+
     commandList->beginMarker(passName);
     m_Profiler->BeginSection(commandList, profilerSection);
 
@@ -326,6 +426,42 @@ void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, Ray
     commandList->endMarker();
 }
 
+void LightingPasses::AddLightSamplingReads(RenderGraph& graph, std::vector<RenderGraph::Access>& reads, const std::vector<RenderGraph::Access>& writes)
+{
+    auto addRead = [&graph, &reads, &writes](RenderGraph::ResourceHandle resource, nvrhi::ResourceStates state)
+    {
+        const bool written = std::any_of(writes.begin(), writes.end(), [resource](const RenderGraph::Access& access) { return access.resource == resource; });
+        if (!written)
+            reads.push_back({ resource, state });
+    };
+
+    addRead(graph.ImportBuffer(m_ConstantBuffer), nvrhi::ResourceStates::ConstantBuffer);
+    for (nvrhi::IBuffer* buffer : m_LightSamplingBuffers)
+        addRead(graph.ImportBuffer(buffer), nvrhi::ResourceStates::UnorderedAccess);
+}
+
+void LightingPasses::AddComputePass(RenderGraph& graph, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, std::vector<RenderGraph::Access> reads, std::vector<RenderGraph::Access> writes)
+{
+    RequestPipeline(&pass);
+    AddLightSamplingReads(graph, reads, writes);
+
+    graph.AddPass(passName, std::move(reads), std::move(writes), [this, &pass, passName, dispatchSize, profilerSection](nvrhi::ICommandList* commandList)
+    {
+        ExecuteComputePass(commandList, pass, passName, dispatchSize, profilerSection);
+    });
+}
+
+void LightingPasses::AddRayTracingPass(RenderGraph& graph, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, std::vector<RenderGraph::Access> reads, std::vector<RenderGraph::Access> writes)
+{
+    RequestPipeline(&pass);
+    AddLightSamplingReads(graph, reads, writes);
+
+    graph.AddPass(passName, std::move(reads), std::move(writes), [this, &pass, enableRayCounts, passName, dispatchSize, profilerSection](nvrhi::ICommandList* commandList)
+    {
+        ExecuteRayTracingPass(commandList, pass, enableRayCounts, passName, dispatchSize, profilerSection);
+    });
+}
+
 donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ReGIRStaticParameters& regirStaticParams)
 {
     std::string regirMode;
@@ -348,57 +484,63 @@ donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ReGIRStati
 
 void LightingPasses::createPresamplingPipelines()
 {
-    CreateComputePass(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", {});
-    CreateComputePass(m_PresampleEnvironmentMapPass, "app/LightingPasses/PresampleEnvironmentMap.hlsl", {});
+    DeclareComputePass(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", {});
+    DeclareComputePass(m_PresampleEnvironmentMapPass, "app/LightingPasses/PresampleEnvironmentMap.hlsl", {});
 }
 
 void LightingPasses::createReGIRPipeline(const rtxdi::ReGIRStaticParameters& regirStaticParams, const std::vector<donut::engine::ShaderMacro>& regirMacros, const ReGIRType reGIRType)
 {
     if (regirStaticParams.Mode != rtxdi::ReGIRMode::Disabled)
     {
-        CreateComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
-        CreateComputePass(m_PresampleDirReGIR, "app/LightingPasses/PresampleDirReGIR.hlsl", regirMacros);
+        DeclareComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
+        DeclareComputePass(m_PresampleDirReGIR, "app/LightingPasses/PresampleDirReGIR.hlsl", regirMacros);
     }
 }
 
 void LightingPasses::createGSGIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery)
 {
-    m_GSGISampleGeometryPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GSGISampleGeometry.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GSGIInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GSGIInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    CreateComputePass(m_GSGIWorldSpaceZeroingPass, "app/LightingPasses/GSGIWorldSpaceZeroing.hlsl", regirMacros);
-    CreateComputePass(m_GSGIWorldSpaceBuildingPass, "app/LightingPasses/GSGIWorldSpaceBuilding.hlsl", regirMacros);
-    m_GSGIWorldSpaceResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GSGIWorldSpaceResampling.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GSGIScreenSpaceResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GSGIScreenSpaceResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GSGICreateLightsPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GSGICreateLights.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    DeclareRayTracingPass(m_GSGISampleGeometryPass, "app/LightingPasses/GSGISampleGeometry.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GSGIInitialSamplesPass, "app/LightingPasses/GSGIInitialSamples.hlsl", regirMacros, useRayQuery);
+    DeclareComputePass(m_GSGIWorldSpaceZeroingPass, "app/LightingPasses/GSGIWorldSpaceZeroing.hlsl", regirMacros);
+    DeclareComputePass(m_GSGIWorldSpaceBuildingPass, "app/LightingPasses/GSGIWorldSpaceBuilding.hlsl", regirMacros);
+    DeclareRayTracingPass(m_GSGIWorldSpaceResamplingPass, "app/LightingPasses/GSGIWorldSpaceResampling.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_GSGIScreenSpaceResamplingPass, "app/LightingPasses/GSGIScreenSpaceResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GSGICreateLightsPass, "app/LightingPasses/GSGICreateLights.hlsl", {}, useRayQuery);
 }
 
 void LightingPasses::createPMGIPipelines(bool useRayQuery)
 {
-    m_PMGICreateLightsPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/PMGICreateLights.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    DeclareRayTracingPass(m_PMGICreateLightsPass, "app/LightingPasses/PMGICreateLights.hlsl", {}, useRayQuery);
 }
 
 void LightingPasses::createReSTIRDIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery)
 {
-    m_GenerateInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIGenerateInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_TemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DITemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_SpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DISpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_ShadeSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIShadeSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_BrdfRayTracingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_ShadeSecondarySurfacesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_FusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIFusedResampling.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GradientsPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIComputeGradients.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    DeclareRayTracingPass(m_GenerateInitialSamplesPass, "app/LightingPasses/DIGenerateInitialSamples.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_TemporalResamplingPass, "app/LightingPasses/DITemporalResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_SpatialResamplingPass, "app/LightingPasses/DISpatialResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_ShadeSamplesPass, "app/LightingPasses/DIShadeSamples.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_BrdfRayTracingPass, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_ShadeSecondarySurfacesPass, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_FusedResamplingPass, "app/LightingPasses/DIFusedResampling.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_GradientsPass, "app/LightingPasses/DIComputeGradients.hlsl", {}, useRayQuery);
 }
 
 void LightingPasses::createReSTIRGIPipelines(bool useRayQuery)
 {
-    m_GITemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GITemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GISpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GISpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GIFusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GIFusedResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GIFinalShadingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GIFinalShading.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    DeclareRayTracingPass(m_GITemporalResamplingPass, "app/LightingPasses/GITemporalResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GISpatialResamplingPass, "app/LightingPasses/GISpatialResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GIFusedResamplingPass, "app/LightingPasses/GIFusedResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GIFinalShadingPass, "app/LightingPasses/GIFinalShading.hlsl", {}, useRayQuery);
 }
 
 void LightingPasses::CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, ReGIRType reGIRType)
 {
+    CpuProfilerScope cpuScope("LightingPasses::CreatePipelines");
+
+    // The permutations of the previous settings may still be in flight
+    m_PipelineCache->Clear();
+    m_PipelineKeys.clear();
+
     std::vector<donut::engine::ShaderMacro> regirMacros = {
         GetRegirMacro(regirStaticParams)
     };
@@ -504,6 +646,8 @@ void LightingPasses::FillResamplingConstants(
     const RenderSettings& lightingSettings,
     const rtxdi::ImportanceSamplingContext& isContext)
 {
+    CpuProfilerScope cpuScope("LightingPasses::FillResamplingConstants");
+
     const RTXDI_LightBufferParameters& lightBufferParameters = isContext.getLightBufferParameters();
 
     constants.enablePreviousTLAS = lightingSettings.enablePreviousTLAS;
@@ -528,10 +672,13 @@ void LightingPasses::FillResamplingConstants(
     FillReSTIRGIConstants(constants.restirGI, isContext.getReSTIRGIContext());
 
     constants.localLightPdfTextureSize = m_LocalLightPdfTextureSize;
+    constants.lightBufferStride = m_LightBufferStride;
+    constants.staticLightRange = m_StaticLightRange;
 
     if (lightBufferParameters.environmentLightParams.lightPresent)
     {
         constants.environmentPdfTextureSize = m_EnvironmentPdfTextureSize;
+        constants.environmentAliasTable = lightingSettings.environmentAliasTable;
     }
 
     constants.gsgi = lightingSettings.gsgiParams;
@@ -541,12 +688,13 @@ void LightingPasses::FillResamplingConstants(
     constants.dirReGIRSampling = lightingSettings.dirReGIRSampling;
     constants.dirReGIRBrdfUniformProbability = lightingSettings.dirReGIRBrdfUniformProbability;
     constants.bypassDirectionalDirReGIRBuild = lightingSettings.bypassDirectionalDirReGIRBuild;
+    constants.dirReGIRTileEncoding = lightingSettings.dirReGIRTileEncoding;
 
     m_CurrentFrameOutputReservoir = isContext.getReSTIRDIContext().getBufferIndices().shadingInputBufferIndex;
 }
 
-void LightingPasses::PrepareForLightSampling(
-    nvrhi::ICommandList* commandList,
+void LightingPasses::AddLightSamplingPass(
+    RenderGraph& graph,
     rtxdi::ImportanceSamplingContext& isContext,
     const donut::engine::IView& view,
     const donut::engine::IView& previousView,
@@ -556,6 +704,7 @@ void LightingPasses::PrepareForLightSampling(
     rtxdi::ReSTIRDIContext& restirDIContext = isContext.getReSTIRDIContext();
     rtxdi::ReGIRContext& regirContext = isContext.getReGIRContext();
 
+    // The constants are filled now, later changes to the contexts are for the passes that write their own constants
     ResamplingConstants constants = {};
     constants.frameIndex = restirDIContext.getFrameIndex();
     view.FillPlanarViewConstants(constants.view);
@@ -563,69 +712,98 @@ void LightingPasses::PrepareForLightSampling(
     FillResamplingConstants(constants, localSettings, isContext);
     constants.enableAccumulation = enableAccumulation;
 
-    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
-
     auto& lightBufferParams = isContext.getLightBufferParameters();
 
+    dm::int2 presampleLightsDispatchSize = 0;
     if (isContext.isLocalLightPowerRISEnabled() &&
         lightBufferParams.localLightBufferRegion.numLights > 0)
     {
-        dm::int2 presampleDispatchSize = {
+        presampleLightsDispatchSize = {
             dm::div_ceil(isContext.getLocalLightRISBufferSegmentParams().tileSize, RTXDI_PRESAMPLING_GROUP_SIZE),
             int(isContext.getLocalLightRISBufferSegmentParams().tileCount)
         };
-
-        ExecuteComputePass(commandList, m_PresampleLightsPass, "PresampleLights", presampleDispatchSize, ProfilerSection::PresampleLights);
+        RequestPipeline(&m_PresampleLightsPass);
     }
 
+    dm::int2 presampleEnvironmentMapDispatchSize = 0;
     if (lightBufferParams.environmentLightParams.lightPresent)
     {
-        dm::int2 presampleDispatchSize = {
+        presampleEnvironmentMapDispatchSize = {
             dm::div_ceil(isContext.getEnvironmentLightRISBufferSegmentParams().tileSize, RTXDI_PRESAMPLING_GROUP_SIZE),
             int(isContext.getEnvironmentLightRISBufferSegmentParams().tileCount)
         };
-
-        ExecuteComputePass(commandList, m_PresampleEnvironmentMapPass, "PresampleEnvironmentMap", presampleDispatchSize, ProfilerSection::PresampleEnvMap);
+        RequestPipeline(&m_PresampleEnvironmentMapPass);
     }
 
+    dm::int2 presampleReGIRDispatchSize = 0;
+    dm::int2 presampleDirReGIRDispatchSize = 0;
     if (isContext.isReGIREnabled() &&
         lightBufferParams.localLightBufferRegion.numLights > 0)
     {
         if (localSettings.reGIRType == ReGIRType::Standard)
         {
-            dm::int2 worldGridDispatchSize = {
+            presampleReGIRDispatchSize = {
                 dm::div_ceil(regirContext.getReGIRLightSlotCount(), RTXDI_GRID_BUILD_GROUP_SIZE),
                 1
             };
-
-            ExecuteComputePass(commandList, m_PresampleReGIR, "PresampleReGIR", worldGridDispatchSize, ProfilerSection::PresampleReGIR);
+            RequestPipeline(&m_PresampleReGIR);
         }
         else
         {
             int reGIRCellCount = regirContext.getReGIRLightSlotCount() / regirContext.getReGIRStaticParameters().LightsPerCell;
-            dm::int2 dirReGIRDispatchSize = {reGIRCellCount, 1};
-            ExecuteComputePass(commandList, m_PresampleDirReGIR, "PresampleDirReGIR", dirReGIRDispatchSize, ProfilerSection::PresampleDirReGIR);
+            presampleDirReGIRDispatchSize = { reGIRCellCount, 1 };
+            RequestPipeline(&m_PresampleDirReGIR);
         }
     }
+
+    std::vector<RenderGraph::Access> writes = { { graph.ImportBuffer(m_ConstantBuffer), nvrhi::ResourceStates::CopyDest } };
+    for (nvrhi::IBuffer* buffer : m_LightSamplingBuffers)
+        writes.push_back({ graph.ImportBuffer(buffer), nvrhi::ResourceStates::UnorderedAccess });
+
+    graph.AddPass("LightSampling", {}, std::move(writes), [this, constants, presampleLightsDispatchSize, presampleEnvironmentMapDispatchSize,
+        presampleReGIRDispatchSize, presampleDirReGIRDispatchSize](nvrhi::ICommandList* commandList)
+    {
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+        if (presampleLightsDispatchSize.x > 0)
+            ExecuteComputePass(commandList, m_PresampleLightsPass, "PresampleLights", presampleLightsDispatchSize, ProfilerSection::PresampleLights);
+
+        if (presampleEnvironmentMapDispatchSize.x > 0)
+            ExecuteComputePass(commandList, m_PresampleEnvironmentMapPass, "PresampleEnvironmentMap", presampleEnvironmentMapDispatchSize, ProfilerSection::PresampleEnvMap);
+
+        if (presampleReGIRDispatchSize.x > 0)
+            ExecuteComputePass(commandList, m_PresampleReGIR, "PresampleReGIR", presampleReGIRDispatchSize, ProfilerSection::PresampleReGIR);
+        else if (presampleDirReGIRDispatchSize.x > 0)
+            ExecuteComputePass(commandList, m_PresampleDirReGIR, "PresampleDirReGIR", presampleDirReGIRDispatchSize, ProfilerSection::PresampleDirReGIR);
+    });
 }
 
-void LightingPasses::GenerateGSGILights(
-    nvrhi::ICommandList* commandList,
-    rtxdi::ReSTIRDIContext& context,
+void LightingPasses::AddGSGIPasses(
+    RenderGraph& graph,
     rtxdi::ImportanceSamplingContext& isContext,
-    const donut::engine::IView& view,
     const RenderSettings& localSettings)
 {
     rtxdi::ReGIRContext& regirContext = isContext.getReGIRContext();
 
+    const RenderGraph::ResourceHandle gbuffer = graph.ImportBuffer(m_GSGIGBuffer);
+    const RenderGraph::ResourceHandle reservoirs = graph.ImportBuffer(m_GSGIReservoirBuffer);
+    const RenderGraph::ResourceHandle grid = graph.ImportBuffer(m_GSGIGridBuffer);
+    const nvrhi::ResourceStates uav = nvrhi::ResourceStates::UnorderedAccess;
+
+    // A partial update of the virtual lights only samples part of the points
+    const uint32_t sampleCount = GetVirtualLightUpdateCount(localSettings.gsgiParams.samplesPerFrame,
+        localSettings.vlightParams.updateStride, localSettings.vlightParams.updatePhase);
+
     dm::int2 dispatchSize = {
-        static_cast<int>(localSettings.gsgiParams.samplesPerFrame),
+        static_cast<int>(sampleCount),
         1
     };
 
-    ExecuteRayTracingPass(commandList, m_GSGISampleGeometryPass, localSettings.enableRayCounts, "GSGISampleGeometry", dispatchSize, ProfilerSection::GSGISampleGeometry);
+    AddRayTracingPass(graph, m_GSGISampleGeometryPass, localSettings.enableRayCounts, "GSGISampleGeometry", dispatchSize, ProfilerSection::GSGISampleGeometry,
+        {}, { { gbuffer, uav } });
 
-    ExecuteRayTracingPass(commandList, m_GSGIInitialSamplesPass, localSettings.enableRayCounts, "GSGIInitialSamples", dispatchSize, ProfilerSection::GSGIInitialSamples);
+    AddRayTracingPass(graph, m_GSGIInitialSamplesPass, localSettings.enableRayCounts, "GSGIInitialSamples", dispatchSize, ProfilerSection::GSGIInitialSamples,
+        { { gbuffer, uav } }, { { reservoirs, uav } });
 
     if (localSettings.gsgiParams.resamplingMode == GSGIResamplingMode::WorldSpace)
     {
@@ -634,43 +812,46 @@ void LightingPasses::GenerateGSGILights(
             1
         };
 
-        ExecuteComputePass(commandList, m_GSGIWorldSpaceZeroingPass, "GSGIWorldSpaceZeroingPass", worldGridDispatchSize, ProfilerSection::GSGIWorldSpaceResampling);
-        nvrhi::utils::BufferUavBarrier(commandList, m_GSGIGridBuffer);
+        AddComputePass(graph, m_GSGIWorldSpaceZeroingPass, "GSGIWorldSpaceZeroingPass", worldGridDispatchSize, ProfilerSection::GSGIWorldSpaceResampling,
+            {}, { { grid, uav } });
 
         dm::int2 gridBuildingDispatchSize = {
-            dm::div_ceil(localSettings.gsgiParams.samplesPerFrame, 256),
+            dm::div_ceil(sampleCount, 256),
             1
         };
 
-        ExecuteComputePass(commandList, m_GSGIWorldSpaceBuildingPass, "GSGIWorldSpaceBuildingPass", gridBuildingDispatchSize, ProfilerSection::GSGIWorldSpaceResampling);
-        nvrhi::utils::BufferUavBarrier(commandList, m_GSGIGridBuffer);
-        ExecuteRayTracingPass(commandList, m_GSGIWorldSpaceResamplingPass, localSettings.enableRayCounts, "GSGIWorldSpaceResampling", dispatchSize, ProfilerSection::GSGIWorldSpaceResampling);
+        AddComputePass(graph, m_GSGIWorldSpaceBuildingPass, "GSGIWorldSpaceBuildingPass", gridBuildingDispatchSize, ProfilerSection::GSGIWorldSpaceResampling,
+            { { gbuffer, uav } }, { { grid, uav } });
+
+        AddRayTracingPass(graph, m_GSGIWorldSpaceResamplingPass, localSettings.enableRayCounts, "GSGIWorldSpaceResampling", dispatchSize, ProfilerSection::GSGIWorldSpaceResampling,
+            { { gbuffer, uav }, { grid, uav } }, { { reservoirs, uav } });
     }
     else if (localSettings.gsgiParams.resamplingMode == GSGIResamplingMode::ScreenSpace)
     {
-        ExecuteRayTracingPass(commandList, m_GSGIScreenSpaceResamplingPass, localSettings.enableRayCounts, "GSGIScreenSpaceResampling", dispatchSize, ProfilerSection::GSGIScreenSpaceResampling);
+        AddRayTracingPass(graph, m_GSGIScreenSpaceResamplingPass, localSettings.enableRayCounts, "GSGIScreenSpaceResampling", dispatchSize, ProfilerSection::GSGIScreenSpaceResampling,
+            { { gbuffer, uav } }, { { reservoirs, uav } });
     }
 
-    ExecuteRayTracingPass(commandList, m_GSGICreateLightsPass, localSettings.enableRayCounts, "GSGICreateLights", dispatchSize, ProfilerSection::GSGICreateLights);
+    AddRayTracingPass(graph, m_GSGICreateLightsPass, localSettings.enableRayCounts, "GSGICreateLights", dispatchSize, ProfilerSection::GSGICreateLights,
+        { { gbuffer, uav }, { reservoirs, uav } }, { { graph.ImportBuffer(m_VirtualLightBuffer), uav } });
 }
 
-void LightingPasses::GeneratePMGILights(
-    nvrhi::ICommandList* commandList,
-    rtxdi::ReSTIRDIContext& context,
-    rtxdi::ImportanceSamplingContext& isContext,
-    const donut::engine::IView& view,
+void LightingPasses::AddPMGIPasses(
+    RenderGraph& graph,
     const RenderSettings& localSettings)
 {
     dm::int2 dispatchSize = {
-        static_cast<int>(localSettings.pmgiParams.samplesPerFrame),
+        static_cast<int>(GetVirtualLightUpdateCount(localSettings.pmgiParams.samplesPerFrame,
+            localSettings.vlightParams.updateStride, localSettings.vlightParams.updatePhase)),
         1
     };
 
-    ExecuteRayTracingPass(commandList, m_PMGICreateLightsPass, localSettings.enableRayCounts, "PMGICreateLights", dispatchSize, ProfilerSection::PMGICreateLights);
+    AddRayTracingPass(graph, m_PMGICreateLightsPass, localSettings.enableRayCounts, "PMGICreateLights", dispatchSize, ProfilerSection::PMGICreateLights,
+        {}, { { graph.ImportBuffer(m_VirtualLightBuffer), nvrhi::ResourceStates::UnorderedAccess } });
 }
 
-void LightingPasses::RenderDirectLighting(
-    nvrhi::ICommandList* commandList,
+void LightingPasses::AddDirectLightingPasses(
+    RenderGraph& graph,
     rtxdi::ReSTIRDIContext& context,
     const donut::engine::IView& view,
     const RenderSettings& localSettings)
@@ -685,49 +866,51 @@ void LightingPasses::RenderDirectLighting(
 
     // Run the lighting passes in the necessary sequence: one fused kernel or multiple separate passes.
     //
-    // Note: the below code places explicit UAV barriers between subsequent passes
-    // because NVRHI misses them, as the binding sets are exactly the same between these passes.
+    // Note: the accesses to the reservoir buffer are declared so that the graph places UAV barriers
+    // between subsequent passes. NVRHI misses them, as the binding sets are exactly the same between these passes.
     // That equality makes NVRHI take a shortcut for performance and it doesn't look at bindings at all.
 
+    const RenderGraph::ResourceHandle reservoirs = graph.ImportBuffer(m_LightReservoirBuffer);
+    const RenderGraph::ResourceHandle diffuse = graph.ImportTexture(m_DiffuseLightingTexture);
+    const RenderGraph::ResourceHandle specular = graph.ImportTexture(m_SpecularLightingTexture);
+    const RenderGraph::ResourceHandle gradients = graph.ImportTexture(m_GradientsTexture);
+    const nvrhi::ResourceStates uav = nvrhi::ResourceStates::UnorderedAccess;
+
     if (context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::FusedSpatiotemporal)
     {
-        nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
-
-        ExecuteRayTracingPass(commandList, m_FusedResamplingPass, localSettings.enableRayCounts, "DIFusedResampling", dispatchSize, ProfilerSection::Shading);
+        AddRayTracingPass(graph, m_FusedResamplingPass, localSettings.enableRayCounts, "DIFusedResampling", dispatchSize, ProfilerSection::Shading,
+            {}, { { reservoirs, uav }, { diffuse, uav }, { specular, uav } });
     }
     else
     {
-        ExecuteRayTracingPass(commandList, m_GenerateInitialSamplesPass, localSettings.enableRayCounts, "DIGenerateInitialSamples", dispatchSize, ProfilerSection::InitialSamples);
+        AddRayTracingPass(graph, m_GenerateInitialSamplesPass, localSettings.enableRayCounts, "DIGenerateInitialSamples", dispatchSize, ProfilerSection::InitialSamples,
+            {}, { { reservoirs, uav } });
 
         if (context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::Temporal || context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial)
         {
-            nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
-
-            ExecuteRayTracingPass(commandList, m_TemporalResamplingPass, localSettings.enableRayCounts, "DITemporalResampling", dispatchSize, ProfilerSection::TemporalResampling);
+            AddRayTracingPass(graph, m_TemporalResamplingPass, localSettings.enableRayCounts, "DITemporalResampling", dispatchSize, ProfilerSection::TemporalResampling,
+                {}, { { reservoirs, uav } });
         }
 
         if (context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::Spatial || context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial)
         {
-            nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
-
-            ExecuteRayTracingPass(commandList, m_SpatialResamplingPass, localSettings.enableRayCounts, "DISpatialResampling", dispatchSize, ProfilerSection::SpatialResampling);
+            AddRayTracingPass(graph, m_SpatialResamplingPass, localSettings.enableRayCounts, "DISpatialResampling", dispatchSize, ProfilerSection::SpatialResampling,
+                {}, { { reservoirs, uav } });
         }
 
-        nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
-
-        ExecuteRayTracingPass(commandList, m_ShadeSamplesPass, localSettings.enableRayCounts, "DIShadeSamples", dispatchSize, ProfilerSection::Shading);
+        AddRayTracingPass(graph, m_ShadeSamplesPass, localSettings.enableRayCounts, "DIShadeSamples", dispatchSize, ProfilerSection::Shading,
+            {}, { { reservoirs, uav }, { diffuse, uav }, { specular, uav } });
     }
     
     if (localSettings.enableGradients)
     {
-        nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
-
-        ExecuteRayTracingPass(commandList, m_GradientsPass, localSettings.enableRayCounts, "DIGradients", (dispatchSize + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR, ProfilerSection::Gradients);
+        AddRayTracingPass(graph, m_GradientsPass, localSettings.enableRayCounts, "DIGradients", (dispatchSize + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR, ProfilerSection::Gradients,
+            { { reservoirs, uav } }, { { gradients, uav } });
     }
 }
 
-void LightingPasses::RenderBrdfRays(
-    nvrhi::ICommandList* commandList, 
+void LightingPasses::AddBrdfRayPasses(
+    RenderGraph& graph,
     rtxdi::ImportanceSamplingContext& isContext,
     const donut::engine::IView& view,
     const donut::engine::IView& previousView,
@@ -765,8 +948,6 @@ void LightingPasses::RenderBrdfRays(
     ReSTIRGI_BufferIndices restirGIBufferIndices = restirGIContext.getBufferIndices();
     m_CurrentFrameGIOutputReservoir = restirGIBufferIndices.finalShadingInputBufferIndex;
 
-    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
-
     dm::int2 dispatchSize = {
         view.GetViewExtent().width(),
         view.GetViewExtent().height()
@@ -775,46 +956,62 @@ void LightingPasses::RenderBrdfRays(
     if (restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
         dispatchSize.x /= 2;
 
-    ExecuteRayTracingPass(commandList, m_BrdfRayTracingPass, localSettings.enableRayCounts, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
+    const RenderGraph::ResourceHandle lightReservoirs = graph.ImportBuffer(m_LightReservoirBuffer);
+    const RenderGraph::ResourceHandle giReservoirs = graph.ImportBuffer(m_GIReservoirBuffer);
+    const RenderGraph::ResourceHandle secondaryGBuffer = graph.ImportBuffer(m_SecondarySurfaceBuffer);
+    const RenderGraph::ResourceHandle diffuse = graph.ImportTexture(m_DiffuseLightingTexture);
+    const RenderGraph::ResourceHandle specular = graph.ImportTexture(m_SpecularLightingTexture);
+    const nvrhi::ResourceStates uav = nvrhi::ResourceStates::UnorderedAccess;
 
+    std::vector<RenderGraph::Access> brdfRayWrites = { { diffuse, uav }, { specular, uav }, { graph.ImportBuffer(m_ConstantBuffer), nvrhi::ResourceStates::CopyDest } };
     if (enableIndirect)
+        brdfRayWrites.push_back({ secondaryGBuffer, uav });
+
+    std::vector<RenderGraph::Access> brdfRayReads;
+    AddLightSamplingReads(graph, brdfRayReads, brdfRayWrites);
+
+    // The constants are written when the graph is executed, after the passes that use the previous contents
+    const bool enableRayCounts = localSettings.enableRayCounts;
+    RequestPipeline(&m_BrdfRayTracingPass);
+    graph.AddPass("BrdfRayTracingPass", brdfRayReads, brdfRayWrites, [this, constants, enableRayCounts, dispatchSize](nvrhi::ICommandList* commandList)
     {
-        // Place an explicit UAV barrier between the passes. See the note on barriers in RenderDirectLighting(...)
-        nvrhi::utils::BufferUavBarrier(commandList, m_SecondarySurfaceBuffer);
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
-        ExecuteRayTracingPass(commandList, m_ShadeSecondarySurfacesPass, localSettings.enableRayCounts, "ShadeSecondarySurfaces", dispatchSize, ProfilerSection::ShadeSecondary, nullptr);
+        ExecuteRayTracingPass(commandList, m_BrdfRayTracingPass, enableRayCounts, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
+    });
+
+    if (enableIndirect)
+    {
+        AddRayTracingPass(graph, m_ShadeSecondarySurfacesPass, localSettings.enableRayCounts, "ShadeSecondarySurfaces", dispatchSize, ProfilerSection::ShadeSecondary,
+            { { lightReservoirs, uav } }, { { secondaryGBuffer, uav }, { giReservoirs, uav }, { diffuse, uav }, { specular, uav } });
         
         if (enableReSTIRGI)
         {
             rtxdi::ReSTIRGI_ResamplingMode resamplingMode = restirGIContext.getResamplingMode();
             if (resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::FusedSpatiotemporal)
             {
-                nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
-
-                ExecuteRayTracingPass(commandList, m_GIFusedResamplingPass, localSettings.enableRayCounts, "GIFusedResampling", dispatchSize, ProfilerSection::GIFusedResampling, nullptr);
+                AddRayTracingPass(graph, m_GIFusedResamplingPass, localSettings.enableRayCounts, "GIFusedResampling", dispatchSize, ProfilerSection::GIFusedResampling,
+                    {}, { { giReservoirs, uav } });
             }
             else
             {
                 if (resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::Temporal ||
                     resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::TemporalAndSpatial)
                 {
-                    nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
-
-                    ExecuteRayTracingPass(commandList, m_GITemporalResamplingPass, localSettings.enableRayCounts, "GITemporalResampling", dispatchSize, ProfilerSection::GITemporalResampling, nullptr);
+                    AddRayTracingPass(graph, m_GITemporalResamplingPass, localSettings.enableRayCounts, "GITemporalResampling", dispatchSize, ProfilerSection::GITemporalResampling,
+                        {}, { { giReservoirs, uav } });
                 }
 
                 if (resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::Spatial ||
                     resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::TemporalAndSpatial)
                 {
-                    nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
-
-                    ExecuteRayTracingPass(commandList, m_GISpatialResamplingPass, localSettings.enableRayCounts, "GISpatialResampling", dispatchSize, ProfilerSection::GISpatialResampling, nullptr);
+                    AddRayTracingPass(graph, m_GISpatialResamplingPass, localSettings.enableRayCounts, "GISpatialResampling", dispatchSize, ProfilerSection::GISpatialResampling,
+                        {}, { { giReservoirs, uav } });
                 }
             }
 
-            nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
-
-            ExecuteRayTracingPass(commandList, m_GIFinalShadingPass, localSettings.enableRayCounts, "GIFinalShading", dispatchSize, ProfilerSection::GIFinalShading, nullptr);
+            AddRayTracingPass(graph, m_GIFinalShadingPass, localSettings.enableRayCounts, "GIFinalShading", dispatchSize, ProfilerSection::GIFinalShading,
+                { { giReservoirs, uav }, { secondaryGBuffer, uav } }, { { diffuse, uav }, { specular, uav } });
         }
     }
 }
@@ -824,3 +1021,9 @@ void LightingPasses::NextFrame()
     std::swap(m_BindingSet, m_PrevBindingSet);
     m_LastFrameOutputReservoir = m_CurrentFrameOutputReservoir;
 }
+
+void LightingPasses::SetStaticLightRange(uint32_t lightBufferStride, dm::uint2 staticLightRange)
+{
+    m_LightBufferStride = lightBufferStride;
+    m_StaticLightRange = staticLightRange;
+}
@@ -12,10 +12,14 @@
 
 #include "RayTracingPass.h"
 #include "ProfilerSections.h"
+#include "RenderGraph.h"
+#include "PipelineCache.h"
 
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
+#include <filesystem>
 #include <memory>
+#include <unordered_map>
 
 #include <rtxdi/ReSTIRDIParameters.h>
 #include <rtxdi/ReSTIRGIParameters.h>
@@ -106,9 +110,16 @@ private:
     nvrhi::BufferHandle m_GIReservoirBuffer;
     nvrhi::BufferHandle m_GSGIReservoirBuffer;
     nvrhi::BufferHandle m_GSGIGridBuffer;
+    nvrhi::BufferHandle m_VirtualLightBuffer;
+    std::vector<nvrhi::BufferHandle> m_LightSamplingBuffers; // written by the light sampling pass, read by all others
+    nvrhi::TextureHandle m_DiffuseLightingTexture;
+    nvrhi::TextureHandle m_SpecularLightingTexture;
+    nvrhi::TextureHandle m_GradientsTexture;
 
     dm::uint2 m_EnvironmentPdfTextureSize;
     dm::uint2 m_LocalLightPdfTextureSize;
+    uint32_t m_LightBufferStride = 0;
+    dm::uint2 m_StaticLightRange = 0u;
 
     uint32_t m_LastFrameOutputReservoir = 0;
     uint32_t m_CurrentFrameOutputReservoir = 0;
@@ -119,9 +130,23 @@ private:
     std::shared_ptr<donut::engine::Scene> m_Scene;
     std::shared_ptr<Profiler> m_Profiler;
 
-    void CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
+    // Declared last so that it is destroyed first: its workers write into the passes above
+    std::unique_ptr<PipelineCache> m_PipelineCache;
+    std::unordered_map<const void*, std::string> m_PipelineKeys; // pass -> cache key of its current permutation
+    bool m_PipelineRequestsEnabled = true;
+
+    // The pipelines are only declared here, they are created when a pass is added to a graph or executed
+    void DeclareComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
+    void DeclareRayTracingPass(RayTracingPass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery);
+    void RequestPipeline(const void* pass);
+    bool WaitForPipeline(const void* pass);
     void ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
     void ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet = nullptr);
+    // Adds reads of the constants and the presampled lights that the pass doesn't write, so that a pass on another
+    // queue waits for the light sampling pass
+    void AddLightSamplingReads(RenderGraph& graph, std::vector<RenderGraph::Access>& reads, const std::vector<RenderGraph::Access>& writes);
+    void AddComputePass(RenderGraph& graph, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, std::vector<RenderGraph::Access> reads, std::vector<RenderGraph::Access> writes);
+    void AddRayTracingPass(RenderGraph& graph, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, std::vector<RenderGraph::Access> reads, std::vector<RenderGraph::Access> writes);
 
 public:
 
@@ -134,6 +159,7 @@ public:
         ibool enableTransparentGeometry = true;
         ibool enableRayCounts = true;
         ibool visualizeRegirCells = false;
+        ibool environmentAliasTable = false; // sample the environment map with alias tables instead of the PDF mip chain
         
         ibool enableGradients = true;
         float gradientLogDarknessBias = -12.f;
@@ -144,6 +170,7 @@ public:
         DirReGIRSampling dirReGIRSampling = DirReGIRSampling::BRDF;
         float dirReGIRBrdfUniformProbability = 0.25;
         ibool bypassDirectionalDirReGIRBuild = false;
+        DirReGIRTileEncoding dirReGIRTileEncoding = DirReGIRTileEncoding::Full;
 
         BRDFPathTracing_Parameters brdfptParams = getDefaultBRDFPathTracingParams();
         GSGI_Parameters gsgiParams = getDefaultGSGIParams();
@@ -162,8 +189,12 @@ public:
         std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
         std::shared_ptr<donut::engine::Scene> scene,
         std::shared_ptr<Profiler> profiler,
-        nvrhi::IBindingLayout* bindlessLayout);
+        nvrhi::IBindingLayout* bindlessLayout,
+        const std::filesystem::path& pipelineCacheFileName,
+        uint32_t pipelineThreadCount);
 
+    // Declares the pipelines of the current shader permutations. Each one is created on first use, by a worker
+    // thread when the pass is added to a graph, or earlier if the previous run used it.
     void CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, ReGIRType reGIRType);
 
     void CreateBindingSet(
@@ -172,36 +203,44 @@ public:
         const RenderTargets& renderTargets,
         const RtxdiResources& resources);
 
-    void PrepareForLightSampling(
-        nvrhi::ICommandList* commandList,
-        rtxdi::ImportanceSamplingContext& context,
+    // Sets the resources that the passes declare in a render graph, without creating the binding sets.
+    // The transient resources are placed with a graph of the lighting passes before they can be bound.
+    void SetResources(const RenderTargets& renderTargets, const RtxdiResources& resources);
+
+    // Adding a pass to a graph starts the creation of its pipeline. The graph that places the transient resources
+    // declares every pass that may ever run, so it disables the requests while it is built.
+    void SetPipelineRequestsEnabled(bool enable) { m_PipelineRequestsEnabled = enable; }
+
+    // The lighting passes are declared in a render graph with the resources that they access,
+    // and recorded when the graph is executed.
+
+    // Writes the constants and presamples the local lights, the environment map and the ReGIR cells.
+    // Every other pass reads what this one writes, so it is declared first.
+    void AddLightSamplingPass(
+        RenderGraph& graph,
+        rtxdi::ImportanceSamplingContext& isContext,
         const donut::engine::IView& view,
         const donut::engine::IView& previousView,
         const RenderSettings& localSettings,
         bool enableAccumulation);
 
-    void GenerateGSGILights(
-        nvrhi::ICommandList* commandList,
-        rtxdi::ReSTIRDIContext& context,
+    void AddGSGIPasses(
+        RenderGraph& graph,
         rtxdi::ImportanceSamplingContext& isContext,
-        const donut::engine::IView& view,
         const RenderSettings& localSettings);
 
-    void GeneratePMGILights(
-        nvrhi::ICommandList* commandList,
-        rtxdi::ReSTIRDIContext& context,
-        rtxdi::ImportanceSamplingContext& isContext,
-        const donut::engine::IView& view,
+    void AddPMGIPasses(
+        RenderGraph& graph,
         const RenderSettings& localSettings);
 
-    void RenderDirectLighting(
-        nvrhi::ICommandList* commandList,
+    void AddDirectLightingPasses(
+        RenderGraph& graph,
         rtxdi::ReSTIRDIContext& context,
         const donut::engine::IView& view,
         const RenderSettings& localSettings);
 
-    void RenderBrdfRays(
-        nvrhi::ICommandList* commandList,
+    void AddBrdfRayPasses(
+        RenderGraph& graph,
         rtxdi::ImportanceSamplingContext& isContext,
         const donut::engine::IView& view,
         const donut::engine::IView& previousView,
@@ -217,10 +256,15 @@ public:
 
     void NextFrame();
 
+    // Lights [staticLightRange.x, staticLightRange.y) of each half of the light buffer that are the same on both frames
+    void SetStaticLightRange(uint32_t lightBufferStride, dm::uint2 staticLightRange);
+
     [[nodiscard]] nvrhi::IBindingLayout* GetBindingLayout() const { return m_BindingLayout; }
     [[nodiscard]] nvrhi::IBindingSet* GetCurrentBindingSet() const { return m_BindingSet; }
     [[nodiscard]] uint32_t GetOutputReservoirBufferIndex() const { return m_CurrentFrameOutputReservoir; }
     [[nodiscard]] uint32_t GetGIOutputReservoirBufferIndex() const { return m_CurrentFrameGIOutputReservoir; }
+    [[nodiscard]] PipelineCache::Statistics GetPipelineStatistics() const { return m_PipelineCache->GetStatistics(); }
+    [[nodiscard]] uint32_t GetPipelineThreadCount() const { return m_PipelineCache->GetThreadCount(); }
 
     static donut::engine::ShaderMacro GetRegirMacro(const rtxdi::ReGIRStaticParameters& regirStaticParams);
 
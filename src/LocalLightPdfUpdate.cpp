@@ -0,0 +1,223 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LocalLightPdfUpdate.h"
+
+#include <algorithm>
+
+// Keeps the even bits, same as RTXDI_CompactBits
+static uint32_t compactBits(uint32_t x)
+{
+    x &= 0x55555555;
+    x = (x ^ (x >> 1)) & 0x33333333;
+    x = (x ^ (x >> 2)) & 0x0f0f0f0f;
+    x = (x ^ (x >> 4)) & 0x00ff00ff;
+    x = (x ^ (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+static uint32_t spreadBits(uint32_t x)
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+dm::uint2 LinearIndexToZCurve(uint32_t index)
+{
+    return dm::uint2(compactBits(index), compactBits(index >> 1));
+}
+
+static uint32_t zCurveToLinearIndex(dm::uint2 position)
+{
+    return spreadBits(position.x) | (spreadBits(position.y) << 1);
+}
+
+// Index of the texel of 'mipLevel' that covers the mip 0 texel 'texel'
+static uint32_t getAncestorTexel(uint32_t texel, uint32_t mipLevel)
+{
+    return (mipLevel < 16) ? (texel >> (2 * mipLevel)) : 0;
+}
+
+static dm::uint2 getMipSize(uint32_t width, uint32_t height, uint32_t mipLevel)
+{
+    return dm::uint2(std::max(1u, width >> mipLevel), std::max(1u, height >> mipLevel));
+}
+
+void AddPdfTexelRange(std::vector<PdfTexelRange>& ranges, uint32_t begin, uint32_t end)
+{
+    if (begin >= end)
+        return;
+
+    // Lights are usually visited in buffer order
+    if (ranges.empty() || begin > ranges.back().end)
+    {
+        ranges.push_back({ begin, end });
+        return;
+    }
+
+    auto first = std::lower_bound(ranges.begin(), ranges.end(), begin,
+        [](const PdfTexelRange& range, uint32_t value) { return range.end < value; });
+
+    auto last = first;
+    while (last != ranges.end() && last->begin <= end)
+    {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+        ++last;
+    }
+
+    if (first == last)
+    {
+        ranges.insert(first, { begin, end });
+    }
+    else
+    {
+        *first = { begin, end };
+        ranges.erase(first + 1, last);
+    }
+}
+
+bool BuildPdfMipUpdateRanges(const std::vector<PdfTexelRange>& changedTexels, uint32_t mipLevels, uint32_t maxRanges,
+    std::vector<PdfMipUpdateRange>& ranges, std::vector<PdfMipUpdateLevel>& levels)
+{
+    ranges.clear();
+    levels.assign(mipLevels, PdfMipUpdateLevel{ 0, 0, 0 });
+
+    for (uint32_t mipLevel = 1; mipLevel < mipLevels; mipLevel++)
+    {
+        PdfMipUpdateLevel& level = levels[mipLevel];
+        level.firstRange = uint32_t(ranges.size());
+
+        uint32_t begin = 0;
+        uint32_t end = 0;
+
+        auto emitRange = [&]()
+        {
+            if (ranges.size() >= maxRanges)
+                return false;
+
+            ranges.push_back({ begin, level.texelCount });
+            level.texelCount += end - begin;
+            return true;
+        };
+
+        // The changed ranges are sorted, so the shifted ones are too, but they can overlap
+        for (const PdfTexelRange& changed : changedTexels)
+        {
+            const uint32_t changedBegin = getAncestorTexel(changed.begin, mipLevel);
+            const uint32_t changedEnd = getAncestorTexel(changed.end - 1, mipLevel) + 1;
+
+            if (end > 0 && changedBegin <= end)
+            {
+                end = std::max(end, changedEnd);
+                continue;
+            }
+
+            if (end > 0 && !emitRange())
+                return false;
+
+            begin = changedBegin;
+            end = changedEnd;
+        }
+
+        if (end > 0 && !emitRange())
+            return false;
+
+        level.rangeCount = uint32_t(ranges.size()) - level.firstRange;
+    }
+
+    return true;
+}
+
+void PdfMipChain::Initialize(uint32_t _width, uint32_t _height, uint32_t mipLevels)
+{
+    width = _width;
+    height = _height;
+    levels.resize(mipLevels);
+
+    for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++)
+    {
+        const dm::uint2 size = getMipSize(width, height, mipLevel);
+        levels[mipLevel].assign(size_t(size.x) * size.y, 0.f);
+    }
+}
+
+float& PdfMipChain::Texel(uint32_t mipLevel, dm::uint2 position)
+{
+    return levels[mipLevel][size_t(position.y) * getMipSize(width, height, mipLevel).x + position.x];
+}
+
+// The children are summed in Z-curve order. Texels outside of the source level read as zero, like in GenerateMipsPass.
+static float averageChildren(PdfMipChain& chain, uint32_t mipLevel, uint32_t texel)
+{
+    const dm::uint2 sourceSize = getMipSize(chain.width, chain.height, mipLevel - 1);
+
+    float sum = 0.f;
+    for (uint32_t child = 0; child < 4; child++)
+    {
+        const dm::uint2 position = LinearIndexToZCurve(texel * 4 + child);
+        if (position.x < sourceSize.x && position.y < sourceSize.y)
+            sum += chain.Texel(mipLevel - 1, position);
+    }
+
+    return sum * 0.25f;
+}
+
+void GeneratePdfMipsReference(PdfMipChain& chain)
+{
+    for (uint32_t mipLevel = 1; mipLevel < uint32_t(chain.levels.size()); mipLevel++)
+    {
+        const dm::uint2 size = getMipSize(chain.width, chain.height, mipLevel);
+
+        for (uint32_t y = 0; y < size.y; y++)
+        {
+            for (uint32_t x = 0; x < size.x; x++)
+            {
+                const dm::uint2 position(x, y);
+                chain.Texel(mipLevel, position) = averageChildren(chain, mipLevel, zCurveToLinearIndex(position));
+            }
+        }
+    }
+}
+
+uint32_t UpdatePdfMipsReference(PdfMipChain& chain, const std::vector<PdfMipUpdateRange>& ranges, const std::vector<PdfMipUpdateLevel>& levels)
+{
+    uint32_t texelsWritten = 0;
+
+    for (uint32_t mipLevel = 1; mipLevel < uint32_t(levels.size()); mipLevel++)
+    {
+        const PdfMipUpdateLevel& level = levels[mipLevel];
+
+        for (uint32_t thread = 0; thread < level.texelCount; thread++)
+        {
+            // Find the last range that starts at or before this thread
+            uint32_t left = level.firstRange;
+            uint32_t right = level.firstRange + level.rangeCount - 1;
+            while (left < right)
+            {
+                const uint32_t middle = (left + right + 1) / 2;
+                if (ranges[middle].threadOffset <= thread)
+                    left = middle;
+                else
+                    right = middle - 1;
+            }
+
+            const uint32_t texel = ranges[left].firstTexel + (thread - ranges[left].threadOffset);
+            chain.Texel(mipLevel, LinearIndexToZCurve(texel)) = averageChildren(chain, mipLevel, texel);
+            texelsWritten++;
+        }
+    }
+
+    return texelsWritten;
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <cstdint>
+#include <vector>
+
+// Incremental updates of the local light PDF mip chain. Light i is stored at RTXDI_LinearIndexToZCurve(i) in mip 0,
+// so the texel i of mip level m is the average of the texels 4i..4i+3 of level m-1 in Z-curve order, and a range
+// of changed lights [begin, end) only affects the texels [begin >> 2m, ((end - 1) >> 2m) + 1) of level m.
+// UpdateLocalLightPdf.hlsl recomputes these texels, one dispatch per mip level, instead of the whole chain.
+
+// Texels [begin, end) of mip 0 in Z-curve order, which are also light buffer indices
+struct PdfTexelRange
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Matches the uint2 entries of t_UpdateRanges in UpdateLocalLightPdf.hlsl
+struct PdfMipUpdateRange
+{
+    uint32_t firstTexel; // in Z-curve order within the mip level
+    uint32_t threadOffset; // index of the first thread that processes this range
+};
+
+// Ranges [firstRange, firstRange + rangeCount) are processed by texelCount threads
+struct PdfMipUpdateLevel
+{
+    uint32_t firstRange;
+    uint32_t rangeCount;
+    uint32_t texelCount;
+};
+
+// Same mapping as RTXDI_LinearIndexToZCurve
+dm::uint2 LinearIndexToZCurve(uint32_t index);
+
+// Keeps the ranges sorted, ranges that overlap or touch are merged
+void AddPdfTexelRange(std::vector<PdfTexelRange>& ranges, uint32_t begin, uint32_t end);
+
+// Builds the texel ranges of mip levels 1 to mipLevels-1, levels[0] is unused.
+// Returns false if more than maxRanges ranges would be needed.
+bool BuildPdfMipUpdateRanges(const std::vector<PdfTexelRange>& changedTexels, uint32_t mipLevels, uint32_t maxRanges,
+    std::vector<PdfMipUpdateRange>& ranges, std::vector<PdfMipUpdateLevel>& levels);
+
+// CPU reference of the PDF texture, every mip level is stored row by row
+struct PdfMipChain
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::vector<float>> levels;
+
+    void Initialize(uint32_t width, uint32_t height, uint32_t mipLevels);
+    float& Texel(uint32_t mipLevel, dm::uint2 position);
+};
+
+// Computes every texel of levels 1 and up, like GenerateMipsPass but with the averaging order of the shader
+void GeneratePdfMipsReference(PdfMipChain& chain);
+
+// Does the same work as UpdateLocalLightPdf.hlsl, thread by thread. Returns the number of texels written.
+uint32_t UpdatePdfMipsReference(PdfMipChain& chain, const std::vector<PdfMipUpdateRange>& ranges, const std::vector<PdfMipUpdateLevel>& levels);
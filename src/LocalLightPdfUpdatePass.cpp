@@ -0,0 +1,123 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LocalLightPdfUpdatePass.h"
+#include "UploadRingBuffer.h"
+#include <donut/engine/ShaderFactory.h>
+#include <nvrhi/utils.h>
+
+#include <donut/core/math/math.h>
+#include <donut/core/log.h>
+
+using namespace donut::math;
+
+#include "../shaders/ShaderParameters.h"
+
+// Size of the range buffer, all mip levels together
+static constexpr uint32_t c_MaxUpdateRanges = 4096;
+
+// Above this fraction of changed texels, GenerateMipsPass is faster than one dispatch per mip level
+static constexpr uint32_t c_MaxChangedTexelsFraction = 8;
+
+LocalLightPdfUpdatePass::LocalLightPdfUpdatePass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+    std::shared_ptr<UploadRingBuffer> uploadRing,
+    nvrhi::ITexture* localLightPdfTexture)
+    : m_PdfTexture(localLightPdfTexture)
+    , m_UploadRing(std::move(uploadRing))
+{
+    donut::log::debug("Initializing LocalLightPdfUpdatePass...");
+
+    const auto& pdfDesc = m_PdfTexture->getDesc();
+
+    nvrhi::BufferDesc rangeBufferDesc;
+    rangeBufferDesc.byteSize = sizeof(PdfMipUpdateRange) * c_MaxUpdateRanges;
+    rangeBufferDesc.structStride = sizeof(PdfMipUpdateRange);
+    rangeBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    rangeBufferDesc.keepInitialState = true;
+    rangeBufferDesc.debugName = "LocalLightPdfUpdateRanges";
+    m_RangeBuffer = device->createBuffer(rangeBufferDesc);
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(LocalLightPdfUpdateConstants)),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_RangeBuffer)
+    };
+
+    for (uint32_t mipLevel = 0; mipLevel < pdfDesc.mipLevels; mipLevel++)
+    {
+        bindingSetDesc.bindings.push_back(nvrhi::BindingSetItem::Texture_UAV(
+            mipLevel,
+            m_PdfTexture,
+            nvrhi::Format::UNKNOWN,
+            nvrhi::TextureSubresourceSet(mipLevel, 1, 0, 1)));
+    }
+
+    nvrhi::BindingLayoutHandle bindingLayout;
+    nvrhi::utils::CreateBindingSetAndLayout(device, nvrhi::ShaderType::Compute, 0,
+        bindingSetDesc, bindingLayout, m_BindingSet);
+
+    nvrhi::ShaderHandle shader = shaderFactory->CreateShader("app/UpdateLocalLightPdf.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { bindingLayout };
+    pipelineDesc.CS = shader;
+    m_Pipeline = device->createComputePipeline(pipelineDesc);
+}
+
+bool LocalLightPdfUpdatePass::Process(nvrhi::ICommandList* commandList, const std::vector<PdfTexelRange>& changedTexels)
+{
+    const auto& pdfDesc = m_PdfTexture->getDesc();
+
+    uint64_t changedTexelCount = 0;
+    for (const PdfTexelRange& range : changedTexels)
+        changedTexelCount += range.end - range.begin;
+
+    if (changedTexelCount * c_MaxChangedTexelsFraction > uint64_t(pdfDesc.width) * pdfDesc.height)
+        return false;
+
+    if (!BuildPdfMipUpdateRanges(changedTexels, pdfDesc.mipLevels, c_MaxUpdateRanges, m_Ranges, m_Levels))
+        return false;
+
+    if (m_Ranges.empty())
+        return true;
+
+    commandList->beginMarker("UpdateLocalLightPdf");
+
+    m_UploadRing->Write(commandList, m_RangeBuffer, m_Ranges.data(), m_Ranges.size() * sizeof(PdfMipUpdateRange));
+    m_UploadRing->Flush(commandList);
+
+    for (uint32_t mipLevel = 1; mipLevel < pdfDesc.mipLevels; mipLevel++)
+    {
+        const PdfMipUpdateLevel& level = m_Levels[mipLevel];
+
+        nvrhi::ComputeState state;
+        state.pipeline = m_Pipeline;
+        state.bindings = { m_BindingSet };
+        commandList->setComputeState(state);
+
+        LocalLightPdfUpdateConstants constants{};
+        constants.sourceSize = { std::max(1u, pdfDesc.width >> (mipLevel - 1)), std::max(1u, pdfDesc.height >> (mipLevel - 1)) };
+        constants.destMipLevel = mipLevel;
+        constants.firstRange = level.firstRange;
+        constants.rangeCount = level.rangeCount;
+        constants.texelCount = level.texelCount;
+        commandList->setPushConstants(&constants, sizeof(constants));
+
+        commandList->dispatch(div_ceil(level.texelCount, 64));
+
+        commandList->clearState(); // make sure nvrhi inserts a barrier
+    }
+
+    commandList->endMarker();
+
+    return true;
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "LocalLightPdfUpdate.h"
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+class UploadRingBuffer;
+
+// Updates the mips of the local light PDF texture above the texels written by PrepareLightsPass
+// for the lights that changed, instead of regenerating the whole chain with GenerateMipsPass.
+class LocalLightPdfUpdatePass
+{
+private:
+    nvrhi::ComputePipelineHandle m_Pipeline;
+    nvrhi::BindingSetHandle m_BindingSet;
+    nvrhi::TextureHandle m_PdfTexture;
+    nvrhi::BufferHandle m_RangeBuffer;
+    std::shared_ptr<UploadRingBuffer> m_UploadRing;
+
+    std::vector<PdfMipUpdateRange> m_Ranges;
+    std::vector<PdfMipUpdateLevel> m_Levels;
+
+public:
+    LocalLightPdfUpdatePass(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        std::shared_ptr<UploadRingBuffer> uploadRing,
+        nvrhi::ITexture* localLightPdfTexture);
+
+    // Returns false if the changes are too large for an incremental update,
+    // then the whole texture should be processed with GenerateMipsPass.
+    bool Process(nvrhi::ICommandList* commandList, const std::vector<PdfTexelRange>& changedTexels);
+};
@@ -0,0 +1,341 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "PipelineCache.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace donut;
+namespace fs = std::filesystem;
+using namespace std::chrono;
+
+static const char* c_CacheFileHeader = "# Pipeline cache: <used by the last run> <creation time in ms> <key>";
+
+PipelineCache::PipelineCache(const fs::path& fileName, uint32_t threadCount)
+    : m_FileName(fileName)
+{
+    Load();
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_Threads.emplace_back(&PipelineCache::WorkerThread, this);
+}
+
+PipelineCache::~PipelineCache()
+{
+    Clear();
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Terminate = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& thread : m_Threads)
+        thread.join();
+
+    Save();
+}
+
+void PipelineCache::Load()
+{
+    if (m_FileName.empty())
+        return;
+
+    std::ifstream file(m_FileName);
+    if (!file.is_open())
+        return;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream ls(line);
+        int used = 0;
+        Record record;
+        std::string key;
+        ls >> used >> record.createTime >> std::ws;
+        std::getline(ls, key);
+
+        if (ls.fail() || key.empty())
+        {
+            log::warning("Ignoring the pipeline cache file %s, it is malformed", m_FileName.generic_string().c_str());
+            m_PreviousRecords.clear();
+            return;
+        }
+
+        record.used = used != 0;
+        m_PreviousRecords[key] = record;
+    }
+}
+
+void PipelineCache::Save()
+{
+    if (m_FileName.empty())
+        return;
+
+    std::unordered_map<std::string, Record> records;
+    {
+        std::lock_guard lock(m_Mutex);
+
+        // Keep the creation times of the pipelines that this run didn't need, for the statistics of the next runs.
+        // A run that exits before rendering anything keeps the used pipelines of the last one.
+        const bool anyUsed = std::any_of(m_Records.begin(), m_Records.end(), [](const auto& it) { return it.second.used; });
+        for (const auto& [key, record] : m_PreviousRecords)
+            records[key] = Record{ record.createTime, record.used && !anyUsed };
+        for (const auto& [key, record] : m_Records)
+        {
+            Record& merged = records[key];
+            if (record.createTime > 0.0)
+                merged.createTime = record.createTime;
+            merged.used = merged.used || record.used;
+        }
+    }
+
+    std::vector<std::string> keys;
+    for (const auto& it : records)
+        keys.push_back(it.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::ofstream file(m_FileName);
+    if (!file.is_open())
+    {
+        log::warning("Failed to write the pipeline cache file %s", m_FileName.generic_string().c_str());
+        return;
+    }
+
+    file << c_CacheFileHeader << "\n";
+    char prefix[64];
+    for (const std::string& key : keys)
+    {
+        const Record& record = records[key];
+        snprintf(prefix, sizeof(prefix), "%d %.3f ", record.used ? 1 : 0, record.createTime);
+        file << prefix << key << "\n";
+    }
+}
+
+void PipelineCache::Declare(const std::string& key, CreateFunction prepare, CreateFunction create)
+{
+    std::unique_lock lock(m_Mutex);
+
+    auto existing = m_Entries.find(key);
+    if (existing != m_Entries.end())
+        m_WorkDone.wait(lock, [&existing] { return existing->second.state != State::Running; });
+
+    Entry& entry = m_Entries[key];
+    entry = Entry();
+    entry.prepare = std::move(prepare);
+    entry.create = std::move(create);
+    m_Statistics.declared++;
+
+    // Permutations that this run or the last one used are likely to be used again soon
+    auto previous = m_PreviousRecords.find(key);
+    auto current = m_Records.find(key);
+    const bool used = (previous != m_PreviousRecords.end() && previous->second.used) || (current != m_Records.end() && current->second.used);
+    if (used && !m_Threads.empty())
+    {
+        if (!Prepare(key, entry))
+            return;
+
+        m_Statistics.prewarmed++;
+        entry.state = State::Queued;
+        m_Queue.push_back(key);
+        m_WorkAvailable.notify_one();
+    }
+}
+
+void PipelineCache::Request(const std::string& key)
+{
+    if (m_Threads.empty())
+        return;
+
+    std::lock_guard lock(m_Mutex);
+
+    auto it = m_Entries.find(key);
+    if (it == m_Entries.end() || it->second.state != State::Declared)
+        return;
+
+    if (!Prepare(key, it->second))
+        return;
+
+    it->second.state = State::Queued;
+    m_Queue.push_back(key);
+    m_WorkAvailable.notify_one();
+}
+
+bool PipelineCache::Wait(const std::string& key)
+{
+    std::unique_lock lock(m_Mutex);
+
+    auto it = m_Entries.find(key);
+    if (it == m_Entries.end())
+    {
+        log::error("Pipeline %s is used without being declared", key.c_str());
+        return false;
+    }
+
+    Entry& entry = it->second;
+    if (!entry.used)
+    {
+        entry.used = true;
+        m_Records[key].used = true;
+    }
+
+    if (entry.state == State::Done)
+        return entry.success;
+
+    const auto startTime = steady_clock::now();
+
+    if (entry.state == State::Running)
+    {
+        m_WorkDone.wait(lock, [&entry] { return entry.state == State::Done; });
+    }
+    else
+    {
+        // Not started by a worker yet, creating it here is faster than waiting for a free worker
+        if (entry.state == State::Queued)
+            m_Queue.erase(std::find(m_Queue.begin(), m_Queue.end(), key));
+
+        if (Prepare(key, entry))
+            Create(lock, key, entry);
+    }
+
+    m_Statistics.waitTime += duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+    return entry.success;
+}
+
+void PipelineCache::Clear()
+{
+    std::unique_lock lock(m_Mutex);
+
+    for (const std::string& key : m_Queue)
+        m_Entries[key].state = State::Declared;
+    m_Queue.clear();
+
+    m_WorkDone.wait(lock, [this]
+    {
+        return std::none_of(m_Entries.begin(), m_Entries.end(), [](const auto& it) { return it.second.state == State::Running; });
+    });
+
+    for (const auto& [key, entry] : m_Entries)
+    {
+        if (entry.state == State::Done)
+            continue;
+
+        m_Statistics.skipped++;
+        auto previous = m_PreviousRecords.find(key);
+        if (previous != m_PreviousRecords.end())
+            m_Statistics.skippedTime += previous->second.createTime;
+    }
+
+    m_Entries.clear();
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics() const
+{
+    std::lock_guard lock(m_Mutex);
+
+    Statistics statistics = m_Statistics;
+    for (const auto& [key, entry] : m_Entries)
+    {
+        if (entry.state == State::Done)
+            continue;
+
+        statistics.skipped++;
+        auto previous = m_PreviousRecords.find(key);
+        if (previous != m_PreviousRecords.end())
+            statistics.skippedTime += previous->second.createTime;
+    }
+
+    return statistics;
+}
+
+bool PipelineCache::Prepare(const std::string& key, Entry& entry)
+{
+    if (!entry.prepare)
+        return true;
+
+    const auto startTime = steady_clock::now();
+    const bool success = entry.prepare();
+    entry.prepareTime = duration<double, std::milli>(steady_clock::now() - startTime).count();
+    entry.prepare = nullptr;
+
+    if (success)
+        return true;
+
+    entry.state = State::Done;
+    entry.success = false;
+    entry.create = nullptr;
+    m_Records[key].createTime = entry.prepareTime;
+    m_Statistics.createTime += entry.prepareTime;
+    m_Statistics.failed++;
+    log::error("Failed to prepare pipeline %s", key.c_str());
+
+    m_WorkDone.notify_all();
+    return false;
+}
+
+void PipelineCache::Create(std::unique_lock<std::mutex>& lock, const std::string& key, Entry& entry)
+{
+    entry.state = State::Running;
+    CreateFunction create = std::move(entry.create);
+
+    lock.unlock();
+    const auto startTime = steady_clock::now();
+    const bool success = create();
+    const double createTime = entry.prepareTime + duration<double, std::milli>(steady_clock::now() - startTime).count();
+    lock.lock();
+
+    // Clear and Declare wait for running entries, so the entry is still there
+    entry.state = State::Done;
+    entry.success = success;
+
+    m_Records[key].createTime = createTime;
+    m_Statistics.createTime += createTime;
+    if (success)
+        m_Statistics.created++;
+    else
+    {
+        m_Statistics.failed++;
+        log::error("Failed to create pipeline %s", key.c_str());
+    }
+
+    m_WorkDone.notify_all();
+}
+
+void PipelineCache::WorkerThread()
+{
+    std::unique_lock lock(m_Mutex);
+
+    while (true)
+    {
+        m_WorkAvailable.wait(lock, [this] { return m_Terminate || !m_Queue.empty(); });
+
+        if (m_Terminate)
+            return;
+
+        const std::string key = m_Queue.front();
+        m_Queue.pop_front();
+
+        auto it = m_Entries.find(key);
+        if (it == m_Entries.end() || it->second.state != State::Queued)
+            continue;
+
+        Create(lock, key, it->second);
+    }
+}
@@ -0,0 +1,119 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Creates pipelines on worker threads when they are first needed instead of all of them up front.
+// Pipelines are declared with a function that creates them, requested when a pass that uses them is set up,
+// and waited for right before they are recorded. Waiting for a pipeline that no worker has started yet
+// creates it on the calling thread.
+// The cache file remembers the pipelines that were used and how long they took to create, so that the next run
+// requests the used ones as soon as they are declared, and can report the time saved on the others.
+// Redeclared pipelines that were used earlier in the same run are requested right away too.
+class PipelineCache
+{
+public:
+    typedef std::function<bool()> CreateFunction;
+
+    struct Statistics
+    {
+        uint32_t declared = 0;
+        uint32_t created = 0;
+        uint32_t failed = 0;
+        uint32_t prewarmed = 0;        // requested at declaration because they were used before
+        double createTime = 0.0;       // ms including the preparation, summed over all threads
+        double waitTime = 0.0;         // ms that the waiting threads were blocked
+        uint32_t skipped = 0;          // declared but never created
+        double skippedTime = 0.0;      // ms that the skipped pipelines took to create in earlier runs, when known
+    };
+
+    // An empty file name disables the cache file, zero threads creates every pipeline on first use on the waiting thread
+    PipelineCache(const std::filesystem::path& fileName, uint32_t threadCount);
+    ~PipelineCache();
+
+    // Makes a pipeline known under a key that identifies its shader permutation. 'prepare' is optional and runs
+    // with the cache locked on the thread that first requests or waits for the pipeline, for the work that is not
+    // thread-safe such as loading shaders. 'create' runs on any thread. Declaring a key again creates it again.
+    void Declare(const std::string& key, CreateFunction prepare, CreateFunction create);
+
+    // Queues a declared pipeline for a worker thread unless it has been started already
+    void Request(const std::string& key);
+
+    // Returns true once the pipeline exists and marks it as used
+    bool Wait(const std::string& key);
+
+    // Waits for the pipelines being created and forgets all declarations, the functions must not be called anymore.
+    // Statistics and the used pipelines are kept.
+    void Clear();
+
+    // Writes the used pipelines and the creation times to the cache file
+    void Save();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+    [[nodiscard]] uint32_t GetThreadCount() const { return uint32_t(m_Threads.size()); }
+
+private:
+    enum class State
+    {
+        Declared,
+        Queued,
+        Running,
+        Done
+    };
+
+    struct Entry
+    {
+        CreateFunction prepare;
+        CreateFunction create;
+        double prepareTime = 0.0;
+        State state = State::Declared;
+        bool success = false;
+        bool used = false;
+    };
+
+    struct Record
+    {
+        double createTime = 0.0; // ms
+        bool used = false;
+    };
+
+    std::filesystem::path m_FileName;
+    std::vector<std::thread> m_Threads;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkDone;
+    std::deque<std::string> m_Queue;
+    std::unordered_map<std::string, Entry> m_Entries;
+    bool m_Terminate = false;
+
+    std::unordered_map<std::string, Record> m_PreviousRecords; // from the cache file
+    std::unordered_map<std::string, Record> m_Records;         // from this run
+    Statistics m_Statistics;
+
+    void Load();
+    void WorkerThread();
+
+    // Called with the lock held, returns false and completes the entry if the preparation fails
+    bool Prepare(const std::string& key, Entry& entry);
+
+    // Called with the lock held, unlocks it while the function runs
+    void Create(std::unique_lock<std::mutex>& lock, const std::string& key, Entry& entry);
+};
@@ -11,6 +11,9 @@
 #include "PrepareLightsPass.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
+#include "CpuProfiler.h"
+#include "LocalLightPdfUpdate.h"
+#include "UploadRingBuffer.h"
 
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
@@ -19,6 +22,8 @@
 #include <rtxdi/ReSTIRDI.h>
 
 #include <algorithm>
+#include <cstring>
+#include <unordered_set>
 #include <utility>
 
 using namespace donut::math;
@@ -26,18 +31,23 @@ using namespace donut::math;
 
 using namespace donut::engine;
 
+// Beyond this many changed ranges, clearing the PDF texture and regenerating its mips is simpler
+static constexpr size_t c_MaxChangedPdfRanges = 1024;
+
 
 PrepareLightsPass::PrepareLightsPass(
     nvrhi::IDevice* device, 
     std::shared_ptr<ShaderFactory> shaderFactory, 
     std::shared_ptr<CommonRenderPasses> commonPasses,
     std::shared_ptr<donut::engine::Scene> scene,
+    std::shared_ptr<UploadRingBuffer> uploadRing,
     nvrhi::IBindingLayout* bindlessLayout)
     : m_Device(device)
     , m_BindlessLayout(bindlessLayout)
     , m_ShaderFactory(std::move(shaderFactory))
     , m_CommonPasses(std::move(commonPasses))
     , m_Scene(std::move(scene))
+    , m_UploadRing(std::move(uploadRing))
 {
     nvrhi::BindingLayoutDesc bindingLayoutDesc;
     bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
@@ -97,25 +107,52 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
     m_GeometryInstanceToLightBuffer = resources.GeometryInstanceToLightBuffer;
     m_LocalLightPdfTexture = resources.LocalLightPdfTexture;
     m_MaxLightsInBuffer = uint32_t(resources.LightDataBuffer->getDesc().byteSize / (sizeof(PolymorphicLightInfo) * 2));
+
+    // New texture, clear it on the next frame
+    m_TaskBuilder.InvalidateLocalLightPdf();
 }
 
 void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles)
 {
-    numEmissiveMeshes = 0;
-    numEmissiveTriangles = 0;
+    // Material flags are cleared by Scene::RefreshBuffers, which runs later in the frame
+    bool materialsChanged = false;
+    for (const auto& material : m_Scene->GetSceneGraph()->GetMaterials())
+        materialsChanged |= material->dirty;
+
+    // Also used by the task builder to find the local light PDF texels that change
+    if (materialsChanged)
+        m_TaskBuilder.MarkMaterialsChanged();
 
-    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
-    for (const auto& instance : instances)
+    if (!m_LightCountsValid || materialsChanged)
     {
-        for (const auto& geometry : instance->GetMesh()->geometries)
+        m_NumEmissiveMeshes = 0;
+        m_NumEmissiveTriangles = 0;
+
+        const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
+        for (const auto& instance : instances)
         {
-            if (any(geometry->material->emissiveColor != 0.f))
+            for (const auto& geometry : instance->GetMesh()->geometries)
             {
-                numEmissiveMeshes += 1;
-                numEmissiveTriangles += geometry->numIndices / 3;
+                if (any(geometry->material->emissiveColor != 0.f))
+                {
+                    m_NumEmissiveMeshes += 1;
+                    m_NumEmissiveTriangles += geometry->numIndices / 3;
+                }
             }
         }
+
+        m_LightCountsValid = true;
     }
+
+    numEmissiveMeshes = m_NumEmissiveMeshes;
+    numEmissiveTriangles = m_NumEmissiveTriangles;
+}
+
+void PrepareLightsPass::SetLightCounts(uint32_t numEmissiveMeshes, uint32_t numEmissiveTriangles)
+{
+    m_NumEmissiveMeshes = numEmissiveMeshes;
+    m_NumEmissiveTriangles = numEmissiveTriangles;
+    m_LightCountsValid = true;
 }
 
 static inline uint floatToUInt(float _V, float _Scale)
@@ -196,7 +233,7 @@ static uint16_t fp32ToFp16(float v)
     return (uint16_t)(sign >> 16 | body >> 13) & 0xFFFF;
 }
 
-static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
+bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
 {
     switch (light.GetLightType())
     {
@@ -329,6 +366,24 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
     }
 }
 
+// Same encoding as TriangleLight::Store in PolymorphicLight.hlsli
+PolymorphicLightInfo ConvertTriangleLight(const float3& v0, const float3& v1, const float3& v2, const float3& radiance)
+{
+    PolymorphicLightInfo polymorphic = {};
+
+    const float3 edge1 = v1 - v0;
+    const float3 edge2 = v2 - v0;
+
+    packLightColor(radiance, polymorphic);
+    polymorphic.center = (v0 + v1 + v2) / 3.f;
+    polymorphic.direction1 = packNormalizedVector(normalize(edge1));
+    polymorphic.direction2 = packNormalizedVector(normalize(edge2));
+    polymorphic.scalars = fp32ToFp16(length(edge1)) | (fp32ToFp16(length(edge2)) << 16);
+    polymorphic.colorTypeAndFlags |= (uint32_t)PolymorphicLightType::kTriangle << kPolymorphicLightTypeShift;
+
+    return polymorphic;
+}
+
 static int isInfiniteLight(const donut::engine::Light& light)
 {
     switch (light.GetLightType())
@@ -344,147 +399,380 @@ static int isInfiniteLight(const donut::engine::Light& light)
     }
 }
 
-RTXDI_LightBufferParameters PrepareLightsPass::Process(
-    nvrhi::ICommandList* commandList,
-    const rtxdi::ReSTIRDIContext& context,
-    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
-    bool enableImportanceSampledEnvironmentLight,
-    bool enableVirtualLights,
-    uint32_t virtualLightsSamplesPerFrame,
-    uint32_t virtualLightsSampleLifespan,
-    bool lockVirtualLights,
-    bool addVirtualLightsToGeometryMap)
+LightTaskBuilder::LightTaskBuilder() = default;
+LightTaskBuilder::~LightTaskBuilder() = default;
+
+void LightTaskBuilder::ClassifyStaticLights(const SceneGraph& sceneGraph)
 {
-    RTXDI_LightBufferParameters outLightBufferParams = {};
-    const rtxdi::ReSTIRDIStaticParameters& contextParameters = context.getStaticParameters();
+    std::unordered_set<const SceneGraphNode*> animatedNodes;
+    for (const auto& animation : sceneGraph.GetAnimations())
+    {
+        for (const auto& channel : animation->GetChannels())
+        {
+            const auto& targetNode = channel->GetTargetNode();
+            if (targetNode)
+                animatedNodes.insert(targetNode.get());
+        }
+    }
 
-    commandList->beginMarker("PrepareLights");
+    // A node moves when it or any of its ancestors is animated
+    auto isAnimated = [&animatedNodes](const SceneGraphNode* node)
+    {
+        for (; node; node = node->GetParent())
+        {
+            if (animatedNodes.count(node))
+                return true;
+        }
+        return false;
+    };
+
+    m_StaticInstances.clear();
+    m_StaticPrimitiveLights.clear();
+
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+        if (mesh->skinPrototype || isAnimated(instance->GetNode()))
+            continue;
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+        {
+            size_t instanceHash = 0;
+            nvrhi::hash_combine(instanceHash, instance.get());
+            nvrhi::hash_combine(instanceHash, geometryIndex);
+            m_StaticInstances.insert(instanceHash);
+        }
+    }
+
+    // Infinite lights are stored after all local lights and stay dynamic
+    for (const auto& pLight : sceneGraph.GetLights())
+    {
+        if (!isInfiniteLight(*pLight) && !isAnimated(pLight->GetNode()))
+            m_StaticPrimitiveLights.insert(pLight.get());
+    }
+
+    m_StaticLightRebuildFrames = 2;
+}
+
+void PrepareLightsPass::ClassifyStaticLights()
+{
+    m_TaskBuilder.ClassifyStaticLights(*m_Scene->GetSceneGraph());
+}
+
+void PrepareLightsPass::BuildTasks(const LightTaskSettings& settings, FramePacket& packet)
+{
+    m_TaskBuilder.Build(*m_Scene->GetSceneGraph(), settings, packet);
+}
+
+void LightTaskBuilder::Build(const SceneGraph& sceneGraph, const LightTaskSettings& settings, FramePacket& packet)
+{
+    CpuProfilerScope cpuScope("LightTaskBuilder::Build");
 
-    std::vector<PrepareLightsTask> tasks;
-    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    const bool enableVirtualLights = settings.enableVirtualLights;
+    const uint32_t virtualLightsSamplesPerFrame = settings.virtualLightsSamplesPerFrame;
+    const uint32_t virtualLightsSampleLifespan = settings.virtualLightsSampleLifespan;
+    const bool lockVirtualLights = settings.lockVirtualLights;
+
+    packet.lightTaskSettings = settings;
+
+    std::vector<PrepareLightsTask>& tasks = packet.lightTasks;
+    std::vector<PrepareLightsTask> staticTasks;
+    std::vector<PolymorphicLightInfo>& primitiveLightInfos = packet.primitiveLightInfos;
+    std::vector<PolymorphicLightInfo> staticPrimitiveLightInfos;
+    std::vector<PolymorphicLightInfo> convertedLightInfos;
     uint32_t lightBufferOffset = 0;
-    uint32_t taskBufferOffset = 0;
+
+    tasks.clear();
+    primitiveLightInfos.clear();
 
     if (enableVirtualLights)
-    {
         lightBufferOffset = virtualLightsSamplesPerFrame * virtualLightsSampleLifespan;
-        taskBufferOffset = virtualLightsSamplesPerFrame * (virtualLightsSampleLifespan - 1);
-    }
-    
-    std::vector<uint32_t> geometryInstanceToLight(m_Scene->GetSceneGraph()->GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
 
-    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
-    for (const auto& instance : instances)
+    // The PDF texels of the lights that may have changed since the previous frame are tracked, so that only their
+    // ancestors in the mip chain need to be updated. Material changes and a different virtual light layout
+    // can change any light, then the whole chain is regenerated.
+    const bool virtualLightLayoutChanged = enableVirtualLights != m_VirtualLightsEnabled || (enableVirtualLights &&
+        (virtualLightsSamplesPerFrame != m_VirtualLightsSamplesPerFrame || virtualLightsSampleLifespan != m_VirtualLightsSampleLifespan));
+    const bool materialsChanged = m_MaterialsChanged;
+    bool trackPdfChanges = settings.incrementalLocalLightPdf && m_LocalLightPdfValid && !materialsChanged && !virtualLightLayoutChanged;
+    m_MaterialsChanged = false;
+
+    // Material changes affect the flux of static lights, and new resources do not hold them yet.
+    // Layout changes are found below from the offsets of the static lights.
+    if (!settings.enableStaticLightRegion || materialsChanged || !m_LocalLightPdfValid)
+        m_StaticLightRebuildFrames = 2;
+
+    if (enableVirtualLights)
     {
-        const auto& mesh = instance->GetMesh();
+        // The virtual lights that are not sampled on this frame are copied between the two halves of the light buffer.
+        // Both halves only hold the same lights after every block has been sampled once, or after the lights are locked.
+        if (virtualLightLayoutChanged || lockVirtualLights != m_VirtualLightsLocked || settings.frameIndex != m_PreviousFrameIndex + 1)
+            m_VirtualLightsUnstableFrames = virtualLightsSampleLifespan + 1;
 
-        assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
-        uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
+        if (trackPdfChanges)
+        {
+            if (m_VirtualLightsUnstableFrames > 0 || !settings.virtualLightsRingComplete)
+            {
+                AddPdfTexelRange(m_ChangedPdfTexels, 0, virtualLightsSamplesPerFrame * virtualLightsSampleLifespan);
+            }
+            else if (!lockVirtualLights && settings.virtualLightsCurrentBlock < virtualLightsSampleLifespan)
+            {
+                const uint32_t currentBlock = settings.virtualLightsCurrentBlock;
+                AddPdfTexelRange(m_ChangedPdfTexels, currentBlock * virtualLightsSamplesPerFrame, (currentBlock + 1) * virtualLightsSamplesPerFrame);
+            }
+        }
 
-        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+        if (m_VirtualLightsUnstableFrames > 0)
+            m_VirtualLightsUnstableFrames--;
+    }
+
+    m_VirtualLightsEnabled = enableVirtualLights;
+    m_VirtualLightsLocked = lockVirtualLights;
+    m_VirtualLightsSamplesPerFrame = virtualLightsSamplesPerFrame;
+    m_VirtualLightsSampleLifespan = virtualLightsSampleLifespan;
+    m_PreviousFrameIndex = settings.frameIndex;
+    
+    std::vector<uint32_t>& geometryInstanceToLight = packet.geometryInstanceToLight;
+    geometryInstanceToLight.assign(sceneGraph.GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
+
+    // Emissive geometry and primitive lights are placed in two passes, first the static lights and then the dynamic ones.
+    // Static lights that move or change on their own are found here, they are moved to the dynamic region on the next frame.
+    auto addMeshLights = [&](bool staticPass)
+    {
+        const auto& instances = sceneGraph.GetMeshInstances();
+        for (const auto& instance : instances)
         {
-            const auto& geometry = mesh->geometries[geometryIndex];
+            const auto& mesh = instance->GetMesh();
 
-            size_t instanceHash = 0;
-            nvrhi::hash_combine(instanceHash, instance.get());
-            nvrhi::hash_combine(instanceHash, geometryIndex);
+            assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
+            uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
 
-            if (!any(geometry->material->emissiveColor != 0.f) || geometry->material->emissiveIntensity <= 0.f)
+            for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
             {
-                // remove the info about this instance, just in case it was emissive and now it's not
-                m_InstanceLightBufferOffsets.erase(instanceHash);
-                continue;
+                const auto& geometry = mesh->geometries[geometryIndex];
+
+                size_t instanceHash = 0;
+                nvrhi::hash_combine(instanceHash, instance.get());
+                nvrhi::hash_combine(instanceHash, geometryIndex);
+
+                if (!any(geometry->material->emissiveColor != 0.f) || geometry->material->emissiveIntensity <= 0.f)
+                {
+                    // remove the info about this instance, just in case it was emissive and now it's not
+                    m_InstanceLightBufferOffsets.erase(instanceHash);
+                    continue;
+                }
+
+                if ((m_StaticInstances.count(instanceHash) != 0) != staticPass)
+                    continue;
+
+                geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
+
+                // find the previous offset of this instance in the light buffer
+                auto pOffset = m_InstanceLightBufferOffsets.find(instanceHash);
+
+                assert(geometryIndex < 0xfff);
+
+                PrepareLightsTask task;
+                task.instanceAndGeometryIndex = (instance->GetInstanceIndex() << 12) | uint32_t(geometryIndex & 0xfff);
+                task.lightBufferOffset = lightBufferOffset;
+                task.triangleCount = geometry->numIndices / 3;
+                task.previousLightBufferOffset = (pOffset != m_InstanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
+
+                // record the current offset of this instance for use on the next frame
+                m_InstanceLightBufferOffsets[instanceHash] = lightBufferOffset;
+
+                // Skinned meshes change their vertices without changing the transform
+                const affine3 transform = instance->GetNode()->GetLocalToWorldTransformFloat();
+                auto pTransform = m_InstanceLightTransforms.find(instanceHash);
+                const bool moved = pTransform == m_InstanceLightTransforms.end() || memcmp(&pTransform->second, &transform, sizeof(affine3)) != 0;
+                const bool offsetChanged = task.previousLightBufferOffset != int(lightBufferOffset);
+                if (trackPdfChanges && (mesh->skinPrototype || moved || offsetChanged))
+                {
+                    AddPdfTexelRange(m_ChangedPdfTexels, lightBufferOffset, lightBufferOffset + task.triangleCount);
+                }
+
+                if (staticPass && (moved || offsetChanged))
+                {
+                    if (pTransform != m_InstanceLightTransforms.end() && moved)
+                        m_StaticInstances.erase(instanceHash);
+                    m_StaticLightRebuildFrames = 2;
+                }
+                m_InstanceLightTransforms[instanceHash] = transform;
+
+                lightBufferOffset += task.triangleCount;
+
+                (staticPass ? staticTasks : tasks).push_back(task);
             }
+        }
+    };
 
-            geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
+    auto sortedLights = sceneGraph.GetLights();
+    std::sort(sortedLights.begin(), sortedLights.end(), [](const auto& a, const auto& b) 
+        { return isInfiniteLight(*a) < isInfiniteLight(*b); });
+
+    uint32_t numInfinitePrimLights = 0;
+    uint32_t numImportanceSampledEnvironmentLights = 0;
+
+    auto addPrimitiveLights = [&](bool staticPass)
+    {
+        for (const std::shared_ptr<Light>& pLight : sortedLights)
+        {
+            if ((m_StaticPrimitiveLights.count(pLight.get()) != 0) != staticPass)
+                continue;
+
+            PolymorphicLightInfo polymorphicLight = {};
+
+            if (!ConvertLight(*pLight, polymorphicLight, settings.enableImportanceSampledEnvironmentLight))
+                continue;
 
             // find the previous offset of this instance in the light buffer
-            auto pOffset = m_InstanceLightBufferOffsets.find(instanceHash);
+            auto pOffset = m_PrimitiveLightBufferOffsets.find(pLight.get());
 
-            assert(geometryIndex < 0xfff);
+            std::vector<PolymorphicLightInfo>& infos = staticPass ? staticPrimitiveLightInfos : primitiveLightInfos;
 
             PrepareLightsTask task;
-            task.instanceAndGeometryIndex = (instance->GetInstanceIndex() << 12) | uint32_t(geometryIndex & 0xfff);
+            task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(infos.size());
             task.lightBufferOffset = lightBufferOffset;
-            task.triangleCount = geometry->numIndices / 3;
-            task.previousLightBufferOffset = (pOffset != m_InstanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
+            task.triangleCount = 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
+            task.previousLightBufferOffset = (pOffset != m_PrimitiveLightBufferOffsets.end()) ? pOffset->second : -1;
 
             // record the current offset of this instance for use on the next frame
-            m_InstanceLightBufferOffsets[instanceHash] = lightBufferOffset;
+            m_PrimitiveLightBufferOffsets[pLight.get()] = lightBufferOffset;
+
+            auto pInfo = m_PrimitiveLightInfoIndices.find(pLight.get());
+            const bool hasPreviousInfo = pInfo != m_PrimitiveLightInfoIndices.end() && pInfo->second < m_PreviousPrimitiveLightInfos.size();
+            const bool changed = !hasPreviousInfo ||
+                memcmp(&m_PreviousPrimitiveLightInfos[pInfo->second], &polymorphicLight, sizeof(PolymorphicLightInfo)) != 0;
+            const bool offsetChanged = task.previousLightBufferOffset != int(lightBufferOffset);
+            if (trackPdfChanges && (changed || offsetChanged))
+            {
+                AddPdfTexelRange(m_ChangedPdfTexels, lightBufferOffset, lightBufferOffset + 1);
+            }
+
+            if (staticPass && (changed || offsetChanged))
+            {
+                if (hasPreviousInfo && changed)
+                    m_StaticPrimitiveLights.erase(pLight.get());
+                m_StaticLightRebuildFrames = 2;
+            }
+
+            m_PrimitiveLightInfoIndices[pLight.get()] = uint32_t(convertedLightInfos.size());
+            convertedLightInfos.push_back(polymorphicLight);
 
             lightBufferOffset += task.triangleCount;
 
-            tasks.push_back(task);
+            (staticPass ? staticTasks : tasks).push_back(task);
+            infos.push_back(polymorphicLight);
+
+            if (pLight->GetLightType() == LightType_Environment && settings.enableImportanceSampledEnvironmentLight)
+                numImportanceSampledEnvironmentLights++;
+            else if (isInfiniteLight(*pLight))
+                numInfinitePrimLights++;
         }
-    }
+    };
 
-    commandList->writeBuffer(m_GeometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
+    // Static region: lights that are only written by the shader when the region is rebuilt
+    const uint32_t firstStaticLight = lightBufferOffset;
+    addMeshLights(true);
+    addPrimitiveLights(true);
+    const uint32_t firstDynamicLight = lightBufferOffset;
 
-    outLightBufferParams.localLightBufferRegion.firstLightIndex = 0;
-    outLightBufferParams.localLightBufferRegion.numLights = lightBufferOffset;
+    // Dynamic region: all other local lights, then the infinite lights
+    addMeshLights(false);
+    addPrimitiveLights(false);
 
-    auto sortedLights = sceneLights;
-    std::sort(sortedLights.begin(), sortedLights.end(), [](const auto& a, const auto& b) 
-        { return isInfiniteLight(*a) < isInfiniteLight(*b); });
+    assert(numImportanceSampledEnvironmentLights <= 1);
 
-    uint32_t numFinitePrimLights = 0;
-    uint32_t numInfinitePrimLights = 0;
-    uint32_t numImportanceSampledEnvironmentLights = 0;
+    packet.infiniteLightCount = numInfinitePrimLights;
+    packet.environmentLightCount = numImportanceSampledEnvironmentLights;
 
-    for (const std::shared_ptr<Light>& pLight : sortedLights)
-    {
-        PolymorphicLightInfo polymorphicLight = {};
+    // Lights that disappear leave texels that nothing overwrites, then mip 0 is cleared and every light is written again
+    const bool clearLocalLightPdf = !m_LocalLightPdfValid || lightBufferOffset < m_PdfTexelCount;
+    const bool processStaticLights = m_StaticLightRebuildFrames > 0 || clearLocalLightPdf;
 
-        if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
-            continue;
+    if (m_StaticLightRebuildFrames > 0)
+        m_StaticLightRebuildFrames--;
 
-        // find the previous offset of this instance in the light buffer
-        auto pOffset = m_PrimitiveLightBufferOffsets.find(pLight.get());
+    if (processStaticLights)
+    {
+        const uint32_t numStaticPrimitiveLights = uint32_t(staticPrimitiveLightInfos.size());
+        for (PrepareLightsTask& task : tasks)
+        {
+            if (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT)
+                task.instanceAndGeometryIndex += numStaticPrimitiveLights;
+        }
 
-        PrepareLightsTask task;
-        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightInfos.size());
-        task.lightBufferOffset = lightBufferOffset;
-        task.triangleCount = 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
-        task.previousLightBufferOffset = (pOffset != m_PrimitiveLightBufferOffsets.end()) ? pOffset->second : -1;
+        tasks.insert(tasks.begin(), staticTasks.begin(), staticTasks.end());
+        primitiveLightInfos.insert(primitiveLightInfos.begin(), staticPrimitiveLightInfos.begin(), staticPrimitiveLightInfos.end());
+        packet.staticLightRange = 0u;
+    }
+    else
+    {
+        packet.staticLightRange = uint2(firstStaticLight, firstDynamicLight);
+    }
 
-        // record the current offset of this instance for use on the next frame
-        m_PrimitiveLightBufferOffsets[pLight.get()] = lightBufferOffset;
+    // The first threads process the current block of virtual lights, the tasks start after them
+    const uint32_t firstTaskLight = processStaticLights ? firstStaticLight : firstDynamicLight;
+    packet.taskBufferOffset = firstTaskLight - (enableVirtualLights ? virtualLightsSamplesPerFrame : 0);
+    packet.lightCount = lightBufferOffset;
+    packet.clearLocalLightPdf = clearLocalLightPdf;
 
-        lightBufferOffset += task.triangleCount;
+    m_PreviousPrimitiveLightInfos = std::move(convertedLightInfos);
 
-        tasks.push_back(task);
-        primitiveLightInfos.push_back(polymorphicLight);
+    if (clearLocalLightPdf || m_ChangedPdfTexels.size() > c_MaxChangedPdfRanges)
+        trackPdfChanges = false;
 
-        if (pLight->GetLightType() == LightType_Environment && enableImportanceSampledEnvironmentLight)
-            numImportanceSampledEnvironmentLights++;
-        else if (isInfiniteLight(*pLight))
-            numInfinitePrimLights++;
-        else
-            numFinitePrimLights++;
+    if (!trackPdfChanges)
+    {
+        m_ChangedPdfTexels.clear();
+        m_LocalLightPdfMipsValid = false;
     }
 
-    assert(numImportanceSampledEnvironmentLights <= 1);
-    
-    outLightBufferParams.localLightBufferRegion.numLights += numFinitePrimLights;
+    m_LocalLightPdfValid = true;
+    m_PdfTexelCount = lightBufferOffset;
+}
+
+RTXDI_LightBufferParameters PrepareLightsPass::Process(nvrhi::ICommandList* commandList, const FramePacket& packet)
+{
+    CpuProfilerScope cpuScope("PrepareLightsPass::Process");
+
+    const LightTaskSettings& settings = packet.lightTaskSettings;
+    const uint32_t lightBufferOffset = packet.lightCount;
+
+    RTXDI_LightBufferParameters outLightBufferParams = {};
+
+    commandList->beginMarker("PrepareLights");
+
+    m_UploadRing->Write(commandList, m_GeometryInstanceToLightBuffer, packet.geometryInstanceToLight.data(), packet.geometryInstanceToLight.size() * sizeof(uint32_t));
+
+    outLightBufferParams.localLightBufferRegion.firstLightIndex = 0;
+    outLightBufferParams.localLightBufferRegion.numLights = lightBufferOffset - packet.infiniteLightCount - packet.environmentLightCount;
     outLightBufferParams.infiniteLightBufferRegion.firstLightIndex = outLightBufferParams.localLightBufferRegion.numLights;
-    outLightBufferParams.infiniteLightBufferRegion.numLights = numInfinitePrimLights;
+    outLightBufferParams.infiniteLightBufferRegion.numLights = packet.infiniteLightCount;
     outLightBufferParams.environmentLightParams.lightIndex = outLightBufferParams.infiniteLightBufferRegion.firstLightIndex + outLightBufferParams.infiniteLightBufferRegion.numLights;
-    outLightBufferParams.environmentLightParams.lightPresent = numImportanceSampledEnvironmentLights;
+    outLightBufferParams.environmentLightParams.lightPresent = packet.environmentLightCount;
+
+    m_StaticLightRange = packet.staticLightRange;
     
-    commandList->writeBuffer(m_TaskBuffer, tasks.data(), tasks.size() * sizeof(PrepareLightsTask));
+    m_UploadRing->Write(commandList, m_TaskBuffer, packet.lightTasks.data(), packet.lightTasks.size() * sizeof(PrepareLightsTask));
 
-    if (!primitiveLightInfos.empty())
+    if (!packet.primitiveLightInfos.empty())
     {
-        commandList->writeBuffer(m_PrimitiveLightBuffer, primitiveLightInfos.data(), primitiveLightInfos.size() * sizeof(PolymorphicLightInfo));
+        m_UploadRing->Write(commandList, m_PrimitiveLightBuffer, packet.primitiveLightInfos.data(), packet.primitiveLightInfos.size() * sizeof(PolymorphicLightInfo));
     }
 
     // clear the mapping buffer - value of 0 means all mappings are invalid
     commandList->clearBufferUInt(m_LightIndexMappingBuffer, 0);
 
-    // Clear the PDF texture mip 0 - not all of it might be written by this shader
-    commandList->clearTextureFloat(m_LocalLightPdfTexture, 
-        nvrhi::TextureSubresourceSet(0, 1, 0, 1), 
-        nvrhi::Color(0.f));
+    if (packet.clearLocalLightPdf)
+    {
+        // Clear the PDF texture mip 0 - not all of it might be written by this shader
+        commandList->clearTextureFloat(m_LocalLightPdfTexture, 
+            nvrhi::TextureSubresourceSet(0, 1, 0, 1), 
+            nvrhi::Color(0.f));
+    }
+
+    m_UploadRing->Flush(commandList);
 
     nvrhi::ComputeState state;
     state.pipeline = m_ComputePipeline;
@@ -492,20 +780,22 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     commandList->setComputeState(state);
 
     PrepareLightsConstants constants;
-    constants.numTasks = uint32_t(tasks.size());
+    constants.numTasks = uint32_t(packet.lightTasks.size());
     constants.currentFrameLightOffset = m_MaxLightsInBuffer * m_OddFrame;
     constants.previousFrameLightOffset = m_MaxLightsInBuffer * !m_OddFrame;
-    constants.virtualLightsEnabled = enableVirtualLights;
-    constants.virtualLightsCurrentFrameBlock = context.getFrameIndex() % virtualLightsSampleLifespan;
-    constants.virtualLightsPreviousFrameBlock = (context.getFrameIndex() - 1) % virtualLightsSampleLifespan;
-    constants.virtualLightsSamplesPerFrame = virtualLightsSamplesPerFrame;
-    constants.virtualLightsSampleLifespan = virtualLightsSampleLifespan;
-    constants.lockVirtualLights = lockVirtualLights;
-    constants.addVirtualLightsToGeometryMap = addVirtualLightsToGeometryMap;
-    constants.taskBufferOffset = taskBufferOffset;
+    constants.virtualLightsEnabled = settings.enableVirtualLights;
+    constants.virtualLightsCurrentFrameBlock = settings.virtualLightsCurrentBlock;
+    constants.virtualLightsPreviousFrameBlock = settings.virtualLightsPreviousBlock;
+    constants.virtualLightsSamplesPerFrame = settings.virtualLightsSamplesPerFrame;
+    constants.virtualLightsSampleLifespan = settings.virtualLightsSampleLifespan;
+    constants.lockVirtualLights = settings.lockVirtualLights;
+    constants.addVirtualLightsToGeometryMap = settings.addVirtualLightsToGeometryMap;
+    constants.taskBufferOffset = packet.taskBufferOffset;
+    constants.virtualLightsUpdateStride = std::max(settings.virtualLightsUpdateStride, 1u);
+    constants.virtualLightsUpdatePhase = settings.virtualLightsUpdatePhase;
     commandList->setPushConstants(&constants, sizeof(constants));
 
-    commandList->dispatch(dm::div_ceil(lightBufferOffset - taskBufferOffset, 256));
+    commandList->dispatch(dm::div_ceil(lightBufferOffset - packet.taskBufferOffset, 256));
 
     commandList->endMarker();
 
@@ -516,3 +806,15 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     m_OddFrame = !m_OddFrame;
     return outLightBufferParams;
 }
+
+bool LightTaskBuilder::TakeLocalLightPdfChanges(std::vector<PdfTexelRange>& changedTexels)
+{
+    const bool mipsValid = m_LocalLightPdfMipsValid;
+
+    changedTexels = std::move(m_ChangedPdfTexels);
+    m_ChangedPdfTexels.clear();
+
+    // The caller regenerates the whole chain if it was invalid
+    m_LocalLightPdfMipsValid = true;
+    return mipsValid;
+}
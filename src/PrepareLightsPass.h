@@ -15,6 +15,10 @@
 #include <rtxdi/ReSTIRDI.h>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "FramePacket.h"
+#include "LocalLightPdfUpdate.h"
 #include "../shaders/GSGIParameters.h"
 
 
@@ -23,10 +27,73 @@ namespace donut::engine
     class CommonRenderPasses;
     class ShaderFactory;
     class Scene;
+    class SceneGraph;
     class Light;
 }
 
 class RtxdiResources;
+class UploadRingBuffer;
+struct PolymorphicLightInfo;
+
+// CPU encoders for the light buffer, also used by the CPU reference renderer
+bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight);
+PolymorphicLightInfo ConvertTriangleLight(const dm::float3& v0, const dm::float3& v1, const dm::float3& v2, const dm::float3& radiance);
+
+// Places the emissive geometry and the primitive lights of a frame in the light buffer and builds the tasks of
+// PrepareLightsPass, tracking the light buffer offsets, the static light region and the changed local light PDF
+// texels between frames. No graphics device is used, so the build can run on a worker thread while the frame is
+// recorded, as long as nothing changes the scene graph meanwhile. The other methods must not be called during a build.
+class LightTaskBuilder
+{
+private:
+    bool m_MaterialsChanged = false;
+
+    // Tracking of the local light PDF texels that change between frames.
+    // m_LocalLightPdfValid: mip 0 holds the flux of the previous frame's lights and zeros after them.
+    bool m_LocalLightPdfValid = false;
+    bool m_LocalLightPdfMipsValid = false;
+    std::vector<PdfTexelRange> m_ChangedPdfTexels;
+    uint32_t m_PdfTexelCount = 0;
+    uint32_t m_PreviousFrameIndex = 0;
+    bool m_VirtualLightsEnabled = false;
+    bool m_VirtualLightsLocked = false;
+    uint32_t m_VirtualLightsSamplesPerFrame = 0;
+    uint32_t m_VirtualLightsSampleLifespan = 0;
+    uint32_t m_VirtualLightsUnstableFrames = 0; // frames during which all virtual lights are treated as changed
+
+    std::unordered_map<size_t, uint32_t> m_InstanceLightBufferOffsets; // hash(instance*, geometryIndex) -> bufferOffset
+    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightBufferOffsets;
+    std::unordered_map<size_t, dm::affine3> m_InstanceLightTransforms; // hash(instance*, geometryIndex) -> transform on the previous frame
+    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightInfoIndices; // light -> index in m_PreviousPrimitiveLightInfos
+    std::vector<PolymorphicLightInfo> m_PreviousPrimitiveLightInfos;
+
+    // Lights that are not animated are stored right after the virtual lights, in the static region of the light buffer.
+    // The shader only writes them when the region is rebuilt, which takes two frames to fill both halves of the buffer.
+    std::unordered_set<size_t> m_StaticInstances; // hash(instance*, geometryIndex)
+    std::unordered_set<const donut::engine::Light*> m_StaticPrimitiveLights;
+    uint32_t m_StaticLightRebuildFrames = 0;
+
+public:
+    LightTaskBuilder();
+    ~LightTaskBuilder();
+
+    // Fills the light task members of the packet
+    void Build(const donut::engine::SceneGraph& sceneGraph, const LightTaskSettings& settings, FramePacket& packet);
+
+    // Marks the emissive geometry and finite primitive lights that are not moved by animations or skinning as static.
+    // Static lights that change later are moved to the dynamic region for good.
+    void ClassifyStaticLights(const donut::engine::SceneGraph& sceneGraph);
+
+    // The flux of any emissive geometry may have changed
+    void MarkMaterialsChanged() { m_MaterialsChanged = true; }
+
+    // The local light PDF texture is new, it is cleared and written again by the next frame
+    void InvalidateLocalLightPdf() { m_LocalLightPdfValid = false; }
+
+    // Moves out the ranges of local light PDF texels that changed since the last call, in Z-curve order.
+    // Returns false if the whole mip chain has to be regenerated instead.
+    bool TakeLocalLightPdfChanges(std::vector<PdfTexelRange>& changedTexels);
+};
 
 class PrepareLightsPass
 {
@@ -48,13 +115,19 @@ private:
     
     uint32_t m_MaxLightsInBuffer;
     bool m_OddFrame = false;
+
+    // Emissive geometry counts, only recomputed when a material changes
+    bool m_LightCountsValid = false;
+    uint32_t m_NumEmissiveMeshes = 0;
+    uint32_t m_NumEmissiveTriangles = 0;
+
+    LightTaskBuilder m_TaskBuilder;
+    dm::uint2 m_StaticLightRange = 0u; // [begin, end) in each half of the light buffer, empty when the region is being rebuilt
     
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
     std::shared_ptr<donut::engine::Scene> m_Scene;
-
-    std::unordered_map<size_t, uint32_t> m_InstanceLightBufferOffsets; // hash(instance*, geometryIndex) -> bufferOffset
-    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightBufferOffsets;
+    std::shared_ptr<UploadRingBuffer> m_UploadRing;
 
 public:
     PrepareLightsPass(
@@ -62,20 +135,28 @@ public:
         std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
         std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
         std::shared_ptr<donut::engine::Scene> scene,
+        std::shared_ptr<UploadRingBuffer> uploadRing,
         nvrhi::IBindingLayout* bindlessLayout);
 
     void CreatePipeline();
     void CreateBindingSet(RtxdiResources& resources);
     void CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles);
-    
-    RTXDI_LightBufferParameters Process(
-        nvrhi::ICommandList* commandList, 
-        const rtxdi::ReSTIRDIContext& context, 
-        const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
-        bool enableImportanceSampledEnvironmentLight,
-        bool enableVirtualLights,
-        uint32_t virtualLightsSamplesPerFrame,
-        uint32_t virtualLightsSampleLifespan,
-        bool lockVirtualLights,
-        bool addVirtualLightsToGeometryMap);
+    void SetLightCounts(uint32_t numEmissiveMeshes, uint32_t numEmissiveTriangles);
+
+    // See LightTaskBuilder::ClassifyStaticLights
+    void ClassifyStaticLights();
+
+    // Builds the light tasks of the packet, see LightTaskBuilder::Build. Must not run while a packet is being built.
+    void BuildTasks(const LightTaskSettings& settings, FramePacket& packet);
+
+    // Uploads the light tasks of the packet and records the shader that fills the light buffer
+    RTXDI_LightBufferParameters Process(nvrhi::ICommandList* commandList, const FramePacket& packet);
+
+    // See LightTaskBuilder::TakeLocalLightPdfChanges
+    bool TakeLocalLightPdfChanges(std::vector<PdfTexelRange>& changedTexels) { return m_TaskBuilder.TakeLocalLightPdfChanges(changedTexels); }
+
+    // The lights in this range were not written on the current frame and have the same index in both halves
+    // of the light buffer, so RAB_TranslateLightIndex maps them without the light index mapping buffer.
+    [[nodiscard]] dm::uint2 GetStaticLightRange() const { return m_StaticLightRange; }
+    [[nodiscard]] uint32_t GetLightBufferStride() const { return m_MaxLightsInBuffer; }
 };
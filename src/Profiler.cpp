@@ -9,6 +9,8 @@
  **************************************************************************/
 
 #include "Profiler.h"
+#include "BenchmarkResults.h"
+#include "CpuProfiler.h"
 #include <donut/app/DeviceManager.h>
 #include <imgui.h>
 #include <sstream>
@@ -95,6 +97,19 @@ void Profiler::ResetAccumulation()
     m_HitCounts.fill(0);
 }
 
+void Profiler::EnableFrameRecording(bool enable)
+{
+    m_IsRecordingFrames = enable;
+}
+
+void Profiler::ClearRecordedFrames()
+{
+    m_RecordedTimes.clear();
+    m_RecordedRayCounts.clear();
+    m_RecordedHitCounts.clear();
+    m_RecordedTimersUsed.clear();
+}
+
 void Profiler::ResolvePreviousFrame()
 {
     m_ActiveBank = !m_ActiveBank;
@@ -102,7 +117,33 @@ void Profiler::ResolvePreviousFrame()
     if (!m_Enabled)
         return;
 
+    // Nothing was recorded into the bank, or ResolveOutstandingFrames got to it first
+    if (!m_TimersUsed[ProfilerSection::Frame + m_ActiveBank * ProfilerSection::Count])
+    {
+        m_LastFrameTimes.fill(0.0);
+        m_RayCounts[ProfilerSection::MaterialReadback] = 0;
+        return;
+    }
+
     const uint32_t* rayCountData = static_cast<const uint32_t*>(m_Device->mapBuffer(m_RayCountReadback[m_ActiveBank], nvrhi::CpuAccessMode::Read));
+
+    // The bank being resolved belongs to the previous frame, so use the recording state from when it was started
+    const bool recordFrame = m_BankRecorded[m_ActiveBank] && m_TimersUsed[ProfilerSection::Frame + m_ActiveBank * ProfilerSection::Count];
+    m_BankRecorded[m_ActiveBank] = false;
+
+    // GPU timer queries only provide durations, so the trace places the frame at its submission time and lays out
+    // the other sections back to back from there, in ProfilerSection order. That layout is synthetic: it doesn't show
+    // where the sections start, their overlap with the compute queue or their nesting, only how long each one took.
+    const bool traceGpuFrame = CpuProfiler::Get().IsEnabled() && m_TimersUsed[ProfilerSection::Frame + m_ActiveBank * ProfilerSection::Count];
+    uint64_t gpuSectionStart = m_BankSubmitTime[m_ActiveBank];
+
+    if (recordFrame)
+    {
+        m_RecordedTimes.emplace_back();
+        m_RecordedRayCounts.emplace_back();
+        m_RecordedHitCounts.emplace_back();
+        m_RecordedTimersUsed.emplace_back();
+    }
     
     for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
     {
@@ -111,8 +152,9 @@ void Profiler::ResolvePreviousFrame()
         uint32_t hitCount = 0;
 
         uint32_t timerIndex = section + m_ActiveBank * ProfilerSection::Count;
+        const bool timerUsed = m_TimersUsed[timerIndex];
         
-        if (m_TimersUsed[timerIndex])
+        if (timerUsed)
         {
             time = double(m_Device->getTimerQueryTime(m_TimerQueries[timerIndex]));
             time *= 1000.0; // seconds -> milliseconds
@@ -125,6 +167,30 @@ void Profiler::ResolvePreviousFrame()
         }
 
         m_TimersUsed[timerIndex] = false;
+        m_LastFrameTimes[section] = time;
+
+        if (traceGpuFrame && time > 0.0)
+        {
+            const uint64_t duration = uint64_t(time * 1e6); // milliseconds -> nanoseconds
+
+            if (section == ProfilerSection::Frame)
+            {
+                CpuProfiler::Get().RecordGpuEvent(g_SectionNames[section], m_BankSubmitTime[m_ActiveBank], m_BankSubmitTime[m_ActiveBank] + duration);
+            }
+            else
+            {
+                CpuProfiler::Get().RecordGpuEvent(g_SectionNames[section], gpuSectionStart, gpuSectionStart + duration);
+                gpuSectionStart += duration;
+            }
+        }
+
+        if (recordFrame)
+        {
+            m_RecordedTimes.back()[section] = float(time);
+            m_RecordedRayCounts.back()[section] = rayCount;
+            m_RecordedHitCounts.back()[section] = hitCount;
+            m_RecordedTimersUsed.back()[section] = timerUsed;
+        }
 
         if (m_IsAccumulating)
         {
@@ -156,6 +222,14 @@ void Profiler::ResolvePreviousFrame()
         m_AccumulatedFrames = 1;
 }
 
+void Profiler::ResolveOutstandingFrames()
+{
+    // The banks of the last two frames, oldest first. The active bank ends up where it was, and the next
+    // ResolvePreviousFrame call finds both banks resolved already.
+    ResolvePreviousFrame();
+    ResolvePreviousFrame();
+}
+
 void Profiler::BeginFrame(nvrhi::ICommandList* commandList)
 {
     if (!m_Enabled)
@@ -163,6 +237,8 @@ void Profiler::BeginFrame(nvrhi::ICommandList* commandList)
 
     commandList->clearBufferUInt(m_RayCountBuffer, 0);
 
+    m_BankRecorded[m_ActiveBank] = m_IsRecordingFrames;
+
     BeginSection(commandList, ProfilerSection::Frame);
 }
 
@@ -172,6 +248,8 @@ void Profiler::EndFrame(nvrhi::ICommandList* commandList)
 
     if (m_Enabled)
     {
+        m_BankSubmitTime[m_ActiveBank] = CpuProfiler::Now();
+
         commandList->copyBuffer(
             m_RayCountReadback[m_ActiveBank],
             0,
@@ -347,6 +425,45 @@ std::string Profiler::GetAsText()
     return text.str();
 }
 
+BenchmarkResults Profiler::GetRecordedFrames()
+{
+    BenchmarkResults results;
+    results.renderer = m_DeviceManager.GetRendererString();
+    results.frameCount = uint32_t(m_RecordedTimes.size());
+
+    if (auto renderTargets = m_RenderTargets.lock())
+    {
+        results.width = renderTargets->Size.x;
+        results.height = renderTargets->Size.y;
+    }
+
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        BenchmarkSection sectionResults;
+        sectionResults.name = g_SectionNames[section];
+        sectionResults.frameTimes.reserve(m_RecordedTimes.size());
+        sectionResults.rayCounts.reserve(m_RecordedTimes.size());
+        sectionResults.hitCounts.reserve(m_RecordedTimes.size());
+
+        // Frames that skipped the section, e.g. the GI passes between the partial virtual light updates,
+        // don't contribute a sample: a zero would lower the statistics
+        for (size_t frame = 0; frame < m_RecordedTimes.size(); frame++)
+        {
+            if (!m_RecordedTimersUsed[frame][section])
+                continue;
+
+            sectionResults.frameTimes.push_back(double(m_RecordedTimes[frame][section]));
+            sectionResults.rayCounts.push_back(m_RecordedRayCounts[frame][section]);
+            sectionResults.hitCounts.push_back(m_RecordedHitCounts[frame][section]);
+        }
+
+        if (!sectionResults.frameTimes.empty())
+            results.sections.push_back(std::move(sectionResults));
+    }
+
+    return results;
+}
+
 ProfilerScope::ProfilerScope(Profiler& profiler, nvrhi::ICommandList* commandList, ProfilerSection::Enum section)
     : m_Profiler(profiler)
     , m_CommandList(commandList)
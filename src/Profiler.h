@@ -13,10 +13,12 @@
 #include <nvrhi/nvrhi.h>
 #include <array>
 #include <memory>
+#include <vector>
 
 #include "ProfilerSections.h"
 
 class RenderTargets;
+struct BenchmarkResults;
 
 namespace donut::app
 {
@@ -30,13 +32,23 @@ private:
     bool m_IsAccumulating = false;
     uint32_t m_AccumulatedFrames = 0;
     uint32_t m_ActiveBank = 0;
+    bool m_IsRecordingFrames = false;
+    std::array<bool, 2> m_BankRecorded{};
+    std::array<uint64_t, 2> m_BankSubmitTime{};
 
     std::array<nvrhi::TimerQueryHandle, ProfilerSection::Count * 2> m_TimerQueries;
     std::array<double, ProfilerSection::Count> m_TimerValues{};
+    std::array<double, ProfilerSection::Count> m_LastFrameTimes{};
     std::array<size_t, ProfilerSection::Count> m_RayCounts{};
     std::array<size_t, ProfilerSection::Count> m_HitCounts{};
     std::array<bool, ProfilerSection::Count * 2> m_TimersUsed{};
 
+    // Per-frame values, only filled while frame recording is enabled
+    std::vector<std::array<float, ProfilerSection::Count>> m_RecordedTimes;
+    std::vector<std::array<uint32_t, ProfilerSection::Count>> m_RecordedRayCounts;
+    std::vector<std::array<uint32_t, ProfilerSection::Count>> m_RecordedHitCounts;
+    std::vector<std::array<bool, ProfilerSection::Count>> m_RecordedTimersUsed;
+
     donut::app::DeviceManager& m_DeviceManager;
     nvrhi::DeviceHandle m_Device;
     nvrhi::BufferHandle m_RayCountBuffer;
@@ -50,7 +62,11 @@ public:
     void EnableProfiler(bool enable);
     void EnableAccumulation(bool enable);
     void ResetAccumulation();
+    void EnableFrameRecording(bool enable);
+    void ClearRecordedFrames();
     void ResolvePreviousFrame();
+    // Resolves the frames that ResolvePreviousFrame hasn't reached yet, the device must be idle
+    void ResolveOutstandingFrames();
     void BeginFrame(nvrhi::ICommandList* commandList);
     void EndFrame(nvrhi::ICommandList* commandList);
     void BeginSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
@@ -58,12 +74,15 @@ public:
     void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets) { m_RenderTargets = renderTargets; }
 
     double GetTimer(ProfilerSection::Enum section);
+    // Time of the last resolved frame in ms, not averaged by accumulation, 0 if the section didn't run
+    double GetLastFrameTimer(ProfilerSection::Enum section) const { return m_LastFrameTimes[section]; }
     double GetRayCount(ProfilerSection::Enum section);
     double GetHitCount(ProfilerSection::Enum section);
     int GetMaterialReadback();
 
     void BuildUI(bool enableRayCounts);
     std::string GetAsText();
+    BenchmarkResults GetRecordedFrames();
 
     [[nodiscard]] nvrhi::IBuffer* GetRayCountBuffer() const { return m_RayCountBuffer; }
 };
@@ -31,18 +31,49 @@ bool RayTracingPass::Init(
 {
     donut::log::debug("Initializing RayTracingPass %s...", shaderName);
 
-    ComputeGroupSize = computeGroupSize;
+    if (!LoadShaders(shaderFactory, shaderName, extraMacros, useRayQuery))
+        return false;
+
+    return CreatePipeline(device, computeGroupSize, bindingLayout, extraBindingLayout, bindlessLayout);
+}
+
+bool RayTracingPass::LoadShaders(
+    donut::engine::ShaderFactory& shaderFactory,
+    const char* shaderName,
+    const std::vector<donut::engine::ShaderMacro>& extraMacros,
+    bool useRayQuery)
+{
+    ComputeShader = nullptr;
+    ComputePipeline = nullptr;
+    ShaderLibrary = nullptr;
+    RayTracingPipeline = nullptr;
+    ShaderTable = nullptr;
 
-    std::vector<donut::engine::ShaderMacro> macros = { { "USE_RAY_QUERY", "1" } };
+    std::vector<donut::engine::ShaderMacro> macros = { { "USE_RAY_QUERY", useRayQuery ? "1" : "0" } };
 
     macros.insert(macros.end(), extraMacros.begin(), extraMacros.end());
 
     if (useRayQuery)
     {
         ComputeShader = shaderFactory.CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
-        if (!ComputeShader)
-            return false;
+        return ComputeShader != nullptr;
+    }
+
+    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
+    return ShaderLibrary != nullptr;
+}
+
+bool RayTracingPass::CreatePipeline(
+    nvrhi::IDevice* device,
+    uint32_t computeGroupSize,
+    nvrhi::IBindingLayout* bindingLayout,
+    nvrhi::IBindingLayout* extraBindingLayout,
+    nvrhi::IBindingLayout* bindlessLayout)
+{
+    ComputeGroupSize = computeGroupSize;
 
+    if (ComputeShader)
+    {
         nvrhi::ComputePipelineDesc pipelineDesc;
         pipelineDesc.bindingLayouts = { bindingLayout };
         if (bindlessLayout)
@@ -58,8 +89,6 @@ bool RayTracingPass::Init(
         return true;
     }
 
-    macros[0].definition = "0"; // USE_RAY_QUERY
-    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
     if (!ShaderLibrary)
         return false;
 
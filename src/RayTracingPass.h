@@ -30,6 +30,7 @@ struct RayTracingPass
 
     uint32_t ComputeGroupSize = 0;
 
+    // Loads the shaders and creates the pipeline, see LoadShaders and CreatePipeline
     bool Init(
         nvrhi::IDevice* device,
         donut::engine::ShaderFactory& shaderFactory,
@@ -41,6 +42,21 @@ struct RayTracingPass
         nvrhi::IBindingLayout* extraBindingLayout,
         nvrhi::IBindingLayout* bindlessLayout);
 
+    // Uses the shader factory, which is not thread-safe
+    bool LoadShaders(
+        donut::engine::ShaderFactory& shaderFactory,
+        const char* shaderName,
+        const std::vector<donut::engine::ShaderMacro>& extraMacros,
+        bool useRayQuery);
+
+    // Only uses the device, so it can run on a worker thread after LoadShaders
+    bool CreatePipeline(
+        nvrhi::IDevice* device,
+        uint32_t computeGroupSize,
+        nvrhi::IBindingLayout* bindingLayout,
+        nvrhi::IBindingLayout* extraBindingLayout,
+        nvrhi::IBindingLayout* bindlessLayout);
+
     void Execute(
         nvrhi::ICommandList* commandList,
         int width,
@@ -0,0 +1,927 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "RenderGraph.h"
+#include "CommandListRecorder.h"
+
+#include <donut/core/log.h>
+#include <nvrhi/utils.h>
+
+#if DONUT_WITH_DX12
+#include <d3d12.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <queue>
+
+using namespace donut;
+
+static bool HasState(nvrhi::ResourceStates states, nvrhi::ResourceStates state)
+{
+    return (uint32_t(states) & uint32_t(state)) != 0;
+}
+
+static bool ContainsStates(nvrhi::ResourceStates states, nvrhi::ResourceStates subset)
+{
+    return (uint32_t(states) & uint32_t(subset)) == uint32_t(subset);
+}
+
+// UAV accesses are ordered by UAV barriers and can't be combined with the read-only states
+static bool CanCombineStates(nvrhi::ResourceStates a, nvrhi::ResourceStates b)
+{
+    return a == b || (!HasState(a, nvrhi::ResourceStates::UnorderedAccess) && !HasState(b, nvrhi::ResourceStates::UnorderedAccess));
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportTexture(nvrhi::ITexture* texture)
+{
+    auto it = m_ImportedResources.find(texture);
+    if (it != m_ImportedResources.end())
+        return it->second;
+
+    Resource resource;
+    resource.name = texture->getDesc().debugName;
+    resource.texture = texture;
+    resource.transient = texture->getDesc().isVirtual;
+    m_Resources.push_back(resource);
+
+    const ResourceHandle handle = ResourceHandle(m_Resources.size() - 1);
+    m_ImportedResources[texture] = handle;
+    return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportBuffer(nvrhi::IBuffer* buffer)
+{
+    auto it = m_ImportedResources.find(buffer);
+    if (it != m_ImportedResources.end())
+        return it->second;
+
+    Resource resource;
+    resource.name = buffer->getDesc().debugName;
+    resource.buffer = buffer;
+    resource.transient = buffer->getDesc().isVirtual;
+    m_Resources.push_back(resource);
+
+    const ResourceHandle handle = ResourceHandle(m_Resources.size() - 1);
+    m_ImportedResources[buffer] = handle;
+    return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraph::AddResource(const std::string& name, uint64_t size, uint64_t alignment, bool transient)
+{
+    Resource resource;
+    resource.name = name;
+    resource.transient = transient;
+    resource.size = size;
+    resource.alignment = std::max<uint64_t>(alignment, 1);
+    m_Resources.push_back(resource);
+
+    return ResourceHandle(m_Resources.size() - 1);
+}
+
+void RenderGraph::AddPass(const std::string& name, std::vector<Access> reads, std::vector<Access> writes, PassFunction function)
+{
+    Pass pass;
+    pass.name = name;
+    pass.function = std::move(function);
+    pass.queue = m_Queue;
+    pass.commandList = uint32_t(m_CommandListNames.size() - 1);
+
+    auto addAccess = [&pass](const Access& access, bool write)
+    {
+        assert(access.state != nvrhi::ResourceStates::Unknown);
+
+        for (PassAccess& existing : pass.accesses)
+        {
+            if (existing.resource != access.resource)
+                continue;
+
+            // Reads in read-only states combine, a write needs all accesses of the pass in its state.
+            // Unknown marks a conflict for Compile to report.
+            if (!write && !existing.write && CanCombineStates(existing.state, access.state))
+                existing.state = existing.state | access.state;
+            else if (existing.state != access.state)
+                existing.state = nvrhi::ResourceStates::Unknown;
+
+            existing.write = existing.write || write;
+            return;
+        }
+
+        pass.accesses.push_back({ access.resource, access.state, write });
+    };
+
+    for (const Access& access : reads)
+        addAccess(access, false);
+    for (const Access& access : writes)
+        addAccess(access, true);
+
+    m_Passes.push_back(std::move(pass));
+}
+
+void RenderGraph::BeginCommandList(const std::string& name)
+{
+    m_CommandListNames.push_back(name);
+}
+
+uint64_t RenderGraph::GetTransientResourceSize() const
+{
+    uint64_t size = 0;
+    for (const Resource& resource : m_Resources)
+    {
+        if (resource.transient)
+            size += resource.size;
+    }
+    return size;
+}
+
+void RenderGraph::CullPasses()
+{
+    // Walk backwards and keep the passes that write something that a later pass uses, or that has to survive the graph
+    std::vector<bool> used(m_Resources.size(), false);
+
+    for (size_t passIndex = m_Passes.size(); passIndex-- > 0; )
+    {
+        Pass& pass = m_Passes[passIndex];
+
+        bool needed = true;
+        for (const PassAccess& access : pass.accesses)
+        {
+            if (!access.write)
+                continue;
+
+            needed = false;
+            if (!m_Resources[access.resource].transient || used[access.resource])
+            {
+                needed = true;
+                break;
+            }
+        }
+
+        pass.culled = !needed;
+        if (pass.culled)
+            continue;
+
+        // Writes may read the previous contents, so they also keep the earlier writers
+        for (const PassAccess& access : pass.accesses)
+            used[access.resource] = true;
+    }
+}
+
+bool RenderGraph::SchedulePasses()
+{
+    // Each access depends on the last write of the resource, and each write depends on the reads since then
+    std::vector<std::vector<uint32_t>> successors(m_Passes.size());
+    std::vector<uint32_t> predecessorCount(m_Passes.size(), 0);
+    std::vector<uint32_t> lastWriter(m_Resources.size(), ~0u);
+    std::vector<std::vector<uint32_t>> readersSinceWrite(m_Resources.size());
+
+    auto addEdge = [&](uint32_t from, uint32_t to)
+    {
+        if (from == to || std::find(successors[from].begin(), successors[from].end(), to) != successors[from].end())
+            return;
+        successors[from].push_back(to);
+        predecessorCount[to]++;
+    };
+
+    for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+    {
+        const Pass& pass = m_Passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        for (const PassAccess& access : pass.accesses)
+        {
+            if (lastWriter[access.resource] != ~0u)
+                addEdge(lastWriter[access.resource], passIndex);
+
+            if (access.write)
+            {
+                for (uint32_t reader : readersSinceWrite[access.resource])
+                    addEdge(reader, passIndex);
+                readersSinceWrite[access.resource].clear();
+                lastWriter[access.resource] = passIndex;
+            }
+            else
+            {
+                readersSinceWrite[access.resource].push_back(passIndex);
+            }
+        }
+    }
+
+    // Kahn's algorithm, taking the ready pass that was declared first
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+    uint32_t activePasses = 0;
+    for (uint32_t passIndex = 0; passIndex < uint32_t(m_Passes.size()); passIndex++)
+    {
+        if (m_Passes[passIndex].culled)
+            continue;
+
+        activePasses++;
+        if (predecessorCount[passIndex] == 0)
+            ready.push(passIndex);
+    }
+
+    m_Schedule.clear();
+    while (!ready.empty())
+    {
+        const uint32_t passIndex = ready.top();
+        ready.pop();
+        m_Schedule.push_back(passIndex);
+
+        for (uint32_t successor : successors[passIndex])
+        {
+            if (--predecessorCount[successor] == 0)
+                ready.push(successor);
+        }
+    }
+
+    return m_Schedule.size() == activePasses;
+}
+
+void RenderGraph::ComputeBarriers()
+{
+    struct ScheduledAccess
+    {
+        uint32_t scheduleIndex;
+        nvrhi::ResourceStates state;
+        bool write;
+    };
+
+    std::vector<std::vector<ScheduledAccess>> resourceAccesses(m_Resources.size());
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+    {
+        for (const PassAccess& access : m_Passes[m_Schedule[scheduleIndex]].accesses)
+            resourceAccesses[access.resource].push_back({ scheduleIndex, access.state, access.write });
+    }
+
+    m_Barriers.clear();
+    m_Barriers.resize(m_Schedule.size());
+
+    for (ResourceHandle resourceIndex = 0; resourceIndex < ResourceHandle(m_Resources.size()); resourceIndex++)
+    {
+        Resource& resource = m_Resources[resourceIndex];
+        const std::vector<ScheduledAccess>& accesses = resourceAccesses[resourceIndex];
+
+        resource.firstUse = accesses.empty() ? ~0u : accesses.front().scheduleIndex;
+        resource.lastUse = accesses.empty() ? 0 : accesses.back().scheduleIndex;
+        resource.uses.clear();
+        for (const ScheduledAccess& access : accesses)
+            resource.uses.push_back(access.scheduleIndex);
+
+        nvrhi::ResourceStates currentState = nvrhi::ResourceStates::Unknown;
+        bool unorderedWrite = false;
+
+        for (size_t accessIndex = 0; accessIndex < accesses.size(); accessIndex++)
+        {
+            const ScheduledAccess& access = accesses[accessIndex];
+            const bool unordered = HasState(access.state, nvrhi::ResourceStates::UnorderedAccess);
+
+            Barrier barrier;
+            barrier.resource = resourceIndex;
+            barrier.stateBefore = currentState;
+            barrier.stateAfter = access.state;
+
+            bool needed;
+            if (accessIndex == 0)
+            {
+                // Nothing is known about the accesses before the graph, or about the memory of a transient resource
+                needed = true;
+                barrier.discard = resource.transient;
+                barrier.uavBarrier = unordered && !resource.transient;
+            }
+            else if (m_CommandListIndex[access.scheduleIndex] != m_CommandListIndex[accesses[accessIndex - 1].scheduleIndex])
+            {
+                // A new command list starts from the permanent state, and the queue waits order the memory accesses
+                needed = true;
+                barrier.stateBefore = nvrhi::ResourceStates::Unknown;
+                barrier.uavBarrier = unordered;
+            }
+            else if (!ContainsStates(currentState, access.state) || (access.write && currentState != access.state))
+            {
+                needed = true;
+            }
+            else
+            {
+                // Same state: only UAV accesses need ordering, and only around writes
+                needed = unordered && (unorderedWrite || access.write);
+                barrier.uavBarrier = needed;
+            }
+
+            if (!needed)
+            {
+                unorderedWrite = unorderedWrite || (unordered && access.write);
+                continue;
+            }
+
+            // Transition once into the combined state of the following reads
+            if (!access.write && !unordered)
+            {
+                for (size_t nextIndex = accessIndex + 1; nextIndex < accesses.size(); nextIndex++)
+                {
+                    const ScheduledAccess& next = accesses[nextIndex];
+                    if (next.write || !CanCombineStates(barrier.stateAfter, next.state))
+                        break;
+                    barrier.stateAfter = barrier.stateAfter | next.state;
+                }
+            }
+
+            m_Barriers[access.scheduleIndex].push_back(barrier);
+            currentState = barrier.stateAfter;
+            unorderedWrite = unordered && access.write;
+        }
+
+        resource.finalState = currentState;
+    }
+}
+
+bool RenderGraph::IsOrdered(uint32_t firstScheduleIndex, uint32_t secondScheduleIndex) const
+{
+    if (firstScheduleIndex >= secondScheduleIndex)
+        return false;
+
+    const nvrhi::CommandQueue firstQueue = m_Passes[m_Schedule[firstScheduleIndex]].queue;
+    if (firstQueue == m_Passes[m_Schedule[secondScheduleIndex]].queue)
+        return true;
+
+    return m_CompletedBefore[secondScheduleIndex][size_t(firstQueue)] >= int64_t(firstScheduleIndex);
+}
+
+bool RenderGraph::IsBefore(const Resource& first, const Resource& second) const
+{
+    // With one queue this is lastUse < firstUse, other queues may still use the first resource later
+    for (uint32_t firstUse : first.uses)
+    {
+        for (uint32_t secondUse : second.uses)
+        {
+            if (!IsOrdered(firstUse, secondUse))
+                return false;
+        }
+    }
+    return true;
+}
+
+void RenderGraph::ComputeQueueWaits()
+{
+    const uint32_t scheduleSize = uint32_t(m_Schedule.size());
+    const size_t graphics = size_t(nvrhi::CommandQueue::Graphics);
+
+    m_Waits.assign(scheduleSize, {});
+    m_SubmitsBefore.assign(scheduleSize, {});
+    m_CommandListIndex.assign(scheduleSize, 0);
+    m_CompletedBefore.assign(scheduleSize, {});
+    m_FinalWaits.clear();
+    m_FinalSubmits.clear();
+    m_CommandListQueues = { nvrhi::CommandQueue::Graphics };
+    m_CommandListNameIndices = { 0 };
+
+    struct ScheduledAccess
+    {
+        uint32_t scheduleIndex;
+        bool write;
+    };
+
+    std::vector<std::vector<ScheduledAccess>> resourceAccesses(m_Resources.size());
+    for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+    {
+        for (const PassAccess& access : m_Passes[m_Schedule[scheduleIndex]].accesses)
+            resourceAccesses[access.resource].push_back({ scheduleIndex, access.write });
+    }
+
+    // What each queue has waited for, and the state of its command list as Execute will see it.
+    // The graphics command list is open with the work before the graph.
+    std::array<QueuePositions, c_QueueCount> completed;
+    QueuePositions recorded;
+    QueuePositions submitted;
+    std::array<bool, c_QueueCount> open = {};
+    for (size_t queue = 0; queue < c_QueueCount; queue++)
+        completed[queue].fill(-2);
+    recorded.fill(-2);
+    submitted.fill(-2);
+    recorded[graphics] = -1;
+    open[graphics] = true;
+    std::array<uint32_t, c_QueueCount> commandListIndex = {};
+    std::array<uint32_t, c_QueueCount> commandListName = {};
+
+    auto submit = [&](size_t queue, std::vector<nvrhi::CommandQueue>& submits)
+    {
+        submits.push_back(nvrhi::CommandQueue(queue));
+        submitted[queue] = recorded[queue];
+        open[queue] = false;
+    };
+
+    auto wait = [&](size_t queue, size_t other, int64_t position, std::vector<nvrhi::CommandQueue>& submits, std::vector<QueueWait>& waits)
+    {
+        if (position <= completed[queue][other])
+            return;
+
+        // The awaited work has to be submitted first, and the work recorded before the wait shouldn't wait
+        if (open[other] && submitted[other] < position)
+            submit(other, submits);
+        if (open[queue])
+            submit(queue, submits);
+
+        waits.push_back({ nvrhi::CommandQueue(other), position < 0 ? c_WorkBeforeGraph : uint32_t(position) });
+
+        // The other queue had itself waited for some work before that pass
+        if (position >= 0)
+        {
+            for (size_t third = 0; third < c_QueueCount; third++)
+                completed[queue][third] = std::max(completed[queue][third], m_CompletedBefore[position][third]);
+        }
+        completed[queue][other] = std::max(completed[queue][other], position);
+    };
+
+    for (uint32_t scheduleIndex = 0; scheduleIndex < scheduleSize; scheduleIndex++)
+    {
+        const Pass& pass = m_Passes[m_Schedule[scheduleIndex]];
+        const size_t queue = size_t(pass.queue);
+
+        // The last conflicting access on each other queue
+        QueuePositions dependencies;
+        dependencies.fill(-2);
+        if (queue != graphics)
+            dependencies[graphics] = -1;
+
+        for (const PassAccess& access : pass.accesses)
+        {
+            for (const ScheduledAccess& previous : resourceAccesses[access.resource])
+            {
+                if (previous.scheduleIndex >= scheduleIndex)
+                    break;
+
+                const size_t previousQueue = size_t(m_Passes[m_Schedule[previous.scheduleIndex]].queue);
+                if (previousQueue != queue && (access.write || previous.write))
+                    dependencies[previousQueue] = std::max(dependencies[previousQueue], int64_t(previous.scheduleIndex));
+            }
+        }
+
+        if (open[queue] && commandListName[queue] != pass.commandList)
+            submit(queue, m_SubmitsBefore[scheduleIndex]);
+
+        for (size_t other = 0; other < c_QueueCount; other++)
+        {
+            if (other != queue && dependencies[other] > -2)
+                wait(queue, other, dependencies[other], m_SubmitsBefore[scheduleIndex], m_Waits[scheduleIndex]);
+        }
+
+        if (!open[queue])
+        {
+            open[queue] = true;
+            commandListIndex[queue] = uint32_t(m_CommandListQueues.size());
+            commandListName[queue] = pass.commandList;
+            m_CommandListQueues.push_back(pass.queue);
+            m_CommandListNameIndices.push_back(pass.commandList);
+        }
+
+        m_CommandListIndex[scheduleIndex] = commandListIndex[queue];
+        recorded[queue] = scheduleIndex;
+        m_CompletedBefore[scheduleIndex] = completed[queue];
+        m_CompletedBefore[scheduleIndex][queue] = scheduleIndex;
+    }
+
+    // The work after the graph sees the results of all queues
+    for (size_t other = 0; other < c_QueueCount; other++)
+    {
+        if (other != graphics && recorded[other] >= 0)
+            wait(graphics, other, recorded[other], m_FinalSubmits, m_FinalWaits);
+    }
+}
+
+void RenderGraph::PlaceTransients()
+{
+    // Larger resources first, then each resource at the lowest offset that doesn't overlap
+    // the memory of a placed resource whose lifetime overlaps
+    std::vector<ResourceHandle> order;
+    for (ResourceHandle resourceIndex = 0; resourceIndex < ResourceHandle(m_Resources.size()); resourceIndex++)
+    {
+        m_Resources[resourceIndex].offset = c_NotPlaced;
+        if (m_Resources[resourceIndex].transient)
+            order.push_back(resourceIndex);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](ResourceHandle a, ResourceHandle b)
+    {
+        return m_Resources[a].size > m_Resources[b].size;
+    });
+
+    m_TransientMemorySize = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> occupied; // begin, end
+
+    for (size_t orderIndex = 0; orderIndex < order.size(); orderIndex++)
+    {
+        Resource& resource = m_Resources[order[orderIndex]];
+        const bool used = resource.firstUse != ~0u;
+
+        occupied.clear();
+        for (size_t placedIndex = 0; placedIndex < orderIndex; placedIndex++)
+        {
+            const Resource& placed = m_Resources[order[placedIndex]];
+            if (used && placed.firstUse != ~0u && !IsBefore(placed, resource) && !IsBefore(resource, placed))
+                occupied.push_back({ placed.offset, placed.offset + placed.size });
+        }
+        std::sort(occupied.begin(), occupied.end());
+
+        uint64_t offset = 0;
+        for (const auto& range : occupied)
+        {
+            if (offset + resource.size <= range.first)
+                break;
+            offset = std::max(offset, (range.second + resource.alignment - 1) / resource.alignment * resource.alignment);
+        }
+
+        resource.offset = offset;
+        m_TransientMemorySize = std::max(m_TransientMemorySize, offset + resource.size);
+    }
+}
+
+bool RenderGraph::Compile()
+{
+    bool valid = true;
+
+    for (const Pass& pass : m_Passes)
+    {
+        for (const PassAccess& access : pass.accesses)
+        {
+            if (access.state == nvrhi::ResourceStates::Unknown)
+            {
+                log::error("Render graph pass '%s' uses resource '%s' in states that can't be combined",
+                    pass.name.c_str(), m_Resources[access.resource].name.c_str());
+                valid = false;
+            }
+        }
+    }
+
+    m_Compiled = false;
+
+    CullPasses();
+
+    if (!SchedulePasses())
+    {
+        log::error("The render graph has a dependency cycle");
+        return false;
+    }
+
+    ComputeQueueWaits();
+    ComputeBarriers();
+
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+    {
+        const Pass& pass = m_Passes[m_Schedule[scheduleIndex]];
+        for (const PassAccess& access : pass.accesses)
+        {
+            const Resource& resource = m_Resources[access.resource];
+            if (resource.transient && resource.firstUse == scheduleIndex && !access.write)
+            {
+                log::error("Render graph pass '%s' reads transient resource '%s' before it is written",
+                    pass.name.c_str(), resource.name.c_str());
+                valid = false;
+            }
+        }
+    }
+
+    PlaceTransients();
+
+    m_Compiled = valid;
+    return valid;
+}
+
+void RenderGraph::RecordPass(nvrhi::ICommandList* commandList, uint32_t scheduleIndex)
+{
+    const std::vector<Barrier>& barriers = m_Barriers[scheduleIndex];
+
+    for (const Barrier& barrier : barriers)
+    {
+        const Resource& resource = m_Resources[barrier.resource];
+
+#if DONUT_WITH_DX12
+        // Placed resources that share memory need an aliasing barrier on D3D12. Vulkan only needs the memory
+        // dependency of the barrier below, which covers the memory range of the resource.
+        if (barrier.discard && commandList->getDevice()->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D12)
+        {
+            commandList->commitBarriers();
+
+            ID3D12GraphicsCommandList* d3dCommandList = commandList->getNativeObject(nvrhi::ObjectTypes::D3D12_GraphicsCommandList);
+            D3D12_RESOURCE_BARRIER d3dBarrier = {};
+            d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+            d3dBarrier.Aliasing.pResourceAfter = resource.texture
+                ? resource.texture->getNativeObject(nvrhi::ObjectTypes::D3D12_Resource)
+                : resource.buffer->getNativeObject(nvrhi::ObjectTypes::D3D12_Resource);
+            d3dCommandList->ResourceBarrier(1, &d3dBarrier);
+        }
+#endif
+
+        // nvrhi places a UAV barrier when a resource in the UnorderedAccess state is required in that state again
+        if (resource.texture)
+            commandList->setTextureState(resource.texture, nvrhi::AllSubresources, barrier.stateAfter);
+        else if (resource.buffer)
+            commandList->setBufferState(resource.buffer, barrier.stateAfter);
+    }
+
+    if (!barriers.empty())
+        commandList->commitBarriers();
+
+    const Pass& pass = m_Passes[m_Schedule[scheduleIndex]];
+    if (pass.function)
+        pass.function(commandList);
+
+    // Return the transient resources to their permanent state after their last use. Later passes may bind them
+    // with the other resources in their binding sets, and then nvrhi shouldn't need to transition them while
+    // another resource is using their memory.
+    for (const Resource& resource : m_Resources)
+    {
+        if (!resource.transient || resource.firstUse == ~0u || resource.lastUse != scheduleIndex)
+            continue;
+
+        if (resource.texture && resource.texture->getDesc().keepInitialState && resource.finalState != resource.texture->getDesc().initialState)
+            commandList->setTextureState(resource.texture, nvrhi::AllSubresources, resource.texture->getDesc().initialState);
+        else if (resource.buffer && resource.buffer->getDesc().keepInitialState && resource.finalState != resource.buffer->getDesc().initialState)
+            commandList->setBufferState(resource.buffer, resource.buffer->getDesc().initialState);
+    }
+}
+
+void RenderGraph::ExecuteInDeclarationOrder(nvrhi::ICommandList* commandList)
+{
+    for (const Pass& pass : m_Passes)
+    {
+        // nvrhi places a UAV barrier when a resource in the UnorderedAccess state is required in that state again
+        for (const PassAccess& access : pass.accesses)
+        {
+            const Resource& resource = m_Resources[access.resource];
+            if (access.state == nvrhi::ResourceStates::Unknown)
+                continue;
+
+            if (resource.texture)
+                commandList->setTextureState(resource.texture, nvrhi::AllSubresources, access.state);
+            else if (resource.buffer)
+                commandList->setBufferState(resource.buffer, access.state);
+        }
+        commandList->commitBarriers();
+
+        if (pass.function)
+            pass.function(commandList);
+    }
+}
+
+void RenderGraph::Execute(nvrhi::ICommandList* commandList)
+{
+    if (!m_Compiled)
+    {
+        ExecuteInDeclarationOrder(commandList);
+        return;
+    }
+
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+        RecordPass(commandList, scheduleIndex);
+}
+
+void RenderGraph::Execute(nvrhi::IDevice* device, nvrhi::ICommandList* graphicsCommandList, nvrhi::ICommandList* computeCommandList)
+{
+    if (!computeCommandList)
+    {
+        Execute(graphicsCommandList);
+        return;
+    }
+
+    std::array<nvrhi::ICommandList*, c_QueueCount> commandLists = {};
+    commandLists[size_t(nvrhi::CommandQueue::Graphics)] = graphicsCommandList;
+    commandLists[size_t(nvrhi::CommandQueue::Compute)] = computeCommandList;
+
+    std::array<bool, c_QueueCount> open = {};
+    open[size_t(nvrhi::CommandQueue::Graphics)] = true;
+
+    QueuePositions recorded;
+    recorded.fill(-2);
+    recorded[size_t(nvrhi::CommandQueue::Graphics)] = -1;
+
+    // The last schedule index and the instance of each submission
+    std::array<std::vector<std::pair<int64_t, uint64_t>>, c_QueueCount> submissions;
+
+    auto submit = [&](nvrhi::CommandQueue queue)
+    {
+        nvrhi::ICommandList* commandList = commandLists[size_t(queue)];
+        commandList->close();
+        submissions[size_t(queue)].push_back({ recorded[size_t(queue)], device->executeCommandList(commandList, queue) });
+        open[size_t(queue)] = false;
+    };
+
+    auto wait = [&](nvrhi::CommandQueue queue, const QueueWait& queueWait)
+    {
+        const int64_t position = queueWait.scheduleIndex == c_WorkBeforeGraph ? -1 : int64_t(queueWait.scheduleIndex);
+        for (const auto& [lastIndex, instance] : submissions[size_t(queueWait.queue)])
+        {
+            if (lastIndex >= position)
+            {
+                device->queueWaitForCommandList(queue, queueWait.queue, instance);
+                return;
+            }
+        }
+        assert(!"The awaited pass has not been submitted");
+    };
+
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+    {
+        const nvrhi::CommandQueue queue = m_Passes[m_Schedule[scheduleIndex]].queue;
+
+        for (nvrhi::CommandQueue submitQueue : m_SubmitsBefore[scheduleIndex])
+            submit(submitQueue);
+        for (const QueueWait& queueWait : m_Waits[scheduleIndex])
+            wait(queue, queueWait);
+
+        if (!open[size_t(queue)])
+        {
+            commandLists[size_t(queue)]->open();
+            open[size_t(queue)] = true;
+        }
+
+        RecordPass(commandLists[size_t(queue)], scheduleIndex);
+        recorded[size_t(queue)] = scheduleIndex;
+    }
+
+    for (nvrhi::CommandQueue submitQueue : m_FinalSubmits)
+        submit(submitQueue);
+    for (const QueueWait& queueWait : m_FinalWaits)
+        wait(nvrhi::CommandQueue::Graphics, queueWait);
+
+    if (!open[size_t(nvrhi::CommandQueue::Graphics)])
+        graphicsCommandList->open();
+}
+
+void RenderGraph::Execute(nvrhi::IDevice* device, nvrhi::ICommandList* graphicsCommandList, CommandListRecorder& recorder)
+{
+    const uint32_t commandListCount = uint32_t(m_CommandListQueues.size());
+
+    std::vector<nvrhi::ICommandList*> commandLists(commandListCount);
+    std::array<uint32_t, c_QueueCount> slots = {};
+    commandLists[0] = graphicsCommandList;
+    for (uint32_t listIndex = 1; listIndex < commandListCount; listIndex++)
+    {
+        const nvrhi::CommandQueue queue = m_CommandListQueues[listIndex];
+        commandLists[listIndex] = recorder.GetCommandList(queue, slots[size_t(queue)]++);
+    }
+
+    std::vector<std::vector<uint32_t>> listPasses(commandListCount);
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+        listPasses[m_CommandListIndex[scheduleIndex]].push_back(scheduleIndex);
+
+    std::vector<CommandListRecorder::Job> jobs;
+    for (uint32_t listIndex = 0; listIndex < commandListCount; listIndex++)
+    {
+        jobs.push_back([this, listIndex, &commandLists, &listPasses]
+        {
+            nvrhi::ICommandList* commandList = commandLists[listIndex];
+            if (listIndex != 0)
+                commandList->open();
+
+            const std::string& name = m_CommandListNames[m_CommandListNameIndices[listIndex]];
+            if (!name.empty())
+                commandList->beginMarker(name.c_str());
+
+            for (uint32_t scheduleIndex : listPasses[listIndex])
+                RecordPass(commandList, scheduleIndex);
+
+            if (!name.empty())
+                commandList->endMarker();
+
+            commandList->close();
+        });
+    }
+
+    recorder.Run(jobs);
+
+    // Submit in the order of the other Execute. The submissions are only made when a queue wait needs them
+    // or at the end, so that the command lists between two waits go to the queue together.
+    std::array<std::vector<nvrhi::ICommandList*>, c_QueueCount> pending;
+    QueuePositions pendingLastIndex;
+    std::array<std::vector<std::pair<int64_t, uint64_t>>, c_QueueCount> submissions;
+    std::array<uint32_t, c_QueueCount> openList = {};
+    std::array<bool, c_QueueCount> open = {};
+    open[size_t(nvrhi::CommandQueue::Graphics)] = true;
+
+    QueuePositions recorded;
+    recorded.fill(-2);
+    recorded[size_t(nvrhi::CommandQueue::Graphics)] = -1;
+
+    auto submit = [&](nvrhi::CommandQueue queue)
+    {
+        pending[size_t(queue)].push_back(commandLists[openList[size_t(queue)]]);
+        pendingLastIndex[size_t(queue)] = recorded[size_t(queue)];
+        open[size_t(queue)] = false;
+    };
+
+    auto flush = [&](nvrhi::CommandQueue queue)
+    {
+        std::vector<nvrhi::ICommandList*>& queueLists = pending[size_t(queue)];
+        if (queueLists.empty())
+            return;
+
+        const uint64_t instance = device->executeCommandLists(queueLists.data(), queueLists.size(), queue);
+        submissions[size_t(queue)].push_back({ pendingLastIndex[size_t(queue)], instance });
+        queueLists.clear();
+    };
+
+    auto wait = [&](nvrhi::CommandQueue queue, const QueueWait& queueWait)
+    {
+        flush(queueWait.queue);
+        flush(queue);
+
+        const int64_t position = queueWait.scheduleIndex == c_WorkBeforeGraph ? -1 : int64_t(queueWait.scheduleIndex);
+        for (const auto& [lastIndex, instance] : submissions[size_t(queueWait.queue)])
+        {
+            if (lastIndex >= position)
+            {
+                device->queueWaitForCommandList(queue, queueWait.queue, instance);
+                return;
+            }
+        }
+        assert(!"The awaited pass has not been submitted");
+    };
+
+    for (uint32_t scheduleIndex = 0; scheduleIndex < uint32_t(m_Schedule.size()); scheduleIndex++)
+    {
+        const nvrhi::CommandQueue queue = m_Passes[m_Schedule[scheduleIndex]].queue;
+
+        for (nvrhi::CommandQueue submitQueue : m_SubmitsBefore[scheduleIndex])
+            submit(submitQueue);
+        for (const QueueWait& queueWait : m_Waits[scheduleIndex])
+            wait(queue, queueWait);
+
+        if (!open[size_t(queue)])
+        {
+            open[size_t(queue)] = true;
+            openList[size_t(queue)] = m_CommandListIndex[scheduleIndex];
+        }
+
+        recorded[size_t(queue)] = scheduleIndex;
+    }
+
+    for (nvrhi::CommandQueue submitQueue : m_FinalSubmits)
+        submit(submitQueue);
+    for (const QueueWait& queueWait : m_FinalWaits)
+        wait(nvrhi::CommandQueue::Graphics, queueWait);
+
+    for (size_t queue = 0; queue < c_QueueCount; queue++)
+    {
+        if (open[queue])
+            submit(nvrhi::CommandQueue(queue));
+        flush(nvrhi::CommandQueue(queue));
+    }
+
+    graphicsCommandList->open();
+}
+
+nvrhi::HeapHandle RenderGraph::PlaceTransientResources(nvrhi::IDevice* device, const char* heapName)
+{
+    for (Resource& resource : m_Resources)
+    {
+        if (!resource.transient)
+            continue;
+
+        const nvrhi::MemoryRequirements requirements = resource.texture
+            ? device->getTextureMemoryRequirements(resource.texture)
+            : device->getBufferMemoryRequirements(resource.buffer);
+
+        resource.size = requirements.size;
+        resource.alignment = std::max<uint64_t>(requirements.alignment, 1);
+    }
+
+    PlaceTransients();
+
+    if (m_TransientMemorySize == 0)
+        return nullptr;
+
+    nvrhi::HeapDesc heapDesc;
+    heapDesc.type = nvrhi::HeapType::DeviceLocal;
+    heapDesc.capacity = m_TransientMemorySize;
+    heapDesc.debugName = heapName;
+
+    nvrhi::HeapHandle heap = device->createHeap(heapDesc);
+    if (!heap)
+        return nullptr;
+
+    for (const Resource& resource : m_Resources)
+    {
+        if (!resource.transient)
+            continue;
+
+        const bool bound = resource.texture
+            ? device->bindTextureMemory(resource.texture, heap, resource.offset)
+            : device->bindBufferMemory(resource.buffer, heap, resource.offset);
+
+        if (!bound)
+            return nullptr;
+    }
+
+    log::info("Placed %d transient resources (%.1f MB) in a %.1f MB heap",
+        int(std::count_if(m_Resources.begin(), m_Resources.end(), [](const Resource& resource) { return resource.transient; })),
+        double(GetTransientResourceSize()) / (1024.0 * 1024.0),
+        double(m_TransientMemorySize) / (1024.0 * 1024.0));
+
+    return heap;
+}
@@ -0,0 +1,198 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <array>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CommandListRecorder;
+
+// Schedules the passes of a frame from the resources that they read and write.
+// Passes declare their accesses to the resources that need tracking, then Compile:
+//  - skips the passes whose results are never used,
+//  - finds a topological order of the remaining passes, which keeps the declaration order when possible,
+//  - computes the barriers needed before each pass, including the UAV barriers that nvrhi can't see
+//    when consecutive passes use the same binding set,
+//  - computes the waits between the queues when passes run on more than one queue,
+//  - assigns memory offsets to the transient resources so that the ones with disjoint lifetimes share memory.
+// Accesses to resources that are not declared are handled by the automatic barriers of nvrhi as usual.
+class RenderGraph
+{
+public:
+    typedef uint32_t ResourceHandle;
+    typedef std::function<void(nvrhi::ICommandList*)> PassFunction;
+
+    static constexpr uint64_t c_NotPlaced = ~0ull;
+    static constexpr uint32_t c_WorkBeforeGraph = ~0u;
+
+    struct Access
+    {
+        ResourceHandle resource;
+        nvrhi::ResourceStates state;
+    };
+
+    struct Barrier
+    {
+        ResourceHandle resource;
+        nvrhi::ResourceStates stateBefore; // Unknown on the first access in the graph
+        nvrhi::ResourceStates stateAfter;
+        bool uavBarrier = false; // orders UAV accesses, stateBefore and stateAfter are both UnorderedAccess
+        bool discard = false;    // first access to a transient resource, its memory may have been used by another one
+    };
+
+    // A queue waits until another queue has finished a pass, or the work recorded before the graph
+    struct QueueWait
+    {
+        nvrhi::CommandQueue queue;
+        uint32_t scheduleIndex; // or c_WorkBeforeGraph
+    };
+
+    // Virtual textures and buffers are transient: their contents are only valid from their first to their last access
+    // in the graph, and they are bound to memory by PlaceTransientResources. Other resources are persistent.
+    // Importing the same object again returns the same handle.
+    ResourceHandle ImportTexture(nvrhi::ITexture* texture);
+    ResourceHandle ImportBuffer(nvrhi::IBuffer* buffer);
+
+    // A resource without a graphics object, for testing the compiler
+    ResourceHandle AddResource(const std::string& name, uint64_t size, uint64_t alignment, bool transient);
+
+    // Declare the passes in a valid execution order, the graph only moves a pass behind the passes that it depends on.
+    // Writes may also read the previous contents. Passes that write nothing or write persistent resources always run.
+    void AddPass(const std::string& name, std::vector<Access> reads, std::vector<Access> writes, PassFunction function = nullptr);
+
+    // Passes added after this call run on the given queue, the graphics queue by default. The graphics queue runs
+    // the work before and after the graph: the other queues wait for the work before the graph when they start, and
+    // the graphics queue waits for them at the end. Only declared accesses are synchronized between the queues, and
+    // the resources shared by the queues must keep their initial state.
+    void SetQueue(nvrhi::CommandQueue queue) { m_Queue = queue; }
+
+    // Passes added after this call go into a new command list on their queue, so that the command lists can be
+    // recorded in parallel. The passes added before the first call share the command list of the work before the graph.
+    // As with the queues, the resources used in more than one command list must keep their initial state.
+    void BeginCommandList(const std::string& name);
+
+    // Returns false if a transient resource is read before it is written, or if a pass uses a resource in two states
+    // that can't be combined. The offsets of the imported transient resources are only known after PlaceTransientResources.
+    bool Compile();
+
+    // Records the scheduled passes, preceded by their barriers. Transient resources go back to their permanent state
+    // after their last use. All passes go into the one command list, whatever their queue.
+    // If Compile failed, records every pass in declaration order with a barrier into each declared state instead,
+    // which is only correct when the transient resources don't share memory.
+    void Execute(nvrhi::ICommandList* commandList);
+
+    // Records the passes into the command list of their queue and submits the command lists where a queue has to
+    // wait for another one. The graphics command list contains the work before the graph, it is open again with
+    // the work of the last passes when this returns. Needs a successful Compile.
+    void Execute(nvrhi::IDevice* device, nvrhi::ICommandList* graphicsCommandList, nvrhi::ICommandList* computeCommandList);
+
+    // Records every command list of the graph as one job of the recorder, then submits them in order with the queue
+    // waits, merging the consecutive command lists of a queue into one submission. The recorder provides the command
+    // lists other than the graphics command list, which contains the work before the graph. All passes are submitted
+    // when this returns, and the graphics command list is open again. Needs a successful Compile.
+    void Execute(nvrhi::IDevice* device, nvrhi::ICommandList* graphicsCommandList, CommandListRecorder& recorder);
+
+    // Binds the memory of all transient resources in a new heap, at offsets found from the lifetimes in this graph.
+    // The graph must contain every pass that may use the transient resources in any frame, in the frame order,
+    // so that the lifetimes in the graphs of later frames are shorter. Returns null if the heap can't be created.
+    nvrhi::HeapHandle PlaceTransientResources(nvrhi::IDevice* device, const char* heapName);
+
+    [[nodiscard]] const std::vector<uint32_t>& GetSchedule() const { return m_Schedule; }
+    [[nodiscard]] const std::vector<Barrier>& GetBarriers(uint32_t scheduleIndex) const { return m_Barriers[scheduleIndex]; }
+    [[nodiscard]] const std::string& GetPassName(uint32_t passIndex) const { return m_Passes[passIndex].name; }
+    [[nodiscard]] uint32_t GetPassCount() const { return uint32_t(m_Passes.size()); }
+    [[nodiscard]] bool IsPassCulled(uint32_t passIndex) const { return m_Passes[passIndex].culled; }
+    [[nodiscard]] nvrhi::CommandQueue GetPassQueue(uint32_t passIndex) const { return m_Passes[passIndex].queue; }
+    [[nodiscard]] const std::vector<QueueWait>& GetWaits(uint32_t scheduleIndex) const { return m_Waits[scheduleIndex]; }
+    [[nodiscard]] const std::vector<QueueWait>& GetFinalWaits() const { return m_FinalWaits; }
+    [[nodiscard]] uint32_t GetCommandListCount() const { return uint32_t(m_CommandListQueues.size()); }
+    [[nodiscard]] uint32_t GetCommandListIndex(uint32_t scheduleIndex) const { return m_CommandListIndex[scheduleIndex]; }
+    [[nodiscard]] uint64_t GetTransientOffset(ResourceHandle resource) const { return m_Resources[resource].offset; }
+    [[nodiscard]] uint64_t GetTransientMemorySize() const { return m_TransientMemorySize; }
+    [[nodiscard]] uint64_t GetTransientResourceSize() const;
+
+private:
+    static constexpr size_t c_QueueCount = size_t(nvrhi::CommandQueue::Count);
+
+    // For each queue, the last schedule index known to be complete: -1 for the work before the graph, -2 for nothing
+    typedef std::array<int64_t, c_QueueCount> QueuePositions;
+
+    struct Resource
+    {
+        std::string name;
+        nvrhi::TextureHandle texture;
+        nvrhi::BufferHandle buffer;
+        bool transient = false;
+        uint64_t size = 0;
+        uint64_t alignment = 1;
+
+        // Schedule indices of the first and last access, set by Compile
+        uint32_t firstUse = ~0u;
+        uint32_t lastUse = 0;
+        std::vector<uint32_t> uses;
+        nvrhi::ResourceStates finalState = nvrhi::ResourceStates::Unknown;
+        uint64_t offset = c_NotPlaced;
+    };
+
+    struct PassAccess
+    {
+        ResourceHandle resource;
+        nvrhi::ResourceStates state;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<PassAccess> accesses; // one per resource
+        PassFunction function;
+        nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics;
+        uint32_t commandList = 0; // index into m_CommandListNames
+        bool culled = false;
+    };
+
+    std::vector<Resource> m_Resources;
+    std::vector<Pass> m_Passes;
+    std::unordered_map<nvrhi::IResource*, ResourceHandle> m_ImportedResources;
+
+    std::vector<uint32_t> m_Schedule;
+    std::vector<std::vector<Barrier>> m_Barriers;
+    std::vector<std::vector<QueueWait>> m_Waits;
+    std::vector<QueueWait> m_FinalWaits;
+    std::vector<std::vector<nvrhi::CommandQueue>> m_SubmitsBefore; // command lists closed and submitted before the waits
+    std::vector<nvrhi::CommandQueue> m_FinalSubmits;
+    std::vector<uint32_t> m_CommandListIndex;      // per scheduled pass, counting the command lists in submission order
+    std::vector<nvrhi::CommandQueue> m_CommandListQueues;
+    std::vector<uint32_t> m_CommandListNameIndices;
+    std::vector<std::string> m_CommandListNames = { "" };
+    std::vector<QueuePositions> m_CompletedBefore; // per scheduled pass, what its queue has waited for
+    uint64_t m_TransientMemorySize = 0;
+    nvrhi::CommandQueue m_Queue = nvrhi::CommandQueue::Graphics;
+    bool m_Compiled = false;
+
+    void CullPasses();
+    bool SchedulePasses();
+    void ComputeBarriers();
+    void ComputeQueueWaits();
+    void PlaceTransients();
+    void RecordPass(nvrhi::ICommandList* commandList, uint32_t scheduleIndex);
+    void ExecuteInDeclarationOrder(nvrhi::ICommandList* commandList);
+
+    // True if the first pass has finished before the second one starts, on any queues
+    [[nodiscard]] bool IsOrdered(uint32_t firstScheduleIndex, uint32_t secondScheduleIndex) const;
+
+    // True if every use of the first resource is ordered before every use of the second one
+    [[nodiscard]] bool IsBefore(const Resource& first, const Resource& second) const;
+};
@@ -195,6 +195,7 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.height = (size.y + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
     desc.format = nvrhi::Format::RGBA16_FLOAT;
     desc.debugName = "Gradients";
+    desc.isVirtual = true; // shares memory with other transient resources, see PlaceTransientResources in main.cpp
     Gradients = device->createTexture(desc);
 
     nvrhi::TextureDesc debugDesc;
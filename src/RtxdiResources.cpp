@@ -30,11 +30,13 @@ RtxdiResources::RtxdiResources(
     uint32_t environmentMapHeight,
     uint32_t virtualLightSamplesPerFrame,
     uint32_t virtualLightSampleLifespan,
-    uint32_t reGIRCellCount)
+    uint32_t reGIRCellCount,
+    bool environmentAliasTable)
     : m_MaxEmissiveMeshes(maxEmissiveMeshes)
     , m_MaxEmissiveTriangles(maxEmissiveTriangles)
     , m_MaxPrimitiveLights(maxPrimitiveLights)
     , m_MaxGeometryInstances(maxGeometryInstances)
+    , m_EnvironmentAliasTable(environmentAliasTable)
 {
     m_VirtualLightSamplesPerFrame = virtualLightSamplesPerFrame;
     m_VirtualLightSampleLifespan = virtualLightSampleLifespan;
@@ -101,9 +103,15 @@ RtxdiResources::RtxdiResources(
     dirReGIRBufferDesc.debugName = "DirReGIRLightDataBuffer";
     DirReGIRLightDataBuffer = device->createBuffer(dirReGIRBufferDesc);
 
+    dirReGIRBufferDesc.byteSize = sizeof(uint32_t) * std::max(reGIRCellCount * 16 * 16, 1u); // R32_UINT per element
+    dirReGIRBufferDesc.format = nvrhi::Format::R32_UINT;
+    dirReGIRBufferDesc.debugName = "DirReGIRPackedBuffer";
+    DirReGIRPackedBuffer = device->createBuffer(dirReGIRBufferDesc);
+
 
     uint32_t maxLocalLights = maxEmissiveTriangles + maxPrimitiveLights + maxVirtualLights;
     uint32_t lightBufferElements = maxLocalLights * 2;
+    m_LightBufferElements = lightBufferElements;
 
     nvrhi::BufferDesc lightBufferDesc;
     lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightBufferElements;
@@ -173,6 +181,7 @@ RtxdiResources::RtxdiResources(
     secondaryGBufferDesc.keepInitialState = true;
     secondaryGBufferDesc.debugName = "SecondaryGBuffer";
     secondaryGBufferDesc.canHaveUAVs = true;
+    secondaryGBufferDesc.isVirtual = true; // shares memory with other transient resources, see PlaceTransientResources in main.cpp
     SecondaryGBuffer = device->createBuffer(secondaryGBufferDesc);
 
 
@@ -183,6 +192,7 @@ RtxdiResources::RtxdiResources(
     GSGIGBufferDesc.keepInitialState = true;
     GSGIGBufferDesc.debugName = "GSGIGBuffer";
     GSGIGBufferDesc.canHaveUAVs = true;
+    GSGIGBufferDesc.isVirtual = true; // shares memory with other transient resources, see PlaceTransientResources in main.cpp
     GSGIGBuffer = device->createBuffer(GSGIGBufferDesc);
 
 
@@ -197,6 +207,24 @@ RtxdiResources::RtxdiResources(
     environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
     EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
 
+    // The alias tables take 8 bytes per texel, so they are only allocated when they are used.
+    // Otherwise the buffers only hold one entry, so that the binding set is the same.
+    const uint32_t aliasTableWidth = environmentAliasTable ? environmentMapWidth : 1;
+    const uint32_t aliasTableHeight = environmentAliasTable ? environmentMapHeight : 1;
+
+    nvrhi::BufferDesc environmentAliasTableDesc;
+    environmentAliasTableDesc.byteSize = sizeof(uint2) * aliasTableWidth * aliasTableHeight;
+    environmentAliasTableDesc.structStride = sizeof(uint2);
+    environmentAliasTableDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    environmentAliasTableDesc.keepInitialState = true;
+    environmentAliasTableDesc.debugName = "EnvironmentAliasTable";
+    environmentAliasTableDesc.canHaveUAVs = true;
+    EnvironmentAliasTableBuffer = device->createBuffer(environmentAliasTableDesc);
+
+    environmentAliasTableDesc.byteSize = sizeof(uint2) * aliasTableHeight;
+    environmentAliasTableDesc.debugName = "EnvironmentAliasMarginal";
+    EnvironmentAliasMarginalBuffer = device->createBuffer(environmentAliasTableDesc);
+
     nvrhi::TextureDesc localLightPdfDesc;
     rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
     assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
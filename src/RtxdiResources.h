@@ -29,6 +29,8 @@ private:
     uint32_t m_MaxGeometryInstances = 0;
     uint32_t m_VirtualLightSamplesPerFrame = 0;
     uint32_t m_VirtualLightSampleLifespan = 0;
+    uint32_t m_LightBufferElements = 0;
+    bool m_EnvironmentAliasTable = false;
 
 public:
     nvrhi::BufferHandle TaskBuffer;
@@ -42,12 +44,15 @@ public:
     nvrhi::BufferHandle RisLightDataBuffer;
     nvrhi::BufferHandle DirReGIRBuffer;
     nvrhi::BufferHandle DirReGIRLightDataBuffer;
+    nvrhi::BufferHandle DirReGIRPackedBuffer;
     nvrhi::BufferHandle NeighborOffsetsBuffer;
     nvrhi::BufferHandle LightReservoirBuffer;
     nvrhi::BufferHandle SecondaryGBuffer;
     nvrhi::BufferHandle GSGIGBuffer;
     nvrhi::TextureHandle EnvironmentPdfTexture;
     nvrhi::TextureHandle LocalLightPdfTexture;
+    nvrhi::BufferHandle EnvironmentAliasTableBuffer;
+    nvrhi::BufferHandle EnvironmentAliasMarginalBuffer;
     nvrhi::BufferHandle GIReservoirBuffer;
     nvrhi::BufferHandle GSGIReservoirBuffer;
     nvrhi::BufferHandle GSGIGridBuffer;
@@ -64,7 +69,8 @@ public:
         uint32_t environmentMapHeight,
         uint32_t virtualLightSamplesPerFrame,
         uint32_t virtualLightSampleLifespan,
-        uint32_t reGIRCellCount);
+        uint32_t reGIRCellCount,
+        bool environmentAliasTable);
 
     void InitializeNeighborOffsets(nvrhi::ICommandList* commandList, uint32_t neighborOffsetCount);
 
@@ -74,4 +80,6 @@ public:
     uint32_t GetMaxGeometryInstances() const { return m_MaxGeometryInstances; }
     uint32_t GetVirtualLightSamplesPerFrame() const { return m_VirtualLightSamplesPerFrame; }
     uint32_t GetVirtualLightSampleLifespan() const { return m_VirtualLightSampleLifespan; }
+    bool HasEnvironmentAliasTable() const { return m_EnvironmentAliasTable; }
+    uint32_t GetLightBufferElements() const { return m_LightBufferElements; } // both halves
 };
@@ -9,11 +9,17 @@
  **************************************************************************/
 
 #include "SampleScene.h"
+#include "BlasBuildScheduler.h"
+#include "BlasDeduplication.h"
+#include "CpuProfiler.h"
+#include "SceneCache.h"
 #include <donut/core/json.h>
+#include <donut/core/log.h>
 #include <donut/core/vfs/VFS.h>
 #include <json/value.h>
 #include <nvrhi/utils.h>
 #include <nvrhi/common/misc.h>
+#include <unordered_map>
 
 #include "donut/engine/TextureCache.h"
 
@@ -198,6 +204,12 @@ bool SampleScene::LoadWithExecutor(const std::filesystem::path& jsonFileName, tf
         }
     }
 
+    if (m_SceneCache && m_SceneCache->IsValid())
+    {
+        m_EnvironmentMaps = m_SceneCache->GetContents().environmentMaps;
+        return true;
+    }
+
     // Enumerate the available environment maps
     std::vector<std::string> environmentMapNames;
     const std::string texturePath = "/media/environment/";
@@ -214,6 +226,9 @@ bool SampleScene::LoadWithExecutor(const std::filesystem::path& jsonFileName, tf
     return true;
 }
 
+// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, also enough for Vulkan scratch buffers
+constexpr uint64_t c_BlasScratchAlignment = 256;
+
 inline uint64_t advanceHeapPtr(uint64_t& heapPtr, const nvrhi::MemoryRequirements& memReq)
 {
     heapPtr = nvrhi::align(heapPtr, memReq.alignment);
@@ -224,15 +239,50 @@ inline uint64_t advanceHeapPtr(uint64_t& heapPtr, const nvrhi::MemoryRequirement
     return current;
 }
 
-void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
+void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device, uint64_t scratchBudget)
 {
     assert(device->queryFeatureSupport(nvrhi::Feature::VirtualResources));
 
+    // Find the non-skinned meshes with identical geometry, they share one BLAS
+    std::vector<std::shared_ptr<engine::MeshInfo>> meshes;
+    std::vector<BlasMeshView> meshViews;
+    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    {
+        meshes.push_back(mesh);
+        BlasMeshView& view = meshViews.emplace_back();
+
+        const auto& buffers = mesh->buffers;
+        if (mesh->skinPrototype || buffers->hasAttribute(engine::VertexAttribute::JointWeights) ||
+            buffers->positionData.size() < size_t(mesh->vertexOffset) + mesh->totalVertices ||
+            buffers->indexData.size() < size_t(mesh->indexOffset) + mesh->totalIndices)
+            continue;
+
+        view.positions = buffers->positionData.data() + mesh->vertexOffset;
+        view.indices = buffers->indexData.data() + mesh->indexOffset;
+        view.vertexCount = mesh->totalVertices;
+        view.indexCount = mesh->totalIndices;
+        view.shareable = true;
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            BlasGeometryRange& range = view.geometries.emplace_back();
+            range.vertexOffset = geometry->vertexOffsetInMesh;
+            range.vertexCount = geometry->numVertices;
+            range.indexOffset = geometry->indexOffsetInMesh;
+            range.indexCount = geometry->numIndices;
+            range.opaque = geometry->material->domain == engine::MaterialDomain::Opaque;
+        }
+    }
+
+    const std::vector<uint32_t> blasOwners = FindDuplicateBlasMeshes(meshViews, HashBlasMeshes(meshViews, 0));
+
     uint64_t heapSize = 0;
 
-    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
     {
-        if (mesh->buffers->hasAttribute(engine::VertexAttribute::JointWeights))
+        const auto& mesh = meshes[meshIndex];
+
+        if (mesh->buffers->hasAttribute(engine::VertexAttribute::JointWeights) || blasOwners[meshIndex] != meshIndex)
             continue;
 
         nvrhi::rt::AccelStructDesc blasDesc;
@@ -342,35 +392,149 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
     device->bindAccelStructMemory(m_PrevTopLevelAS, heap, heapOffset);
 
 
-    nvrhi::CommandListParameters clparams;
-    clparams.scratchChunkSize = clparams.scratchMaxMemory;
-
-    nvrhi::CommandListHandle commandList = device->createCommandList(clparams);
-    commandList->open();
+    // Schedule the builds into batches whose scratch memory fits into the budget. nvrhi does not expose the
+    // prebuild scratch size, so the size of the acceleration structure itself is used as the estimate.
+    std::vector<engine::MeshInfo*> blasMeshes;
+    std::vector<BlasBuildItem> buildItems;
+    m_BlasBuildStats = BlasBuildStatistics();
 
     for (const auto& mesh : GetSceneGraph()->GetMeshes())
     {
         if (!mesh->accelStruct)
             continue;
 
-        // Get the desc from the AS, restore the buffer pointers because they're erased by nvrhi
-        nvrhi::rt::AccelStructDesc blasDesc = mesh->accelStruct->getDesc();
-        for (auto& geometryDesc : blasDesc.bottomLevelGeometries)
+        buildItems.push_back(BlasBuildItem{ uint32_t(blasMeshes.size()), device->getAccelStructMemoryRequirements(mesh->accelStruct).size });
+        blasMeshes.push_back(mesh.get());
+
+        if (!mesh->skinPrototype)
+            m_BlasBuildStats.compactableBlases++;
+    }
+
+    const std::vector<BlasBuildBatch> batches = ScheduleBlasBuilds(buildItems, scratchBudget, c_BlasScratchAlignment);
+
+    for (const BlasBuildBatch& batch : batches)
+        m_BlasBuildStats.peakBatchScratch = std::max(m_BlasBuildStats.peakBatchScratch, batch.scratchSize);
+
+    m_BlasBuildStats.blases = uint32_t(blasMeshes.size());
+    m_BlasBuildStats.batches = uint32_t(batches.size());
+    m_BlasBuildStats.scratchBudget = scratchBudget;
+    m_BlasBuildStats.heapSize = heapSize;
+
+    // Two batches can be in flight at the same time, so the scratch chunks of batch N can be reused by batch N+2
+    // while the GPU is still working on batch N+1. There is no wait for idle, the first frame is submitted on the
+    // same queue and CompactMeshBLASes starts the compaction when the last batch is done.
+    nvrhi::CommandListParameters clparams;
+    clparams.scratchChunkSize = std::max(scratchBudget, c_BlasScratchAlignment);
+    clparams.scratchMaxMemory = std::max(clparams.scratchMaxMemory, m_BlasBuildStats.peakBatchScratch * 2);
+
+    nvrhi::CommandListHandle commandList = device->createCommandList(clparams);
+    nvrhi::EventQueryHandle batchQueries[2] = { device->createEventQuery(), device->createEventQuery() };
+
+    for (size_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+    {
+        const BlasBuildBatch& batch = batches[batchIndex];
+        nvrhi::IEventQuery* batchQuery = batchQueries[batchIndex % 2];
+
+        if (batchIndex >= 2)
+            device->waitEventQuery(batchQuery);
+
+        if (batch.overBudget)
         {
-            geometryDesc.geometryData.triangles.indexBuffer = mesh->buffers->indexBuffer;
-            geometryDesc.geometryData.triangles.vertexBuffer = mesh->buffers->vertexBuffer;
+            log::warning("BLAS '%s' needs %.1f MB of scratch memory, which is over the budget of %.1f MB",
+                blasMeshes[batch.ids[0]]->name.c_str(), double(batch.scratchSize) / (1 << 20), double(scratchBudget) / (1 << 20));
         }
 
-        nvrhi::utils::BuildBottomLevelAccelStruct(commandList, mesh->accelStruct, blasDesc);
+        commandList->open();
+
+        for (uint32_t id : batch.ids)
+        {
+            engine::MeshInfo* mesh = blasMeshes[id];
+
+            // Get the desc from the AS, restore the buffer pointers because they're erased by nvrhi
+            nvrhi::rt::AccelStructDesc blasDesc = mesh->accelStruct->getDesc();
+            for (auto& geometryDesc : blasDesc.bottomLevelGeometries)
+            {
+                geometryDesc.geometryData.triangles.indexBuffer = mesh->buffers->indexBuffer;
+                geometryDesc.geometryData.triangles.vertexBuffer = mesh->buffers->vertexBuffer;
+            }
+
+            nvrhi::utils::BuildBottomLevelAccelStruct(commandList, mesh->accelStruct, blasDesc);
+        }
+
+        commandList->close();
+        device->executeCommandList(commandList);
+
+        device->resetEventQuery(batchQuery);
+        device->setEventQuery(batchQuery, nvrhi::CommandQueue::Graphics);
+        m_BlasBuildQuery = batchQuery;
     }
 
-    commandList->close();
-    device->executeCommandList(commandList);
+    // The duplicates only get their BLAS now, so that the loops above bind and build each BLAS once
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
+    {
+        const auto& owner = meshes[blasOwners[meshIndex]];
+        if (blasOwners[meshIndex] == meshIndex || !owner->accelStruct)
+            continue;
+
+        auto sampleMesh = dynamic_cast<SampleMesh*>(meshes[meshIndex].get());
+        assert(sampleMesh);
+        sampleMesh->accelStruct = owner->accelStruct;
+        sampleMesh->sharesAccelStruct = true;
+
+        m_BlasBuildStats.sharedBlases++;
+        m_BlasBuildStats.sharedMemory += device->getAccelStructMemoryRequirements(owner->accelStruct).size;
+    }
 
-    device->waitForIdle();
     device->runGarbageCollection();
 }
 
+void SampleScene::CompactMeshBLASes(nvrhi::IDevice* device, nvrhi::ICommandList* commandList)
+{
+    // Nothing to compact until the last build batch is done, the builds are not waited on
+    if (m_BlasBuildQuery)
+    {
+        if (!device->pollEventQuery(m_BlasBuildQuery))
+            return;
+
+        m_BlasBuildQuery = nullptr;
+    }
+
+    commandList->compactBottomLevelAccelStructs();
+
+    if (m_BlasBuildStats.reported)
+        return;
+
+    // nvrhi does not report the compacted sizes, only which acceleration structures have been compacted
+    uint32_t compactedBlases = 0;
+    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    {
+        auto sampleMesh = dynamic_cast<SampleMesh*>(mesh.get());
+        if (mesh->accelStruct && !mesh->skinPrototype && !(sampleMesh && sampleMesh->sharesAccelStruct) && mesh->accelStruct->isCompacted())
+            compactedBlases++;
+    }
+
+    // Compaction needs the sizes to be read back, which takes a few frames, and some backends never compact
+    constexpr uint32_t maxReportDelay = 100;
+    if (compactedBlases < m_BlasBuildStats.compactableBlases && ++m_BlasBuildStats.framesSinceBuild < maxReportDelay)
+        return;
+
+    log::info("BLAS BUILD >>>\n\n"
+        "BLASes:                  %9u\n"
+        "Build batches:           %9u\n"
+        "Scratch budget:          %9.1f MB\n"
+        "Largest batch scratch:   %9.1f MB\n"
+        "Uncompacted memory:      %9.1f MB\n"
+        "Compacted BLASes:        %9u of %u\n"
+        "Meshes sharing a BLAS:   %9u\n"
+        "Memory saved by sharing: %9.1f MB\n<<<",
+        m_BlasBuildStats.blases, m_BlasBuildStats.batches, double(m_BlasBuildStats.scratchBudget) / (1 << 20),
+        double(m_BlasBuildStats.peakBatchScratch) / (1 << 20), double(m_BlasBuildStats.heapSize) / (1 << 20),
+        compactedBlases, m_BlasBuildStats.compactableBlases,
+        m_BlasBuildStats.sharedBlases, double(m_BlasBuildStats.sharedMemory) / (1 << 20));
+
+    m_BlasBuildStats.reported = true;
+}
+
 void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex)
 {
     commandList->beginMarker("Skinned BLAS Updates");
@@ -410,53 +574,122 @@ void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint
     commandList->endMarker();
 }
 
-void SampleScene::BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList)
+void SampleScene::UpdateTlasInstanceSources()
 {
-    m_TlasInstances.resize(GetSceneGraph()->GetMeshInstances().size());
+    m_TlasInstanceSources.clear();
+    m_TlasMeshes.clear();
 
-    nvrhi::rt::AccelStructBuildFlags buildFlags = m_CanUpdateTLAS
-        ? nvrhi::rt::AccelStructBuildFlags::PerformUpdate
-        : nvrhi::rt::AccelStructBuildFlags::None;
-    
-    uint32_t index = 0;
+    std::unordered_map<const engine::MeshInfo*, uint32_t> meshIndices;
 
-    for (const auto& instance : GetSceneGraph()->GetMeshInstances())
+    const auto& meshInstances = GetSceneGraph()->GetMeshInstances();
+    for (const auto& instance : meshInstances)
     {
         const auto& mesh = instance->GetMesh();
-        
+
         if (!mesh->accelStruct)
             continue;
 
-        nvrhi::rt::InstanceDesc& instanceDesc = m_TlasInstances[index++];
+        auto [it, inserted] = meshIndices.try_emplace(mesh.get(), uint32_t(m_TlasMeshes.size()));
+        if (inserted)
+            m_TlasMeshes.push_back(mesh.get());
+
+        m_TlasInstanceSources.push_back(TlasInstanceSource{ instance.get(), it->second });
+    }
+
+    m_TlasMeshFlags.resize(m_TlasMeshes.size());
+    m_TlasMeshInstanceCount = meshInstances.size();
 
-        instanceDesc.instanceMask = 0;
-        engine::SceneContentFlags contentFlags = instance->GetContentFlags();
+    // The instance count has changed, so the next builds cannot be updates
+    m_CanUpdateTLAS = false;
+    m_CanUpdatePrevTLAS = false;
+}
 
-        if ((contentFlags & engine::SceneContentFlags::OpaqueMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_OPAQUE;
+void SampleScene::BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList)
+{
+    CpuProfilerScope cpuScope("SampleScene::BuildTopLevelAccelStruct");
 
-        if ((contentFlags & engine::SceneContentFlags::AlphaTestedMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_ALPHA_TESTED;
+    if (GetSceneGraph()->GetMeshInstances().size() != m_TlasMeshInstanceCount || m_TlasInstanceSources.empty())
+        UpdateTlasInstanceSources();
 
-        if ((contentFlags & engine::SceneContentFlags::BlendedMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_TRANSPARENT;
+    // The double-sided flag depends on the materials, which can be edited, so it is checked on every build,
+    // but once per mesh and not once per instance.
+    // The BLASes may have been built, updated or compacted since the previous build, the TLAS build needs them ready.
+    for (size_t meshIndex = 0; meshIndex < m_TlasMeshes.size(); meshIndex++)
+    {
+        const engine::MeshInfo* mesh = m_TlasMeshes[meshIndex];
 
+        m_TlasMeshFlags[meshIndex] = nvrhi::rt::InstanceFlags::None;
         for (const auto& geometry : mesh->geometries)
         {
             if (geometry->material->doubleSided)
-                instanceDesc.flags = nvrhi::rt::InstanceFlags::TriangleCullDisable;
+                m_TlasMeshFlags[meshIndex] = nvrhi::rt::InstanceFlags::TriangleCullDisable;
         }
 
-        instanceDesc.bottomLevelAS = mesh->accelStruct;
+        commandList->setAccelStructState(mesh->accelStruct, nvrhi::ResourceStates::AccelStructBuildBlas);
+    }
+
+    const uint32_t instanceCount = uint32_t(m_TlasInstanceSources.size());
+    const uint64_t instanceBufferSize = std::max(instanceCount, 1u) * sizeof(nvrhi::rt::InstanceDesc);
+
+    if (!m_TlasInstanceBuffer || m_TlasInstanceBuffer->getDesc().byteSize < instanceBufferSize)
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = instanceBufferSize;
+        bufferDesc.debugName = "TlasInstances";
+        bufferDesc.isAccelStructBuildInput = true;
+        bufferDesc.initialState = nvrhi::ResourceStates::AccelStructBuildInput;
+        bufferDesc.keepInitialState = true;
+
+        m_TlasInstanceBuffer = commandList->getDevice()->createBuffer(bufferDesc);
+        m_TlasInstanceUpdater.Invalidate();
+    }
+
+    // The descriptors are compared with the previous build, only the changed ones are uploaded
+    m_TlasInstanceUpdater.Update(instanceCount, [this](uint32_t begin, uint32_t end, nvrhi::rt::InstanceDesc* instances)
+    {
+        for (uint32_t index = begin; index < end; index++)
+        {
+            const TlasInstanceSource& source = m_TlasInstanceSources[index];
+            nvrhi::rt::InstanceDesc instanceDesc;
+
+            engine::SceneContentFlags contentFlags = source.instance->GetContentFlags();
 
-        auto node = instance->GetNode();
-        if (node)
-            dm::affineToColumnMajor(node->GetLocalToWorldTransformFloat(), instanceDesc.transform);
+            if ((contentFlags & engine::SceneContentFlags::OpaqueMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_OPAQUE;
 
-        instanceDesc.instanceID = uint(instance->GetInstanceIndex());
+            if ((contentFlags & engine::SceneContentFlags::AlphaTestedMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_ALPHA_TESTED;
+
+            if ((contentFlags & engine::SceneContentFlags::BlendedMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_TRANSPARENT;
+
+            instanceDesc.flags = m_TlasMeshFlags[source.meshIndex];
+
+            // Skinned meshes swap their BLASes and compaction moves them, so the address is read on every build
+            instanceDesc.blasDeviceAddress = m_TlasMeshes[source.meshIndex]->accelStruct->getDeviceAddress();
+
+            auto node = source.instance->GetNode();
+            if (node)
+                dm::affineToColumnMajor(node->GetLocalToWorldTransformFloat(), instanceDesc.transform);
+
+            instanceDesc.instanceID = uint(source.instance->GetInstanceIndex());
+
+            instances[index - begin] = instanceDesc;
+        }
+    });
+
+    const nvrhi::rt::InstanceDesc* instances = m_TlasInstanceUpdater.GetInstances().data();
+    for (const TlasInstanceRange& range : m_TlasInstanceUpdater.GetChangedRanges())
+    {
+        commandList->writeBuffer(m_TlasInstanceBuffer, instances + range.begin,
+            range.count * sizeof(nvrhi::rt::InstanceDesc), range.begin * sizeof(nvrhi::rt::InstanceDesc));
     }
 
-    commandList->buildTopLevelAccelStruct(m_TopLevelAS, m_TlasInstances.data(), m_TlasInstances.size(), buildFlags);
+    nvrhi::rt::AccelStructBuildFlags buildFlags = m_CanUpdateTLAS
+        ? nvrhi::rt::AccelStructBuildFlags::PerformUpdate
+        : nvrhi::rt::AccelStructBuildFlags::None;
+
+    commandList->buildTopLevelAccelStructFromBuffer(m_TopLevelAS, m_TlasInstanceBuffer, 0, instanceCount, buildFlags);
     m_CanUpdateTLAS = true;
 }
 
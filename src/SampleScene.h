@@ -13,6 +13,10 @@
 #include <donut/engine/Scene.h>
 #include <donut/engine/KeyframeAnimation.h>
 
+#include "TlasInstanceUpdater.h"
+
+class SceneCache;
+
 constexpr int LightType_Environment = 1000;
 constexpr int LightType_Cylinder = 1001;
 constexpr int LightType_Disk = 1002;
@@ -85,6 +89,21 @@ public:
     using MeshInfo::MeshInfo;
 
     nvrhi::rt::AccelStructHandle prevAccelStruct;
+    bool sharesAccelStruct = false; // accelStruct belongs to another mesh with identical geometry
+};
+
+struct BlasBuildStatistics
+{
+    uint32_t blases = 0;
+    uint32_t compactableBlases = 0;
+    uint32_t batches = 0;
+    uint64_t scratchBudget = 0;
+    uint64_t peakBatchScratch = 0;
+    uint64_t heapSize = 0;
+    uint32_t sharedBlases = 0;
+    uint64_t sharedMemory = 0;
+    uint32_t framesSinceBuild = 0;
+    bool reported = false;
 };
 
 class SampleSceneTypeFactory : public donut::engine::SceneTypeFactory
@@ -99,7 +118,19 @@ class SampleScene : public donut::engine::Scene
 private:
     nvrhi::rt::AccelStructHandle m_TopLevelAS;
     nvrhi::rt::AccelStructHandle m_PrevTopLevelAS;
-    std::vector<nvrhi::rt::InstanceDesc> m_TlasInstances;
+
+    // Mesh instances that have a BLAS, in TLAS order, rebuilt when the number of instances changes
+    struct TlasInstanceSource
+    {
+        const donut::engine::MeshInstance* instance = nullptr;
+        uint32_t meshIndex = 0;
+    };
+    std::vector<TlasInstanceSource> m_TlasInstanceSources;
+    std::vector<donut::engine::MeshInfo*> m_TlasMeshes;
+    std::vector<nvrhi::rt::InstanceFlags> m_TlasMeshFlags;
+    size_t m_TlasMeshInstanceCount = 0;
+    TlasInstanceUpdater m_TlasInstanceUpdater;
+    nvrhi::BufferHandle m_TlasInstanceBuffer;
     std::shared_ptr<donut::engine::SceneGraphAnimation> m_BenchmarkAnimation;
     std::shared_ptr<donut::engine::PerspectiveCamera> m_BenchmarkCamera;
     
@@ -109,16 +140,28 @@ private:
     double m_WallclockTime = 0;
 
     std::vector<std::string> m_EnvironmentMaps;
+    std::shared_ptr<SceneCache> m_SceneCache;
+
+    nvrhi::EventQueryHandle m_BlasBuildQuery;
+    BlasBuildStatistics m_BlasBuildStats;
+
+    void UpdateTlasInstanceSources();
 
 public:
     using Scene::Scene;
 
     bool LoadWithExecutor(const std::filesystem::path& jsonFileName, tf::Executor* executor) override;
 
+    // Data derived from the scene files is taken from the cache when it is valid, see SceneCache.h
+    void SetSceneCache(const std::shared_ptr<SceneCache>& cache) { m_SceneCache = cache; }
+
     const donut::engine::SceneGraphAnimation* GetBenchmarkAnimation() const { return m_BenchmarkAnimation.get(); }
     const donut::engine::PerspectiveCamera* GetBenchmarkCamera() const { return m_BenchmarkCamera.get(); }
     
-    void BuildMeshBLASes(nvrhi::IDevice* device);
+    // Builds the BLASes in batches that fit into the scratch memory budget, without waiting for the GPU
+    void BuildMeshBLASes(nvrhi::IDevice* device, uint64_t scratchBudget);
+    // Compacts the BLASes once their builds are complete, call on every frame
+    void CompactMeshBLASes(nvrhi::IDevice* device, nvrhi::ICommandList* commandList);
     void UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex);
     void BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList);
     void NextFrame();
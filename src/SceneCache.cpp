@@ -0,0 +1,491 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "SceneCache.h"
+
+#include <donut/engine/Scene.h>
+#include <donut/engine/SceneGraph.h>
+#include <json/reader.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace donut;
+using namespace donut::math;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t c_SceneCacheMagic = 0x43535852; // "RXSC"
+    constexpr uint64_t c_SectionAlignment = 16;
+
+    enum SectionId : uint32_t
+    {
+        SectionId_Strings = 1,
+        SectionId_EnvironmentMaps,
+        SectionId_LightCounts,
+
+        SectionId_Count
+    };
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceKey;
+        uint64_t fileSize;
+        uint32_t sectionCount;
+        uint32_t reserved;
+    };
+
+    struct SectionHeader
+    {
+        uint32_t id;
+        uint32_t elementCount;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct StringRef
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct LightCounts
+    {
+        uint32_t numEmissiveMeshes;
+        uint32_t numEmissiveTriangles;
+    };
+
+    static_assert(sizeof(FileHeader) == 32);
+    static_assert(sizeof(SectionHeader) == 24);
+
+    // FNV-1a, 64-bit
+    class Hasher
+    {
+    public:
+        void Add(const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                m_Hash ^= bytes[i];
+                m_Hash *= 0x100000001b3ull;
+            }
+        }
+
+        template<typename T>
+        void Add(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Add(&value, sizeof(value));
+        }
+
+        void Add(const std::string& s)
+        {
+            Add(uint64_t(s.size()));
+            Add(s.data(), s.size());
+        }
+
+        [[nodiscard]] uint64_t Get() const { return m_Hash; }
+
+    private:
+        uint64_t m_Hash = 0xcbf29ce484222325ull;
+    };
+
+    bool readJsonFile(const fs::path& fileName, Json::Value& root, std::string* contents)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        std::stringstream ss;
+        ss << file.rdbuf();
+        if (contents)
+            *contents = ss.str();
+
+        Json::CharReaderBuilder builder;
+        std::string errors;
+        return Json::parseFromStream(builder, ss, &root, &errors);
+    }
+
+    void addFileStamp(Hasher& hasher, const fs::path& fileName)
+    {
+        std::error_code ec;
+        hasher.Add(fileName.generic_string());
+
+        const auto status = fs::status(fileName, ec);
+        if (ec || !fs::exists(status))
+        {
+            hasher.Add(uint64_t(0));
+            return;
+        }
+
+        hasher.Add(fs::is_regular_file(status) ? uint64_t(fs::file_size(fileName, ec)) : uint64_t(1));
+        hasher.Add(uint64_t(fs::last_write_time(fileName, ec).time_since_epoch().count()));
+    }
+
+    class CacheBuilder
+    {
+    public:
+        uint32_t AddString(const std::string& s)
+        {
+            const uint32_t offset = uint32_t(m_Strings.size());
+            m_Strings.insert(m_Strings.end(), s.begin(), s.end());
+            return offset;
+        }
+
+        StringRef AddStringRef(const std::string& s)
+        {
+            return StringRef{ AddString(s), uint32_t(s.size()) };
+        }
+
+        template<typename T>
+        void AddSection(SectionId id, const T* elements, size_t count)
+        {
+            Section& section = m_Sections.emplace_back();
+            section.id = id;
+            section.elementCount = uint32_t(count);
+            section.data.resize(count * sizeof(T));
+            if (count)
+                memcpy(section.data.data(), elements, section.data.size());
+        }
+
+        void AddStringsSection()
+        {
+            AddSection(SectionId_Strings, m_Strings.data(), m_Strings.size());
+        }
+
+        std::vector<uint8_t> Build(uint64_t sourceKey) const
+        {
+            uint64_t offset = sizeof(FileHeader) + sizeof(SectionHeader) * m_Sections.size();
+            std::vector<SectionHeader> headers;
+            for (const Section& section : m_Sections)
+            {
+                offset = (offset + c_SectionAlignment - 1) & ~(c_SectionAlignment - 1);
+                headers.push_back(SectionHeader{ section.id, section.elementCount, offset, section.data.size() });
+                offset += section.data.size();
+            }
+
+            std::vector<uint8_t> file(offset, 0);
+
+            FileHeader header{};
+            header.magic = c_SceneCacheMagic;
+            header.version = c_SceneCacheVersion;
+            header.sourceKey = sourceKey;
+            header.fileSize = offset;
+            header.sectionCount = uint32_t(m_Sections.size());
+            memcpy(file.data(), &header, sizeof(header));
+            memcpy(file.data() + sizeof(header), headers.data(), headers.size() * sizeof(SectionHeader));
+
+            for (size_t i = 0; i < m_Sections.size(); i++)
+            {
+                if (!m_Sections[i].data.empty())
+                    memcpy(file.data() + headers[i].offset, m_Sections[i].data.data(), m_Sections[i].data.size());
+            }
+
+            return file;
+        }
+
+    private:
+        struct Section
+        {
+            SectionId id;
+            uint32_t elementCount;
+            std::vector<uint8_t> data;
+        };
+
+        std::vector<char> m_Strings;
+        std::vector<Section> m_Sections;
+    };
+}
+
+class SceneCache::MappedFile
+{
+public:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (m_Mapping)
+            CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE)
+            CloseHandle(m_File);
+#else
+        if (data)
+            munmap(const_cast<uint8_t*>(data), size);
+        if (m_File >= 0)
+            close(m_File);
+#endif
+    }
+
+    bool Map(const fs::path& fileName)
+    {
+#ifdef _WIN32
+        m_File = CreateFileW(fileName.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0)
+            return false;
+        size = size_t(fileSize.QuadPart);
+
+        m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_Mapping)
+            return false;
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        return data != nullptr;
+#else
+        m_File = open(fileName.c_str(), O_RDONLY);
+        if (m_File < 0)
+            return false;
+
+        struct stat fileStat;
+        if (fstat(m_File, &fileStat) != 0 || fileStat.st_size == 0)
+            return false;
+        size = size_t(fileStat.st_size);
+
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, m_File, 0);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        data = static_cast<const uint8_t*>(mapping);
+        return true;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_File = INVALID_HANDLE_VALUE;
+    HANDLE m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
+
+SceneCache::SceneCache() = default;
+SceneCache::~SceneCache() = default;
+
+bool SceneCache::Open(const fs::path& fileName, uint64_t sourceKey)
+{
+    Close();
+
+    auto file = std::make_unique<MappedFile>();
+    if (!file->Map(fileName))
+        return false;
+
+    if (file->size < sizeof(FileHeader))
+        return false;
+
+    FileHeader header;
+    memcpy(&header, file->data, sizeof(header));
+    if (header.magic != c_SceneCacheMagic || header.version != c_SceneCacheVersion || header.sourceKey != sourceKey || header.fileSize != file->size)
+        return false;
+
+    if (header.sectionCount > 64 || sizeof(FileHeader) + sizeof(SectionHeader) * header.sectionCount > file->size)
+        return false;
+
+    struct SectionView
+    {
+        const uint8_t* data = nullptr;
+        uint64_t size = 0;
+        uint32_t elementCount = 0;
+        bool present = false;
+    };
+    SectionView sections[SectionId_Count];
+
+    for (uint32_t i = 0; i < header.sectionCount; i++)
+    {
+        SectionHeader section;
+        memcpy(&section, file->data + sizeof(FileHeader) + i * sizeof(SectionHeader), sizeof(section));
+
+        if (section.offset % c_SectionAlignment != 0 || section.offset > file->size || section.size > file->size - section.offset)
+            return false;
+
+        if (section.id < SectionId_Count)
+            sections[section.id] = SectionView{ file->data + section.offset, section.size, section.elementCount, true };
+    }
+
+    auto getArray = [&sections](SectionId id, auto*& elements, uint32_t& count)
+    {
+        const SectionView& section = sections[id];
+        using T = std::remove_const_t<std::remove_pointer_t<std::remove_reference_t<decltype(elements)>>>;
+        if (!section.present || section.size != uint64_t(section.elementCount) * sizeof(T))
+            return false;
+        elements = reinterpret_cast<const T*>(section.data);
+        count = section.elementCount;
+        return true;
+    };
+
+    const char* strings; uint32_t stringsSize;
+    const StringRef* environmentMaps; uint32_t environmentMapCount;
+    const LightCounts* lightCounts; uint32_t lightCountsCount;
+
+    if (!getArray(SectionId_Strings, strings, stringsSize) ||
+        !getArray(SectionId_EnvironmentMaps, environmentMaps, environmentMapCount) ||
+        !getArray(SectionId_LightCounts, lightCounts, lightCountsCount) || lightCountsCount != 1)
+        return false;
+
+    auto getString = [strings, stringsSize](const StringRef& ref, std::string& result)
+    {
+        if (ref.offset > stringsSize || ref.length > stringsSize - ref.offset)
+            return false;
+        result.assign(strings + ref.offset, ref.length);
+        return true;
+    };
+
+    SceneCacheContents contents;
+
+    contents.environmentMaps.resize(environmentMapCount);
+    for (uint32_t i = 0; i < environmentMapCount; i++)
+    {
+        if (!getString(environmentMaps[i], contents.environmentMaps[i]))
+            return false;
+    }
+
+    contents.numEmissiveMeshes = lightCounts->numEmissiveMeshes;
+    contents.numEmissiveTriangles = lightCounts->numEmissiveTriangles;
+
+    m_File = std::move(file);
+    m_Contents = std::move(contents);
+    return true;
+}
+
+void SceneCache::Close()
+{
+    m_Contents = SceneCacheContents();
+    m_File.reset();
+}
+
+bool SceneCache::Write(const fs::path& fileName, uint64_t sourceKey, const SceneCacheContents& contents)
+{
+    CacheBuilder builder;
+
+    std::vector<StringRef> environmentMaps;
+    for (const std::string& name : contents.environmentMaps)
+        environmentMaps.push_back(builder.AddStringRef(name));
+
+    const LightCounts lightCounts = { contents.numEmissiveMeshes, contents.numEmissiveTriangles };
+
+    builder.AddStringsSection();
+    builder.AddSection(SectionId_EnvironmentMaps, environmentMaps.data(), environmentMaps.size());
+    builder.AddSection(SectionId_LightCounts, &lightCounts, 1);
+
+    const std::vector<uint8_t> data = builder.Build(sourceKey);
+
+    // Write into a temporary file first, a partially written cache must never replace a valid one
+    const fs::path tempFileName = fs::path(fileName).concat(".tmp");
+    FILE* file = fopen(tempFileName.string().c_str(), "wb");
+    if (!file)
+        return false;
+
+    const bool success = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    std::error_code ec;
+    if (success)
+        fs::rename(tempFileName, fileName, ec);
+
+    if (!success || ec)
+    {
+        fs::remove(tempFileName, ec);
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t ComputeSceneCacheKey(const fs::path& sceneFileName, const std::vector<fs::path>& dependencies)
+{
+    Hasher hasher;
+    hasher.Add(c_SceneCacheVersion);
+
+    Json::Value root;
+    std::string sceneContents;
+    if (!readJsonFile(sceneFileName, root, &sceneContents))
+        return 0;
+
+    hasher.Add(sceneContents);
+
+    // Hashing the contents of the models would take about as long as loading them, use the file stamps instead
+    const fs::path sceneFolder = sceneFileName.parent_path();
+    const Json::Value& models = root["models"];
+    if (models.isArray())
+    {
+        for (const Json::Value& model : models)
+        {
+            if (!model.isString())
+                continue;
+
+            const fs::path modelFileName = sceneFolder / model.asString();
+            addFileStamp(hasher, modelFileName);
+
+            // External glTF buffers
+            Json::Value gltf;
+            if (modelFileName.extension() == ".gltf" && readJsonFile(modelFileName, gltf, nullptr) && gltf["buffers"].isArray())
+            {
+                for (const Json::Value& buffer : gltf["buffers"])
+                {
+                    const std::string uri = buffer["uri"].asString();
+                    if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+                        addFileStamp(hasher, modelFileName.parent_path() / uri);
+                }
+            }
+        }
+    }
+
+    for (const fs::path& dependency : dependencies)
+        addFileStamp(hasher, dependency);
+
+    // Zero means that the key could not be computed
+    return std::max(hasher.Get(), uint64_t(1));
+}
+
+SceneCacheContents GatherSceneCacheContents(const engine::Scene& scene, const std::vector<std::string>& environmentMaps)
+{
+    SceneCacheContents contents;
+    contents.environmentMaps = environmentMaps;
+
+    const auto& sceneGraph = scene.GetSceneGraph();
+
+    for (const auto& instance : sceneGraph->GetMeshInstances())
+    {
+        for (const auto& geometry : instance->GetMesh()->geometries)
+        {
+            if (!any(geometry->material->emissiveColor != 0.f))
+                continue;
+
+            contents.numEmissiveMeshes += 1;
+            contents.numEmissiveTriangles += geometry->numIndices / 3;
+        }
+    }
+
+    return contents;
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace donut::engine
+{
+    class Scene;
+}
+
+// Binary cache of the data that the sample derives from the scene files at load time.
+// The file starts with a header and a section table, every section payload is 16-byte aligned so that
+// the cache can be memory-mapped and read in place.
+// The header stores a key computed from the source files, a cache with a different key or version is ignored.
+
+constexpr uint32_t c_SceneCacheVersion = 2;
+
+// Everything that is written into the cache
+struct SceneCacheContents
+{
+    std::vector<std::string> environmentMaps;
+    uint32_t numEmissiveMeshes = 0;
+    uint32_t numEmissiveTriangles = 0;
+};
+
+class SceneCache
+{
+private:
+    class MappedFile;
+    std::unique_ptr<MappedFile> m_File;
+    SceneCacheContents m_Contents;
+
+public:
+    SceneCache();
+    ~SceneCache();
+
+    // Maps the file and validates it against the key, returns false and stays empty if it is missing or stale
+    bool Open(const std::filesystem::path& fileName, uint64_t sourceKey);
+    void Close();
+    [[nodiscard]] bool IsValid() const { return m_File != nullptr; }
+
+    [[nodiscard]] const SceneCacheContents& GetContents() const { return m_Contents; }
+
+    static bool Write(const std::filesystem::path& fileName, uint64_t sourceKey, const SceneCacheContents& contents);
+};
+
+// Key of the scene files: the contents of the scene JSON, and the size and modification time of the
+// models it references and of the additional dependencies, such as the environment map folder.
+uint64_t ComputeSceneCacheKey(const std::filesystem::path& sceneFileName, const std::vector<std::filesystem::path>& dependencies);
+
+// Collects the cache contents from a loaded scene, same emissive test as PrepareLightsPass::CountLightsInScene
+SceneCacheContents GatherSceneCacheContents(const donut::engine::Scene& scene, const std::vector<std::string>& environmentMaps);
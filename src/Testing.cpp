@@ -10,6 +10,7 @@
 
 
 #include "Testing.h"
+#include "BenchmarkResults.h"
 #include "UserInterface.h"
 
 #include <donut/app/DeviceManager.h>
@@ -89,6 +90,26 @@ std::istream& operator>> (std::istream& is, IndirectLightingMode& mode)
     return is;
 }
 
+std::istream& operator>> (std::istream& is, VirtualLightUpdateMode& mode)
+{
+    std::string s;
+    is >> s;
+    toupper(s);
+
+    if (s == "FULL")
+        mode = VirtualLightUpdateMode::Full;
+    else if (s == "CHECKERBOARD")
+        mode = VirtualLightUpdateMode::Checkerboard;
+    else if (s == "HALF_RATE")
+        mode = VirtualLightUpdateMode::HalfRate;
+    else if (s == "ADAPTIVE")
+        mode = VirtualLightUpdateMode::Adaptive;
+    else
+        throw cxxopts::exceptions::exception("Unrecognized value passed to the --virtual-light-update argument.");
+
+    return is;
+}
+
 std::istream& operator>> (std::istream& is, rtxdi::ReSTIRDI_ResamplingMode& mode)
 {
     std::string s;
@@ -175,30 +196,70 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("aa-mode", "Anti-aliasing mode: OFF, ACC, TAA, DLSS (if supported)", value(ui.aaMode))
         ("alpha-tested", "Alpha-tested materials toggle", value(ui.gbufferSettings.enableAlphaTestedGeometry))
         ("animation", "Animations toggle", value(ui.enableAnimations))
+        ("async-compute", "Run the light presampling and the virtual light generation on the compute queue, Vulkan only", value(args.asyncCompute))
         ("benchmark", "Run the benchmark", value(args.benchmark))
+        ("benchmark-output", "Save per-frame benchmark results to a JSON or CSV file", value(args.benchmarkOutputFileName))
+        ("benchmark-baseline", "Compare the benchmark results with a JSON file saved by --benchmark-output, exit with an error code on regression", value(args.benchmarkBaselineFileName))
+        ("benchmark-compare", "Compare a JSON results file with --benchmark-baseline and exit without rendering", value(args.benchmarkCompareFileName))
+        ("benchmark-threshold", "Relative median slowdown of a section that counts as a regression, default is 0.05", value(args.benchmarkComparison.relativeThreshold))
+        ("benchmark-min-delta", "Median slowdown of a section in ms below which it is never a regression, default is 0.02", value(args.benchmarkComparison.minAbsoluteDelta))
+        ("benchmark-alpha", "Significance level of the Mann-Whitney U test used for regressions, default is 0.01", value(args.benchmarkComparison.significanceLevel))
+        ("blas-scratch-budget", "Scratch memory in MB that the BLAS builds at load time can use at once, default is 256", value(args.blasScratchBudget))
         ("bloom", "Bloom effect toggle", value(ui.enableBloom))
+        ("capture-output", "Save HdrColor, DiffuseLighting and SpecularLighting as PFM files into this folder without stalling the GPU", value(args.captureOutputFolder))
+        ("capture-start", "Index of the first frame saved by --capture-output, default is 0", value(args.captureStartFrame))
+        ("capture-count", "Number of consecutive frames saved by --capture-output, default is 1", value(args.captureFrameCount))
+        ("capture-latency", "Number of frames after which --capture-output waits for a readback to complete, default is 2", value(args.captureLatency))
         ("checkerboard", "Use checkerboard rendering", value(checkerboard))
+        ("cpu-reference", "Render the frame selected by --save-frame with the CPU ReSTIR DI implementation, save it as PFM and exit", value(args.cpuReferenceFileName))
+        ("cpu-reference-frames", "Number of frames rendered by --cpu-reference for temporal reuse, default is 8", value(args.cpuReferenceFrames))
+        ("cpu-reference-threads", "Number of threads used by --cpu-reference, default is all cores", value(args.cpuReferenceThreads))
         ("d,debug", "Enable the DX12 or Vulkan validation layers", value(deviceParams.enableDebugRuntime))
         ("disable-bg-opt", "Disable DX12 driver background optimization", value(args.disableBackgroundOptimization))
+        ("disable-frame-packet-thread", "Build the light tasks of each frame on the main thread instead of overlapping them with the recording", value(args.disableFramePacketThread))
         ("direct-resampling", "Direct lighting resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirDI.resamplingMode))
+        ("env-alias-table", "Sample the environment map with alias tables instead of the PDF mip chain", value(ui.lightingSettings.environmentAliasTable))
+        ("env-pdf-cache", "Folder for the cached importance sampling PDFs of the environment maps, default is next to the executable", value(args.environmentPdfCacheFolder))
         ("fullscreen", "Run in full screen", value(deviceParams.startFullscreen))
         ("h,help", "Display this help message", value(help))
         ("height", "Window height", value(deviceParams.backBufferHeight))
+        ("image-diff", "Compare comma-separated PFM files with --image-diff-reference, print PSNR, relative MSE and FLIP and exit", value(args.imageDiffFileNames))
+        ("image-diff-reference", "Reference PFM file for --image-diff", value(args.imageDiffReferenceFileName))
+        ("image-diff-exposure", "Exposure applied before tone mapping the images for PSNR and FLIP, default is 1", value(args.imageDiff.exposure))
+        ("image-diff-ppd", "Pixels per degree of visual angle used by FLIP, default is 67", value(args.imageDiff.pixelsPerDegree))
         ("indirect-resampling", "ReSTIR GI resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirGI.resamplingMode))
+        ("local-light-pdf-updates", "Update only the local light PDF mips above the lights that changed, default is on", value(ui.incrementalLocalLightPdf))
+        ("no-env-pdf-cache", "Always generate the environment map PDF on the GPU and do not write PDF cache files", value(args.disableEnvironmentPdfCache))
+        ("no-pipeline-cache", "Do not read or write the lighting pipeline cache file", value(args.disablePipelineCache))
+        ("no-scene-cache", "Always load the scene from the source files and do not write the scene cache", value(args.disableSceneCache))
         ("noise-mix", "Amount of noise to mix in after denoising", value(ui.noiseMix))
+        ("pipeline-cache", "File that records the lighting pipelines used by the last run and their creation times, default is next to the executable", value(args.pipelineCacheFileName))
+        ("pipeline-threads", "Number of threads that create the lighting pipelines, 0 creates them on the main thread on first use, default is half of the cores", value(args.pipelineThreads))
         ("pixel-jitter", "Pixel jitter toggle", value(ui.enablePixelJitter))
         ("preset", "Rendering settings preset: FAST, MEDIUM, UNBIASED, ULTRA, REFERENCE", value(ui))
         ("rasterize-gbuffer", "G-buffer rasterization toggle", value(ui.rasterizeGBuffer))
         ("ray-query", "Ray Query toggle", value(ui.useRayQuery))
+        ("record-benchmark", "Time the recording of this many frames with one command list, then as many with parallel recording, log the medians and exit. Use with -d to time the recording with the validation layers", value(args.recordBenchmarkFrames))
+        ("record-inputs", "Record the camera, UI settings, lights and frame times into a file that is saved on exit", value(args.recordInputsFileName))
+        ("record-threads", "Number of worker threads that record the command lists of a frame with the main thread, 0 records one command list on the main thread, default is up to 3", value(args.recordThreads))
+        ("replay-inputs", "Replay a file saved by --record-inputs, save the benchmark results and exit", value(args.replayInputsFileName))
+        ("replay-timestep", "Advance the replay by this many ms per frame instead of the recorded frame times, default is 0 which uses the recorded times", value(args.replayTimestep))
         ("direct-mode", "Direct lighting mode: NONE, BRDF, RESTIR", value(ui.directLightingMode))
         ("indirect-mode", "Indirect lighting mode: NONE, BRDF, RESTIRGI", value(ui.indirectLightingMode))
         ("render-width", "Internal render target width, overrides window size", value(args.renderWidth))
         ("render-height", "Internal render target height, overrides window size", value(args.renderHeight))
         ("save-file", "Save frame to file and exit", value(args.saveFrameFileName))
         ("save-frame", "Index of the frame to save, default is 0", value(args.saveFrameIndex))
+        ("scene-cache", "Binary scene cache file, default is the scene name with a .cache extension next to the executable", value(args.sceneCacheFileName))
+        ("startup-benchmark", "Exit as soon as the scene is loaded, after logging the startup times", value(args.startupBenchmark))
+        ("static-lights", "Keep the lights that are not animated in a region of the light buffer that is only rebuilt when they change, default is on", value(ui.staticLightRegion))
         ("tone-mapping", "Tone mapping toggle", value(ui.enableToneMapping))
+        ("trace-output", "Record CPU scopes and GPU sections and save them as a Chrome trace JSON file on exit", value(args.traceOutputFileName))
         ("transparent", "Transparent materials toggle", value(ui.gbufferSettings.enableTransparentGeometry))
+        ("upload-ring-size", "Size in MB of the persistently mapped buffer for per-frame uploads, 0 uses writeBuffer, default is 16", value(args.uploadRingSize))
         ("verbose", "Enable debug log messages", value(args.verbose))
+        ("virtual-light-budget", "GPU time in ms of the GSGI or PMGI passes that --virtual-light-update ADAPTIVE aims for, default is 2", value(ui.virtualLightBudget))
+        ("virtual-light-update", "Part of the GSGI or PMGI virtual lights created per frame: FULL, CHECKERBOARD, HALF_RATE, ADAPTIVE", value(ui.virtualLightUpdateMode))
         ("vk", "Run the application using Vulkan (otherwise D3D12 if supported)", value(useVk))
         ("width", "Window width", value(deviceParams.backBufferWidth))
     ;
@@ -246,7 +307,31 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         exit(1);
     }
 
-    if (args.saveFrameIndex != 0 && args.saveFrameFileName.empty())
+    if (!args.benchmarkCompareFileName.empty() && args.benchmarkBaselineFileName.empty())
+    {
+        log::error("The --benchmark-compare argument requires --benchmark-baseline.");
+        exit(1);
+    }
+
+    if (!args.imageDiffFileNames.empty() && args.imageDiffReferenceFileName.empty())
+    {
+        log::error("The --image-diff argument requires --image-diff-reference.");
+        exit(1);
+    }
+
+    if (args.captureLatency == 0)
+    {
+        log::warning("The --capture-latency argument must be at least 1, using 1.");
+        args.captureLatency = 1;
+    }
+
+    if (!args.recordInputsFileName.empty() && !args.replayInputsFileName.empty())
+    {
+        log::error("The --record-inputs and --replay-inputs arguments cannot be used together.");
+        exit(1);
+    }
+
+    if (args.saveFrameIndex != 0 && args.saveFrameFileName.empty() && args.cpuReferenceFileName.empty())
     {
         log::warning("The --save-frame argument is used without --save-file. It will be ignored.");
     }
@@ -263,6 +348,15 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
     
     deviceParams.enableNvrhiValidationLayer = deviceParams.enableDebugRuntime;
 
+    if (args.asyncCompute && args.graphicsApi != nvrhi::GraphicsAPI::VULKAN)
+    {
+        // nvrhi transitions shader resources to a D3D12 state that includes PIXEL_SHADER_RESOURCE,
+        // which command lists of the compute queue can't use
+        log::warning("The --async-compute argument is only supported on Vulkan. It will be ignored.");
+        args.asyncCompute = false;
+    }
+    deviceParams.enableComputeQueue = args.asyncCompute;
+
     if (args.benchmark)
         ui.animationFrame = 0;
 
@@ -336,17 +430,11 @@ bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* w
         return false;
     }
 
-    uint32_t* textureInSysmem = new uint32_t[desc.width * desc.height];
-
-    if (!textureInSysmem)
-    {
-        log::error("Couldn't allocate the memory for a %dx%d texture on the CPU.", desc.width, desc.height);
-        return false;
-    }
+    std::vector<uint32_t> textureInSysmem(size_t(desc.width) * desc.height);
     
     for (uint32_t row = 0; row < desc.height; row++)
     {
-        memcpy(textureInSysmem + row * desc.width, static_cast<char*>(pData) + row * rowPitch, desc.width * sizeof(uint32_t));
+        memcpy(textureInSysmem.data() + size_t(row) * desc.width, static_cast<char*>(pData) + row * rowPitch, desc.width * sizeof(uint32_t));
     }
 
     device->unmapStagingTexture(stagingTexture);
@@ -362,14 +450,78 @@ bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* w
             fs::create_directories(parentFolder);
         }
 
-        success = stbi_write_bmp(writeFileName, desc.width, desc.height, 4, pData) != 0;
+        success = stbi_write_bmp(writeFileName, desc.width, desc.height, 4, textureInSysmem.data()) != 0;
         if (success)
             log::info("Saved the screenshot into '%s'", writeFileName);
         else
             log::error("Failed to save the screenshot into '%s'", writeFileName);
     }
-    
-    delete[] textureInSysmem;
+
+    return success;
+}
+
+bool CompareBenchmarkWithBaseline(const BenchmarkResults& current, const CommandLineArguments& args)
+{
+    BenchmarkResults baseline;
+    if (!ReadBenchmarkResults(args.benchmarkBaselineFileName, baseline))
+    {
+        log::error("Failed to read the benchmark baseline from %s", args.benchmarkBaselineFileName.c_str());
+        return false;
+    }
+
+    if (baseline.width != current.width || baseline.height != current.height || baseline.renderer != current.renderer)
+    {
+        log::warning("The benchmark baseline was recorded with a different configuration (%s, %u x %u)",
+            baseline.renderer.c_str(), baseline.width, baseline.height);
+    }
+
+    const BenchmarkComparison comparison = CompareBenchmarkResults(baseline, current, args.benchmarkComparison);
+    const std::string table = FormatBenchmarkComparison(comparison);
+
+    if (comparison.HasRegressions())
+    {
+        log::error("BENCHMARK REGRESSION against %s >>>\n\n%s<<<", args.benchmarkBaselineFileName.c_str(), table.c_str());
+        return false;
+    }
+
+    log::info("BENCHMARK COMPARISON against %s >>>\n\n%s<<<", args.benchmarkBaselineFileName.c_str(), table.c_str());
+    return true;
+}
+
+bool CompareImagesWithReference(const CommandLineArguments& args)
+{
+    FloatImage reference;
+    if (!ReadPfm(args.imageDiffReferenceFileName, reference))
+    {
+        log::error("Failed to read the reference image from %s", args.imageDiffReferenceFileName.c_str());
+        return false;
+    }
+
+    bool success = true;
+    std::vector<std::pair<std::string, ImageDiffMetrics>> results;
+    for (const std::string& fileName : args.imageDiffFileNames)
+    {
+        FloatImage image;
+        if (!ReadPfm(fileName, image))
+        {
+            log::error("Failed to read the image from %s", fileName.c_str());
+            success = false;
+            continue;
+        }
+
+        if (image.width != reference.width || image.height != reference.height)
+        {
+            log::error("The image %s is %u x %u, the reference is %u x %u", fileName.c_str(),
+                image.width, image.height, reference.width, reference.height);
+            success = false;
+            continue;
+        }
+
+        results.emplace_back(fs::path(fileName).filename().generic_string(), CompareImages(image, reference, args.imageDiff));
+    }
+
+    const std::string table = FormatImageDiffMetrics(results);
+    log::info("IMAGE DIFF against %s >>>\n\n%s<<<", args.imageDiffReferenceFileName.c_str(), table.c_str());
 
     return success;
 }
@@ -11,8 +11,11 @@
 #pragma once
 
 #include <nvrhi/nvrhi.h>
+#include "BenchmarkComparison.h"
+#include "ImageDiff.h"
 
 struct UIData;
+struct BenchmarkResults;
 
 namespace donut::app {
     struct DeviceCreationParameters;
@@ -31,6 +34,38 @@ struct CommandLineArguments
     std::string saveFrameFileName;
     bool verbose = false;
     bool benchmark = false;
+    std::string benchmarkOutputFileName;
+    std::string benchmarkBaselineFileName;
+    std::string benchmarkCompareFileName;
+    BenchmarkComparisonSettings benchmarkComparison;
+    std::string traceOutputFileName;
+    std::string recordInputsFileName;
+    std::string replayInputsFileName;
+    float replayTimestep = 0.f;
+    std::string cpuReferenceFileName;
+    uint32_t cpuReferenceFrames = 8;
+    uint32_t cpuReferenceThreads = 0;
+    std::string captureOutputFolder;
+    uint32_t captureStartFrame = 0;
+    uint32_t captureFrameCount = 1;
+    uint32_t captureLatency = 2;
+    std::vector<std::string> imageDiffFileNames;
+    std::string imageDiffReferenceFileName;
+    ImageDiffSettings imageDiff;
+    std::string sceneCacheFileName;
+    bool disableSceneCache = false;
+    bool startupBenchmark = false;
+    uint32_t blasScratchBudget = 256;
+    std::string environmentPdfCacheFolder;
+    bool disableEnvironmentPdfCache = false;
+    uint32_t uploadRingSize = 16;
+    std::string pipelineCacheFileName;
+    bool disablePipelineCache = false;
+    int pipelineThreads = -1;
+    bool asyncCompute = false;
+    int recordThreads = -1;
+    uint32_t recordBenchmarkFrames = 0;
+    bool disableFramePacketThread = false;
     bool disableBackgroundOptimization = false;
     int renderWidth = 0;
     int renderHeight = 0;
@@ -38,4 +73,6 @@ struct CommandLineArguments
 
 void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
 void ApplicationLogCallback(donut::log::Severity severity, const char* message);
-bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
\ No newline at end of file
+bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
+bool CompareBenchmarkWithBaseline(const BenchmarkResults& current, const CommandLineArguments& args);
+bool CompareImagesWithReference(const CommandLineArguments& args);
\ No newline at end of file
@@ -0,0 +1,147 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TlasInstanceUpdater.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+// Instances per work item, also the granularity at which threads are started
+static constexpr uint32_t c_ChunkSize = 4096;
+
+// Instances filled at once before they are compared
+static constexpr uint32_t c_BatchSize = 128;
+
+// Changed ranges that are at most this many instances apart become one upload
+static constexpr uint32_t c_MergeGap = 16;
+
+// Fixed cost of one upload, expressed as a number of descriptors
+static constexpr size_t c_UploadOverhead = 64;
+
+static void appendChangedRange(std::vector<TlasInstanceRange>& ranges, uint32_t begin, uint32_t count, uint32_t mergeGap)
+{
+    if (!ranges.empty())
+    {
+        TlasInstanceRange& last = ranges.back();
+        if (begin - (last.begin + last.count) <= mergeGap)
+        {
+            last.count = begin + count - last.begin;
+            return;
+        }
+    }
+
+    ranges.push_back(TlasInstanceRange{ begin, count });
+}
+
+TlasInstanceUpdater::TlasInstanceUpdater(uint32_t threadCount)
+    : m_ThreadCount(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+uint32_t TlasInstanceUpdater::Update(uint32_t instanceCount, const FillFunction& fill)
+{
+    const bool fullUpdate = !m_Valid || instanceCount != uint32_t(m_Instances.size());
+    const uint32_t chunkCount = (instanceCount + c_ChunkSize - 1) / c_ChunkSize;
+
+    m_Instances.resize(instanceCount);
+    m_ChunkRanges.resize(chunkCount);
+
+    std::atomic<uint32_t> nextChunk = 0;
+    std::atomic<uint32_t> changedCount = 0;
+
+    auto worker = [&]()
+    {
+        nvrhi::rt::InstanceDesc batch[c_BatchSize];
+
+        for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const uint32_t begin = chunk * c_ChunkSize;
+            const uint32_t end = std::min(begin + c_ChunkSize, instanceCount);
+            std::vector<TlasInstanceRange>& ranges = m_ChunkRanges[chunk];
+            ranges.clear();
+
+            if (fullUpdate)
+            {
+                fill(begin, end, m_Instances.data() + begin);
+                appendChangedRange(ranges, begin, end - begin, c_MergeGap);
+                changedCount += end - begin;
+                continue;
+            }
+
+            // Fill small batches that stay in the L1 cache and compare them with the previous descriptors,
+            // the descriptors have no padding so a byte comparison is exact
+            uint32_t chunkChanged = 0;
+            for (uint32_t batchBegin = begin; batchBegin < end; batchBegin += c_BatchSize)
+            {
+                const uint32_t batchEnd = std::min(batchBegin + c_BatchSize, end);
+                fill(batchBegin, batchEnd, batch);
+
+                for (uint32_t index = batchBegin; index < batchEnd; index++)
+                {
+                    const nvrhi::rt::InstanceDesc& instance = batch[index - batchBegin];
+                    if (memcmp(&instance, &m_Instances[index], sizeof(nvrhi::rt::InstanceDesc)) == 0)
+                        continue;
+
+                    m_Instances[index] = instance;
+                    appendChangedRange(ranges, index, 1, c_MergeGap);
+                    chunkChanged++;
+                }
+            }
+            changedCount += chunkChanged;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < std::min(m_ThreadCount, chunkCount); i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    m_ChangedRanges.clear();
+    for (const std::vector<TlasInstanceRange>& ranges : m_ChunkRanges)
+    {
+        for (const TlasInstanceRange& range : ranges)
+            appendChangedRange(m_ChangedRanges, range.begin, range.count, c_MergeGap);
+    }
+
+    // Each upload has a fixed cost, so merging ranges across larger gaps can be cheaper than uploading them separately
+    auto uploadCost = [](const std::vector<TlasInstanceRange>& ranges)
+    {
+        size_t cost = 0;
+        for (const TlasInstanceRange& range : ranges)
+            cost += range.count + c_UploadOverhead;
+        return cost;
+    };
+
+    std::vector<TlasInstanceRange> merged = m_ChangedRanges;
+    size_t bestCost = uploadCost(m_ChangedRanges);
+    for (uint32_t mergeGap = c_MergeGap * 2; merged.size() > 1; mergeGap *= 2)
+    {
+        std::vector<TlasInstanceRange> ranges;
+        ranges.swap(merged);
+        for (const TlasInstanceRange& range : ranges)
+            appendChangedRange(merged, range.begin, range.count, mergeGap);
+
+        const size_t cost = uploadCost(merged);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            m_ChangedRanges = merged;
+        }
+    }
+
+    m_Valid = true;
+    return changedCount;
+}
@@ -0,0 +1,51 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+
+#include <functional>
+#include <vector>
+
+struct TlasInstanceRange
+{
+    uint32_t begin = 0;
+    uint32_t count = 0;
+};
+
+// Keeps the TLAS instance descriptors of the previous update and finds the ones that changed,
+// so that only those are uploaded. The descriptors store BLAS device addresses, not IAccelStruct pointers,
+// so that the array can be copied into an instance buffer as is.
+class TlasInstanceUpdater
+{
+public:
+    // Fills the descriptors of the instances in [begin, end), called from several threads at once
+    typedef std::function<void(uint32_t begin, uint32_t end, nvrhi::rt::InstanceDesc* instances)> FillFunction;
+
+    // Zero threads means all cores
+    explicit TlasInstanceUpdater(uint32_t threadCount = 0);
+
+    // Returns the number of changed descriptors. Everything is reported as changed after Invalidate or a count change.
+    uint32_t Update(uint32_t instanceCount, const FillFunction& fill);
+    void Invalidate() { m_Valid = false; }
+
+    [[nodiscard]] const std::vector<nvrhi::rt::InstanceDesc>& GetInstances() const { return m_Instances; }
+
+    // Ranges of changed descriptors from the last Update, close ranges are merged into one upload
+    [[nodiscard]] const std::vector<TlasInstanceRange>& GetChangedRanges() const { return m_ChangedRanges; }
+
+private:
+    uint32_t m_ThreadCount;
+    bool m_Valid = false;
+    std::vector<nvrhi::rt::InstanceDesc> m_Instances;
+    std::vector<std::vector<TlasInstanceRange>> m_ChunkRanges;
+    std::vector<TlasInstanceRange> m_ChangedRanges;
+};
@@ -0,0 +1,71 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "UploadRingAllocator.h"
+
+#include <cassert>
+
+UploadRingAllocator::UploadRingAllocator(uint64_t capacity)
+    : m_Capacity(capacity)
+{
+}
+
+uint64_t UploadRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size > m_Capacity)
+        return c_InvalidOffset;
+
+    // Start from the beginning when nothing is in use, so that an empty ring can hold any allocation
+    if (m_UsedSize == 0)
+        m_Head = 0;
+
+    uint64_t offset = (m_Head + alignment - 1) & ~(alignment - 1);
+    uint64_t consumed;
+    if (offset + size <= m_Capacity)
+    {
+        consumed = offset - m_Head + size;
+    }
+    else
+    {
+        // Skip the end of the ring
+        offset = 0;
+        consumed = m_Capacity - m_Head + size;
+    }
+
+    // The used bytes are contiguous from the oldest frame in flight to the head,
+    // so the allocation fits if the ring has enough free bytes in total
+    if (m_UsedSize + consumed > m_Capacity)
+        return c_InvalidOffset;
+
+    m_Head = offset + size;
+    m_UsedSize += consumed;
+    m_CurrentFrameSize += consumed;
+
+    return offset;
+}
+
+uint64_t UploadRingAllocator::EndFrame()
+{
+    const uint64_t frame = m_NextFrame++;
+    m_Frames.push_back({ frame, m_CurrentFrameSize });
+    m_CurrentFrameSize = 0;
+    return frame;
+}
+
+void UploadRingAllocator::Release(uint64_t frame)
+{
+    while (!m_Frames.empty() && m_Frames.front().frame <= frame)
+    {
+        m_UsedSize -= m_Frames.front().size;
+        m_Frames.pop_front();
+    }
+}
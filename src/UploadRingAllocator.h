@@ -0,0 +1,54 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Suballocates the uploads of every frame from a ring of bytes. Allocations are never freed one by one:
+// all allocations of a frame are released together once the GPU has completed that frame.
+// UploadRingBuffer detects the completed frames with event queries and calls Release.
+class UploadRingAllocator
+{
+public:
+    static constexpr uint64_t c_InvalidOffset = ~0ull;
+
+    explicit UploadRingAllocator(uint64_t capacity);
+
+    // Returns the offset of 'size' contiguous bytes aligned to 'alignment', which must be a power of two.
+    // Returns c_InvalidOffset if the free part of the ring is too small, the bytes skipped at the end of the ring
+    // when an allocation wraps around are counted as used until the frame is released.
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+    // Closes the allocations made since the previous call and returns the frame number to pass to Release
+    uint64_t EndFrame();
+
+    // Releases the allocations of all frames up to and including 'frame'
+    void Release(uint64_t frame);
+
+    [[nodiscard]] uint64_t GetCapacity() const { return m_Capacity; }
+    [[nodiscard]] uint64_t GetUsedSize() const { return m_UsedSize; }
+    [[nodiscard]] uint64_t GetFramesInFlight() const { return m_Frames.size(); }
+
+private:
+    struct FrameRecord
+    {
+        uint64_t frame;
+        uint64_t size; // including padding and the bytes skipped when wrapping around
+    };
+
+    uint64_t m_Capacity;
+    uint64_t m_Head = 0;
+    uint64_t m_UsedSize = 0;
+    uint64_t m_CurrentFrameSize = 0;
+    uint64_t m_NextFrame = 0;
+    std::deque<FrameRecord> m_Frames;
+};
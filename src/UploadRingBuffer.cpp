@@ -0,0 +1,150 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "UploadRingBuffer.h"
+#include "CpuProfiler.h"
+
+#include <donut/core/log.h>
+
+#include <cassert>
+#include <cstring>
+
+using namespace donut;
+
+// Keeps the copies aligned for the copy engines, the data is mostly arrays of 16-byte structures
+static constexpr uint64_t c_UploadAlignment = 16;
+
+UploadRingBuffer::UploadRingBuffer(nvrhi::IDevice* device, uint64_t capacity)
+    : m_Device(device)
+    , m_Allocator(capacity)
+{
+    if (capacity == 0)
+        return;
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = capacity;
+    bufferDesc.cpuAccess = nvrhi::CpuAccessMode::Write;
+    bufferDesc.initialState = nvrhi::ResourceStates::CopySource;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = "UploadRing";
+    m_Buffer = m_Device->createBuffer(bufferDesc);
+
+    // Upload heap memory stays mapped for the lifetime of the buffer
+    m_MappedData = static_cast<uint8_t*>(m_Device->mapBuffer(m_Buffer, nvrhi::CpuAccessMode::Write));
+
+    if (!m_MappedData)
+    {
+        log::warning("Failed to map the upload ring buffer, uploads will use writeBuffer");
+        m_Buffer = nullptr;
+    }
+}
+
+UploadRingBuffer::~UploadRingBuffer()
+{
+    if (m_MappedData)
+        m_Device->unmapBuffer(m_Buffer);
+}
+
+bool UploadRingBuffer::ReleaseCompletedFrames(bool waitForOldest)
+{
+    if (waitForOldest)
+    {
+        if (m_FramesInFlight.empty())
+            return false;
+
+        CpuProfilerScope cpuScope("UploadRingBuffer::Wait");
+        m_Device->waitEventQuery(m_FramesInFlight.front().eventQuery);
+    }
+
+    while (!m_FramesInFlight.empty() && m_Device->pollEventQuery(m_FramesInFlight.front().eventQuery))
+    {
+        FrameInFlight& frame = m_FramesInFlight.front();
+        m_Allocator.Release(frame.frame);
+        m_Device->resetEventQuery(frame.eventQuery);
+        m_FreeEventQueries.push_back(frame.eventQuery);
+        m_FramesInFlight.pop_front();
+    }
+
+    return true;
+}
+
+void UploadRingBuffer::Write(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffset)
+{
+    if (dataSize == 0)
+        return;
+
+    uint64_t srcOffset = UploadRingAllocator::c_InvalidOffset;
+    if (m_Buffer)
+    {
+        srcOffset = m_Allocator.Allocate(dataSize, c_UploadAlignment);
+
+        // The ring is full with frames that the GPU is still using, wait for them one by one
+        while (srcOffset == UploadRingAllocator::c_InvalidOffset && ReleaseCompletedFrames(true))
+            srcOffset = m_Allocator.Allocate(dataSize, c_UploadAlignment);
+    }
+
+    if (srcOffset == UploadRingAllocator::c_InvalidOffset)
+    {
+        if (m_Buffer && !m_OverflowReported)
+        {
+            log::warning("The upload ring buffer (%llu MB) is too small for the uploads of one frame, "
+                "the remaining uploads use writeBuffer", (unsigned long long)(m_Allocator.GetCapacity() >> 20));
+            m_OverflowReported = true;
+        }
+
+        // Keep the order of the writes into the same buffer
+        Flush(commandList);
+        commandList->writeBuffer(buffer, data, dataSize, destOffset);
+        return;
+    }
+
+    memcpy(m_MappedData + srcOffset, data, dataSize);
+    m_PendingCopies.push_back({ buffer, destOffset, srcOffset, dataSize });
+}
+
+void UploadRingBuffer::Flush(nvrhi::ICommandList* commandList)
+{
+    if (m_PendingCopies.empty())
+        return;
+
+    // One barrier batch for all destinations, the copies then find their buffers in the right state
+    for (const PendingCopy& copy : m_PendingCopies)
+        commandList->setBufferState(copy.buffer, nvrhi::ResourceStates::CopyDest);
+    commandList->commitBarriers();
+
+    for (const PendingCopy& copy : m_PendingCopies)
+        commandList->copyBuffer(copy.buffer, copy.destOffset, m_Buffer, copy.srcOffset, copy.size);
+
+    m_PendingCopies.clear();
+}
+
+void UploadRingBuffer::EndFrame()
+{
+    if (!m_Buffer)
+        return;
+
+    assert(m_PendingCopies.empty());
+
+    nvrhi::EventQueryHandle eventQuery;
+    if (!m_FreeEventQueries.empty())
+    {
+        eventQuery = m_FreeEventQueries.back();
+        m_FreeEventQueries.pop_back();
+    }
+    else
+    {
+        eventQuery = m_Device->createEventQuery();
+    }
+
+    m_Device->setEventQuery(eventQuery, nvrhi::CommandQueue::Graphics);
+    m_FramesInFlight.push_back({ m_Allocator.EndFrame(), eventQuery });
+
+    ReleaseCompletedFrames(false);
+}
@@ -0,0 +1,64 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "UploadRingAllocator.h"
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <vector>
+
+// Persistently mapped upload buffer for the data that the passes upload on every frame.
+// Write copies the data into the ring and queues a copy into the destination buffer, Flush records the queued copies
+// after a single batch of barriers. The ring space of a frame is reused once an event query shows the frame has completed.
+// Constant buffers are not written through the ring, they are volatile and already suballocated by nvrhi without copies.
+class UploadRingBuffer
+{
+private:
+    struct PendingCopy
+    {
+        nvrhi::BufferHandle buffer;
+        uint64_t destOffset;
+        uint64_t srcOffset;
+        uint64_t size;
+    };
+
+    struct FrameInFlight
+    {
+        uint64_t frame;
+        nvrhi::EventQueryHandle eventQuery;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    nvrhi::BufferHandle m_Buffer;
+    uint8_t* m_MappedData = nullptr;
+    UploadRingAllocator m_Allocator;
+
+    std::vector<PendingCopy> m_PendingCopies;
+    std::deque<FrameInFlight> m_FramesInFlight;
+    std::vector<nvrhi::EventQueryHandle> m_FreeEventQueries;
+    bool m_OverflowReported = false;
+
+    // Returns false if there is no frame in flight to wait for
+    bool ReleaseCompletedFrames(bool waitForOldest);
+
+public:
+    // Zero capacity disables the ring, then Write forwards to ICommandList::writeBuffer
+    UploadRingBuffer(nvrhi::IDevice* device, uint64_t capacity);
+    ~UploadRingBuffer();
+
+    void Write(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffset = 0);
+
+    // Call before the GPU reads the buffers passed to Write
+    void Flush(nvrhi::ICommandList* commandList);
+
+    // Call after executing the command list of a frame
+    void EndFrame();
+};
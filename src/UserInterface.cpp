@@ -35,6 +35,7 @@
 #include "UserInterface.h"
 #include "Profiler.h"
 #include "SampleScene.h"
+#include "IesProfileRegistry.h"
 
 #include <donut/engine/IesProfile.h>
 #include <donut/app/Camera.h>
@@ -333,6 +334,9 @@ void UserInterface::SamplingSettings()
     {
         ShowHelpMarker("Heavyweight settings (e.g. that dictate buffer sizes) that require recreating the context to change.");
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Env. Map", &m_ui.environmentMapImportanceSampling);
+        m_ui.resetAccumulation |= ImGui::Checkbox("Env. Map Alias Tables", (bool*)&m_ui.lightingSettings.environmentAliasTable);
+        ShowHelpMarker("Sample the environment map with alias tables in constant time instead of descending the PDF mip chain. "
+            "The tables take 8 bytes per texel.");
 
         if (ImGui::TreeNode("RTXDI Context"))
         {
@@ -490,6 +494,16 @@ void UserInterface::SamplingSettings()
                     ShowHelpMarker(
                         "Number of samples drawn from the local lights power-based RIS buffer.");
 
+                    ImGui::Checkbox("Incremental Light PDF Updates", &m_ui.incrementalLocalLightPdf);
+                    ShowHelpMarker(
+                        "Update only the mips of the local light PDF texture above the lights that moved or changed, "
+                        "instead of regenerating the whole mip chain on every frame.");
+
+                    ImGui::Checkbox("Static Light Region", &m_ui.staticLightRegion);
+                    ShowHelpMarker(
+                        "Store the emissive meshes and lights that are not animated in a separate region of the light buffer, "
+                        "which is only rebuilt when one of them changes, so that PrepareLights only processes the dynamic lights.");
+
                     samplingSettingsChanged |= ImGui::RadioButton("Local Light ReGIR RIS", initSamplingMode, 2);
                     ShowHelpMarker("Sample local lights using ReGIR-based RIS");
 
@@ -503,6 +517,13 @@ void UserInterface::SamplingSettings()
                     {
                         samplingSettingsChanged |= ImGui::Combo("DirReGIR Sampling", (int*)&m_ui.lightingSettings.dirReGIRSampling, "Uniform\0UniformHemisphere\0Diffuse\0BRDF\0");
                         ShowHelpMarker("Sampling mode for Directional ReGIR-based RIS");
+
+                        samplingSettingsChanged |= ImGui::Combo("DirReGIR Tile Encoding", (int*)&m_ui.lightingSettings.dirReGIRTileEncoding, "Full (64-bit)\0Packed (32-bit)\0Packed, Index Only\0");
+                        ShowHelpMarker(
+                            "Storage format for Directional ReGIR tile entries.\n"
+                            "Packed stores a 20-bit light index and a log-encoded weight in 32 bits.\n"
+                            "Index Only additionally skips the compact light data copies.\n"
+                            "The packed formats fall back to Full when the light buffer holds 2^20 lights or more.");
                     }
                     if (m_ui.lightingSettings.reGIRType == ReGIRType::Directional && m_ui.lightingSettings.dirReGIRSampling == DirReGIRSampling::BRDF)
                     {
@@ -870,6 +891,10 @@ void UserInterface::SamplingSettings()
             m_ui.resetAccumulation |= ImGui::Combo("Virtual light contribution", (int*)&m_ui.lightingSettings.vlightParams.virtualLightContribution, "DiffuseAndSpecular\0DiffuseOnly\0");
             m_ui.resetAccumulation |= ImGui::Checkbox("Freeze virtual lights", (bool*)&m_ui.lightingSettings.vlightParams.lockLights);
             m_ui.resetAccumulation |= ImGui::Checkbox("Include virtual lights in BRDF sampling", (bool*)&m_ui.lightingSettings.vlightParams.includeInBrdfLightSampling);
+            m_ui.resetAccumulation |= ImGui::Combo("Virtual light updates", (int*)&m_ui.virtualLightUpdateMode, "Full\0Checkerboard\0Half Rate\0Adaptive\0");
+            if (m_ui.virtualLightUpdateMode == VirtualLightUpdateMode::Adaptive)
+                ImGui::SliderFloat("GI budget (ms)", &m_ui.virtualLightBudget, 0.1f, 10.f);
+            ImGui::Text("Update stride: %d, oldest lights: %d frames", m_ui.virtualLightUpdateStride, m_ui.virtualLightMaxAge);
         }
 
         ImGui::TreePop();
@@ -1326,13 +1351,13 @@ void UserInterface::SceneSettings()
                         spotLight.profileTextureIndex = -1;
                     }
 
-                    for (auto profile : m_ui.resources->iesProfiles)
+                    for (const auto& profile : m_ui.resources->iesProfiles->GetProfiles())
                     {
                         selected = profile->name == spotLight.profileName;
                         if (ImGui::Selectable(profile->name.c_str(), &selected) && selected)
                         {
                             spotLight.profileName = profile->name;
-                            spotLight.profileTextureIndex = -1;
+                            m_ui.resources->iesProfiles->MarkChanged(std::static_pointer_cast<SpotLightWithProfile>(m_SelectedLight));
                         }
 
                         if (selected)
@@ -20,6 +20,7 @@
 #include <donut/app/imgui_renderer.h>
 #include "GBufferPass.h"
 #include "LightingPasses.h"
+#include "VirtualLightUpdate.h"
 
 #if WITH_NRD
 #include <NRD.h>
@@ -30,10 +31,7 @@
 
 
 class SampleScene;
-
-namespace donut::engine {
-    struct IesProfile;
-}
+class IesProfileRegistry;
 
 namespace donut::app {
     class FirstPersonCamera;
@@ -82,7 +80,7 @@ struct UIResources
     std::shared_ptr<SampleScene> scene;
     donut::app::FirstPersonCamera* camera = nullptr;
 
-    std::vector<std::shared_ptr<donut::engine::IesProfile>> iesProfiles;
+    std::shared_ptr<IesProfileRegistry> iesProfiles;
 
     std::shared_ptr<donut::engine::Material> selectedMaterial;
 };
@@ -177,6 +175,12 @@ struct UIData
     bool resetISContext = false;
     uint32_t regirLightSlotCount = 0;
     bool freezeRegirPosition = false;
+    bool incrementalLocalLightPdf = true;
+    bool staticLightRegion = true;
+    VirtualLightUpdateMode virtualLightUpdateMode = VirtualLightUpdateMode::Full;
+    float virtualLightBudget = 2.f; // ms of the GI passes in the adaptive mode
+    uint32_t virtualLightUpdateStride = 1;
+    uint32_t virtualLightMaxAge = 0;
     std::optional<int> animationFrame;
     std::string benchmarkResults;
 
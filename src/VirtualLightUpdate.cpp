@@ -0,0 +1,203 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "VirtualLightUpdate.h"
+
+#include <algorithm>
+#include <limits>
+
+// Estimate of the full update cost: weight of a new measurement
+static constexpr double c_CostSmoothing = 0.25;
+
+// The stride is halved when the estimate for the halved stride is below this part of the budget...
+static constexpr double c_BudgetHeadroom = 0.8;
+
+// ...on this many frames in a row
+static constexpr uint32_t c_FramesToLowerStride = 16;
+
+uint32_t GetVirtualLightUpdateCount(uint32_t samplesPerFrame, uint32_t stride, uint32_t phase)
+{
+    if (phase >= samplesPerFrame)
+        return 0;
+
+    return (samplesPerFrame - phase + stride - 1) / stride;
+}
+
+void VirtualLightScheduler::Resize(uint32_t samplesPerFrame, uint32_t sampleLifespan)
+{
+    if (samplesPerFrame == m_SamplesPerFrame && sampleLifespan == m_SampleLifespan)
+        return;
+
+    m_SamplesPerFrame = samplesPerFrame;
+    m_SampleLifespan = sampleLifespan;
+    Reset();
+}
+
+void VirtualLightScheduler::Reset()
+{
+    // The ring is empty until the next frame, its lights count as created on the frame before
+    m_ResetFrame = m_Frame + 1;
+    m_LastUpdate.assign(size_t(m_SamplesPerFrame ? m_SampleLifespan : 0) * c_MaxVirtualLightUpdateStride, m_ResetFrame - 1);
+    m_FramesSinceUpdate = std::numeric_limits<uint32_t>::max() - 1;
+    m_LastBlock = c_NoVirtualLightBlock;
+    m_LastPhase = 0;
+    m_UpdatedLastFrame = false;
+}
+
+VirtualLightUpdate VirtualLightScheduler::Hold()
+{
+    m_Frame++;
+
+    VirtualLightUpdate update;
+    if (m_UpdatedLastFrame)
+        update.previousBlock = m_LastBlock;
+    m_UpdatedLastFrame = false;
+
+    if (m_FramesSinceUpdate < std::numeric_limits<uint32_t>::max() - 1)
+        m_FramesSinceUpdate++;
+
+    return update;
+}
+
+VirtualLightUpdate VirtualLightScheduler::Advance(uint32_t stride, uint32_t interval)
+{
+    if (m_LastUpdate.empty() || m_FramesSinceUpdate + 1 < interval)
+        return Hold();
+
+    m_Frame++;
+
+    VirtualLightUpdate update;
+    if (m_UpdatedLastFrame)
+        update.previousBlock = m_LastBlock;
+
+    m_FramesSinceUpdate = 0;
+
+    // Powers of two only, then the lights of one phase are a set of whole groups.
+    // A stride above the number of lights would leave phases without any light.
+    uint32_t powerOfTwoStride = 1;
+    while (powerOfTwoStride * 2 <= std::min(stride, c_MaxVirtualLightUpdateStride) && powerOfTwoStride * 2 <= m_SamplesPerFrame)
+        powerOfTwoStride *= 2;
+    stride = powerOfTwoStride;
+
+    // Each slot is one phase of one block, the one with the oldest lights is replaced.
+    // Ties go to the slot after the last update in ring order, so equal ages are replaced in order.
+    const uint32_t slotCount = m_SampleLifespan * stride;
+    const uint32_t lastSlot = (m_LastBlock == c_NoVirtualLightBlock)
+        ? slotCount - 1
+        : std::min(m_LastBlock, m_SampleLifespan - 1) * stride + m_LastPhase % stride;
+
+    uint32_t bestSlot = 0;
+    int64_t bestTime = std::numeric_limits<int64_t>::max();
+    for (uint32_t i = 1; i <= slotCount; i++)
+    {
+        const uint32_t slot = (lastSlot + i) % slotCount;
+        const uint32_t block = slot / stride;
+        const uint32_t phase = slot % stride;
+
+        int64_t oldest = std::numeric_limits<int64_t>::max();
+        for (uint32_t group = phase; group < c_MaxVirtualLightUpdateStride; group += stride)
+            oldest = std::min(oldest, m_LastUpdate[block * c_MaxVirtualLightUpdateStride + group]);
+
+        if (oldest < bestTime)
+        {
+            bestTime = oldest;
+            bestSlot = slot;
+        }
+    }
+
+    update.active = true;
+    update.block = bestSlot / stride;
+    update.stride = stride;
+    update.phase = bestSlot % stride;
+    update.lightCount = GetVirtualLightUpdateCount(m_SamplesPerFrame, stride, update.phase);
+
+    for (uint32_t group = update.phase; group < c_MaxVirtualLightUpdateStride; group += stride)
+        m_LastUpdate[update.block * c_MaxVirtualLightUpdateStride + group] = m_Frame;
+
+    m_LastBlock = update.block;
+    m_LastPhase = update.phase;
+    m_UpdatedLastFrame = true;
+
+    return update;
+}
+
+uint32_t VirtualLightScheduler::GetAge(uint32_t block, uint32_t group) const
+{
+    return uint32_t(m_Frame - m_LastUpdate[block * c_MaxVirtualLightUpdateStride + group]);
+}
+
+uint32_t VirtualLightScheduler::GetMaxAge() const
+{
+    if (m_LastUpdate.empty())
+        return 0;
+
+    return uint32_t(m_Frame - *std::min_element(m_LastUpdate.begin(), m_LastUpdate.end()));
+}
+
+bool VirtualLightScheduler::IsComplete() const
+{
+    return std::all_of(m_LastUpdate.begin(), m_LastUpdate.end(), [this](int64_t frame) { return frame >= m_ResetFrame; });
+}
+
+VirtualLightBudgetController::VirtualLightBudgetController(uint32_t latency)
+    : m_Latency(std::max(latency, 1u))
+{
+}
+
+void VirtualLightBudgetController::Reset()
+{
+    m_History.clear();
+    m_Stride = 1;
+    m_FullUpdateCost = -1.0;
+    m_FramesWithHeadroom = 0;
+}
+
+uint32_t VirtualLightBudgetController::Update(double measuredTime, double budget)
+{
+    // The history holds the strides of the last `latency` frames, the first one is the measured frame
+    if (m_History.size() == m_Latency)
+    {
+        const uint32_t measuredStride = m_History.front();
+        m_History.erase(m_History.begin());
+
+        if (measuredTime > 0.0)
+        {
+            const double fullUpdateCost = measuredTime * measuredStride;
+            m_FullUpdateCost = (m_FullUpdateCost < 0.0)
+                ? fullUpdateCost
+                : m_FullUpdateCost + (fullUpdateCost - m_FullUpdateCost) * c_CostSmoothing;
+        }
+    }
+
+    if (m_FullUpdateCost > 0.0)
+    {
+        if (m_FullUpdateCost / m_Stride > budget)
+        {
+            while (m_Stride < c_MaxVirtualLightUpdateStride && m_FullUpdateCost / m_Stride > budget)
+                m_Stride *= 2;
+            m_FramesWithHeadroom = 0;
+        }
+        else if (m_Stride > 1 && m_FullUpdateCost / (m_Stride / 2) <= budget * c_BudgetHeadroom)
+        {
+            if (++m_FramesWithHeadroom >= c_FramesToLowerStride)
+            {
+                m_Stride /= 2;
+                m_FramesWithHeadroom = 0;
+            }
+        }
+        else
+        {
+            m_FramesWithHeadroom = 0;
+        }
+    }
+
+    m_History.push_back(m_Stride);
+    return m_Stride;
+}
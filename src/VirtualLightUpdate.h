@@ -0,0 +1,108 @@
+/***************************************************************************
+ # Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Partial updates of the virtual light ring of GSGI and PMGI. The ring holds sampleLifespan blocks of samplesPerFrame
+// lights, and a full update replaces the oldest block with the lights created on the frame. A partial update with
+// stride N only creates the lights of a block whose index is phase modulo N, which divides the cost of the GI passes
+// by N. The scheduler tracks the age of each interleaved group of lights and always replaces the oldest ones, so the
+// ring keeps sampleLifespan * N frames of lights.
+
+enum class VirtualLightUpdateMode : uint32_t
+{
+    Full,         // one block per frame
+    Checkerboard, // half of a block per frame, the even and the odd lights in turn
+    HalfRate,     // one block every other frame, the GI passes are skipped in between
+    Adaptive      // stride chosen by VirtualLightBudgetController from the GPU time of the GI passes
+};
+
+// Lights are interleaved in this many groups, the largest stride
+static constexpr uint32_t c_MaxVirtualLightUpdateStride = 8;
+static constexpr uint32_t c_NoVirtualLightBlock = ~0u;
+
+// What the GI passes and PrepareLights do on one frame
+struct VirtualLightUpdate
+{
+    bool active = false; // the GI passes run and create lightCount lights
+    uint32_t block = c_NoVirtualLightBlock; // receives the new lights
+    uint32_t previousBlock = c_NoVirtualLightBlock; // updated on the previous frame, PrepareLights copies it from the other half of the light buffer
+    uint32_t stride = 1;
+    uint32_t phase = 0;
+    uint32_t lightCount = 0; // thread i creates the light phase + i * stride of the block
+};
+
+// Number of lights in [0, samplesPerFrame) that are phase modulo stride
+uint32_t GetVirtualLightUpdateCount(uint32_t samplesPerFrame, uint32_t stride, uint32_t phase);
+
+class VirtualLightScheduler
+{
+private:
+    uint32_t m_SamplesPerFrame = 0;
+    uint32_t m_SampleLifespan = 0;
+    int64_t m_Frame = -1;
+    int64_t m_ResetFrame = 0;
+    uint32_t m_FramesSinceUpdate = 0;
+    uint32_t m_LastBlock = c_NoVirtualLightBlock;
+    uint32_t m_LastPhase = 0;
+    bool m_UpdatedLastFrame = false;
+    std::vector<int64_t> m_LastUpdate; // frame of the last update per block and group, blocks are contiguous
+
+public:
+    // Forgets the ages when the ring layout changes, the contents of the ring are lost then
+    void Resize(uint32_t samplesPerFrame, uint32_t sampleLifespan);
+
+    // Forgets the ages, e.g. when the ring was used for other lights
+    void Reset();
+
+    // Picks the lights to replace on this frame. The stride is rounded down to a power of two up to
+    // c_MaxVirtualLightUpdateStride, interval is the number of frames from one update to the next.
+    VirtualLightUpdate Advance(uint32_t stride, uint32_t interval);
+
+    // Moves to the next frame without replacing any light, e.g. while the lights are frozen
+    VirtualLightUpdate Hold();
+
+    // Frames since a group of lights was created, 0 for the lights created on the current frame
+    [[nodiscard]] uint32_t GetAge(uint32_t block, uint32_t group) const;
+    [[nodiscard]] uint32_t GetMaxAge() const;
+
+    // Every light of the ring has been created since the last reset, so both halves of the light buffer hold the
+    // same lights outside of the blocks updated on this frame and the previous one
+    [[nodiscard]] bool IsComplete() const;
+};
+
+// Chooses the update stride of the adaptive mode so that the GI passes fit in a time budget. The GPU time of a frame is
+// known a few frames later, so the controller remembers the stride of the recent frames and scales each measurement
+// to the estimated cost of a full update. The stride goes up as soon as the estimate exceeds the budget, and down
+// only after the estimate has left some headroom for a number of frames, so that noise doesn't make it oscillate.
+class VirtualLightBudgetController
+{
+private:
+    uint32_t m_Latency;
+    std::vector<uint32_t> m_History; // stride of the last frames, oldest first
+    uint32_t m_Stride = 1;
+    double m_FullUpdateCost = -1.0; // ms, negative until measured
+    uint32_t m_FramesWithHeadroom = 0;
+
+public:
+    // latency: frames from the recording of the GI passes to their GPU time, at least 1, and 2 for the Profiler
+    explicit VirtualLightBudgetController(uint32_t latency);
+
+    void Reset();
+
+    // measuredTime: GPU time of the GI passes `latency` frames ago in ms, 0 if unknown. Returns the stride of this frame.
+    uint32_t Update(double measuredTime, double budget);
+
+    [[nodiscard]] double GetFullUpdateCost() const { return m_FullUpdateCost; }
+    [[nodiscard]] uint32_t GetStride() const { return m_Stride; }
+};
@@ -44,14 +44,33 @@
 #include "PrepareLightsPass.h"
 #include "RenderEnvironmentMapPass.h"
 #include "GenerateMipsPass.h"
+#include "LocalLightPdfUpdate.h"
+#include "LocalLightPdfUpdatePass.h"
 #include "LightingPasses.h"
+#include "RenderGraph.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
+#include "SceneCache.h"
+#include "CommandListRecorder.h"
+#include "DirReGIRTileEncoding.h"
+#include "FramePacket.h"
+#include "VirtualLightUpdate.h"
+#include "UploadRingBuffer.h"
+#include "EnvironmentPdfCache.h"
+#include "EnvironmentAliasTable.h"
+#include "EnvironmentAliasTablePass.h"
+#include "EnvironmentMapStreamer.h"
+#include "IesProfileRegistry.h"
 #include "Profiler.h"
+#include "BenchmarkResults.h"
+#include "CpuProfiler.h"
+#include "FrameCapture.h"
+#include "InputRecorder.h"
 #include "UserInterface.h"
 #include "VisualizationPass.h"
 #include "Testing.h"
 #include "DebugViz/DebugVizPasses.h"
+#include "CpuReference/CpuReferenceScene.h"
 
 #if WITH_NRD
 #include "NrdIntegration.h"
@@ -81,6 +100,14 @@ class SceneRenderer : public app::ApplicationBase
 {
 private:
     nvrhi::CommandListHandle m_CommandList;
+    nvrhi::CommandListHandle m_ComputeCommandList; // for --async-compute
+    std::unique_ptr<CommandListRecorder> m_CommandListRecorder;
+    bool m_ParallelRecording = false;
+    std::unique_ptr<FramePacketBuilder> m_FramePackets;
+    VirtualLightScheduler m_VirtualLightScheduler;
+    VirtualLightBudgetController m_VirtualLightBudget{ 2 }; // the Profiler resolves the timers of a frame two frames later
+    uint32_t m_RecordBenchmarkFrame = 0;
+    std::array<std::vector<double>, 2> m_RecordBenchmarkTimes; // ms per frame, serial then parallel
     
     nvrhi::BindingLayoutHandle m_BindlessLayout;
 
@@ -99,6 +126,7 @@ private:
     std::shared_ptr<engine::DirectionalLight> m_SunLight;
     std::shared_ptr<EnvironmentLight> m_EnvironmentLight;
     std::shared_ptr<engine::LoadedTexture> m_EnvironmentMap;
+    std::shared_ptr<const EnvironmentAliasTable> m_EnvironmentAliasTable; // built on the CPU for the current map, if any
     engine::BindingCache m_BindingCache;
 
     std::unique_ptr<rtxdi::ImportanceSamplingContext> m_isContext;
@@ -113,15 +141,33 @@ private:
     std::unique_ptr<PrepareLightsPass> m_PrepareLightsPass;
     std::unique_ptr<RenderEnvironmentMapPass> m_RenderEnvironmentMapPass;
     std::unique_ptr<GenerateMipsPass> m_EnvironmentMapPdfMipmapPass;
+    std::unique_ptr<EnvironmentAliasTablePass> m_EnvironmentAliasTablePass;
+    std::unique_ptr<EnvironmentPdfCache> m_EnvironmentPdfCache;
+    std::unique_ptr<EnvironmentMapStreamer> m_EnvironmentMapStreamer;
     std::unique_ptr<GenerateMipsPass> m_LocalLightPdfMipmapPass;
+    std::unique_ptr<LocalLightPdfUpdatePass> m_LocalLightPdfUpdatePass;
     std::unique_ptr<LightingPasses> m_LightingPasses;
     std::unique_ptr<VisualizationPass> m_VisualizationPass;
     std::unique_ptr<RtxdiResources> m_RtxdiResources;
+    nvrhi::HeapHandle m_TransientHeap;
+    bool m_TransientHeapVisualization = false;
+    bool m_RenderGraphFailed = false; // the transient resources stop sharing memory once a lighting graph fails to compile
     std::unique_ptr<engine::IesProfileLoader> m_IesProfileLoader;
+    std::unique_ptr<InputRecorder> m_InputRecorder;
+    std::unique_ptr<InputReplayer> m_InputReplayer;
     std::shared_ptr<Profiler> m_Profiler;
     std::unique_ptr<DebugVizPasses> m_DebugVizPasses;
+    std::unique_ptr<FrameCapture> m_FrameCapture;
+    std::shared_ptr<SceneCache> m_SceneCache;
+    std::shared_ptr<UploadRingBuffer> m_UploadRing;
+    std::filesystem::path m_SceneCacheFileName;
+    uint64_t m_SceneCacheKey = 0;
+
+    steady_clock::time_point m_StartupTime;
+    double m_SceneLoadTime = 0.0;
 
     uint32_t m_RenderFrameIndex = 0;
+    bool m_PipelineStatisticsLogged = false;
     
 #if WITH_NRD
     std::unique_ptr<NrdIntegration> m_NRD;
@@ -137,7 +183,7 @@ private:
     bool m_PreviousViewValid = false;
     time_point<steady_clock> m_PreviousFrameTimeStamp;
 
-    std::vector<std::shared_ptr<engine::IesProfile>> m_IesProfiles;
+    std::shared_ptr<IesProfileRegistry> m_IesProfiles;
     
     dm::float3 m_RegirCenter;
     
@@ -172,6 +218,8 @@ public:
 
     bool Init()
     {
+        m_StartupTime = steady_clock::now();
+
         std::filesystem::path mediaPath = app::GetDirectoryWithExecutable().parent_path() / "rtxdi-assets";
         if (!std::filesystem::exists(mediaPath))
         {
@@ -224,6 +272,33 @@ public:
         m_Scene = std::make_shared<SampleScene>(GetDevice(), *m_ShaderFactory, m_RootFs, m_TextureCache, m_DescriptorTableManager, sceneTypeFactory);
         m_ui.resources->scene = m_Scene;
 
+        if (!m_args.disableSceneCache)
+        {
+            m_SceneCacheFileName = m_args.sceneCacheFileName.empty()
+                ? app::GetDirectoryWithExecutable() / scenePath.filename().replace_extension(".cache")
+                : std::filesystem::path(m_args.sceneCacheFileName);
+            m_SceneCacheKey = ComputeSceneCacheKey(mediaPath / scenePath.filename(), { mediaPath / "environment" });
+
+            m_SceneCache = std::make_shared<SceneCache>();
+            if (m_SceneCacheKey != 0 && m_SceneCache->Open(m_SceneCacheFileName, m_SceneCacheKey))
+                log::info("Using the scene cache %s", m_SceneCacheFileName.generic_string().c_str());
+            else
+                log::info("The scene cache %s is missing or out of date, it will be written after loading", m_SceneCacheFileName.generic_string().c_str());
+
+            m_Scene->SetSceneCache(m_SceneCache);
+        }
+
+        if (!m_args.recordInputsFileName.empty())
+        {
+            m_InputRecorder = std::make_unique<InputRecorder>(m_ui, scenePath.generic_string());
+        }
+        else if (!m_args.replayInputsFileName.empty())
+        {
+            m_InputReplayer = std::make_unique<InputReplayer>(m_ui);
+            if (!m_InputReplayer->Load(m_args.replayInputsFileName, scenePath.generic_string()))
+                return false;
+        }
+
         SetAsynchronousLoadingEnabled(true);
         BeginLoadingScene(m_RootFs, scenePath);
         GetDeviceManager()->SetVsyncEnabled(true);
@@ -234,6 +309,19 @@ public:
         m_Profiler = std::make_shared<Profiler>(*GetDeviceManager());
         m_ui.resources->profiler = m_Profiler;
 
+        if (!m_args.captureOutputFolder.empty())
+            m_FrameCapture = std::make_unique<FrameCapture>(GetDevice(), m_args.captureOutputFolder, m_args.captureLatency);
+
+        if (!m_args.disableEnvironmentPdfCache)
+        {
+            const std::filesystem::path environmentPdfCacheFolder = m_args.environmentPdfCacheFolder.empty()
+                ? app::GetDirectoryWithExecutable() / "EnvironmentPdfCache"
+                : std::filesystem::path(m_args.environmentPdfCacheFolder);
+            m_EnvironmentPdfCache = std::make_unique<EnvironmentPdfCache>(GetDevice(), environmentPdfCacheFolder);
+        }
+
+        m_EnvironmentMapStreamer = std::make_unique<EnvironmentMapStreamer>(GetDevice(), m_TextureCache, m_RootFs, m_EnvironmentPdfCache.get());
+
         m_FilterGradientsPass = std::make_unique<FilterGradientsPass>(GetDevice(), m_ShaderFactory);
         m_ConfidencePass = std::make_unique<ConfidencePass>(GetDevice(), m_ShaderFactory);
         m_CompositingPass = std::make_unique<CompositingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
@@ -242,8 +330,25 @@ public:
         m_RasterizedGBufferPass = std::make_unique<RasterizedGBufferPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
         m_PostprocessGBufferPass = std::make_unique<PostprocessGBufferPass>(GetDevice(), m_ShaderFactory);
         m_GlassPass = std::make_unique<GlassPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
-        m_PrepareLightsPass = std::make_unique<PrepareLightsPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
-        m_LightingPasses = std::make_unique<LightingPasses>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
+        m_UploadRing = std::make_shared<UploadRingBuffer>(GetDevice(), uint64_t(m_args.uploadRingSize) << 20);
+        m_PrepareLightsPass = std::make_unique<PrepareLightsPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_UploadRing, m_BindlessLayout);
+        {
+            // The pipelines depend on the shader binaries, so the cache file is per graphics API
+            std::filesystem::path pipelineCacheFileName;
+            if (!m_args.disablePipelineCache)
+            {
+                pipelineCacheFileName = m_args.pipelineCacheFileName.empty()
+                    ? app::GetDirectoryWithExecutable() / (std::string("LightingPipelines.") + app::GetShaderTypeName(GetDevice()->getGraphicsAPI()) + ".cache")
+                    : std::filesystem::path(m_args.pipelineCacheFileName);
+            }
+
+            const uint32_t pipelineThreadCount = m_args.pipelineThreads >= 0
+                ? uint32_t(m_args.pipelineThreads)
+                : std::max(1u, std::thread::hardware_concurrency() / 2);
+
+            m_LightingPasses = std::make_unique<LightingPasses>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout,
+                pipelineCacheFileName, pipelineThreadCount);
+        }
 
 
 #if WITH_DLSS
@@ -261,50 +366,29 @@ public:
 
         LoadShaders();
 
-        std::vector<std::string> profileNames;
-        m_RootFs->enumerateFiles("/rtxdi-assets/ies-profiles", { ".ies" }, vfs::enumerate_to_vector(profileNames));
-
-        for (const std::string& profileName : profileNames)
-        {
-            auto profile = m_IesProfileLoader->LoadIesProfile(*m_RootFs, "/rtxdi-assets/ies-profiles/" + profileName);
-
-            if (profile)
-            {
-                m_IesProfiles.push_back(profile);
-            }
-        }
+        m_IesProfiles = std::make_shared<IesProfileRegistry>(*m_IesProfileLoader);
+        m_IesProfiles->LoadProfiles(*m_RootFs, "/rtxdi-assets/ies-profiles");
         m_ui.resources->iesProfiles = m_IesProfiles;
 
         m_CommandList = GetDevice()->createCommandList();
 
-        return true;
-    }
+        if (m_args.asyncCompute)
+            m_ComputeCommandList = GetDevice()->createCommandList(nvrhi::CommandListParameters().setQueueType(nvrhi::CommandQueue::Compute));
 
-    void AssignIesProfiles(nvrhi::ICommandList* commandList)
-    {
-        for (const auto& light : m_Scene->GetSceneGraph()->GetLights())
+        // The benchmark records the first half of its frames serially, it needs the recorder for the second half
+        if (m_args.recordThreads != 0 || m_args.recordBenchmarkFrames)
         {
-            if (light->GetLightType() == LightType_Spot)
-            {
-                SpotLightWithProfile& spotLight = static_cast<SpotLightWithProfile&>(*light);
-
-                if (spotLight.profileName.empty())
-                    continue;
+            const uint32_t recordThreadCount = m_args.recordThreads >= 0
+                ? uint32_t(m_args.recordThreads)
+                : std::min(3u, std::max(1u, std::thread::hardware_concurrency()) - 1);
 
-                if (spotLight.profileTextureIndex >= 0)
-                    continue;
-
-                auto foundProfile = std::find_if(m_IesProfiles.begin(), m_IesProfiles.end(),
-                    [&spotLight](auto it) { return it->name == spotLight.profileName; });
+            m_CommandListRecorder = std::make_unique<CommandListRecorder>(GetDevice(), recordThreadCount);
+            m_ParallelRecording = m_args.recordBenchmarkFrames == 0;
+        }
 
-                if (foundProfile != m_IesProfiles.end())
-                {
-                    m_IesProfileLoader->BakeIesProfile(**foundProfile, commandList);
+        m_FramePackets = std::make_unique<FramePacketBuilder>(!m_args.disableFramePacketThread);
 
-                    spotLight.profileTextureIndex = (*foundProfile)->textureIndex;
-                }
-            }
-        }
+        return true;
     }
 
     virtual void SceneLoaded() override
@@ -336,7 +420,7 @@ public:
         }
 
         m_CommandList->open();
-        AssignIesProfiles(m_CommandList);
+        m_IesProfiles->AssignProfiles(*sceneGraph, m_CommandList);
         m_CommandList->close();
         GetDevice()->executeCommandList(m_CommandList);
 
@@ -348,14 +432,99 @@ public:
         m_ui.environmentMapIndex = 0;
         
         m_RasterizedGBufferPass->CreateBindingSet();
+        m_PrepareLightsPass->ClassifyStaticLights();
+
+        const auto blasStart = steady_clock::now();
+        m_Scene->BuildMeshBLASes(GetDevice(), uint64_t(m_args.blasScratchBudget) << 20);
+        const double blasTime = duration<double, std::milli>(steady_clock::now() - blasStart).count();
 
-        m_Scene->BuildMeshBLASes(GetDevice());
+        const auto cacheStart = steady_clock::now();
+        UpdateSceneCache();
+        const double cacheTime = duration<double, std::milli>(steady_clock::now() - cacheStart).count();
+
+        log::info("STARTUP TIMES >>>\n\n"
+            "Scene load:         %9.1f ms (scene cache %s)\n"
+            "BLAS creation:      %9.1f ms\n"
+            "Scene cache update: %9.1f ms\n"
+            "Total:              %9.1f ms\n<<<",
+            m_SceneLoadTime, !m_SceneCache ? "disabled" : m_SceneCache->IsValid() ? "hit" : "miss",
+            blasTime, cacheTime, duration<double, std::milli>(steady_clock::now() - m_StartupTime).count());
+
+        if (m_args.startupBenchmark)
+            glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
 
         GetDeviceManager()->SetVsyncEnabled(false);
 
         m_ui.isLoading = false;
     }
     
+    void LogPipelineStatistics() const
+    {
+        const PipelineCache::Statistics statistics = m_LightingPasses->GetPipelineStatistics();
+
+        // Compared to creating every declared pipeline on the main thread, before the first frame
+        const double savedTime = statistics.createTime - statistics.waitTime + statistics.skippedTime;
+
+        log::info("LIGHTING PIPELINES >>>\n\n"
+            "Declared:           %9u\n"
+            "Created:            %9u (%u prewarmed, %u failed)\n"
+            "Not created:        %9u (%.1f ms in earlier runs)\n"
+            "Creation time:      %9.1f ms on %u threads\n"
+            "Main thread waited: %9.1f ms\n"
+            "Saved:              %9.1f ms\n<<<",
+            statistics.declared,
+            statistics.created, statistics.prewarmed, statistics.failed,
+            statistics.skipped, statistics.skippedTime,
+            statistics.createTime, m_LightingPasses->GetPipelineThreadCount(),
+            statistics.waitTime,
+            savedTime);
+    }
+
+    // Times the recording and submission of each frame on the CPU, first with one command list on the main thread,
+    // then with the command lists recorded by the workers. Logs the medians and exits after both halves.
+    void UpdateRecordBenchmark(double frameTime)
+    {
+        // The first frames create the pipelines and binding sets
+        constexpr uint32_t warmupFrames = 16;
+        if (m_RecordBenchmarkFrame++ < warmupFrames)
+            return;
+
+        std::vector<double>& times = m_RecordBenchmarkTimes[m_ParallelRecording ? 1 : 0];
+        times.push_back(frameTime);
+        if (times.size() < m_args.recordBenchmarkFrames)
+            return;
+
+        if (!m_ParallelRecording)
+        {
+            m_ParallelRecording = true;
+            return;
+        }
+
+        auto median = [](std::vector<double> values)
+        {
+            std::sort(values.begin(), values.end());
+            return values[values.size() / 2];
+        };
+
+        const double serialTime = median(m_RecordBenchmarkTimes[0]);
+        const double parallelTime = median(m_RecordBenchmarkTimes[1]);
+        const CommandListRecorder::Statistics& statistics = m_CommandListRecorder->GetStatistics();
+
+        log::info("RECORD BENCHMARK >>>\n\n"
+            "Frames:             %9u serial, %u parallel\n"
+            "Serial:             %9.3f ms median, one command list\n"
+            "Parallel:           %9.3f ms median, %u command lists on %u threads\n"
+            "Last frame jobs:    %9.3f ms wall, %.3f ms summed\n"
+            "Speedup:            %9.2fx\n<<<",
+            m_args.recordBenchmarkFrames, m_args.recordBenchmarkFrames,
+            serialTime,
+            parallelTime, statistics.jobs, m_CommandListRecorder->GetThreadCount() + 1,
+            statistics.wallTime, statistics.jobTime,
+            serialTime / parallelTime);
+
+        glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
+    }
+
     void LoadShaders()
     {
         m_FilterGradientsPass->CreatePipeline();
@@ -368,14 +537,36 @@ public:
         m_PrepareLightsPass->CreatePipeline();
     }
 
-    virtual bool LoadScene(std::shared_ptr<vfs::IFileSystem> fs, const std::filesystem::path& sceneFileName) override 
+    // Takes the light counts from a valid scene cache, or writes a new cache from the loaded scene
+    void UpdateSceneCache()
     {
-        if (m_Scene->Load(sceneFileName))
+        if (!m_SceneCache)
+            return;
+
+        if (m_SceneCache->IsValid())
         {
-            return true;
+            const SceneCacheContents& contents = m_SceneCache->GetContents();
+            m_PrepareLightsPass->SetLightCounts(contents.numEmissiveMeshes, contents.numEmissiveTriangles);
+            return;
         }
 
-        return false;
+        if (m_SceneCacheKey == 0)
+            return;
+
+        const SceneCacheContents contents = GatherSceneCacheContents(*m_Scene, m_Scene->GetEnvironmentMaps());
+        if (SceneCache::Write(m_SceneCacheFileName, m_SceneCacheKey, contents))
+            log::info("Scene cache saved to %s", m_SceneCacheFileName.generic_string().c_str());
+        else
+            log::warning("Failed to write the scene cache to %s", m_SceneCacheFileName.generic_string().c_str());
+    }
+
+    virtual bool LoadScene(std::shared_ptr<vfs::IFileSystem> fs, const std::filesystem::path& sceneFileName) override 
+    {
+        const auto loadStart = steady_clock::now();
+        const bool success = m_Scene->Load(sceneFileName);
+        m_SceneLoadTime = duration<double, std::milli>(steady_clock::now() - loadStart).count();
+
+        return success;
     }
 
     bool KeyboardUpdate(int key, int scancode, int action, int mods) override
@@ -459,13 +650,120 @@ public:
         if (!m_args.saveFrameFileName.empty())
             fElapsedTimeSeconds = 1.f / 60.f;
 
-        m_Camera.Animate(fElapsedTimeSeconds);
+        if (m_InputReplayer)
+        {
+            if (m_InputReplayer->IsFinished())
+            {
+                // Report the results once and exit, after the timers of the last replayed frames are resolved
+                if (m_InputReplayer->IsStarted())
+                {
+                    GetDevice()->waitForIdle();
+                    m_Profiler->ResolveOutstandingFrames();
+                    m_ui.benchmarkResults = m_Profiler->GetAsText();
+                    ProcessBenchmarkResults();
+                    log::info("REPLAY RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+                    m_InputReplayer.reset();
+                    glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
+                }
+                return;
+            }
+
+            if (!m_InputReplayer->IsStarted())
+                m_Profiler->ClearRecordedFrames();
+
+            // The recorded or fixed frame time replaces the wall clock to make the replay deterministic
+            fElapsedTimeSeconds = m_InputReplayer->ApplyNextFrame(m_Camera, *m_Scene);
+            if (m_args.replayTimestep > 0.f)
+                fElapsedTimeSeconds = m_args.replayTimestep * 0.001f;
+        }
+        else
+            m_Camera.Animate(fElapsedTimeSeconds);
 
         if (m_ui.enableAnimations)
             m_Scene->Animate(fElapsedTimeSeconds * m_ui.animationSpeed);
 
         if (m_ToneMappingPass)
             m_ToneMappingPass->AdvanceFrame(fElapsedTimeSeconds);
+
+        if (m_InputRecorder)
+            m_InputRecorder->RecordFrame(fElapsedTimeSeconds, m_Camera, *m_Scene);
+    }
+
+    void SaveInputRecording() const
+    {
+        if (!m_InputRecorder)
+            return;
+
+        if (m_InputRecorder->Save(m_args.recordInputsFileName))
+            log::info("Recorded %d frames of inputs to %s", int(m_InputRecorder->GetFrameCount()), m_args.recordInputsFileName.c_str());
+        else
+        {
+            log::error("Failed to save the input recording to %s", m_args.recordInputsFileName.c_str());
+            g_ExitCode = 1;
+        }
+    }
+
+    // Renders the current view with the CPU implementation of ReSTIR DI, using the same settings as the GPU passes
+    bool RenderCpuReference()
+    {
+        const rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->getReSTIRDIContext();
+
+        ResamplingConstants constants = {};
+        m_View.FillPlanarViewConstants(constants.view);
+        m_View.FillPlanarViewConstants(constants.prevView);
+        constants.restirDI.initialSamplingParams = restirDIContext.getInitialSamplingParameters();
+        constants.restirDI.temporalResamplingParams = restirDIContext.getTemporalResamplingParameters();
+        constants.restirDI.spatialResamplingParams = restirDIContext.getSpatialResamplingParameters();
+        constants.restirDI.shadingParams = restirDIContext.getShadingParameters();
+
+        std::shared_ptr<CpuReferenceScene> scene = BuildCpuReferenceScene(*m_Scene, constants.lightBufferParams);
+
+        CpuReferenceRenderer renderer(m_args.cpuReferenceThreads);
+        renderer.SetScene(scene);
+
+        log::info("CPU reference scene: %d triangles, %d BVH nodes, %d local and %d infinite lights",
+            int(renderer.GetBvh().GetTriangleCount()), int(renderer.GetBvh().GetNodeCount()),
+            int(constants.lightBufferParams.localLightBufferRegion.numLights),
+            int(constants.lightBufferParams.infiniteLightBufferRegion.numLights));
+
+        for (uint32_t frame = 0; frame < std::max(m_args.cpuReferenceFrames, 1u); frame++)
+        {
+            constants.frameIndex = frame;
+            renderer.RenderFrame(constants, restirDIContext.getResamplingMode());
+        }
+
+        log::info("%s", renderer.GetStats().GetAsText().c_str());
+
+        if (!renderer.SaveOutput(m_args.cpuReferenceFileName))
+        {
+            log::error("Failed to save the CPU reference image to %s", m_args.cpuReferenceFileName.c_str());
+            return false;
+        }
+
+        log::info("CPU reference image saved to %s", m_args.cpuReferenceFileName.c_str());
+        return true;
+    }
+
+    void ProcessBenchmarkResults()
+    {
+        const BenchmarkResults recordedFrames = m_Profiler->GetRecordedFrames();
+
+        if (!m_args.benchmarkOutputFileName.empty())
+        {
+            if (WriteBenchmarkResults(recordedFrames, m_args.benchmarkOutputFileName))
+                log::info("Benchmark results saved to %s", m_args.benchmarkOutputFileName.c_str());
+            else
+            {
+                log::error("Failed to write benchmark results to %s", m_args.benchmarkOutputFileName.c_str());
+                g_ExitCode = 1;
+            }
+        }
+
+        if (!m_args.benchmarkBaselineFileName.empty())
+        {
+            if (!CompareBenchmarkWithBaseline(recordedFrames, m_args))
+                g_ExitCode = 1;
+        }
     }
 
     virtual void BackBufferResized(const uint32_t width, const uint32_t height, const uint32_t sampleCount) override
@@ -489,41 +787,77 @@ public:
 #endif
     }
 
-    void LoadEnvironmentMap()
+    void SetEnvironmentMap(const std::shared_ptr<engine::LoadedTexture>& environmentMap)
+    {
+        // The old map may still be used by the frames in flight, it is released once they have completed
+        if (m_EnvironmentMap != environmentMap)
+            m_EnvironmentMapStreamer->Retire(m_EnvironmentMap);
+
+        m_EnvironmentMap = environmentMap;
+        m_EnvironmentAliasTable = nullptr;
+
+        if (m_EnvironmentPdfCache && !m_EnvironmentMap)
+            m_EnvironmentPdfCache->Clear();
+    }
+
+    void RequestEnvironmentMap()
     {
-        if (m_EnvironmentMap)
+        if (m_ui.environmentMapIndex <= 0)
         {
-            // Make sure there is no rendering in-flight before we unload the texture and erase its descriptor.
-            // Decsriptor manipulations are synchronous and immediately affect whatever is executing on the GPU.
-            GetDevice()->waitForIdle();
+            m_EnvironmentMapStreamer->Cancel();
+            SetEnvironmentMap(nullptr);
+            return;
+        }
 
-            m_TextureCache->UnloadTexture(m_EnvironmentMap);
-            
-            m_EnvironmentMap = nullptr;
+        const std::string& environmentMapPath = m_Scene->GetEnvironmentMaps()[m_ui.environmentMapIndex];
+
+        // Back to the current map before the requested one has finished loading
+        if (m_EnvironmentMap && m_EnvironmentMap->path == environmentMapPath)
+        {
+            m_EnvironmentMapStreamer->Cancel();
+            m_ui.environmentMapDirty = 0;
+            return;
         }
 
-        if (m_ui.environmentMapIndex > 0)
+        // Keep rendering with the current map until the new one is ready
+        m_EnvironmentMapStreamer->Request(environmentMapPath, m_ui.lightingSettings.environmentAliasTable);
+        m_ui.environmentMapDirty = 0;
+
+        // Replays must switch maps on the same frame every time
+        if (!m_args.replayInputsFileName.empty())
+            m_EnvironmentMapStreamer->Wait();
+    }
+
+    void UpdateEnvironmentMap()
+    {
+        StreamedEnvironmentMap streamed;
+        if (!m_EnvironmentMapStreamer->Poll(*m_CommonPasses, streamed))
+            return;
+
+        if (!streamed.texture)
         {
+            // Failed to load the file: revert to the procedural map and remove this file from the list.
             auto& environmentMaps = m_Scene->GetEnvironmentMaps();
-            const std::string& environmentMapPath = environmentMaps[m_ui.environmentMapIndex];
+            environmentMaps.erase(std::remove(environmentMaps.begin(), environmentMaps.end(), streamed.path), environmentMaps.end());
+            m_ui.environmentMapIndex = 0;
+            SetEnvironmentMap(nullptr);
+            m_ui.environmentMapDirty = 2;
+            return;
+        }
 
-            m_EnvironmentMap = m_TextureCache->LoadTextureFromFileDeferred(environmentMapPath, false);
+        if (!streamed.texture->bindlessDescriptor.IsValid())
+            streamed.texture->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, streamed.texture->texture));
 
-            if (m_TextureCache->IsTextureLoaded(m_EnvironmentMap))
-            {
-                m_TextureCache->ProcessRenderingThreadCommands(*m_CommonPasses, 0.f);
-                m_TextureCache->LoadingFinished();
+        SetEnvironmentMap(streamed.texture);
+        m_EnvironmentAliasTable = std::move(streamed.aliasTable);
 
-                m_EnvironmentMap->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_EnvironmentMap->texture));
-            }
-            else
-            {
-                // Failed to load the file: revert to the procedural map and remove this file from the list.
-                m_EnvironmentMap = nullptr;
-                environmentMaps.erase(environmentMaps.begin() + m_ui.environmentMapIndex);
-                m_ui.environmentMapIndex = 0;
-            }
-        }
+        if (m_EnvironmentPdfCache && streamed.pdfKey != 0)
+            m_EnvironmentPdfCache->SetEnvironmentMap(streamed.path, streamed.pdfKey, std::move(streamed.pdfMips));
+        else if (m_EnvironmentPdfCache)
+            m_EnvironmentPdfCache->Clear();
+
+        // Re-create the PDF pass for the new map, and the RTXDI resources if its size is different
+        m_ui.environmentMapDirty = 2;
     }
 
     void SetupView(uint32_t renderWidth, uint32_t renderHeight, const engine::PerspectiveCamera* activeCamera)
@@ -562,11 +896,206 @@ public:
         m_UpscaledView.SetViewport(windowViewport);
     }
 
+    void RenderGBuffer(nvrhi::ICommandList* commandList)
+    {
+        ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::GBufferFill);
+
+        GBufferSettings gbufferSettings = m_ui.gbufferSettings;
+        float upscalingLodBias = ::log2f(m_View.GetViewport().width() / m_UpscaledView.GetViewport().width());
+        gbufferSettings.textureLodBias += upscalingLodBias;
+
+        if (m_ui.rasterizeGBuffer)
+            m_RasterizedGBufferPass->Render(commandList, m_View, m_ViewPrevious, *m_RenderTargets, m_ui.gbufferSettings);
+        else
+            m_GBufferPass->Render(commandList, m_View, m_ViewPrevious, m_ui.gbufferSettings);
+
+        m_PostprocessGBufferPass->Render(commandList, m_View);
+    }
+
+    // Declares the G-buffer and lighting passes of a frame. The transient resources are placed with a graph of all
+    // the passes that may run in any frame, declared by the same function.
+    void AddLightingPasses(
+        RenderGraph& graph,
+        const LightingPasses::RenderSettings& lightingSettings,
+        bool enableLightSampling,
+        bool enableDirectReStirPass,
+        bool enableGSGIPass,
+        bool enablePMGIPass,
+        bool enableBrdfAndIndirectPass,
+        bool enableIndirect,
+        bool enableReSTIRGI,
+        bool enableVisualization)
+    {
+        rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->getReSTIRDIContext();
+        const bool checkerboard = restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off;
+
+        const RenderGraph::ResourceHandle gradients = graph.ImportTexture(m_RenderTargets->Gradients);
+        const nvrhi::ResourceStates uav = nvrhi::ResourceStates::UnorderedAccess;
+        const nvrhi::ResourceStates srv = nvrhi::ResourceStates::ShaderResource;
+
+        // With parallel recording, each group of passes goes into its own command list
+        auto beginCommandList = [this, &graph](const char* name)
+        {
+            if (m_ParallelRecording)
+                graph.BeginCommandList(name);
+        };
+
+        // The light presampling and the virtual lights don't read the G-buffer. With async compute they run on
+        // the compute queue while the G-buffer is drawn, and they come first so that the compute queue only waits
+        // for the work before the graph.
+        if (m_ComputeCommandList)
+            graph.SetQueue(nvrhi::CommandQueue::Compute);
+
+        if (enableLightSampling)
+        {
+            m_LightingPasses->AddLightSamplingPass(graph,
+                *m_isContext,
+                m_View, m_ViewPrevious,
+                lightingSettings,
+                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
+        }
+
+        if (enableGSGIPass || enablePMGIPass)
+            beginCommandList("GI");
+
+        if (enableGSGIPass)
+        {
+            m_LightingPasses->AddGSGIPasses(graph,
+                *m_isContext,
+                lightingSettings);
+        }
+
+        if (enablePMGIPass)
+        {
+            m_LightingPasses->AddPMGIPasses(graph,
+                lightingSettings);
+        }
+
+        graph.SetQueue(nvrhi::CommandQueue::Graphics);
+
+        beginCommandList("GBuffer");
+        graph.AddPass("GBufferFill", {}, {}, [this](nvrhi::ICommandList* commandList)
+        {
+            RenderGBuffer(commandList);
+        });
+
+        if (enableDirectReStirPass)
+        {
+            beginCommandList("DirectLighting");
+
+            graph.AddPass("ClearGradients", {}, { { gradients, uav } }, [this](nvrhi::ICommandList* commandList)
+            {
+                commandList->clearTextureFloat(m_RenderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            });
+
+            m_LightingPasses->AddDirectLightingPasses(graph,
+                restirDIContext,
+                m_View,
+                lightingSettings);
+
+            // Post-process the gradients into a confidence buffer usable by NRD
+            if (lightingSettings.enableGradients)
+            {
+                graph.AddPass("FilterGradients", {}, { { gradients, uav } }, [this, checkerboard](nvrhi::ICommandList* commandList)
+                {
+                    m_FilterGradientsPass->Render(commandList, m_View, checkerboard);
+                });
+
+                graph.AddPass("Confidence", { { gradients, srv } }, {}, [this, lightingSettings, checkerboard](nvrhi::ICommandList* commandList)
+                {
+                    m_ConfidencePass->Render(commandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                });
+            }
+        }
+
+        if (enableBrdfAndIndirectPass)
+        {
+            beginCommandList("IndirectLighting");
+
+            m_LightingPasses->AddBrdfRayPasses(
+                graph,
+                *m_isContext,
+                m_View, m_ViewPrevious,
+                lightingSettings,
+                m_ui.gbufferSettings,
+                *m_EnvironmentLight,
+                /* enableIndirect = */ enableIndirect,
+                /* enableAdditiveBlend = */ enableDirectReStirPass,
+                /* enableEmissiveSurfaces = */ m_ui.directLightingMode == DirectLightingMode::Brdf,
+                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation,
+                enableReSTIRGI
+                );
+        }
+
+        // The visualization pass binds the gradients in all modes, after the lighting passes
+        if (enableVisualization && enableDirectReStirPass)
+            graph.AddPass("Visualization", { { gradients, srv } }, {});
+    }
+
+    // Gradients, SecondaryGBuffer and GSGIGBuffer are only used by the lighting passes, with disjoint lifetimes.
+    // They are placed in one heap where they share memory. Placed resources can't be bound to another heap,
+    // so they are created again every time.
+    void PlaceTransientResources(bool enableVisualization)
+    {
+        auto createTransientResources = [this](bool isVirtual)
+        {
+            nvrhi::TextureDesc gradientsDesc = m_RenderTargets->Gradients->getDesc();
+            gradientsDesc.isVirtual = isVirtual;
+            m_RenderTargets->Gradients = GetDevice()->createTexture(gradientsDesc);
+
+            nvrhi::BufferDesc secondaryGBufferDesc = m_RtxdiResources->SecondaryGBuffer->getDesc();
+            secondaryGBufferDesc.isVirtual = isVirtual;
+            m_RtxdiResources->SecondaryGBuffer = GetDevice()->createBuffer(secondaryGBufferDesc);
+
+            nvrhi::BufferDesc gsgiGBufferDesc = m_RtxdiResources->GSGIGBuffer->getDesc();
+            gsgiGBufferDesc.isVirtual = isVirtual;
+            m_RtxdiResources->GSGIGBuffer = GetDevice()->createBuffer(gsgiGBufferDesc);
+
+            m_LightingPasses->SetResources(*m_RenderTargets, *m_RtxdiResources);
+        };
+
+        m_TransientHeap = nullptr;
+        createTransientResources(true);
+
+        LightingPasses::RenderSettings lightingSettings = m_ui.lightingSettings;
+        lightingSettings.enableGradients = true;
+
+        // The pipelines are only created for the passes that the frames actually render
+        m_LightingPasses->SetPipelineRequestsEnabled(false);
+
+        RenderGraph graph;
+        AddLightingPasses(graph, lightingSettings,
+            /* enableLightSampling = */ true,
+            /* enableDirectReStirPass = */ true,
+            /* enableGSGIPass = */ true,
+            /* enablePMGIPass = */ true,
+            /* enableBrdfAndIndirectPass = */ true,
+            /* enableIndirect = */ true,
+            /* enableReSTIRGI = */ true,
+            enableVisualization);
+
+        m_LightingPasses->SetPipelineRequestsEnabled(true);
+
+        if (!m_RenderGraphFailed && graph.Compile())
+            m_TransientHeap = graph.PlaceTransientResources(GetDevice(), "TransientHeap");
+
+        if (!m_TransientHeap)
+        {
+            log::warning("Couldn't place the transient resources in a shared heap, creating them separately");
+            createTransientResources(false);
+        }
+
+        m_TransientHeapVisualization = enableVisualization;
+    }
+
     void SetupRenderPasses(uint32_t renderWidth, uint32_t renderHeight, bool& exposureResetRequired)
     {
+        CpuProfilerScope cpuScope("SetupRenderPasses");
+
         if (m_ui.environmentMapDirty == 2)
         {
             m_EnvironmentMapPdfMipmapPass = nullptr;
+            m_EnvironmentAliasTablePass = nullptr;
 
             m_ui.environmentMapDirty = 1;
         }
@@ -579,7 +1108,9 @@ public:
             m_TemporalAntiAliasingPass = nullptr;
             m_RenderEnvironmentMapPass = nullptr;
             m_EnvironmentMapPdfMipmapPass = nullptr;
+            m_EnvironmentAliasTablePass = nullptr;
             m_LocalLightPdfMipmapPass = nullptr;
+            m_LocalLightPdfUpdatePass = nullptr;
             m_VisualizationPass = nullptr;
             m_DebugVizPasses = nullptr;
             m_ui.environmentMapDirty = 1;
@@ -595,7 +1126,7 @@ public:
             m_RenderEnvironmentMapPass = std::make_unique<RenderEnvironmentMapPass>(GetDevice(), m_ShaderFactory, m_DescriptorTableManager, 2048);
         }
         
-        const auto environmentMap = (m_ui.environmentMapIndex > 0)
+        const auto environmentMap = m_EnvironmentMap
             ? m_EnvironmentMap->texture.Get()
             : m_RenderEnvironmentMapPass->GetTexture();
 
@@ -634,7 +1165,8 @@ public:
             numPrimitiveLights > m_RtxdiResources->GetMaxPrimitiveLights() ||
             numGeometryInstances > m_RtxdiResources->GetMaxGeometryInstances() ||
             virtualLightSamplesPerFrame != m_RtxdiResources->GetVirtualLightSamplesPerFrame() ||
-            virtualLightSampleLifespan != m_RtxdiResources->GetVirtualLightSampleLifespan()))
+            virtualLightSampleLifespan != m_RtxdiResources->GetVirtualLightSampleLifespan() ||
+            bool(m_ui.lightingSettings.environmentAliasTable) != m_RtxdiResources->HasEnvironmentAliasTable()))
         {
             m_RtxdiResources = nullptr;
         }
@@ -664,10 +1196,6 @@ public:
 
             m_GlassPass->CreateBindingSet(m_Scene->GetTopLevelAS(), m_Scene->GetPrevTopLevelAS(), *m_RenderTargets);
 
-            m_FilterGradientsPass->CreateBindingSet(*m_RenderTargets);
-
-            m_ConfidencePass->CreateBindingSet(*m_RenderTargets);
-            
             m_AccumulationPass->CreateBindingSet(*m_RenderTargets);
 
             m_RasterizedGBufferPass->CreatePipeline(*m_RenderTargets);
@@ -700,7 +1228,8 @@ public:
                 environmentMapSize.y,
                 virtualLightSamplesPerFrame,
                 virtualLightSampleLifespan,
-                reGIRCellCount);
+                reGIRCellCount,
+                m_ui.lightingSettings.environmentAliasTable);
 
             m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources);
             
@@ -719,16 +1248,51 @@ public:
                 m_RtxdiResources->EnvironmentPdfTexture);
         }
 
-        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated)
+        if (m_ui.lightingSettings.environmentAliasTable && (!m_EnvironmentAliasTablePass || rtxdiResourcesCreated))
         {
-            m_LocalLightPdfMipmapPass = std::make_unique<GenerateMipsPass>(
+            m_EnvironmentAliasTablePass = std::make_unique<EnvironmentAliasTablePass>(
                 GetDevice(),
                 m_ShaderFactory,
-                nullptr,
-                m_RtxdiResources->LocalLightPdfTexture);
+                environmentMap,
+                *m_RtxdiResources);
         }
-
-        if (renderTargetsCreated || rtxdiResourcesCreated)
+        else if (!m_ui.lightingSettings.environmentAliasTable)
+        {
+            m_EnvironmentAliasTablePass = nullptr;
+        }
+
+        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated)
+        {
+            m_LocalLightPdfMipmapPass = std::make_unique<GenerateMipsPass>(
+                GetDevice(),
+                m_ShaderFactory,
+                nullptr,
+                m_RtxdiResources->LocalLightPdfTexture);
+
+            m_LocalLightPdfUpdatePass = std::make_unique<LocalLightPdfUpdatePass>(
+                GetDevice(),
+                m_ShaderFactory,
+                m_UploadRing,
+                m_RtxdiResources->LocalLightPdfTexture);
+        }
+
+        // The visualization pass binds the gradients, which then can't share memory with the other transient resources
+        const bool enableVisualization = m_ui.visualizationMode != VIS_MODE_NONE;
+        bool transientResourcesPlaced = false;
+
+        if (renderTargetsCreated || rtxdiResourcesCreated || enableVisualization != m_TransientHeapVisualization ||
+            (m_RenderGraphFailed && m_TransientHeap))
+        {
+            PlaceTransientResources(enableVisualization);
+
+            m_FilterGradientsPass->CreateBindingSet(*m_RenderTargets);
+
+            m_ConfidencePass->CreateBindingSet(*m_RenderTargets);
+
+            transientResourcesPlaced = true;
+        }
+
+        if (transientResourcesPlaced)
         {
             m_LightingPasses->CreateBindingSet(
                 m_Scene->GetTopLevelAS(),
@@ -772,7 +1336,7 @@ public:
             m_BloomPass = std::make_unique<render::BloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView);
         }
 
-        if (!m_VisualizationPass || renderTargetsCreated || rtxdiResourcesCreated)
+        if (!m_VisualizationPass || transientResourcesPlaced)
         {
             m_VisualizationPass = std::make_unique<VisualizationPass>(GetDevice(), *m_CommonPasses, *m_ShaderFactory, *m_RenderTargets, *m_RtxdiResources);
         }
@@ -819,11 +1383,85 @@ public:
             : 0.f;
     }
 
-    void Resolve(nvrhi::ICommandList* commandList, float accumulationWeight) const
+    // The UI values that the post-processing uses. They are copied on the main thread because the post-processing
+    // can be recorded on a worker thread, at the same time as the lighting passes.
+    struct PostProcessingSettings
+    {
+        AntiAliasingMode aaMode = AntiAliasingMode::None;
+        render::TemporalAntiAliasingParameters taaParams;
+        bool resetAccumulation = false;
+        bool enableDenoiser = false;
+#if WITH_NRD
+        nrd::Denoiser denoisingMethod = nrd::Denoiser::RELAX_DIFFUSE_SPECULAR;
+        nrd::ReblurSettings reblurSettings = {};
+        nrd::RelaxSettings relaxSettings = {};
+        float denoiserDebug = 0.f;
+#endif
+#if WITH_DLSS
+        float dlssExposureScale = 0.f;
+        float dlssSharpness = 0.f;
+        ibool rasterizeGBuffer = false;
+#endif
+        ibool enableTextures = false;
+        float noiseMix = 0.f;
+        float noiseClampLow = 0.f;
+        float noiseClampHigh = 0.f;
+        GBufferSettings gbufferSettings;
+        ibool enableBloom = false;
+        float resolutionScale = 1.f;
+        bool storeReferenceImage = false;
+        float referenceImageSplit = 0.f;
+        ibool enableToneMapping = false;
+        float exposureBias = 0.f;
+        uint32_t visualizationMode = VIS_MODE_NONE;
+        bool enableGradients = false; // the UI setting, the lighting passes can turn the gradients off for a frame
+        DirectLightingMode directLightingMode = DirectLightingMode::None;
+        IndirectLightingMode indirectLightingMode = IndirectLightingMode::None;
+        uint32_t debugRenderOutputBuffer = 0;
+    };
+
+    [[nodiscard]] PostProcessingSettings GetPostProcessingSettings() const
+    {
+        PostProcessingSettings settings;
+        settings.aaMode = m_ui.aaMode;
+        settings.taaParams = m_ui.taaParams;
+        settings.resetAccumulation = m_ui.resetAccumulation;
+        settings.enableDenoiser = m_ui.enableDenoiser;
+#if WITH_NRD
+        settings.denoisingMethod = m_ui.denoisingMethod;
+        settings.reblurSettings = m_ui.reblurSettings;
+        settings.relaxSettings = m_ui.relaxSettings;
+        settings.denoiserDebug = m_ui.debug;
+#endif
+#if WITH_DLSS
+        settings.dlssExposureScale = m_ui.dlssExposureScale;
+        settings.dlssSharpness = m_ui.dlssSharpness;
+        settings.rasterizeGBuffer = m_ui.rasterizeGBuffer;
+#endif
+        settings.enableTextures = m_ui.enableTextures;
+        settings.noiseMix = m_ui.noiseMix;
+        settings.noiseClampLow = m_ui.noiseClampLow;
+        settings.noiseClampHigh = m_ui.noiseClampHigh;
+        settings.gbufferSettings = m_ui.gbufferSettings;
+        settings.enableBloom = m_ui.enableBloom;
+        settings.resolutionScale = m_ui.resolutionScale;
+        settings.storeReferenceImage = m_ui.storeReferenceImage;
+        settings.referenceImageSplit = m_ui.referenceImageSplit;
+        settings.enableToneMapping = m_ui.enableToneMapping;
+        settings.exposureBias = m_ui.exposureBias;
+        settings.visualizationMode = m_ui.visualizationMode;
+        settings.enableGradients = m_ui.lightingSettings.enableGradients;
+        settings.directLightingMode = m_ui.directLightingMode;
+        settings.indirectLightingMode = m_ui.indirectLightingMode;
+        settings.debugRenderOutputBuffer = m_ui.debugRenderOutputBuffer;
+        return settings;
+    }
+
+    void Resolve(nvrhi::ICommandList* commandList, float accumulationWeight, const PostProcessingSettings& settings) const
     {
         ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Resolve);
 
-        switch (m_ui.aaMode)
+        switch (settings.aaMode)
         {
         case AntiAliasingMode::None: {
             engine::BlitParameters blitParams;
@@ -842,8 +1480,8 @@ public:
         }
 
         case AntiAliasingMode::TAA: {
-            auto taaParams = m_ui.taaParams;
-            if (m_ui.resetAccumulation)
+            auto taaParams = settings.taaParams;
+            if (settings.resetAccumulation)
                 taaParams.newFrameWeight = 1.f;
 
             m_TemporalAntiAliasingPass->TemporalResolve(commandList, taaParams, m_PreviousViewValid, m_View, m_UpscaledView);
@@ -852,7 +1490,7 @@ public:
 
 #if WITH_DLSS
         case AntiAliasingMode::DLSS: {
-            m_DLSS->Render(commandList, *m_RenderTargets, m_ToneMappingPass->GetExposureBuffer(), m_ui.dlssExposureScale, m_ui.dlssSharpness, m_ui.rasterizeGBuffer, m_ui.resetAccumulation, m_View, m_ViewPrevious);
+            m_DLSS->Render(commandList, *m_RenderTargets, m_ToneMappingPass->GetExposureBuffer(), settings.dlssExposureScale, settings.dlssSharpness, settings.rasterizeGBuffer, settings.resetAccumulation, m_View, m_ViewPrevious);
             break;
         }
 #endif
@@ -915,6 +1553,8 @@ public:
 
     void RenderScene(nvrhi::IFramebuffer* framebuffer) override
     {
+        CpuProfilerScope cpuScope("RenderScene");
+
         if (m_FrameStepMode == FrameStepMode::Wait)
         {
             nvrhi::TextureHandle finalImage;
@@ -950,13 +1590,23 @@ public:
                 (void)animation->Apply(animationTime);
                 activeCamera = m_Scene->GetBenchmarkCamera();
                 effectiveFrameIndex = m_ui.animationFrame.value();
+                if (effectiveFrameIndex == 0 && !m_InputReplayer)
+                    m_Profiler->ClearRecordedFrames();
                 m_ui.animationFrame = effectiveFrameIndex + 1;
             }
             else
             {
+                // The timers of the last two frames are still in flight, the results must include them
+                GetDevice()->waitForIdle();
+                m_Profiler->ResolveOutstandingFrames();
+
                 m_ui.benchmarkResults = m_Profiler->GetAsText();
                 m_ui.animationFrame.reset();
 
+                // A replay reports the results of the whole recording when it ends
+                if (!m_InputReplayer)
+                    ProcessBenchmarkResults();
+
                 if (m_args.benchmark)
                 {
                     glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
@@ -1003,10 +1653,15 @@ public:
 
         if (m_ui.environmentMapDirty == 2)
         {
-            LoadEnvironmentMap();
+            RequestEnvironmentMap();
         }
 
-        m_Scene->RefreshSceneGraph(GetFrameIndex());
+        UpdateEnvironmentMap();
+
+        {
+            CpuProfilerScope refreshScope("RefreshSceneGraph");
+            m_Scene->RefreshSceneGraph(GetFrameIndex());
+        }
 
         const auto& fbinfo = framebuffer->getFramebufferInfo();
         uint32_t renderWidth = fbinfo.width;
@@ -1063,9 +1718,14 @@ public:
             m_Profiler->EnableAccumulation(m_ui.animationFrame.has_value());
         }
 
+        m_Profiler->EnableFrameRecording(m_ui.animationFrame.has_value() || m_InputReplayer != nullptr);
+
         float accumulationWeight = 1.f / (float)m_ui.numAccumulatedFrames;
 
-        m_Profiler->ResolvePreviousFrame();
+        {
+            CpuProfilerScope resolveScope("Profiler::ResolvePreviousFrame");
+            m_Profiler->ResolvePreviousFrame();
+        }
         
         int materialIndex = m_Profiler->GetMaterialReadback();
         if (materialIndex >= 0)
@@ -1096,7 +1756,7 @@ public:
             }
             m_EnvironmentLight->radianceScale = ::exp2f(m_ui.environmentIntensityBias);
             m_EnvironmentLight->rotation = m_ui.environmentRotation / 360.f;  //  +/- 0.5
-            m_SunLight->irradiance = (m_ui.environmentMapIndex > 0) ? 0.f : 1.f;
+            m_SunLight->irradiance = m_EnvironmentMap ? 0.f : 1.f;
         }
         else
         {
@@ -1116,11 +1776,130 @@ public:
         uint32_t denoiserMode = DENOISER_MODE_OFF;
 #endif
 
+        bool enableGSGIPass = m_ui.indirectLightingMode == IndirectLightingMode::GSGI;
+        bool enablePMGIPass = m_ui.indirectLightingMode == IndirectLightingMode::PMGI;
+        bool enableVirtualLights = enableGSGIPass || enablePMGIPass;
+
+        uint32_t virtualLightsSamplesPerFrame;
+        uint32_t virtualLightsSampleLifespan;
+        bool lockVirtualLights = m_ui.lightingSettings.vlightParams.lockLights;
+
+        if (enablePMGIPass)
+        {
+            virtualLightsSamplesPerFrame = m_ui.lightingSettings.pmgiParams.samplesPerFrame;
+            virtualLightsSampleLifespan = m_ui.lightingSettings.pmgiParams.sampleLifespan;
+        }
+        else
+        {
+            virtualLightsSamplesPerFrame = m_ui.lightingSettings.gsgiParams.samplesPerFrame;
+            virtualLightsSampleLifespan = m_ui.lightingSettings.gsgiParams.sampleLifespan;
+        }
+
+        if (enableVirtualLights)
+            m_ui.lightingSettings.vlightParams.totalVirtualLights = virtualLightsSamplesPerFrame * virtualLightsSampleLifespan;
+        else
+            m_ui.lightingSettings.vlightParams.totalVirtualLights = 0;
+
+        // Pick the virtual lights that the GI passes replace on this frame
+        VirtualLightUpdate virtualLightUpdate;
+        if (enableVirtualLights)
+        {
+            m_VirtualLightScheduler.Resize(virtualLightsSamplesPerFrame, virtualLightsSampleLifespan);
+
+            uint32_t stride = 1;
+            uint32_t interval = 1;
+            switch (m_ui.virtualLightUpdateMode)
+            {
+            case VirtualLightUpdateMode::Checkerboard:
+                stride = 2;
+                break;
+            case VirtualLightUpdateMode::HalfRate:
+                interval = 2;
+                break;
+            case VirtualLightUpdateMode::Adaptive: {
+                if (lockVirtualLights)
+                    break;
+
+                double measuredTime = 0.0;
+                if (m_Profiler->IsEnabled())
+                {
+                    measuredTime = enablePMGIPass
+                        ? m_Profiler->GetLastFrameTimer(ProfilerSection::PMGICreateLights)
+                        : m_Profiler->GetLastFrameTimer(ProfilerSection::GSGISampleGeometry) +
+                          m_Profiler->GetLastFrameTimer(ProfilerSection::GSGIInitialSamples) +
+                          m_Profiler->GetLastFrameTimer(ProfilerSection::GSGIWorldSpaceResampling) +
+                          m_Profiler->GetLastFrameTimer(ProfilerSection::GSGIScreenSpaceResampling) +
+                          m_Profiler->GetLastFrameTimer(ProfilerSection::GSGICreateLights);
+                }
+                stride = m_VirtualLightBudget.Update(measuredTime, m_ui.virtualLightBudget);
+                break;
+            }
+            default:
+                break;
+            }
+
+            // Frozen lights run the GI passes in full, their timings don't fit the strides of the controller
+            if (m_ui.virtualLightUpdateMode != VirtualLightUpdateMode::Adaptive || lockVirtualLights)
+                m_VirtualLightBudget.Reset();
+
+            if (lockVirtualLights)
+            {
+                // Frozen lights are not replaced, but the block written on the last frame still goes to the other half
+                // of the light buffer. The GI passes run in full as before.
+                virtualLightUpdate = m_VirtualLightScheduler.Hold();
+                virtualLightUpdate.active = true;
+                virtualLightUpdate.lightCount = virtualLightsSamplesPerFrame;
+            }
+            else
+            {
+                virtualLightUpdate = m_VirtualLightScheduler.Advance(stride, interval);
+            }
+
+            m_ui.virtualLightUpdateStride = virtualLightUpdate.stride;
+            m_ui.virtualLightMaxAge = m_VirtualLightScheduler.GetMaxAge();
+        }
+        else
+        {
+            m_VirtualLightScheduler.Resize(0, 0);
+            m_VirtualLightBudget.Reset();
+        }
+
+        const uint64_t recordingStart = CpuProfiler::Now();
+
         m_CommandList->open();
 
         m_Profiler->BeginFrame(m_CommandList);
 
-        AssignIesProfiles(m_CommandList);
+        m_IesProfiles->UpdateChangedLights(m_CommandList);
+
+        // The lights are final from here on, their tasks are built while the scene buffers, the acceleration structures
+        // and the environment map are recorded. Nothing below writes the scene graph until the packet is taken.
+        {
+            // Emissive textures that are still streaming in change the light flux without marking the materials dirty
+            const bool texturesLoaded = m_TextureCache->GetNumberOfFinalizedTextures() >= m_TextureCache->GetNumberOfRequestedTextures();
+
+            LightTaskSettings lightTaskSettings;
+            lightTaskSettings.frameIndex = effectiveFrameIndex;
+            lightTaskSettings.enableImportanceSampledEnvironmentLight = m_EnvironmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling;
+            lightTaskSettings.enableVirtualLights = enableVirtualLights;
+            lightTaskSettings.virtualLightsSamplesPerFrame = virtualLightsSamplesPerFrame;
+            lightTaskSettings.virtualLightsSampleLifespan = virtualLightsSampleLifespan;
+            lightTaskSettings.virtualLightsCurrentBlock = virtualLightUpdate.block;
+            lightTaskSettings.virtualLightsPreviousBlock = virtualLightUpdate.previousBlock;
+            lightTaskSettings.virtualLightsUpdateStride = virtualLightUpdate.stride;
+            lightTaskSettings.virtualLightsUpdatePhase = virtualLightUpdate.phase;
+            lightTaskSettings.virtualLightsRingComplete = m_VirtualLightScheduler.IsComplete();
+            lightTaskSettings.lockVirtualLights = lockVirtualLights;
+            lightTaskSettings.addVirtualLightsToGeometryMap = m_ui.lightingSettings.vlightParams.includeInBrdfLightSampling;
+            lightTaskSettings.incrementalLocalLightPdf = m_ui.incrementalLocalLightPdf && texturesLoaded;
+            lightTaskSettings.enableStaticLightRegion = m_ui.staticLightRegion && texturesLoaded;
+
+            m_FramePackets->Begin(effectiveFrameIndex, [this, lightTaskSettings](FramePacket& packet)
+            {
+                m_PrepareLightsPass->BuildTasks(lightTaskSettings, packet);
+            });
+        }
+
         m_Scene->RefreshBuffers(m_CommandList, GetFrameIndex());
         m_RtxdiResources->InitializeNeighborOffsets(m_CommandList, m_isContext->getNeighborOffsetCount());
 
@@ -1131,83 +1910,51 @@ public:
             m_Scene->UpdateSkinnedMeshBLASes(m_CommandList, GetFrameIndex());
             m_Scene->BuildTopLevelAccelStruct(m_CommandList);
         }
-        m_CommandList->compactBottomLevelAccelStructs();
+        m_Scene->CompactMeshBLASes(GetDevice(), m_CommandList);
 
         if (m_ui.environmentMapDirty)
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::EnvironmentMap);
 
-            if (m_ui.environmentMapIndex == 0)
+            if (!m_EnvironmentMap)
             {
                 donut::render::SkyParameters params;
                 m_RenderEnvironmentMapPass->Render(m_CommandList, *m_SunLight, params);
             }
-            
-            m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
-
-            m_ui.environmentMapDirty = 0;
-        }
 
-        nvrhi::utils::ClearColorAttachment(m_CommandList, framebuffer, 0, nvrhi::Color(0.f));
+            const bool pdfUploaded = m_EnvironmentPdfCache
+                && m_EnvironmentPdfCache->Upload(m_CommandList, m_RtxdiResources->EnvironmentPdfTexture);
 
-        {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::GBufferFill);
+            if (!pdfUploaded)
+            {
+                m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
 
-            GBufferSettings gbufferSettings = m_ui.gbufferSettings;
-            float upscalingLodBias = ::log2f(m_View.GetViewport().width() / m_UpscaledView.GetViewport().width());
-            gbufferSettings.textureLodBias += upscalingLodBias;
+                if (m_EnvironmentPdfCache && m_EnvironmentMap)
+                    m_EnvironmentPdfCache->Capture(m_CommandList, m_EnvironmentMap->texture);
+            }
 
-            if (m_ui.rasterizeGBuffer)
-                m_RasterizedGBufferPass->Render(m_CommandList, m_View, m_ViewPrevious, *m_RenderTargets, m_ui.gbufferSettings);
-            else
-                m_GBufferPass->Render(m_CommandList, m_View, m_ViewPrevious, m_ui.gbufferSettings);
+            // Tables built on the CPU while streaming the map, otherwise on the GPU, e.g. for the procedural sky
+            if (m_EnvironmentAliasTablePass &&
+                (!m_EnvironmentAliasTable || !m_EnvironmentAliasTablePass->Upload(m_CommandList, *m_EnvironmentAliasTable)))
+                m_EnvironmentAliasTablePass->Build(m_CommandList);
 
-            m_PostprocessGBufferPass->Render(m_CommandList, m_View);
+            m_ui.environmentMapDirty = 0;
         }
 
+        nvrhi::utils::ClearColorAttachment(m_CommandList, framebuffer, 0, nvrhi::Color(0.f));
+
         // The light indexing members of frameParameters are written by PrepareLightsPass below
         rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->getReSTIRDIContext();
         restirDIContext.setFrameIndex(effectiveFrameIndex);
         m_isContext->getReSTIRGIContext().setFrameIndex(effectiveFrameIndex);
 
-        bool enableGSGIPass = m_ui.indirectLightingMode == IndirectLightingMode::GSGI;
-        bool enablePMGIPass = m_ui.indirectLightingMode == IndirectLightingMode::PMGI;
-        bool enableVirtualLights = enableGSGIPass || enablePMGIPass;
-
-        uint32_t virtualLightsSamplesPerFrame;
-        uint32_t virtualLightsSampleLifespan;
-        bool lockVirtualLights = m_ui.lightingSettings.vlightParams.lockLights;
-
-        if (enablePMGIPass)
-        {
-            virtualLightsSamplesPerFrame = m_ui.lightingSettings.pmgiParams.samplesPerFrame;
-            virtualLightsSampleLifespan = m_ui.lightingSettings.pmgiParams.sampleLifespan;
-        }
-        else
-        {
-            virtualLightsSamplesPerFrame = m_ui.lightingSettings.gsgiParams.samplesPerFrame;
-            virtualLightsSampleLifespan = m_ui.lightingSettings.gsgiParams.sampleLifespan;
-        }
-
-        if (enableVirtualLights)
-            m_ui.lightingSettings.vlightParams.totalVirtualLights = virtualLightsSamplesPerFrame * virtualLightsSampleLifespan;
-        else
-            m_ui.lightingSettings.vlightParams.totalVirtualLights = 0;
-
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::MeshProcessing);
-            
-            RTXDI_LightBufferParameters lightBufferParams = m_PrepareLightsPass->Process(
-                m_CommandList,
-                restirDIContext,
-                m_Scene->GetSceneGraph()->GetLights(),
-                m_EnvironmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling,
-                enableVirtualLights,
-                virtualLightsSamplesPerFrame,
-                virtualLightsSampleLifespan,
-                lockVirtualLights,
-                m_ui.lightingSettings.vlightParams.includeInBrdfLightSampling);
+
+            const FramePacket& framePacket = m_FramePackets->Wait();
+            RTXDI_LightBufferParameters lightBufferParams = m_PrepareLightsPass->Process(m_CommandList, framePacket);
             m_isContext->setLightBufferParams(lightBufferParams);
+            m_LightingPasses->SetStaticLightRange(m_PrepareLightsPass->GetLightBufferStride(), m_PrepareLightsPass->GetStaticLightRange());
 
             auto initialSamplingParams = restirDIContext.getInitialSamplingParameters();
             initialSamplingParams.environmentMapImportanceSampling = lightBufferParams.environmentLightParams.lightPresent;
@@ -1218,8 +1965,14 @@ public:
         if (IsLocalLightPowerRISEnabled())
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::LocalLightPdfMap);
-            
-            m_LocalLightPdfMipmapPass->Process(m_CommandList);
+
+            // Only the mips above the changed lights are updated when possible
+            std::vector<PdfTexelRange> changedTexels;
+            if (!m_PrepareLightsPass->TakeLocalLightPdfChanges(changedTexels) ||
+                !m_LocalLightPdfUpdatePass->Process(m_CommandList, changedTexels))
+            {
+                m_LocalLightPdfMipmapPass->Process(m_CommandList);
+            }
         }
 
 
@@ -1236,6 +1989,15 @@ public:
         }
 #endif
         
+        if (m_ui.lightingSettings.dirReGIRTileEncoding != DirReGIRTileEncoding::Full &&
+            !IsDirReGIRPackedEncodingSupported(m_RtxdiResources->GetLightBufferElements()))
+        {
+            // The packed tile entries would turn the light indices past 2^20 into invalid samples
+            log::warning("The light buffer holds %u lights, too many for the packed DirReGIR tile encoding. Using the full encoding.",
+                m_RtxdiResources->GetLightBufferElements());
+            m_ui.lightingSettings.dirReGIRTileEncoding = DirReGIRTileEncoding::Full;
+        }
+
         LightingPasses::RenderSettings lightingSettings = m_ui.lightingSettings;
         lightingSettings.enablePreviousTLAS &= m_ui.enableAnimations;
         lightingSettings.enableAlphaTestedGeometry = m_ui.gbufferSettings.enableAlphaTestedGeometry;
@@ -1255,6 +2017,8 @@ public:
         else
             lightingSettings.vlightParams.clampingRatio = lightingSettings.gsgiParams.clampingDistance / lightingSettings.gsgiParams.lightSize;
         lightingSettings.pmgiParams.invTotalVirtualLights = 1 / static_cast<float>(lightingSettings.pmgiParams.samplesPerFrame * lightingSettings.pmgiParams.sampleLifespan);
+        lightingSettings.vlightParams.updateStride = virtualLightUpdate.stride;
+        lightingSettings.vlightParams.updatePhase = virtualLightUpdate.phase;
 
         const bool checkerboard = restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off;
 
@@ -1277,292 +2041,326 @@ public:
             lightingSettings.enableGradients = false;
         }
 
-        if (enableDirectReStirPass || enableIndirect)
-        {
-            m_LightingPasses->PrepareForLightSampling(m_CommandList,
-                *m_isContext,
-                m_View, m_ViewPrevious,
-                lightingSettings,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
-        }
+        // The BRDF rays are not traced when virtual lights are generated for indirect lighting
+        const bool enableBrdfRayPasses = enableBrdfAndIndirectPass && !enableGSGIPass && !enablePMGIPass;
 
-        if (enableDirectReStirPass)
+        if (enableBrdfRayPasses)
         {
-            m_CommandList->clearTextureFloat(m_RenderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
-
-            m_LightingPasses->RenderDirectLighting(m_CommandList,
-                restirDIContext,
-                m_View,
-                lightingSettings);
-
-            // Post-process the gradients into a confidence buffer usable by NRD
-            if (lightingSettings.enableGradients)
-            {
-                m_FilterGradientsPass->Render(m_CommandList, m_View, checkerboard);
-                m_ConfidencePass->Render(m_CommandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
-            }
+            ReSTIRDI_ShadingParameters restirDIShadingParams = m_isContext->getReSTIRDIContext().getShadingParameters();
+            restirDIShadingParams.enableDenoiserInputPacking = true;
+            m_isContext->getReSTIRDIContext().setShadingParameters(restirDIShadingParams);
         }
 
-        if (enableGSGIPass)
+        // Reference image functionality:
+        // When the camera is moved, discard the previously stored image, if any, and disable its display.
+        if (!cameraIsStatic)
         {
-            m_LightingPasses->GenerateGSGILights(m_CommandList,
-                restirDIContext,
-                *m_isContext,
-                m_View,
-                lightingSettings);
+            m_ui.referenceImageCaptured = false;
+            m_ui.referenceImageSplit = 0.f;
         }
 
-        else if (enablePMGIPass)
-        {
-            m_LightingPasses->GeneratePMGILights(m_CommandList,
-                restirDIContext,
-                *m_isContext,
-                m_View,
-                lightingSettings);
-        }
+        const PostProcessingSettings post = GetPostProcessingSettings();
 
-        else if (enableBrdfAndIndirectPass)
+        // The post-processing stores the reference image below
+        if (m_ui.storeReferenceImage)
         {
-            ReSTIRDI_ShadingParameters restirDIShadingParams = m_isContext->getReSTIRDIContext().getShadingParameters();
-            restirDIShadingParams.enableDenoiserInputPacking = true;
-            m_isContext->getReSTIRDIContext().setShadingParameters(restirDIShadingParams);
-
-            bool enableReSTIRGI = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
-
-            m_LightingPasses->RenderBrdfRays(
-                m_CommandList,
-                *m_isContext,
-                m_View, m_ViewPrevious,
-                lightingSettings,
-                m_ui.gbufferSettings,
-                *m_EnvironmentLight,
-                /* enableIndirect = */ enableIndirect,
-                /* enableAdditiveBlend = */ enableDirectReStirPass,
-                /* enableEmissiveSurfaces = */ m_ui.directLightingMode == DirectLightingMode::Brdf,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation,
-                enableReSTIRGI
-                );
+            m_ui.storeReferenceImage = false;
+            m_ui.referenceImageCaptured = true;
         }
 
         // If none of the passes above were executed, clear the textures to avoid stale data there.
         // It's a weird mode but it can be selected from the UI.
-        if (!enableDirectReStirPass && !enableBrdfAndIndirectPass)
+        const bool clearLighting = !enableDirectReStirPass && !enableBrdfAndIndirectPass;
+
+        // Everything after the lighting, recorded after the graph or as its last pass
+        auto renderPostProcessing = [this, framebuffer, post, clearLighting, denoiserMode, checkerboard, accumulationWeight,
+            exposureResetRequired, enableGradients = lightingSettings.enableGradients](nvrhi::ICommandList* commandList)
         {
-            m_CommandList->clearTextureFloat(m_RenderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
-            m_CommandList->clearTextureFloat(m_RenderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
-        }
+            if (clearLighting)
+            {
+                commandList->clearTextureFloat(m_RenderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+                commandList->clearTextureFloat(m_RenderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            }
         
 #if WITH_NRD
-        if (m_ui.enableDenoiser)
-        {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::Denoising);
-            m_CommandList->beginMarker("Denoising");
+            if (post.enableDenoiser)
+            {
+                ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Denoising);
+                commandList->beginMarker("Denoising");
 
-            const void* methodSettings = (m_ui.denoisingMethod == nrd::Denoiser::RELAX_DIFFUSE_SPECULAR)
-                ? (void*)&m_ui.relaxSettings
-                : (void*)&m_ui.reblurSettings;
+                const void* methodSettings = (post.denoisingMethod == nrd::Denoiser::RELAX_DIFFUSE_SPECULAR)
+                    ? (const void*)&post.relaxSettings
+                    : (const void*)&post.reblurSettings;
 
-            m_NRD->RunDenoiserPasses(m_CommandList, *m_RenderTargets, m_View, m_ViewPrevious, GetFrameIndex(), lightingSettings.enableGradients, methodSettings, m_ui.debug);
+                m_NRD->RunDenoiserPasses(commandList, *m_RenderTargets, m_View, m_ViewPrevious, GetFrameIndex(), enableGradients, methodSettings, post.denoiserDebug);
             
-            m_CommandList->endMarker();
-        }
+                commandList->endMarker();
+            }
 #endif
 
-        m_CompositingPass->Render(
-            m_CommandList,
-            m_View,
-            m_ViewPrevious,
-            denoiserMode,
-            checkerboard,
-            m_ui,
-            *m_EnvironmentLight);
-
-        if (m_ui.gbufferSettings.enableTransparentGeometry)
-        {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::Glass);
+            m_CompositingPass->Render(
+                commandList,
+                m_View,
+                m_ViewPrevious,
+                denoiserMode,
+                checkerboard,
+                post.enableTextures,
+                post.noiseMix,
+                post.noiseClampLow,
+                post.noiseClampHigh,
+                *m_EnvironmentLight);
+
+            if (post.gbufferSettings.enableTransparentGeometry)
+            {
+                ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Glass);
 
-            m_GlassPass->Render(m_CommandList, m_View,
-                *m_EnvironmentLight,
-                m_ui.gbufferSettings.normalMapScale,
-                m_ui.gbufferSettings.enableMaterialReadback,
-                m_ui.gbufferSettings.materialReadbackPosition);
-        }
+                m_GlassPass->Render(commandList, m_View,
+                    *m_EnvironmentLight,
+                    post.gbufferSettings.normalMapScale,
+                    post.gbufferSettings.enableMaterialReadback,
+                    post.gbufferSettings.materialReadbackPosition);
+            }
 
-        Resolve(m_CommandList, accumulationWeight);
+            Resolve(commandList, accumulationWeight, post);
 
-        if (m_ui.enableBloom)
-        {
+            if (post.enableBloom)
+            {
 #if WITH_DLSS
-            // Use the unresolved image for bloom when DLSS is active because DLSS can modify HDR values significantly and add bloom flicker.
-            nvrhi::ITexture* bloomSource = (m_ui.aaMode == AntiAliasingMode::DLSS && m_ui.resolutionScale == 1.f)
-                ? m_RenderTargets->HdrColor
-                : m_RenderTargets->ResolvedColor;
+                // Use the unresolved image for bloom when DLSS is active because DLSS can modify HDR values significantly and add bloom flicker.
+                nvrhi::ITexture* bloomSource = (post.aaMode == AntiAliasingMode::DLSS && post.resolutionScale == 1.f)
+                    ? m_RenderTargets->HdrColor
+                    : m_RenderTargets->ResolvedColor;
 #else
-            nvrhi::ITexture* bloomSource = m_RenderTargets->ResolvedColor;
+                nvrhi::ITexture* bloomSource = m_RenderTargets->ResolvedColor;
 #endif
 
-            m_BloomPass->Render(m_CommandList, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView, bloomSource, 32.f, 0.005f);
-        }
-
-        // Reference image functionality:
-        {
-            // When the camera is moved, discard the previously stored image, if any, and disable its display.
-            if (!cameraIsStatic)
-            {
-                m_ui.referenceImageCaptured = false;
-                m_ui.referenceImageSplit = 0.f;
+                m_BloomPass->Render(commandList, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView, bloomSource, 32.f, 0.005f);
             }
 
-            // When the user clicks the "Store" button, copy the ResolvedColor texture into ReferenceColor.
-            if (m_ui.storeReferenceImage)
+            // Reference image functionality:
             {
-                m_CommandList->copyTexture(m_RenderTargets->ReferenceColor, nvrhi::TextureSlice(), m_RenderTargets->ResolvedColor, nvrhi::TextureSlice());
-                m_ui.storeReferenceImage = false;
-                m_ui.referenceImageCaptured = true;
-            }
+                // When the user clicks the "Store" button, copy the ResolvedColor texture into ReferenceColor.
+                if (post.storeReferenceImage)
+                {
+                    commandList->copyTexture(m_RenderTargets->ReferenceColor, nvrhi::TextureSlice(), m_RenderTargets->ResolvedColor, nvrhi::TextureSlice());
+                }
 
-            // When the "Split Display" parameter is nonzero, show a portion of the previously stored
-            // ReferenceColor texture on the left side of the screen by copying it into the ResolvedColor texture.
-            if (m_ui.referenceImageSplit > 0.f)
-            {
-                engine::BlitParameters blitParams;
-                blitParams.sourceTexture = m_RenderTargets->ReferenceColor;
-                blitParams.sourceBox.m_maxs = float2(m_ui.referenceImageSplit, 1.f);
-                blitParams.targetFramebuffer = m_RenderTargets->ResolvedFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
-                blitParams.targetBox = blitParams.sourceBox;
-                blitParams.sampler = engine::BlitSampler::Point;
-                m_CommonPasses->BlitTexture(m_CommandList, blitParams, &m_BindingCache);
+                // When the "Split Display" parameter is nonzero, show a portion of the previously stored
+                // ReferenceColor texture on the left side of the screen by copying it into the ResolvedColor texture.
+                if (post.referenceImageSplit > 0.f)
+                {
+                    engine::BlitParameters blitParams;
+                    blitParams.sourceTexture = m_RenderTargets->ReferenceColor;
+                    blitParams.sourceBox.m_maxs = float2(post.referenceImageSplit, 1.f);
+                    blitParams.targetFramebuffer = m_RenderTargets->ResolvedFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
+                    blitParams.targetBox = blitParams.sourceBox;
+                    blitParams.sampler = engine::BlitSampler::Point;
+                    m_CommonPasses->BlitTexture(commandList, blitParams, &m_BindingCache);
+                }
             }
-        }
 
-        if(m_ui.enableToneMapping)
-        { // Tone mapping
-            render::ToneMappingParameters ToneMappingParams;
-            ToneMappingParams.minAdaptedLuminance = 0.002f;
-            ToneMappingParams.maxAdaptedLuminance = 0.2f;
-            ToneMappingParams.exposureBias = m_ui.exposureBias;
-            ToneMappingParams.eyeAdaptationSpeedUp = 2.0f;
-            ToneMappingParams.eyeAdaptationSpeedDown = 1.0f;
+            if(post.enableToneMapping)
+            { // Tone mapping
+                render::ToneMappingParameters ToneMappingParams;
+                ToneMappingParams.minAdaptedLuminance = 0.002f;
+                ToneMappingParams.maxAdaptedLuminance = 0.2f;
+                ToneMappingParams.exposureBias = post.exposureBias;
+                ToneMappingParams.eyeAdaptationSpeedUp = 2.0f;
+                ToneMappingParams.eyeAdaptationSpeedDown = 1.0f;
+
+                if (exposureResetRequired)
+                {
+                    ToneMappingParams.eyeAdaptationSpeedUp = 0.f;
+                    ToneMappingParams.eyeAdaptationSpeedDown = 0.f;
+                }
 
-            if (exposureResetRequired)
+                m_ToneMappingPass->SimpleRender(commandList, ToneMappingParams, m_UpscaledView, m_RenderTargets->ResolvedColor);
+            }
+            else
             {
-                ToneMappingParams.eyeAdaptationSpeedUp = 0.f;
-                ToneMappingParams.eyeAdaptationSpeedDown = 0.f;
+                m_CommonPasses->BlitTexture(commandList, m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView), m_RenderTargets->ResolvedColor, &m_BindingCache);
             }
 
-            m_ToneMappingPass->SimpleRender(m_CommandList, ToneMappingParams, m_UpscaledView, m_RenderTargets->ResolvedColor);
-        }
-        else
-        {
-            m_CommonPasses->BlitTexture(m_CommandList, m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView), m_RenderTargets->ResolvedColor, &m_BindingCache);
-        }
-
-        if (m_ui.visualizationMode != VIS_MODE_NONE)
-        {
-            bool haveSignal = true;
-            uint32_t inputBufferIndex = 0;
-            switch(m_ui.visualizationMode)
+            if (post.visualizationMode != VIS_MODE_NONE)
             {
-            case VIS_MODE_DENOISED_DIFFUSE:
-            case VIS_MODE_DENOISED_SPECULAR:
-                haveSignal = m_ui.enableDenoiser;
-                break;
+                bool haveSignal = true;
+                uint32_t inputBufferIndex = 0;
+                switch(post.visualizationMode)
+                {
+                case VIS_MODE_DENOISED_DIFFUSE:
+                case VIS_MODE_DENOISED_SPECULAR:
+                    haveSignal = post.enableDenoiser;
+                    break;
 
-            case VIS_MODE_DIFFUSE_CONFIDENCE:
-            case VIS_MODE_SPECULAR_CONFIDENCE:
-                haveSignal = m_ui.lightingSettings.enableGradients && m_ui.enableDenoiser;
-                break;
+                case VIS_MODE_DIFFUSE_CONFIDENCE:
+                case VIS_MODE_SPECULAR_CONFIDENCE:
+                    haveSignal = post.enableGradients && post.enableDenoiser;
+                    break;
 
-            case VIS_MODE_RESERVOIR_WEIGHT:
-            case VIS_MODE_RESERVOIR_M:
-                inputBufferIndex = m_LightingPasses->GetOutputReservoirBufferIndex();
-                haveSignal = m_ui.directLightingMode == DirectLightingMode::ReStir;
-                break;
+                case VIS_MODE_RESERVOIR_WEIGHT:
+                case VIS_MODE_RESERVOIR_M:
+                    inputBufferIndex = m_LightingPasses->GetOutputReservoirBufferIndex();
+                    haveSignal = post.directLightingMode == DirectLightingMode::ReStir;
+                    break;
                 
-            case VIS_MODE_GI_WEIGHT:
-            case VIS_MODE_GI_M:
-                inputBufferIndex = m_LightingPasses->GetGIOutputReservoirBufferIndex();
-                haveSignal = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
-                break;
+                case VIS_MODE_GI_WEIGHT:
+                case VIS_MODE_GI_M:
+                    inputBufferIndex = m_LightingPasses->GetGIOutputReservoirBufferIndex();
+                    haveSignal = post.indirectLightingMode == IndirectLightingMode::ReStirGI;
+                    break;
+                }
+
+                if (haveSignal)
+                {
+                    m_VisualizationPass->Render(
+                        commandList,
+                        m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView),
+                        m_View,
+                        m_UpscaledView,
+                        *m_isContext,
+                        inputBufferIndex,
+                        post.visualizationMode,
+                        post.aaMode == AntiAliasingMode::Accumulation);
+                }
             }
 
-            if (haveSignal)
+            switch (post.debugRenderOutputBuffer)
             {
-                m_VisualizationPass->Render(
-                    m_CommandList,
-                    m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView),
-                    m_View,
-                    m_UpscaledView,
-                    *m_isContext,
-                    inputBufferIndex,
-                    m_ui.visualizationMode,
-                    m_ui.aaMode == AntiAliasingMode::Accumulation);
+                case DebugRenderOutput::LDRColor:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->LdrColor, &m_BindingCache);
+                    break;
+                case DebugRenderOutput::Depth:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->Depth, &m_BindingCache);
+                    break;
+                case GBufferDiffuseAlbedo:
+                    m_DebugVizPasses->RenderUnpackedDiffuseAlbeo(commandList, m_UpscaledView);
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                    break;
+                case GBufferSpecularRough:
+                    m_DebugVizPasses->RenderUnpackedSpecularRoughness(commandList, m_UpscaledView);
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                    break;
+                case GBufferNormals:
+                    m_DebugVizPasses->RenderUnpackedNormals(commandList, m_UpscaledView);
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                    break;
+                case GBufferGeoNormals:
+                    m_DebugVizPasses->RenderUnpackedGeoNormals(commandList, m_UpscaledView);
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                    break;
+                case GBufferEmissive:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->GBufferEmissive, &m_BindingCache);
+                    break;
+                case DiffuseLighting:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DiffuseLighting, &m_BindingCache);
+                    break;
+                case SpecularLighting:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->SpecularLighting, &m_BindingCache);
+                    break;
+                case DenoisedDiffuseLighting:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DenoisedDiffuseLighting, &m_BindingCache);
+                    break;
+                case DenoisedSpecularLighting:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DenoisedSpecularLighting, &m_BindingCache);
+                    break;
+                case RestirLuminance:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->RestirLuminance, &m_BindingCache);
+                    break;
+                case PrevRestirLuminance:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->PrevRestirLuminance, &m_BindingCache);
+                    break;
+                case DiffuseConfidence:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DiffuseConfidence, &m_BindingCache);
+                    break;
+                case SpecularConfidence:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->SpecularConfidence, &m_BindingCache);
+                    break;
+                case MotionVectors:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->MotionVectors, &m_BindingCache);
+                    break;
+                case DebugRenderOutput::LocalLightPdf:
+                    m_CommonPasses->BlitTexture(commandList, framebuffer, m_RtxdiResources->LocalLightPdfTexture, &m_BindingCache);
+                    break;
             }
+        };
+
+        RenderGraph lightingGraph;
+        AddLightingPasses(lightingGraph, lightingSettings,
+            /* enableLightSampling = */ enableDirectReStirPass || enableIndirect,
+            enableDirectReStirPass,
+            /* enableGSGIPass = */ enableGSGIPass && virtualLightUpdate.active,
+            /* enablePMGIPass = */ enablePMGIPass && virtualLightUpdate.active,
+            enableBrdfRayPasses,
+            enableIndirect,
+            /* enableReSTIRGI = */ m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI,
+            /* enableVisualization = */ m_ui.visualizationMode != VIS_MODE_NONE);
+
+        if (m_ParallelRecording)
+        {
+            lightingGraph.BeginCommandList("Post");
+            lightingGraph.AddPass("Post", {}, {}, renderPostProcessing);
+        }
+
+        // The G-buffer pass is part of the graph so that it can overlap with the compute queue
+        if (!lightingGraph.Compile())
+        {
+            // The declaration order is valid too, but the shared heap was placed for the compiled schedules.
+            // This frame still uses it, the transient resources get memory of their own from the next frame on.
+            if (!m_RenderGraphFailed)
+                log::error("The lighting render graph failed to compile, recording its passes in declaration order and giving the transient resources their own memory");
+            m_RenderGraphFailed = true;
+            lightingGraph.Execute(m_CommandList);
+        }
+        else if (m_ParallelRecording)
+            lightingGraph.Execute(GetDevice(), m_CommandList, *m_CommandListRecorder);
+        else if (m_ComputeCommandList)
+            lightingGraph.Execute(GetDevice(), m_CommandList, m_ComputeCommandList);
+        else
+            lightingGraph.Execute(m_CommandList);
+
+        if (!m_PipelineStatisticsLogged)
+        {
+            // The first frame has created all the lighting pipelines that it needs
+            LogPipelineStatistics();
+            m_PipelineStatisticsLogged = true;
         }
 
-        switch (m_ui.debugRenderOutputBuffer)
+        if (!m_ParallelRecording)
+            renderPostProcessing(m_CommandList);
+
+        // Recorded after the "Post" command list when that is used, which is submitted before this one
+        const bool captureFrame = m_FrameCapture
+            && m_RenderFrameIndex >= m_args.captureStartFrame
+            && m_RenderFrameIndex - m_args.captureStartFrame < m_args.captureFrameCount;
+
+        if (captureFrame)
         {
-            case DebugRenderOutput::LDRColor:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->LdrColor, &m_BindingCache);
-                break;
-            case DebugRenderOutput::Depth:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->Depth, &m_BindingCache);
-                break;
-            case GBufferDiffuseAlbedo:
-                m_DebugVizPasses->RenderUnpackedDiffuseAlbeo(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
-                break;
-            case GBufferSpecularRough:
-                m_DebugVizPasses->RenderUnpackedSpecularRoughness(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
-                break;
-            case GBufferNormals:
-                m_DebugVizPasses->RenderUnpackedNormals(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
-                break;
-            case GBufferGeoNormals:
-                m_DebugVizPasses->RenderUnpackedGeoNormals(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
-                break;
-            case GBufferEmissive:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->GBufferEmissive, &m_BindingCache);
-                break;
-            case DiffuseLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DiffuseLighting, &m_BindingCache);
-                break;
-            case SpecularLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->SpecularLighting, &m_BindingCache);
-                break;
-            case DenoisedDiffuseLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DenoisedDiffuseLighting, &m_BindingCache);
-                break;
-            case DenoisedSpecularLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DenoisedSpecularLighting, &m_BindingCache);
-                break;
-            case RestirLuminance:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->RestirLuminance, &m_BindingCache);
-                break;
-            case PrevRestirLuminance:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->PrevRestirLuminance, &m_BindingCache);
-                break;
-            case DiffuseConfidence:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DiffuseConfidence, &m_BindingCache);
-                break;
-            case SpecularConfidence:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->SpecularConfidence, &m_BindingCache);
-                break;
-            case MotionVectors:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->MotionVectors, &m_BindingCache);
-                break;
-            case DebugRenderOutput::LocalLightPdf:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RtxdiResources->LocalLightPdfTexture, &m_BindingCache);
-                break;
+            m_FrameCapture->Capture(m_CommandList, m_RenderTargets->HdrColor, "HdrColor", m_RenderFrameIndex);
+            m_FrameCapture->Capture(m_CommandList, m_RenderTargets->DiffuseLighting, "DiffuseLighting", m_RenderFrameIndex);
+            m_FrameCapture->Capture(m_CommandList, m_RenderTargets->SpecularLighting, "SpecularLighting", m_RenderFrameIndex);
         }
-        
+
         m_Profiler->EndFrame(m_CommandList);
 
         m_CommandList->close();
-        GetDevice()->executeCommandList(m_CommandList);
+        CpuProfiler::Get().RecordEvent("RecordCommandList", recordingStart, CpuProfiler::Now());
+
+        {
+            CpuProfilerScope executeScope("ExecuteCommandList");
+            GetDevice()->executeCommandList(m_CommandList);
+        }
+
+        if (m_args.recordBenchmarkFrames)
+            UpdateRecordBenchmark(double(CpuProfiler::Now() - recordingStart) * 1e-6);
+
+        if (m_FrameCapture)
+            m_FrameCapture->EndFrame(m_RenderFrameIndex);
+
+        if (m_EnvironmentPdfCache)
+            m_EnvironmentPdfCache->EndFrame();
+
+        m_EnvironmentMapStreamer->EndFrame();
+        m_UploadRing->EndFrame();
 
         if (!m_args.saveFrameFileName.empty() && m_RenderFrameIndex == m_args.saveFrameIndex)
         {
@@ -1572,6 +2370,15 @@ public:
             
             glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), 1);
         }
+
+        if (!m_args.cpuReferenceFileName.empty() && m_RenderFrameIndex == m_args.saveFrameIndex)
+        {
+            bool success = RenderCpuReference();
+
+            g_ExitCode = success ? 0 : 1;
+
+            glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), 1);
+        }
         
         m_ui.gbufferSettings.enableMaterialReadback = false;
         
@@ -1614,6 +2421,31 @@ int main(int argc, char** argv)
 
     if (args.verbose)
         log::SetMinSeverity(log::Severity::Debug);
+
+    if (!args.benchmarkCompareFileName.empty())
+    {
+        // Offline comparison of two result files, no rendering
+        BenchmarkResults current;
+        if (!ReadBenchmarkResults(args.benchmarkCompareFileName, current))
+        {
+            log::error("Failed to read benchmark results from %s", args.benchmarkCompareFileName.c_str());
+            return 1;
+        }
+
+        return CompareBenchmarkWithBaseline(current, args) ? 0 : 1;
+    }
+
+    if (!args.imageDiffFileNames.empty())
+    {
+        // Offline comparison of captured images with a reference, no rendering
+        return CompareImagesWithReference(args) ? 0 : 1;
+    }
+
+    if (!args.traceOutputFileName.empty())
+    {
+        CpuProfiler::Get().Enable(true);
+        CpuProfiler::Get().SetThreadName("Main Thread");
+    }
     
     app::DeviceManager* deviceManager = app::DeviceManager::Create(args.graphicsApi);
 
@@ -1708,6 +2540,7 @@ int main(int argc, char** argv)
             deviceManager->AddRenderPassToBack(&sceneRenderer);
             deviceManager->AddRenderPassToBack(&userInterface);
             deviceManager->RunMessageLoop();
+            sceneRenderer.SaveInputRecording();
             deviceManager->GetDevice()->waitForIdle();
             deviceManager->RemoveRenderPass(&sceneRenderer);
             deviceManager->RemoveRenderPass(&userInterface);
@@ -1721,5 +2554,13 @@ int main(int argc, char** argv)
 
     delete deviceManager;
 
+    if (!args.traceOutputFileName.empty())
+    {
+        if (CpuProfiler::Get().WriteChromeTrace(args.traceOutputFileName))
+            log::info("Trace saved to %s", args.traceOutputFileName.c_str());
+        else
+            log::error("Failed to write the trace to %s", args.traceOutputFileName.c_str());
+    }
+
     return g_ExitCode;
 }